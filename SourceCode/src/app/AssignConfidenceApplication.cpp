@@ -11,9 +11,7 @@
 #include "util/Params.h"
 #include "util/StringUtils.h"
 
-#include "boost/tuple/tuple.hpp" // This will be <tuple> once we move to C++11.
-#include "boost/tuple/tuple_comparison.hpp"
-
+#include <algorithm>
 #include <map>
 #include <utility>
 
@@ -53,14 +51,123 @@ AssignConfidenceApplication::~AssignConfidenceApplication() {
  * Generate keys when building a hash on PSMs.
  * http://stackoverflow.com/questions/98153/whats-the-best-hashing-algorithm-to-use-on-a-stl-string-when-using-hash-map/
  */
-int stringToIndex(string myString) {
+int stringToIndex(const char* myString) {
   int returnValue = 0;
-  for(std::string::iterator it = myString.begin(); it != myString.end(); ++it) {
+  for (const char* it = myString; *it != '\0'; ++it) {
     returnValue = (returnValue * 101) + (int)*it;
   }
   return(returnValue);
 }
 
+/**
+ * Open-addressing hash table from (file, scan, charge, rank) to a PSM
+ * index, used to pair each target PSM with its decoy. Keys and values are
+ * kept in flat arrays and collisions are resolved by linear probing. The
+ * table is sized for the given number of PSMs up front and never grows.
+ */
+class PsmKeyTable {
+ public:
+  explicit PsmKeyTable(size_t max_psms) {
+    size_t size = 16;
+    while (size < 2 * max_psms) {
+      size <<= 1;
+    }
+    mask_ = size - 1;
+    keys_.resize(4 * size);
+    values_.resize(size, 0);
+  }
+
+  /**
+   * Stores value (> 0) for the key, unless the key is already present.
+   */
+  void insert(int file, int scan, int charge, int rank, int value) {
+    size_t slot = findSlot(file, scan, charge, rank);
+    if (values_[slot] == 0) {
+      int* key = &keys_[4 * slot];
+      key[0] = file;
+      key[1] = scan;
+      key[2] = charge;
+      key[3] = rank;
+      values_[slot] = value;
+    }
+  }
+
+  /**
+   * \returns the value stored for the key, or 0 if there is none.
+   */
+  int find(int file, int scan, int charge, int rank) const {
+    return values_[findSlot(file, scan, charge, rank)];
+  }
+
+ private:
+  /**
+   * \returns the slot holding the key, or the empty slot where it belongs.
+   */
+  size_t findSlot(int file, int scan, int charge, int rank) const {
+    uint64_t h = (uint32_t)file;
+    h = h * 0x9e3779b97f4a7c15ULL + (uint32_t)scan;
+    h = h * 0x9e3779b97f4a7c15ULL + (uint32_t)((charge << 16) ^ rank);
+    h ^= h >> 29;
+    size_t slot = (size_t)(h * 0xbf58476d1ce4e5b9ULL >> 32) & mask_;
+    while (values_[slot] != 0) {
+      const int* key = &keys_[4 * slot];
+      if (key[0] == file && key[1] == scan && key[2] == charge && key[3] == rank) {
+        break;
+      }
+      slot = (slot + 1) & mask_;
+    }
+    return slot;
+  }
+
+  vector<int> keys_;    ///< four ints per slot
+  vector<int> values_;  ///< 0 for an empty slot
+  size_t mask_;
+};
+
+/**
+ * Orders PSM indices by their scores, best first.
+ */
+class ScoreIndexLess {
+ public:
+  ScoreIndexLess(const FLOAT_T* scores, bool ascending)
+    : scores_(scores), ascending_(ascending) {}
+  bool operator()(int a, int b) const {
+    return ascending_ ? Match::ScoreLess(scores_[a], scores_[b])
+                      : Match::ScoreGreater(scores_[a], scores_[b]);
+  }
+ private:
+  const FLOAT_T* scores_;
+  bool ascending_;
+};
+
+/**
+ * Orders scores worst first, with non-finite scores as the worst.
+ */
+class ScoreWorstFirst {
+ public:
+  explicit ScoreWorstFirst(bool ascending) : ascending_(ascending) {}
+  bool operator()(FLOAT_T x, FLOAT_T y) const {
+    return ascending_ ? Match::ScoreLess(y, x) : Match::ScoreGreater(y, x);
+  }
+ private:
+  bool ascending_;
+};
+
+/**
+ * Orders PSM indices by their scores, worst first.
+ */
+class ScoreIndexWorstFirst {
+ public:
+  ScoreIndexWorstFirst(const FLOAT_T* scores, bool ascending)
+    : scores_(scores), worst_first_(ascending) {}
+  bool operator()(int a, int b) const {
+    return worst_first_(scores_[a], scores_[b]);
+  }
+ private:
+  const FLOAT_T* scores_;
+  ScoreWorstFirst worst_first_;
+};
+
 /**
 * main method for ComputeQValues
 */
@@ -171,7 +278,7 @@ int AssignConfidenceApplication::main(const vector<string> input_files) {
 
   bool distinct_matches = false;
   MatchCollectionParser parser;
-  std::map<string, FLOAT_T> BestPeptideScore;
+  PeptideScoreMap BestPeptideScore;
   
   for (vector<string>::const_iterator iter = input_files.begin(); iter != input_files.end(); ++iter) {
     string target_path = *iter;
@@ -277,7 +384,7 @@ int AssignConfidenceApplication::main(const vector<string> input_files) {
 
       // Mark decoy matches
       // key = (filename, scan number, charge, rank); value = index
-      std::map<boost::tuple <int, int, int, int>, int> pairidx;
+      PsmKeyTable pairidx(temp_collection->getMatchTotal());
       int fileIndex;
       int scanid;
       int charge;
@@ -298,7 +405,6 @@ int AssignConfidenceApplication::main(const vector<string> input_files) {
         scanid = decoy_match->getSpectrum()->getFirstScan();
         charge = decoy_match->getCharge();
         rank   = decoy_match->getRank(XCORR);
-        boost::tuple<int, int, int, int> myTuple (fileIndex, scanid, charge, rank);
 
         decoy_match->setNullPeptide(true);
         switch (estimation_method) {
@@ -311,9 +417,7 @@ int AssignConfidenceApplication::main(const vector<string> input_files) {
           // If the PSM is already there, that means there was a tie
           // for top-ranked decoys.  In that case, there is no need to
           // store a pointer to the second one.
-          if (pairidx[myTuple] == 0) {
-            pairidx[myTuple] = cnt;
-          }
+          pairidx.insert(fileIndex, scanid, charge, rank, cnt);
           break;
         case NUMBER_METHOD_TYPES:
         case INVALID_METHOD:
@@ -353,8 +457,7 @@ int AssignConfidenceApplication::main(const vector<string> input_files) {
           scanid = target_match->getSpectrum()->getFirstScan();
           charge = target_match->getCharge();
           rank   = target_match->getRank(XCORR);
-          decoy_idx = pairidx[boost::tuple <int, int, int, int>
-                              (fileIndex, scanid, charge, rank)];
+          decoy_idx = pairidx.find(fileIndex, scanid, charge, rank);
           if (decoy_idx == 0) {
             carp(CARP_DEBUG,
                  "Failed to find decoy for file=%s scan=%d charge=%d rank=%d.",
@@ -451,21 +554,18 @@ int AssignConfidenceApplication::main(const vector<string> input_files) {
         FLOAT_T score = match->getScore(score_type);
         string peptideStr = getPeptideSeq(match);
 
-        FLOAT_T bestScore;
-        try {
-          bestScore = BestPeptideScore.at(peptideStr);
-          if (bestScore != score) {  //not the best scoring peptide
-            if (is_decoy) {
-              num_decoy_peptide_skipped++;
-            } else {
-              num_target_peptide_skipped++;              
-            }
-            continue;
+        PeptideScoreMap::iterator best = BestPeptideScore.find(peptideStr);
+        if (best == BestPeptideScore.end()) {
+          carp(CARP_DEBUG, "Error in peptide-level filtering");
+        } else if (best->second != score) {  //not the best scoring peptide
+          if (is_decoy) {
+            num_decoy_peptide_skipped++;
           } else {
-            BestPeptideScore.at(peptideStr) += ascending ? -1.0 : 1.0;  //make sure only one best scoring peptide reported.
+            num_target_peptide_skipped++;              
           }
-        } catch (const std::out_of_range& oor) {
-          carp(CARP_DEBUG, "Error in peptide-level filtering");
+          continue;
+        } else {
+          best->second += ascending ? -1.0 : 1.0;  //make sure only one best scoring peptide reported.
         }
       }
 
@@ -570,9 +670,21 @@ int AssignConfidenceApplication::main(const vector<string> input_files) {
     carp(CARP_FATAL, "No estimation method specified.");
   }
 
-  // Compute q-values.
-  FLOAT_T* target_scores = target_matches->extractScores(score_type);
+  // Compute q-values. The targets are sorted by score once, through an
+  // index array, so that the q-values computed in score order can be
+  // written straight back to the matches in collection order.
+  FLOAT_T* match_scores = target_matches->extractScores(score_type);
   int num_targets = target_matches->getMatchTotal();
+  vector<int> score_order(num_targets);
+  for (int i = 0; i < num_targets; ++i) {
+    score_order[i] = i;
+  }
+  sort(score_order.begin(), score_order.end(),
+       ScoreIndexLess(match_scores, ascending));
+  FLOAT_T* target_scores = (FLOAT_T*)mymalloc(max(num_targets, 1) * sizeof(FLOAT_T));
+  for (int i = 0; i < num_targets; ++i) {
+    target_scores[i] = match_scores[score_order[i]];
+  }
   FLOAT_T* decoy_scores = decoy_matches->extractScores(score_type);
   int num_decoys = decoy_matches->getMatchTotal();
   carp(CARP_INFO,
@@ -611,12 +723,28 @@ int AssignConfidenceApplication::main(const vector<string> input_files) {
 
   free(decoy_scores);
 
-  // Store p-values to q-values as a hash, and then assign them.
-  map<FLOAT_T, FLOAT_T> qvalue_hash
-    = store_arrays_as_hash(target_scores, qvalues, num_targets);
-
-  target_matches->assignQValues(&qvalue_hash, score_type, derived_score_type);
+  // compute_decoy_qvalues_mixmax() leaves the scores sorted worst first, so
+  // the targets are sorted the same way. Reversing the best first order
+  // would not give the same order for tied or non-finite scores.
+  if (estimation_method == MIXMAX_METHOD) {
+    sort(score_order.begin(), score_order.end(),
+         ScoreIndexWorstFirst(match_scores, ascending));
+  }
+  // Targets with equal scores get the q-value of the last of them in score
+  // order, then the q-values are scattered back to collection order.
+  for (int i = num_targets - 2; i >= 0; --i) {
+    if (target_scores[i] == target_scores[i + 1]) {
+      qvalues[i] = qvalues[i + 1];
+    }
+  }
+  for (int i = 0; i < num_targets; ++i) {
+    FLOAT_T score = target_scores[i];
+    match_scores[score_order[i]] = (isinf(score) || isnan(score))
+      ? numeric_limits<FLOAT_T>::quiet_NaN() : qvalues[i];
+  }
+  target_matches->assignQValues(match_scores, derived_score_type);
 
+  free(match_scores);
   free(target_scores);
   free(qvalues);
   
@@ -751,22 +879,6 @@ void AssignConfidenceApplication::convert_fdr_to_qvalue(
   }
 }
 
-/**
- * Store two parallel arrays of floats in a hash table.
- */
-map<FLOAT_T, FLOAT_T> AssignConfidenceApplication::store_arrays_as_hash(
-  FLOAT_T* keys, 
-  FLOAT_T* values,
-  int      num_values
-) {
-  map<FLOAT_T, FLOAT_T> return_value;
-  for (int idx=0; idx < num_values; idx++) {
-    carp(CARP_DETAILED_DEBUG, "%g maps to %g", keys[idx], values[idx]);
-    return_value[keys[idx]] = values[idx];
-  }
-  return(return_value);
-}
-
 /**
  * \brief Compute q-values from a given set of scores, using a second
  * set of scores as an empirical null.  Sorts the incoming target
@@ -931,13 +1043,8 @@ FLOAT_T* AssignConfidenceApplication::compute_decoy_qvalues_mixmax(
   }
 
   //Sort decoy and target stores
-  if (ascending) {
-    sort(target_scores, target_scores + num_targets, greater<FLOAT_T>());
-    sort(decoy_scores, decoy_scores + num_decoys, greater<FLOAT_T>());
-  } else {
-    sort(target_scores, target_scores + num_targets);
-    sort(decoy_scores, decoy_scores + num_decoys);
-  }
+  sort(target_scores, target_scores + num_targets, ScoreWorstFirst(ascending));
+  sort(decoy_scores, decoy_scores + num_decoys, ScoreWorstFirst(ascending));
 
   //histogram of the target scores.
   double* h_w_le_z = new double[num_decoys + 1];   //histogram for N_{w<=z}
@@ -1016,7 +1123,7 @@ FLOAT_T* AssignConfidenceApplication::compute_decoy_qvalues_mixmax(
 
 void AssignConfidenceApplication::peptide_level_filtering(
   MatchCollection* match_collection,
-  std::map<string, FLOAT_T>* BestPeptideScore, 
+  PeptideScoreMap* BestPeptideScore, 
   SCORER_TYPE_T score_type,
   bool ascending) {
 
@@ -1027,15 +1134,14 @@ void AssignConfidenceApplication::peptide_level_filtering(
       FLOAT_T score = match->getScore(score_type);
       string peptideStr = getPeptideSeq(match);
 
-      FLOAT_T bestScore = 0.0;
-      try {
-        bestScore = BestPeptideScore->at(peptideStr);
-      } catch (const std::out_of_range& oor) {
-        BestPeptideScore->insert(std::pair<string, FLOAT_T>(peptideStr, score));
+      pair<PeptideScoreMap::iterator, bool> inserted =
+        BestPeptideScore->insert(PeptideScoreMap::value_type(peptideStr, score));
+      if (inserted.second) {
         continue;
       }
+      FLOAT_T bestScore = inserted.first->second;
       if ((ascending && bestScore > score) || (!ascending && score > bestScore)) {
-        BestPeptideScore->at(peptideStr) = score;
+        inserted.first->second = score;
       }
     }
     delete temp_iter;
@@ -22,6 +22,8 @@
 #include "io/OutputFiles.h"
 #include "model/Peptide.h"
 
+#include "boost/unordered_map.hpp"
+
 /**
  * Legal values for the --estimation-method option.
  */
@@ -36,6 +38,11 @@ enum _estimation_method {
 
 typedef enum _estimation_method ESTIMATION_METHOD_T;
 
+/**
+ * Best score seen for each peptide, keyed by the string from getPeptideSeq().
+ */
+typedef boost::unordered_map<std::string, FLOAT_T> PeptideScoreMap;
+
 class AssignConfidenceApplication : public CruxApplication {
  protected:
   map<pair<string, unsigned int>, bool>* spectrum_flag_;  // this variable is used in Cascade Search, this is an idicator 
@@ -141,7 +148,7 @@ class AssignConfidenceApplication : public CruxApplication {
 
   void peptide_level_filtering(
     MatchCollection* match_collection,
-    std::map<string, FLOAT_T>* BestPeptideScore,
+    PeptideScoreMap* BestPeptideScore,
     SCORER_TYPE_T score_type,
     bool ascending);
   
@@ -151,10 +158,6 @@ class AssignConfidenceApplication : public CruxApplication {
   void convert_fdr_to_qvalue
     (FLOAT_T* qvalues,     ///< Come in as FDRs, go out as q-values.
     int      num_values);
-  map<FLOAT_T, FLOAT_T> store_arrays_as_hash
-    (FLOAT_T* keys,
-    FLOAT_T* values,
-    int      num_values);
   FLOAT_T* compute_decoy_qvalues_tdc(
     FLOAT_T* target_scores,
     int      num_targets,
@@ -59,32 +59,56 @@ int MakePinApplication::main(const vector<string>& paths) {
     }
 
     MatchCollection* current_collection = parser.create(iter->c_str(), "");
-    if (!target_collection->getHasDistinctMatches() && current_collection->getHasDistinctMatches()) {
-      target_collection->setHasDistinctMatches(true);
-      decoy_collection->setHasDistinctMatches(true);
-    }
-    for (int scorer_idx = (int)SP; scorer_idx < (int)NUMBER_SCORER_TYPES; scorer_idx++) {
-      SCORER_TYPE_T cur_type = (SCORER_TYPE_T)scorer_idx;
-      bool scored = current_collection->getScoredType(cur_type);
-      target_collection->setScoredType(cur_type, scored);
-      decoy_collection->setScoredType(cur_type, scored);
+    splitMatches(current_collection, target_collection, decoy_collection, &max_charge);
+    delete current_collection;
+  }
+
+  return writePin(target_collection, decoy_collection, max_charge);
+}
+
+/**
+ * Adds the matches of a collection to the target or decoy collection, and
+ * updates the highest charge of the matches.
+ */
+void MakePinApplication::splitMatches(
+  MatchCollection* current_collection,
+  MatchCollection* target_collection,
+  MatchCollection* decoy_collection,
+  int* max_charge
+) {
+  if (!target_collection->getHasDistinctMatches() && current_collection->getHasDistinctMatches()) {
+    target_collection->setHasDistinctMatches(true);
+    decoy_collection->setHasDistinctMatches(true);
+  }
+  for (int scorer_idx = (int)SP; scorer_idx < (int)NUMBER_SCORER_TYPES; scorer_idx++) {
+    SCORER_TYPE_T cur_type = (SCORER_TYPE_T)scorer_idx;
+    bool scored = current_collection->getScoredType(cur_type);
+    target_collection->setScoredType(cur_type, scored);
+    decoy_collection->setScoredType(cur_type, scored);
+  }
+  MatchIterator match_iter(current_collection);
+  while (match_iter.hasNext()) {
+    Crux::Match* match = match_iter.next();
+    if (match->getNullPeptide()) {
+      decoy_collection->addMatch(match);
+    } else {
+      target_collection->addMatch(match);
     }
-    MatchIterator match_iter(current_collection);
-    while (match_iter.hasNext()) {
-      Crux::Match* match = match_iter.next();
-      if (match->getNullPeptide()) {
-        decoy_collection->addMatch(match);
-      } else {
-        target_collection->addMatch(match);
-      }
-      int charge = match->getCharge();
-      if (charge > max_charge) {
-        max_charge = charge;
-      }
+    int charge = match->getCharge();
+    if (charge > *max_charge) {
+      *max_charge = charge;
     }
-    delete current_collection;
   }
+}
 
+/**
+ * Writes the pin file and deletes the collections.
+ */
+int MakePinApplication::writePin(
+  MatchCollection* target_collection,
+  MatchCollection* decoy_collection,
+  int max_charge
+) {
   carp(CARP_INFO, "There are %d target matches and %d decoys",
        target_collection->getMatchTotal(), decoy_collection->getMatchTotal());
   if (target_collection->getMatchTotal() == 0) {
@@ -105,25 +129,7 @@ int MakePinApplication::main(const vector<string>& paths) {
   PinWriter writer;
   writer.openFile(output_filename, Params::GetString("output-dir"),
                   Params::GetBool("overwrite"));
-
-  for (int i = 1; i <= max_charge; i++) {
-    writer.setEnabledStatus("Charge" + StringUtils::ToString(i), true);
-  }
-  writer.setEnabledStatus("deltCn", target_collection->getScoredType(DELTA_CN));
-  writer.setEnabledStatus("deltLCn", target_collection->getScoredType(DELTA_LCN));
-  bool is_sp = target_collection->getScoredType(SP);
-  writer.setEnabledStatus("lnrSp", is_sp);
-  writer.setEnabledStatus("Sp", is_sp);
-  writer.setEnabledStatus("IonFrac", is_sp);
-  bool is_refactored_xcorr = target_collection->getScoredType(TIDE_SEARCH_REFACTORED_XCORR);
-  writer.setEnabledStatus("XCorr", !is_refactored_xcorr);
-  writer.setEnabledStatus("RefactoredXCorr", is_refactored_xcorr);
-  writer.setEnabledStatus("NegLog10PValue",
-                          target_collection->getScoredType(TIDE_SEARCH_EXACT_PVAL));
-  if (writer.getEnabledStatus("lnNumSP") && target_collection->getHasDistinctMatches()) {
-    writer.setEnabledStatus("lnNumSP", false);
-    writer.setEnabledStatus("lnNumDSP", true);
-  }
+  enableFeatures(&writer, target_collection, max_charge);
 
   //write .pin file 
   writer.printHeader();
@@ -136,6 +142,35 @@ int MakePinApplication::main(const vector<string>& paths) {
   return 0;
 }
 
+/**
+ * Enables the pin features that make-pin writes for matches scored like
+ * those of the target collection, with charges up to max_charge.
+ */
+void MakePinApplication::enableFeatures(
+  PinWriter* writer,
+  MatchCollection* target_collection,
+  int max_charge
+) {
+  for (int i = 1; i <= max_charge; i++) {
+    writer->setEnabledStatus("Charge" + StringUtils::ToString(i), true);
+  }
+  writer->setEnabledStatus("deltCn", target_collection->getScoredType(DELTA_CN));
+  writer->setEnabledStatus("deltLCn", target_collection->getScoredType(DELTA_LCN));
+  bool is_sp = target_collection->getScoredType(SP);
+  writer->setEnabledStatus("lnrSp", is_sp);
+  writer->setEnabledStatus("Sp", is_sp);
+  writer->setEnabledStatus("IonFrac", is_sp);
+  bool is_refactored_xcorr = target_collection->getScoredType(TIDE_SEARCH_REFACTORED_XCORR);
+  writer->setEnabledStatus("XCorr", !is_refactored_xcorr);
+  writer->setEnabledStatus("RefactoredXCorr", is_refactored_xcorr);
+  writer->setEnabledStatus("NegLog10PValue",
+                           target_collection->getScoredType(TIDE_SEARCH_EXACT_PVAL));
+  if (writer->getEnabledStatus("lnNumSP") && target_collection->getHasDistinctMatches()) {
+    writer->setEnabledStatus("lnNumSP", false);
+    writer->setEnabledStatus("lnNumDSP", true);
+  }
+}
+
 /**
  * \returns the command name for PercolatorApplication
  */
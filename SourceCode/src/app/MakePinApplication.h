@@ -15,6 +15,8 @@
 
 using namespace std;
 
+class PinWriter;
+
 class MakePinApplication: public CruxApplication {
 
  public:
@@ -39,6 +41,16 @@ class MakePinApplication: public CruxApplication {
    */
   static int main(const std::vector<std::string>& paths);
 
+  /**
+   * Enables the pin features that make-pin writes for matches scored like
+   * those of the target collection
+   */
+  static void enableFeatures(
+    PinWriter* writer,
+    MatchCollection* target_collection,
+    int max_charge
+  );
+
   /**
    * \returns the command name for MakePinApplication
    */
@@ -75,6 +87,19 @@ class MakePinApplication: public CruxApplication {
   */
 
   virtual bool hidden() const;
+
+ protected:
+  static void splitMatches(
+    MatchCollection* current_collection,
+    MatchCollection* target_collection,
+    MatchCollection* decoy_collection,
+    int* max_charge
+  );
+  static int writePin(
+    MatchCollection* target_collection,
+    MatchCollection* decoy_collection,
+    int max_charge
+  );
 };
 
 
@@ -7,6 +7,7 @@
 #include "model/MatchCollection.h"
 #include "model/ProteinMatchCollection.h"
 #include "io/HTMLWriter.h"
+#include "io/BinaryMatchFile.h"
 #include "io/MatchFileReader.h"
 #include "io/MzIdentMLReader.h"
 #include "io/MzIdentMLWriter.h"
@@ -60,7 +61,9 @@ void PSMConvertApplication::convertFile(string input_format, string output_forma
            "sqt, pin, pepxml, mzidentml, barista-xml");
     }
   } else {
-    if (StringUtils::IEndsWith(input_file, ".txt")) {
+    if (BinaryMatchFile::isBinaryMatchFile(input_file)) {
+      reader = new BinaryMatchFileReader(input_file, data);
+    } else if (StringUtils::IEndsWith(input_file, ".txt")) {
       reader = new MatchFileReader(input_file.c_str(), data);
       isTabDelimited = true;
     } else if (StringUtils::IEndsWith(input_file, ".html")) {
@@ -136,17 +136,41 @@ void ParamMedicApplication::processParams() {
   }
 }
 
+ParamMedicErrorCalculator::Config::Config():
+  charge(Params::GetInt("pm-charge")),
+  minPrecursorMz(Params::GetDouble("pm-min-precursor-mz")),
+  maxPrecursorMz(Params::GetDouble("pm-max-precursor-mz")),
+  minFragMz(Params::GetDouble("pm-min-frag-mz")),
+  maxFragMz(Params::GetDouble("pm-max-frag-mz")),
+  maxPrecursorDeltaPpm(Params::GetDouble("pm-max-precursor-delta-ppm")),
+  minScanFragPeaks(Params::GetInt("pm-min-scan-frag-peaks")),
+  topNFragPeaks(Params::GetInt("pm-top-n-frag-peaks")),
+  pairTopNFragPeaks(Params::GetInt("pm-pair-top-n-frag-peaks")),
+  minCommonFragPeaks(Params::GetInt("pm-min-common-frag-peaks")),
+  maxScanSeparation(Params::GetInt("pm-max-scan-separation")),
+  minPeakPairs(Params::GetInt("pm-min-peak-pairs")) {
+  if (charge <= 0) {
+    carp(CARP_FATAL, "pm-charge must be positive");
+  }
+  if (minPrecursorMz > maxPrecursorMz) {
+    carp(CARP_FATAL, "pm-min-precursor-mz must not be greater than pm-max-precursor-mz");
+  }
+  if (minFragMz > maxFragMz) {
+    carp(CARP_FATAL, "pm-min-frag-mz must not be greater than pm-max-frag-mz");
+  }
+}
+
 ParamMedicErrorCalculator::ParamMedicErrorCalculator():
   numTotalSpectra_(0), numPassingSpectra_(0) {
   if (!numeric_limits<double>::is_iec559) {
     carp(CARP_FATAL, "Something went wrong.");
   }
-  lowestPrecursorBinStartMz_ = Params::GetDouble("pm-min-precursor-mz") -
-    fmod(Params::GetDouble("pm-min-precursor-mz"), AVERAGINE_PEAK_SEPARATION / Params::GetInt("pm-charge"));
-  lowestFragmentBinStartMz_ = Params::GetDouble("pm-min-frag-mz") -
-    fmod(Params::GetDouble("pm-min-frag-mz"), AVERAGINE_PEAK_SEPARATION);
-  numPrecursorBins_ = getBinIndexPrecursor(Params::GetDouble("pm-max-precursor-mz")) + 1;
-  numFragmentBins_ = getBinIndexFragment(Params::GetDouble("pm-max-frag-mz")) + 1;
+  lowestPrecursorBinStartMz_ = config_.minPrecursorMz -
+    fmod(config_.minPrecursorMz, AVERAGINE_PEAK_SEPARATION / config_.charge);
+  lowestFragmentBinStartMz_ = config_.minFragMz -
+    fmod(config_.minFragMz, AVERAGINE_PEAK_SEPARATION);
+  numPrecursorBins_ = getBinIndexPrecursor(config_.maxPrecursorMz) + 1;
+  numFragmentBins_ = getBinIndexFragment(config_.maxFragMz) + 1;
 }
 
 ParamMedicErrorCalculator::~ParamMedicErrorCalculator() {
@@ -174,19 +198,19 @@ void ParamMedicErrorCalculator::processFiles(const vector<string>& files) {
 void ParamMedicErrorCalculator::processSpectrum(Spectrum* spectrum) {
   ++numTotalSpectra_;
 
-  if (spectrum->getNumPeaks() < Params::GetInt("pm-min-scan-frag-peaks")) {
+  if (spectrum->getNumPeaks() < config_.minScanFragPeaks) {
     return;
   }
 
   double precursorMz = getPrecursorMz(spectrum);
-  if (!(Params::GetDouble("pm-min-precursor-mz") <= precursorMz && precursorMz <= Params::GetDouble("pm-max-precursor-mz"))) {
+  if (!(config_.minPrecursorMz <= precursorMz && precursorMz <= config_.maxPrecursorMz)) {
     return;
   }
 
   ++numPassingSpectra_;
   // pull out the top fragments by intensity
   spectrum->sortPeaks(_PEAK_INTENSITY);
-  spectrum->truncatePeaks(Params::GetInt("pm-top-n-frag-peaks"));
+  spectrum->truncatePeaks(config_.topNFragPeaks);
 
   int precursorBinIndex = getBinIndexPrecursor(precursorMz);
   map<int, Spectrum*>::const_iterator prevIter = spectra_.find(precursorBinIndex);
@@ -196,16 +220,16 @@ void ParamMedicErrorCalculator::processSpectrum(Spectrum* spectrum) {
     const double precursorMzPrev = getPrecursorMz(prev);
     const double precursorMzDiffPpm = (precursorMz - precursorMzPrev) * MILLION / precursorMz;
     // check precursor and scan count between the scans
-    if (abs(precursorMzDiffPpm) <= Params::GetDouble("pm-max-precursor-delta-ppm") &&
-        abs(spectrum->getFirstScan() - prev->getFirstScan()) <= Params::GetInt("pm-max-scan-separation")) {
+    if (abs(precursorMzDiffPpm) <= config_.maxPrecursorDeltaPpm &&
+        abs(spectrum->getFirstScan() - prev->getFirstScan()) <= config_.maxScanSeparation) {
       // count the fragment peaks in common
       vector< pair<const Peak*, const Peak*> > pairedFragments = pairFragments(prev, spectrum);
-      if (pairedFragments.size() >= Params::GetInt("pm-min-common-frag-peaks")) {
+      if (pairedFragments.size() >= config_.minCommonFragPeaks) {
         // we've got a pair! record everything
         sort(pairedFragments.begin(), pairedFragments.end(), sortPairedFragments);
         vector< pair<const Peak*, const Peak*> >::const_iterator stop =
-          pairedFragments.size() >= Params::GetInt("pm-pair-top-n-frag-peaks")
-            ? pairedFragments.begin() + Params::GetInt("pm-pair-top-n-frag-peaks")
+          pairedFragments.size() >= config_.pairTopNFragPeaks
+            ? pairedFragments.begin() + config_.pairTopNFragPeaks
             : pairedFragments.end();
         for (vector< pair<const Peak*, const Peak*> >::const_iterator i = pairedFragments.begin();
             i != stop;
@@ -261,9 +285,9 @@ void ParamMedicErrorCalculator::calcMassErrorDist(
   }
 
   // check for conditions that would cause us to bomb out
-  if (precursorDistancesPpm.size() < Params::GetInt("pm-min-peak-pairs")) {
+  if (precursorDistancesPpm.size() < config_.minPeakPairs) {
     *precursorFailure = 
-      "Need >= " + Params::GetString("pm-min-peak-pairs") + " peak pairs to fit mixed distribution. "
+      "Need >= " + StringUtils::ToString(config_.minPeakPairs) + " peak pairs to fit mixed distribution. "
       "Got only " + StringUtils::ToString(precursorDistancesPpm.size());
   }
   if (precursorFailure->empty()) {
@@ -285,9 +309,9 @@ void ParamMedicErrorCalculator::calcMassErrorDist(
                     &precursorMuPpm2Measures, &precursorSigmaPpm2Measures);
   }
 
-  if (pairedFragmentPeaks_.size() < Params::GetInt("pm-min-peak-pairs")) {
+  if (pairedFragmentPeaks_.size() < config_.minPeakPairs) {
     *fragmentFailure =
-      "Need >= " + Params::GetString("pm-min-peak-pairs") + " peak pairs to fit mixed distribution. "
+      "Need >= " + StringUtils::ToString(config_.minPeakPairs) + " peak pairs to fit mixed distribution. "
       "Got only " + StringUtils::ToString(pairedFragmentPeaks_.size());
   }
 
@@ -396,7 +420,7 @@ void ParamMedicErrorCalculator::estimateMuSigma(
 }
 
 int ParamMedicErrorCalculator::getBinIndexPrecursor(double mz) const {
-  return (int)((mz - lowestPrecursorBinStartMz_) / (AVERAGINE_PEAK_SEPARATION / Params::GetInt("pm-charge")));
+  return (int)((mz - lowestPrecursorBinStartMz_) / (AVERAGINE_PEAK_SEPARATION / config_.charge));
 }
 
 int ParamMedicErrorCalculator::getBinIndexFragment(double mz) const {
@@ -406,7 +430,7 @@ int ParamMedicErrorCalculator::getBinIndexFragment(double mz) const {
 double ParamMedicErrorCalculator::getPrecursorMz(const Spectrum* spectrum) const {
   const vector<SpectrumZState>& zStates = spectrum->getZStates();
   for (vector<SpectrumZState>::const_iterator i = zStates.begin(); i != zStates.end(); i++) {
-    if (i->getCharge() == Params::GetInt("pm-charge")) {
+    if (i->getCharge() == config_.charge) {
       return i->getMZ();
     }
   }
@@ -435,7 +459,7 @@ map<int, const Peak*> ParamMedicErrorCalculator::binFragments(const Spectrum* sp
   for (PeakIterator i = spectrum->begin(); i != spectrum->end(); i++) {
     FLOAT_T mz = (*i)->getLocation();
     FLOAT_T intensity = (*i)->getIntensity();
-    if (mz < Params::GetDouble("pm-min-frag-mz")) {
+    if (mz < config_.minFragMz) {
       continue;
     }
     int binIndex = getBinIndexFragment(mz);
@@ -47,6 +47,26 @@ class ParamMedicErrorCalculator {
     double* sigmaFit
   );
  protected:
+  /**
+   * The param-medic parameters, read once when the calculator is created
+   * instead of being looked up by name for every spectrum and peak.
+   */
+  struct Config {
+    Config();
+    int charge;
+    double minPrecursorMz;
+    double maxPrecursorMz;
+    double minFragMz;
+    double maxFragMz;
+    double maxPrecursorDeltaPpm;
+    int minScanFragPeaks;
+    int topNFragPeaks;
+    int pairTopNFragPeaks;
+    int minCommonFragPeaks;
+    int maxScanSeparation;
+    int minPeakPairs;
+  };
+
   int getBinIndexPrecursor(double mz) const;
   int getBinIndexFragment(double mz) const;
   double getPrecursorMz(const Crux::Spectrum* spectrum) const;
@@ -66,6 +86,7 @@ class ParamMedicErrorCalculator {
     const std::pair<const Peak*, const Peak*> y
   );
 
+  const Config config_;
   // count the spectra that go by
   int numTotalSpectra_;
   int numPassingSpectra_;
@@ -16,6 +16,7 @@
 #include "util/FileUtils.h"
 #include "util/Params.h"
 #include "util/StringUtils.h"
+#include "io/BinaryMatchFile.h"
 #include "io/MzIdentMLWriter.h"
 #include "model/ProteinMatchCollection.h"
 #include "io/PMCDelimitedFileWriter.h"
@@ -48,6 +49,7 @@ int PercolatorApplication::main(int argc, char** argv) {
   if (!Params::GetBool("feature-file-in") &&
       (Params::GetBool("list-of-files") ||
        StringUtils::IEndsWith(input_pin, ".txt") ||
+       BinaryMatchFile::isBinaryMatchFile(input_pin) ||
        StringUtils::IEndsWith(input_pin, ".sqt") ||
        StringUtils::IEndsWith(input_pin, ".pep.xml") ||
        StringUtils::IEndsWith(input_pin, ".mzid"))) {
@@ -195,7 +195,15 @@ int PipelineApplication::runSearch(
   if (comet) {
     return ((CometApplication*)app)->main(spectra);
   }
-  return ((TideSearchApplication*)app)->main(spectra);
+  // Percolator gets the matches through make-pin, whose pin file the search
+  // can write while it reports them.
+  TideSearchApplication* tideApp = (TideSearchApplication*)app;
+  if (Params::GetString("post-processor") == "percolator") {
+    tideApp->writeMakePin(make_file_path("make-pin.pin"));
+  }
+  int ret = tideApp->main(spectra);
+  searchPin_ = tideApp->wroteMakePin() ? make_file_path("make-pin.pin") : "";
+  return ret;
 }
 
 int PipelineApplication::runPostProcessor(
@@ -226,6 +234,10 @@ int PipelineApplication::runPostProcessor(
   string pin;
   if (resultsFiles.size() == 1 && StringUtils::IEndsWith(resultsFiles.front(), ".pin")) {
     pin = resultsFiles.front();
+  } else if (!searchPin_.empty()) {
+    // The search wrote the make-pin file, so make-pin does not have to parse
+    // the results files.
+    pin = searchPin_;
   } else {
     // If passed anything but a single pin file, run make-pin
     pin = make_file_path("make-pin.pin");
@@ -23,6 +23,10 @@ class PipelineApplication : public CruxApplication {
  private:
   std::vector<CruxApplication*> apps_;
 
+  // make-pin file written by the search, or empty if make-pin has to be run
+  // on the results files.
+  std::string searchPin_;
+
   static void checkParams();
   static std::vector<std::string> getExpectedResultsFiles(
     CruxApplication* app,
@@ -20,6 +20,21 @@ int ReadSpectrumRecordsApplication::main(int argc, char** argv) {
     carp(CARP_FATAL, "Error reading spectrum records file");
   }
 
+  if (header.spectra_header().version() >= 2) {
+    // Spectra are after the records, see tide/indexed_spectra.h
+    SpectrumCollection spectra;
+    if (!spectra.ReadSpectrumRecords(records_file)) {
+      carp(CARP_FATAL, "Error reading spectrum records file");
+    }
+    cout << setprecision(10);
+    for (vector<Spectrum*>::const_iterator i = spectra.Spectra()->begin();
+         i != spectra.Spectra()->end();
+         ++i) {
+      show(**i);
+    }
+    return 0;
+  }
+
   show(reader);
 
   if (!reader.OK()) {
@@ -37,23 +52,27 @@ void ReadSpectrumRecordsApplication::show(
   cout << setprecision(10);
   while (!reader.Done()) {
     reader.Read(&pb_spectrum);
-    Spectrum spectrum(pb_spectrum);
+    show(Spectrum(pb_spectrum));
+  }
+}
 
-    cout << "Spectrum Number: " << spectrum.SpectrumNumber();
-    if (spectrum.PrecursorMZ() > 0)
-      cout << "  Precursor m/z: " << spectrum.PrecursorMZ();
+void ReadSpectrumRecordsApplication::show(
+  const Spectrum& spectrum
+) {
+  cout << "Spectrum Number: " << spectrum.SpectrumNumber();
+  if (spectrum.PrecursorMZ() > 0)
+    cout << "  Precursor m/z: " << spectrum.PrecursorMZ();
+  cout << endl;
+
+  if (spectrum.NumChargeStates() > 0) {
+    cout << "Charge states: " << spectrum.ChargeState(0);
+    for (int i = 1; i < spectrum.NumChargeStates(); ++i)
+      cout << ", " << spectrum.ChargeState(i);
     cout << endl;
-
-    if (spectrum.NumChargeStates() > 0) {
-      cout << "Charge states: " << spectrum.ChargeState(0);
-      for (int i = 1; i < spectrum.NumChargeStates(); ++i)
-        cout << ", " << spectrum.ChargeState(i);
-      cout << endl;
-    }
-
-    for (int i = 0; i < spectrum.Size(); ++i)
-      cout << spectrum.M_Z(i) << " " << spectrum.Intensity(i) << endl;
   }
+
+  for (int i = 0; i < spectrum.Size(); ++i)
+    cout << spectrum.M_Z(i) << " " << spectrum.Intensity(i) << endl;
 }
 
 string ReadSpectrumRecordsApplication::getName() const {
@@ -19,6 +19,7 @@ class ReadSpectrumRecordsApplication : public CruxApplication {
  protected:
 
   void show(HeadedRecordReader& reader);
+  void show(const Spectrum& spectrum);
 
  public:
 
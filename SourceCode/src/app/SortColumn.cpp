@@ -1,20 +1,206 @@
 /**
- * \file SortColumn.cpp 
- * \brief Given a delimited file and a column-name, sort the 
+ * \file SortColumn.cpp
+ * \brief Given a delimited file and a column-name, sort the
  * file.
  *****************************************************************************/
 #include "SortColumn.h"
 
-#include "io/DelimitedFile.h"
-
 #include "fdstream.hpp"
 
 #include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
 #include "util/WinCrux.h"
 #include "util/Params.h"
+#include "util/StringUtils.h"
 
 using namespace std;
 
+/**
+ * A block of rows held in memory, along with the sort key of each row.
+ * Only the key array for the column type being sorted is filled in.
+ */
+class SortColumnChunk {
+ public:
+  string text_;                   ///< rows, each followed by a newline
+  vector<size_t> row_starts_;     ///< start of each row in text_
+  vector<double> real_keys_;
+  vector<long long> int_keys_;
+  vector<size_t> string_starts_;  ///< start of each string key in text_
+  vector<unsigned int> string_lengths_;
+  vector<unsigned int> order_;    ///< row indices in sorted order
+
+  unsigned int numRows() const { return row_starts_.size(); }
+
+  size_t rowLength(unsigned int row) const {
+    size_t end = row + 1 < row_starts_.size() ? row_starts_[row + 1] : text_.size();
+    return end - row_starts_[row] - 1;
+  }
+};
+
+/**
+ * A sorted sequence of rows being merged, either an in-memory chunk or
+ * a temporary file.  Holds the current row and its key.
+ */
+class SortColumnRun {
+ public:
+  SortColumnRun(int index) : index_(index) {}
+  virtual ~SortColumnRun() {}
+
+  /**
+   * Moves to the next row. \returns false if there are no more rows.
+   */
+  virtual bool next() = 0;
+
+  int index_;               ///< position of the run in the input, for ties
+  const char* row_;
+  size_t row_length_;
+  double real_key_;
+  long long int_key_;
+  const char* string_key_;
+  size_t string_length_;
+};
+
+/**
+ * Reads the rows of a sorted chunk in order.
+ */
+class SortColumnChunkRun : public SortColumnRun {
+ public:
+  SortColumnChunkRun(int index, const SortColumnChunk* chunk)
+    : SortColumnRun(index), chunk_(chunk), position_(0) {}
+
+  bool next() {
+    if (position_ >= chunk_->order_.size()) {
+      return false;
+    }
+    unsigned int row = chunk_->order_[position_++];
+    const char* text = chunk_->text_.data();
+    row_ = text + chunk_->row_starts_[row];
+    row_length_ = chunk_->rowLength(row);
+    if (!chunk_->real_keys_.empty()) {
+      real_key_ = chunk_->real_keys_[row];
+    } else if (!chunk_->int_keys_.empty()) {
+      int_key_ = chunk_->int_keys_[row];
+    } else {
+      string_key_ = text + chunk_->string_starts_[row];
+      string_length_ = chunk_->string_lengths_[row];
+    }
+    return true;
+  }
+
+ protected:
+  const SortColumnChunk* chunk_;
+  size_t position_;
+};
+
+/**
+ * Reads the rows of a temporary file written by SortColumn::sortChunk,
+ * parsing the key of each row as it is read.
+ */
+class SortColumnFileRun : public SortColumnRun {
+ public:
+  SortColumnFileRun(int index, const string& filename, const SortColumn* sorter)
+    : SortColumnRun(index), buffer_(1 << 20), sorter_(sorter) {
+    file_.rdbuf()->pubsetbuf(&buffer_[0], buffer_.size());
+    file_.open(filename.c_str(), ios::binary);
+    if (!file_.is_open()) {
+      carp(CARP_FATAL, "Error opening temp file %s", filename.c_str());
+    }
+  }
+
+  bool next() {
+    if (!getline(file_, line_)) {
+      return false;
+    }
+    size_t start, length;
+    sorter_->parseKey(line_.data(), line_.size(),
+                      &real_key_, &int_key_, &start, &length);
+    row_ = line_.data();
+    row_length_ = line_.size();
+    string_key_ = row_ + start;
+    string_length_ = length;
+    return true;
+  }
+
+ protected:
+  vector<char> buffer_;
+  ifstream file_;
+  string line_;
+  const SortColumn* sorter_;
+};
+
+/**
+ * Orders the rows of a chunk by key, then by input order.
+ */
+class SortColumnKeyLess {
+ public:
+  SortColumnKeyLess(const SortColumnChunk* chunk, COLTYPE_T type, bool ascending)
+    : chunk_(chunk), type_(type), ascending_(ascending) {}
+
+  bool operator()(unsigned int x, unsigned int y) const {
+    int result = 0;
+    switch (type_) {
+      case COLTYPE_REAL:
+        result = chunk_->real_keys_[x] < chunk_->real_keys_[y] ? -1 :
+          (chunk_->real_keys_[y] < chunk_->real_keys_[x] ? 1 : 0);
+        break;
+      case COLTYPE_INT:
+        result = chunk_->int_keys_[x] < chunk_->int_keys_[y] ? -1 :
+          (chunk_->int_keys_[y] < chunk_->int_keys_[x] ? 1 : 0);
+        break;
+      default: {
+        const char* text = chunk_->text_.data();
+        unsigned int x_length = chunk_->string_lengths_[x];
+        unsigned int y_length = chunk_->string_lengths_[y];
+        result = memcmp(text + chunk_->string_starts_[x],
+                        text + chunk_->string_starts_[y],
+                        min(x_length, y_length));
+        if (result == 0) {
+          result = x_length < y_length ? -1 : (y_length < x_length ? 1 : 0);
+        }
+        break;
+      }
+    }
+    if (result == 0) {
+      return x < y;
+    }
+    return ascending_ ? result < 0 : result > 0;
+  }
+
+ protected:
+  const SortColumnChunk* chunk_;
+  COLTYPE_T type_;
+  bool ascending_;
+};
+
+/**
+ * Heap order for merging: the top of the heap is the run whose current
+ * row comes first.
+ */
+class SortColumnRunAfter {
+ public:
+  SortColumnRunAfter(const SortColumn* sorter, bool ascending)
+    : sorter_(sorter), ascending_(ascending) {}
+
+  bool operator()(const SortColumnRun* x, const SortColumnRun* y) const {
+    int result = sorter_->compare(x, y);
+    if (result == 0) {
+      return x->index_ > y->index_;
+    }
+    return ascending_ ? result > 0 : result < 0;
+  }
+
+ protected:
+  const SortColumn* sorter_;
+  bool ascending_;
+};
 
 /**
  * \returns a blank SortColumn object
@@ -40,137 +226,128 @@ int SortColumn::main(int argc, char** argv) {
   ascending_ = Params::GetBool("ascending");
   delimiter_ = get_delimiter_parameter("delimiter");
   header_ = Params::GetBool("header");
+  memory_budget_ = (size_t)Params::GetInt("sort-memory") << 20;
+  num_threads_ = Params::GetInt("num-threads");
+  if (num_threads_ < 1) {
+    num_threads_ = boost::thread::hardware_concurrency();
+  }
+  num_threads_ = max(num_threads_, 1);
+
+  if (column_type_ != COLTYPE_STRING && column_type_ != COLTYPE_INT &&
+      column_type_ != COLTYPE_REAL) {
+    carp(CARP_FATAL, "Unknow column type");
+  }
 
-  DelimitedFileReader delimited_file(delimited_filename_, true, delimiter_);
-  
-  int col_sort_idx = delimited_file.findColumn(column_name_string_);
+  vector<char> input_buffer(1 << 20);
+  ifstream input_file;
+  istream* input = &cin;
+  if (delimited_filename_ != "-") {
+    input_file.rdbuf()->pubsetbuf(&input_buffer[0], input_buffer.size());
+    input_file.open(delimited_filename_.c_str(), ios::binary);
+    if (!input_file.is_open()) {
+      carp(CARP_ERROR, "Error opening %s", delimited_filename_.c_str());
+      return -1;
+    }
+    input = &input_file;
+  }
 
-  if (col_sort_idx == -1) {
-    carp(CARP_ERROR, "column not found:%s\n\n%s", 
-      column_name_string_.c_str(),
-      delimited_file.getAvailableColumnsString().c_str());
+  string header_line;
+  getline(*input, header_line);
+  vector<string> column_names = StringUtils::Split(header_line, delimiter_);
+  vector<string>::const_iterator column =
+    find(column_names.begin(), column_names.end(), column_name_string_);
+
+  if (column == column_names.end()) {
+    ostringstream oss;
+    oss << "Available columns:" << endl;
+    for (unsigned int col_idx = 0; col_idx < column_names.size(); col_idx++) {
+      oss << col_idx << "  " << column_names[col_idx] << endl;
+    }
+    carp(CARP_ERROR, "column not found:%s\n\n%s",
+      column_name_string_.c_str(), oss.str().c_str());
     return -1;
   }
 
-  col_sort_idx_ = (unsigned int)col_sort_idx;
+  col_sort_idx_ = (unsigned int)(column - column_names.begin());
 
   /*
    * So to be able to handle sorting large files without reading the
-   * whole file into memory, we implement a divide-then-merge approach.  
-   * Meaning that we read in a maximum number of rows, sort these, 
-   * then write out the sorted delimited file to a temporary file.  
-   * After processing all of the rows in the original file, we then
-   * merge all the temporary files created, printing out the full sorted file.  
+   * whole file into memory, we implement a divide-then-merge approach.
+   * Rows are read into chunks of at most sort-memory / num-threads
+   * bytes, with the key of each row parsed once into an array of the
+   * column's type.  Each round reads one chunk per thread and sorts
+   * the chunks in parallel.  If the whole file fits in the first round,
+   * the chunks are merged straight from memory; otherwise each sorted
+   * chunk is written to a temporary file and the files are merged.
    */
-  vector<int> temp_file_descriptors;
-  vector<boost::fdostream*> temp_file_streams;
+  size_t chunk_bytes = max(memory_budget_ / num_threads_, (size_t)(1 << 20));
+  vector<SortColumnChunk*> chunks;
   vector<string> temp_filenames;
-
-  DelimitedFile* temp_delimited = new DelimitedFile(delimiter_);
-  for (unsigned int col_idx=0;col_idx < delimited_file.numCols();col_idx++) {
-    temp_delimited->addColumn(delimited_file.getColumnName(col_idx));
-  }
-
-  //Maximum number of rows to read before sorting then saving to a temporary file.
-  //In the future, we can set this number to be based upon how much memory
-  //is available on the system.  We want to make it large enough so that we
-  //don't have to create/merge too many temporary files, but small enough so
-  //that sort-by-column doesn't crash from not enough memory or affect the
-  //other processes on the computer.
-  int max_rows = 200000;
-
-  int current_count = 0;
-
-  while(delimited_file.hasNext()) {
-
-    unsigned int new_row = temp_delimited->addRow();
-    for (unsigned int col_idx = 0;col_idx < delimited_file.numCols();col_idx++) {
-      temp_delimited->setString(col_idx, new_row, delimited_file.getString(col_idx));
-    }
-
-    current_count++;
-
-    if (current_count >= max_rows) {
-      carp(CARP_DEBUG, "Sorting %i rows", max_rows);
-      sortDelimited(temp_delimited);
-
-      char ctemp_filename[50] = "SortColumn_XXXXXX";
-    
-      int fd = mkstemp(ctemp_filename);
-      if (fd == -1) {
-        carp(CARP_ERROR, "Error creating temp file!\n "
-                         "Error: %s", strerror(errno));
-        return(-1);
+  bool first_round = true;
+  bool in_memory = false;
+
+  while (true) {
+    vector<SortColumnChunk*> round;
+    for (int thread = 0; thread < num_threads_; thread++) {
+      SortColumnChunk* chunk = new SortColumnChunk();
+      if (!readChunk(*input, chunk_bytes, chunk)) {
+        delete chunk;
+        break;
       }
-      
-      string temp_filename(ctemp_filename);
-  
-      boost::fdostream* out = new boost::fdostream(fd);
-  
-      (*out) << (*temp_delimited);
-      temp_file_streams.push_back(out);
-      temp_file_descriptors.push_back(fd);
-      temp_filenames.push_back(temp_filename);
-      delete(temp_delimited);
-
-      //create a new delimited file.
-      temp_delimited = new DelimitedFile(delimiter_);
-
-      for (unsigned int col_idx = 0;col_idx < delimited_file.numCols();col_idx++) {
-        temp_delimited->setString(col_idx, new_row, delimited_file.getString(col_idx));
-      }
-      //reset to count so that we can read in the next batch of rows.
-      current_count = 0;
-  
+      round.push_back(chunk);
     }
-
-    delimited_file.next();
-  } 
-
-  //done reading the file, now print out the sorted version.
-
-  if (temp_file_descriptors.size() == 0) {
-
-    //no temporary files used, print out the sorted output.
-    sortDelimited(temp_delimited);
-    cout << (*temp_delimited);
-    delete temp_delimited;
-  } else {
-
-    //sort the current and save to a temporary file. 
-    sortDelimited(temp_delimited);
-    char ctemp_filename[50] = "SortColumn_XXXXXX";
-
-    int fd = mkstemp(ctemp_filename);
-
-    if (fd == -1) {
-      carp(CARP_ERROR, "Error creating temp file!\n "
-                       "Error: %s", strerror(errno));
-        return(-1);
+    if (round.empty()) {
+      break;
     }
+    bool input_done = input->eof();
+    in_memory = first_round && input_done;
+
+    carp(CARP_DEBUG, "Sorting %d chunks", (int)round.size());
+    vector<string> round_filenames(round.size());
+    boost::thread_group threads;
+    for (size_t idx = 0; idx < round.size(); idx++) {
+      threads.create_thread(boost::bind(&SortColumn::sortChunk, this, round[idx],
+        in_memory ? (string*)NULL : &round_filenames[idx]));
+    }
+    threads.join_all();
 
-    string temp_filename(ctemp_filename);
-
-    boost::fdostream* out = new boost::fdostream(fd);
-    (*out) << (*temp_delimited);
-    temp_file_streams.push_back(out);
-    temp_file_descriptors.push_back(fd);
-    temp_filenames.push_back(temp_filename);
-    delete(temp_delimited);
-
-    //flush everything.
-    for (unsigned int i=0; i < temp_file_descriptors.size(); i++) {
-      temp_file_streams[i]->flush();
+    if (in_memory) {
+      chunks = round;
+      break;
+    }
+    temp_filenames.insert(temp_filenames.end(),
+                          round_filenames.begin(), round_filenames.end());
+    for (size_t idx = 0; idx < round.size(); idx++) {
+      delete round[idx];
+    }
+    first_round = false;
+    if (input_done) {
+      break;
     }
+  }
+
+  //merge the sorted chunks or temporary files, printing out the merged output.
+  vector<SortColumnRun*> runs;
+  for (size_t idx = 0; idx < chunks.size(); idx++) {
+    runs.push_back(new SortColumnChunkRun(idx, chunks[idx]));
+  }
+  for (size_t idx = 0; idx < temp_filenames.size(); idx++) {
+    runs.push_back(new SortColumnFileRun(idx, temp_filenames[idx], this));
+  }
 
-    //merge the temporary files together, printing out the merged output.
-    mergeDelimitedFiles(temp_filenames);
+  if (header_) {
+    cout << header_line << endl;
   }
-  
+  mergeRuns(runs);
+
   //clean everything up
-  for (unsigned int idx=0; idx < temp_file_descriptors.size(); idx++) {
-    delete temp_file_streams[idx];
-    close(temp_file_descriptors[idx]);
+  for (size_t idx = 0; idx < runs.size(); idx++) {
+    delete runs[idx];
+  }
+  for (size_t idx = 0; idx < chunks.size(); idx++) {
+    delete chunks[idx];
+  }
+  for (size_t idx = 0; idx < temp_filenames.size(); idx++) {
     remove(temp_filenames[idx].c_str());
   }
 
@@ -215,6 +392,8 @@ vector<string> SortColumn::getOptions() const {
     "header",
     "column-type",
     "ascending",
+    "sort-memory",
+    "num-threads",
     "verbosity"
   };
   return vector<string>(arr, arr + sizeof(arr) / sizeof(string));
@@ -232,132 +411,215 @@ vector< pair<string, string> > SortColumn::getOutputs() const {
 }
 
 /**
- * sorts the delimited file based upon the column type parameter
+ * Reads rows into chunk until it holds max_bytes of rows and keys or
+ * the input ends. \returns false if no rows were read.
  */
-void SortColumn::sortDelimited(
-  DelimitedFile* delimited ///< delimited file to sort.
+bool SortColumn::readChunk(
+  istream& input, ///< the delimited rows -in
+  size_t max_bytes, ///< memory budget for the chunk -in
+  SortColumnChunk* chunk ///< chunk to fill -out
   ) {
 
-  switch(column_type_) {
-
-    case COLTYPE_STRING:
-      delimited->sortByStringColumn(column_name_string_, ascending_);
-      break;
-    case COLTYPE_INT:
-      delimited->sortByIntegerColumn(column_name_string_, ascending_);
-      break;
-    case COLTYPE_REAL:
-      delimited->sortByFloatColumn(column_name_string_, ascending_);
-      break;
-    case NUMBER_COLTYPES:
-    case COLTYPE_INVALID:
-      carp(CARP_FATAL, "Unknow column type");
+  size_t key_bytes = column_type_ == COLTYPE_STRING
+    ? sizeof(size_t) + sizeof(unsigned int) : sizeof(double);
+  size_t row_bytes = sizeof(size_t) + sizeof(unsigned int) + key_bytes;
+  size_t used = 0;
+  string line;
+  while (used < max_bytes && getline(input, line)) {
+    if (line.empty()) {
+      continue;
+    }
+    size_t start = chunk->text_.size();
+    chunk->row_starts_.push_back(start);
+    chunk->text_.append(line);
+    chunk->text_.push_back('\n');
+
+    double real_key;
+    long long int_key;
+    size_t key_start, key_length;
+    parseKey(line.data(), line.size(), &real_key, &int_key, &key_start, &key_length);
+    switch (column_type_) {
+      case COLTYPE_REAL:
+        chunk->real_keys_.push_back(real_key);
+        break;
+      case COLTYPE_INT:
+        chunk->int_keys_.push_back(int_key);
+        break;
+      default:
+        chunk->string_starts_.push_back(start + key_start);
+        chunk->string_lengths_.push_back(key_length);
+        break;
+    }
+    used += line.size() + 1 + row_bytes;
   }
+  return chunk->numRows() > 0;
 }
 
 /**
- * merges a list of sorted delimited files and prints 
- * out the resulting sorted file.  This method accomplishes this
- * by testing the current row of each temporary file against
- * the others.  If it's compare value is the smallest (or largest when descending)
- * then printout that temporary file's row and advance the next row.
- * Keep iterating until all rows for all temporary files are printed out.
+ * Sorts the rows of a chunk by their keys and, if temp_filename is not
+ * NULL, writes them to a new temporary file whose name is stored there.
  */
-void SortColumn::mergeDelimitedFiles(
-  vector<string>& temp_filenames
+void SortColumn::sortChunk(
+  SortColumnChunk* chunk, ///< chunk to sort -in/out
+  string* temp_filename ///< name of the temporary file -out
   ) {
 
-  //open the temporary delimited files using a reader.
-  vector<DelimitedFileReader*> delimited_files;
-  for (unsigned int idx=0;idx < temp_filenames.size();idx++) {
-    delimited_files.push_back(new DelimitedFileReader(temp_filenames[idx], delimiter_));
+  chunk->order_.resize(chunk->numRows());
+  for (unsigned int row = 0; row < chunk->numRows(); row++) {
+    chunk->order_[row] = row;
   }
-  
-  //print out the header if requested.
-  if (header_) {
-    cout << delimited_files[0]->getHeaderString() << endl;
+  sort(chunk->order_.begin(), chunk->order_.end(),
+       SortColumnKeyLess(chunk, column_type_, ascending_));
+
+  if (temp_filename == NULL) {
+    return;
   }
 
-  int best_idx = -1;
-
-  do {
-    best_idx = -1;
-    //find the temporary file whose current row's column value is the
-    //smallest or largest.
-    for (unsigned int idx = 0;idx < delimited_files.size();idx++) {
-      if (delimited_files[idx]->hasNext()) {
-        if (best_idx == -1) {
-          best_idx = idx;
-        } else {
-          int compare_result = compare(delimited_files[idx], delimited_files[best_idx]);
-          if ((ascending_) && (compare_result == -1)) {
-            best_idx = idx;
-          } else if ((!ascending_) && (compare_result == 1)) {
-            best_idx = idx;
-          }
-        }
-      }
-  
-      //if a best was found, print out the row and advance to the
-      //next row.
-      if (best_idx != -1) {
-        cout << delimited_files[best_idx]->getString() << endl;
-        delimited_files[best_idx]->next();
-      }
+  char ctemp_filename[50] = "SortColumn_XXXXXX";
+  int fd = mkstemp(ctemp_filename);
+  if (fd == -1) {
+    carp(CARP_FATAL, "Error creating temp file!\n "
+                     "Error: %s", strerror(errno));
+  }
+  *temp_filename = ctemp_filename;
+
+  boost::fdostream out(fd);
+  const char* text = chunk->text_.data();
+  for (size_t idx = 0; idx < chunk->order_.size(); idx++) {
+    unsigned int row = chunk->order_[idx];
+    out.write(text + chunk->row_starts_[row], chunk->rowLength(row) + 1);
+  }
+  out.flush();
+  if (!out) {
+    carp(CARP_FATAL, "Error writing temp file %s", ctemp_filename);
+  }
+  close(fd);
+
+  // the rows are on disk now
+  string().swap(chunk->text_);
+}
+
+/**
+ * merges sorted runs and prints out the resulting sorted rows.  The
+ * current row of each run is kept in a heap ordered by its key, so each
+ * row costs O(log runs) comparisons.  Rows with equal keys are printed
+ * in the order they appeared in the input.
+ */
+void SortColumn::mergeRuns(
+  vector<SortColumnRun*>& runs
+  ) {
+
+  SortColumnRunAfter after(this, ascending_);
+  vector<SortColumnRun*> heap;
+  for (size_t idx = 0; idx < runs.size(); idx++) {
+    if (runs[idx]->next()) {
+      heap.push_back(runs[idx]);
     }
-    //iterate until all rows of all temporary files are printed out.
-  } while (best_idx != -1);
+  }
+  make_heap(heap.begin(), heap.end(), after);
+
+  const size_t kFlushBytes = 1 << 20;
+  string output;
+  output.reserve(kFlushBytes + 4096);
+  while (!heap.empty()) {
+    pop_heap(heap.begin(), heap.end(), after);
+    SortColumnRun* run = heap.back();
+    output.append(run->row_, run->row_length_);
+    output.push_back('\n');
+    if (output.size() >= kFlushBytes) {
+      cout.write(output.data(), output.size());
+      output.clear();
+    }
+    if (run->next()) {
+      push_heap(heap.begin(), heap.end(), after);
+    } else {
+      heap.pop_back();
+    }
+  }
+  cout.write(output.data(), output.size());
+  cout.flush();
+}
+
+/**
+ * Parses the key of a row from its sort column.  A missing or empty
+ * field has key 0 (or the empty string), and a real value that is not a
+ * number sorts below all others.
+ */
+void SortColumn::parseKey(
+  const char* row, ///< the row -in
+  size_t length, ///< length of the row -in
+  double* real_key, ///< key for COLTYPE_REAL -out
+  long long* int_key, ///< key for COLTYPE_INT -out
+  size_t* string_start, ///< start of the field in the row -out
+  size_t* string_length ///< length of the field -out
+  ) const {
+
+  const char* end = row + length;
+  const char* field = row;
+  for (unsigned int col_idx = 0; col_idx < col_sort_idx_ && field < end; col_idx++) {
+    const char* delimiter = (const char*)memchr(field, delimiter_, end - field);
+    field = delimiter == NULL ? end : delimiter + 1;
+  }
+  const char* field_end = (const char*)memchr(field, delimiter_, end - field);
+  if (field_end == NULL) {
+    field_end = end;
+  }
+  *string_start = field - row;
+  *string_length = field_end - field;
 
-  for (unsigned int idx = 0; idx < temp_filenames.size(); idx++) {
-    delete delimited_files[idx];
+  *real_key = 0;
+  *int_key = 0;
+  if (column_type_ == COLTYPE_STRING || field == field_end) {
+    return;
+  }
+  char buffer[64];
+  string long_field;
+  const char* value = buffer;
+  size_t field_length = field_end - field;
+  if (field_length < sizeof(buffer)) {
+    memcpy(buffer, field, field_length);
+    buffer[field_length] = '\0';
+  } else {
+    long_field.assign(field, field_length);
+    value = long_field.c_str();
+  }
+  if (column_type_ == COLTYPE_REAL) {
+    *real_key = strtod(value, NULL);
+    if (*real_key != *real_key) {
+      *real_key = -HUGE_VAL;
+    }
+  } else {
+    *int_key = strtoll(value, NULL, 10);
   }
 }
 
 /**
- * \returns the result of comparing two file(s) current row and column: 
- * 1 : file1 > file2
- * -1 : file1 < file2
- * 0 : file1 = file2
+ * \returns the result of comparing the keys of two runs' current rows:
+ * 1 : run1 > run2
+ * -1 : run1 < run2
+ * 0 : run1 = run2
  */
 int SortColumn::compare(
-  DelimitedFileReader* file1, 
-  DelimitedFileReader* file2
-  ) {
+  const SortColumnRun* run1,
+  const SortColumnRun* run2
+  ) const {
 
-  bool isless = false;
-  bool isequal = false;
-  
   switch (column_type_) {
-    case COLTYPE_STRING:
-      isless = file1->getString(col_sort_idx_) < file2->getString(col_sort_idx_);
-      if (!isless) {
-        isequal = file1->getString(col_sort_idx_) == file2->getString(col_sort_idx_);
-      }
-    break;
     case COLTYPE_REAL:
-      isless = file1->getDouble(col_sort_idx_) < file2->getDouble(col_sort_idx_);
-      if (!isless) {
-        isequal = file1->getDouble(col_sort_idx_) == file2->getDouble(col_sort_idx_);
-      }
-    break;
+      return run1->real_key_ < run2->real_key_ ? -1 :
+        (run2->real_key_ < run1->real_key_ ? 1 : 0);
     case COLTYPE_INT:
-      isless = file1->getInteger(col_sort_idx_) < file2->getInteger(col_sort_idx_);
-      if (!isless) {
-        isequal = file1->getInteger(col_sort_idx_) == file2->getInteger(col_sort_idx_);
+      return run1->int_key_ < run2->int_key_ ? -1 :
+        (run2->int_key_ < run1->int_key_ ? 1 : 0);
+    default: {
+      int result = memcmp(run1->string_key_, run2->string_key_,
+                          min(run1->string_length_, run2->string_length_));
+      if (result != 0) {
+        return result < 0 ? -1 : 1;
       }
-    break;
-    case NUMBER_COLTYPES:
-    case COLTYPE_INVALID:
-      carp(CARP_FATAL, "Column type invalid!");
-
-  }
-
-  if (isless) {
-    return -1;
-  } else if (isequal) {
-    return 0;
-  } else {
-    return 1;
+      return run1->string_length_ < run2->string_length_ ? -1 :
+        (run2->string_length_ < run1->string_length_ ? 1 : 0);
+    }
   }
 }
 
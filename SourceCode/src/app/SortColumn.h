@@ -14,8 +14,14 @@
 #include <string>
 #include <vector>
 
+class SortColumnChunk;
+class SortColumnRun;
+
 class SortColumn: public CruxApplication {
 
+  friend class SortColumnFileRun;
+  friend class SortColumnRunAfter;
+
  protected:
   //parameters
   std::string delimited_filename_; ///<delimited filename to sort
@@ -25,34 +31,60 @@ class SortColumn: public CruxApplication {
   char delimiter_;            ///<file's delimiter
   bool header_;               ///<print out the header?
   unsigned int col_sort_idx_; ///<column index to sort by
+  size_t memory_budget_;      ///<bytes of rows and keys to hold in memory
+  int num_threads_;           ///<threads used to sort chunks
 
   //private methods.
   /**
-   * sorts the delimited file based upon the column type parameter
+   * Reads rows into chunk until it holds max_bytes of rows and keys or
+   * the input ends. \returns false if no rows were read.
    */
-  void sortDelimited(
-    DelimitedFile* delimited
+  bool readChunk(
+    std::istream& input,
+    size_t max_bytes,
+    SortColumnChunk* chunk
   );
 
   /**
-   * merges a list of sorted delimited files and prints 
-   * out the resulting sorted file.
+   * Sorts the rows of a chunk by their keys and, if temp_filename is
+   * not NULL, writes them to a new temporary file whose name is stored
+   * there.
    */
-  void mergeDelimitedFiles(
-    std::vector<std::string>& temp_filenames
+  void sortChunk(
+    SortColumnChunk* chunk,
+    std::string* temp_filename
   );
 
   /**
-   * /returns the result of comparing two file(s) current row and column: 
-   * 1 : file1 > file2
-   * -1 : file1 < file2
-   * 0 : file1 = file2
+   * Merges sorted runs, writing the rows to standard output.
    */
-  int compare(
-    DelimitedFileReader* file1,
-    DelimitedFileReader* file2
+  void mergeRuns(
+    std::vector<SortColumnRun*>& runs
   );
 
+  /**
+   * Parses the key of a row from its sort column.
+   */
+  void parseKey(
+    const char* row,
+    size_t length,
+    double* real_key,
+    long long* int_key,
+    size_t* string_start,
+    size_t* string_length
+  ) const;
+
+  /**
+   * /returns the result of comparing the keys of two runs' current rows:
+   * 1 : run1 > run2
+   * -1 : run1 < run2
+   * 0 : run1 = run2
+   */
+  int compare(
+    const SortColumnRun* run1,
+    const SortColumnRun* run2
+  ) const;
+
 
  public:
 
@@ -6,6 +6,11 @@
 #include "model/Peptide.h"
 #include "model/ProteinPeptideIterator.h"
 #include "io/SpectrumCollectionFactory.h"
+#include "util/GlobalParams.h"
+#include "util/StringUtils.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
 
 using namespace std;
 using namespace Crux;
@@ -428,50 +433,191 @@ void SpectralCounts::computeEmpai() {
 }
 
 /**
- * For the spectrum associated with the match, sum the intensities of
- * all b and y ions that are not modified.
- * \return The sum of unmodified b and y ions.
+ * What the SIN computation needs from one match, gathered up front so that
+ * the worker threads do not touch the Match objects.
  */
-FLOAT_T SpectralCounts::sumMatchIntensity(Match* match,
-                                        Crux::SpectrumCollection* spectra) {
-  FLOAT_T match_intensity = 0;
-  char* peptide_seq = match->getSequence();
-  MODIFIED_AA_T* modified_sequence = match->getModSequence();
-  int charge = match->getCharge();
-  Spectrum* temp = match->getSpectrum();
-  int scan = temp->getFirstScan();
-
-  Spectrum* spectrum = spectra->getSpectrum(scan);
-
-  if (spectrum == NULL) {
-    carp(CARP_FATAL, "scan: %d doesn't exist or not found!");
-    return 0.0;
-  }
+struct SinMatch {
+  int scan;
+  int max_charge;  ///< highest fragment ion charge
+  int length;
+  MODIFIED_AA_T* sequence;
+  int match_idx;   ///< index into the list of matches
+};
+
+static bool compareSinMatchScans(const SinMatch& x, const SinMatch& y) {
+  return x.scan < y.scan;
+}
+
+/**
+ * State shared by the threads computing SIN intensities. The matches are
+ * sorted by scan, so each spectrum is read once and all of its matches
+ * are summed by the same thread.
+ */
+struct SinJob {
+  Crux::SpectrumCollection* spectra;
+  FLOAT_T bin_width;
+  const vector<SinMatch>* matches;
+  vector<size_t> group_starts;  ///< start of each scan's matches, then the end
+  size_t next_group;
+  boost::mutex lock;  ///< guards next_group and reading spectra
+  vector<FLOAT_T>* intensities;  ///< by match_idx -out
+};
+
+/**
+ * Thread body for SIN: takes the matches to one spectrum at a time, sums
+ * the intensities of the peaks nearest to the b and y ions of each
+ * match, and repeats until all spectra are done. The fragment and peak
+ * buffers are reused across spectra.
+ */
+static void sumSpectrumIntensities(SinJob* job) {
+  vector<FLOAT_T> residues;
+  vector<FLOAT_T> fragments;
+  vector< pair<FLOAT_T, FLOAT_T> > peaks;  // (m/z, intensity)
+  while (true) {
+    size_t group;
+    Spectrum* spectrum;
+    {
+      boost::mutex::scoped_lock guard(job->lock);
+      if (job->next_group + 1 >= job->group_starts.size()) {
+        return;
+      }
+      group = job->next_group++;
+      int scan = (*job->matches)[job->group_starts[group]].scan;
+      spectrum = job->spectra->getSpectrum(scan);
+      if (spectrum == NULL) {
+        carp(CARP_FATAL, "scan: %d doesn't exist or not found!", scan);
+      }
+    }
 
-  Ion* ion;
-  SCORER_TYPE_T score_type = XCORR;
-  IonConstraint* ion_constraint =
-    IonConstraint::newIonConstraintSmart(score_type, charge);
-  IonSeries* ion_series = new IonSeries(ion_constraint, charge);
-  ion_series->update(peptide_seq, modified_sequence);
-  ion_series->predictIons();
-  for (IonIterator ion_it = ion_series->begin();
-       ion_it != ion_series->end(); ++ion_it) {
-    ion = (*ion_it);
-    if (ion -> getType() == B_ION || ion -> getType() == Y_ION) {
-      if (!ion->isModified()) {
-        Peak * peak = spectrum->getNearestPeak(ion->getMassZ(),
-                                                bin_width_);
-        if (peak != NULL) {
-          match_intensity += peak->getIntensity();
+    peaks.clear();
+    const vector<FLOAT_T>& peak_mzs = spectrum->getPeakMzs();
+    const vector<FLOAT_T>& peak_intensities = spectrum->getPeakIntensities();
+    for (size_t peak = 0; peak < peak_mzs.size(); ++peak) {
+      peaks.push_back(make_pair(peak_mzs[peak], peak_intensities[peak]));
+    }
+    delete spectrum;
+    sort(peaks.begin(), peaks.end());
+
+    for (size_t idx = job->group_starts[group];
+         idx < job->group_starts[group + 1]; ++idx) {
+      const SinMatch& match = (*job->matches)[idx];
+      // b and y ion m/z at each charge, computed as IonSeries does
+      residues.resize(match.length);
+      FLOAT_T total = 0;
+      for (int aa = 0; aa < match.length; ++aa) {
+        residues[aa] = get_mass_mod_amino_acid(match.sequence[aa], MONO);
+        total += residues[aa];
+      }
+      fragments.clear();
+      FLOAT_T prefix = residues[0];
+      for (int cleavage = 1; cleavage < match.length; ++cleavage) {
+        FLOAT_T b_mass = prefix;
+        FLOAT_T y_mass = total - prefix + MASS_H2O_MONO;
+        for (int charge = 1; charge <= match.max_charge; ++charge) {
+          fragments.push_back((b_mass + MASS_H_MONO * charge) / charge);
+          fragments.push_back((y_mass + MASS_H_MONO * charge) / charge);
         }
+        prefix += residues[cleavage];
       }
+      sort(fragments.begin(), fragments.end());
+
+      // Merge walk: for each fragment, the nearest peak is one of the two
+      // peaks around it. Ties go to the lower m/z.
+      FLOAT_T intensity = 0;
+      size_t peak = 0;
+      for (vector<FLOAT_T>::const_iterator mz = fragments.begin();
+           mz != fragments.end(); ++mz) {
+        while (peak < peaks.size() && peaks[peak].first < *mz) {
+          ++peak;
+        }
+        FLOAT_T best_distance = BILLION;
+        FLOAT_T best_intensity = 0;
+        if (peak > 0) {
+          best_distance = *mz - peaks[peak - 1].first;
+          best_intensity = peaks[peak - 1].second;
+        }
+        if (peak < peaks.size() && peaks[peak].first - *mz < best_distance) {
+          best_distance = peaks[peak].first - *mz;
+          best_intensity = peaks[peak].second;
+        }
+        if (best_distance <= job->bin_width) {
+          intensity += best_intensity;
+        }
+      }
+      (*job->intensities)[match.match_idx] = intensity;
     }
   }
-  delete ion_series;
-  free(peptide_seq);
+}
 
-  return match_intensity;
+/**
+ * For the spectrum associated with each match, sum the intensities of
+ * all b and y ions that are not modified. The spectra are processed in
+ * parallel, using num-threads threads.
+ */
+void SpectralCounts::sumMatchIntensities(
+  Crux::SpectrumCollection* spectra,
+  const vector<Match*>& matches,
+  vector<FLOAT_T>* intensities ///< sum of unmodified b and y ions -out
+) {
+  intensities->assign(matches.size(), 0);
+  if (matches.empty()) {
+    return;
+  }
+
+  // Fragment charges as in IonConstraint::newIonConstraintSequestXcorr.
+  int max_ion_charge = 0;
+  const string& charge_str = GlobalParams::getMaxIonCharge();
+  if (charge_str != "peptide" &&
+      !StringUtils::TryFromString(charge_str, &max_ion_charge)) {
+    carp_once(CARP_WARNING, "Charge is not valid:%s", charge_str.c_str());
+  }
+
+  vector<SinMatch> sin_matches(matches.size());
+  for (size_t idx = 0; idx < matches.size(); ++idx) {
+    Match* match = matches[idx];
+    SinMatch& sin_match = sin_matches[idx];
+    sin_match.scan = match->getSpectrum()->getFirstScan();
+    sin_match.max_charge = max(1, match->getCharge() - 1);
+    if (max_ion_charge > 0) {
+      sin_match.max_charge = min(max_ion_charge, sin_match.max_charge);
+    }
+    sin_match.length = match->getPeptide()->getLength();
+    sin_match.sequence = match->getModSequence();
+    sin_match.match_idx = idx;
+  }
+  stable_sort(sin_matches.begin(), sin_matches.end(), compareSinMatchScans);
+  // Initialize the amino acid masses before the threads read them.
+  get_mass_mod_amino_acid(sin_matches[0].sequence[0], MONO);
+
+  SinJob job;
+  job.spectra = spectra;
+  job.bin_width = bin_width_;
+  job.matches = &sin_matches;
+  for (size_t idx = 0; idx < sin_matches.size(); ++idx) {
+    if (idx == 0 || sin_matches[idx].scan != sin_matches[idx - 1].scan) {
+      job.group_starts.push_back(idx);
+    }
+  }
+  job.group_starts.push_back(sin_matches.size());
+  job.next_group = 0;
+  job.intensities = intensities;
+
+  int num_threads = Params::GetInt("num-threads");
+  if (num_threads < 1) {
+    num_threads = boost::thread::hardware_concurrency();
+  }
+  num_threads = max(1, min(num_threads, (int)job.group_starts.size() - 1));
+  carp(CARP_DEBUG, "Computing SIN for %d spectra with %d threads.",
+       (int)job.group_starts.size() - 1, num_threads);
+  boost::thread_group threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.create_thread(boost::bind(sumSpectrumIntensities, &job));
+  }
+  threads.join_all();
+
+  for (size_t idx = 0; idx < sin_matches.size(); ++idx) {
+    free(sin_matches[idx].sequence);
+  }
 }
 
 
@@ -495,16 +641,21 @@ void SpectralCounts::getPeptideScores() {
     spectra = SpectrumCollectionFactory::create(Params::GetString("input-ms2"));
   }
 
-  for(set<Match*>::iterator match_it = matches_.begin();
-      match_it != matches_.end(); ++match_it) {
+  vector<Match*> matches(matches_.begin(), matches_.end());
+  // for sin, calculate total ion intensity for each match by
+  // summing up peak intensities
+  vector<FLOAT_T> intensities;
+  if (measure_ == MEASURE_SIN) {
+    sumMatchIntensities(spectra, matches, &intensities);
+  }
+
+  for (size_t match_idx = 0; match_idx < matches.size(); ++match_idx) {
 
     FLOAT_T match_intensity = 1; // for NSAF just count each for the peptide/
 
-    Match* match = (*match_it);
-    // for sin, calculate total ion intensity for match by
-    // summing up peak intensities
+    Match* match = matches[match_idx];
     if (measure_ == MEASURE_SIN) {
-      match_intensity = sumMatchIntensity(match, spectra);
+      match_intensity = intensities[match_idx];
     }
 
     // add ion_intensity to peptide scores
@@ -894,36 +1045,86 @@ void SpectralCounts::getMetaRanks() {
 void SpectralCounts::performParsimonyAnalysis() {
   carp(CARP_DEBUG, "Performing Greedy Parsimony analysis");
   MetaMapping result(comparePeptideSets);
-  vector< pair<PeptideSet, MetaProtein > > peps_vector;
 
-  // get all meta mappings into a vector 
+  // Give each distinct peptide an integer id and each meta protein the list
+  // of ids of its peptides.
+  int num_metas = meta_mapping_.size();
+  vector<MetaMapping::iterator> metas;
+  metas.reserve(num_metas);
+  map<Peptide*, int, bool(*)(Peptide*, Peptide*)> peptide_ids(Peptide::lessThan);
+  vector< vector<int> > meta_peptides(num_metas);
   for (MetaMapping::iterator meta_iter = meta_mapping_.begin();
        meta_iter != meta_mapping_.end(); ++meta_iter) {
-    peps_vector.push_back((*meta_iter));
+    vector<int>& ids = meta_peptides[metas.size()];
+    metas.push_back(meta_iter);
+    const PeptideSet& peptides = meta_iter->first;
+    ids.reserve(peptides.size());
+    for (PeptideSet::const_iterator pep_iter = peptides.begin();
+         pep_iter != peptides.end(); ++pep_iter) {
+      int next_id = peptide_ids.size();
+      ids.push_back(peptide_ids.insert(make_pair(*pep_iter, next_id)).first->second);
+    }
+  }
+
+  // Inverted index from each peptide to the meta proteins containing it.
+  vector< vector<int> > peptide_metas(peptide_ids.size());
+  for (int meta = 0; meta < num_metas; ++meta) {
+    for (vector<int>::const_iterator id = meta_peptides[meta].begin();
+         id != meta_peptides[meta].end(); ++id) {
+      peptide_metas[*id].push_back(meta);
+    }
   }
 
+  // Bucket queue of the meta proteins not yet picked, keyed by the number
+  // of their peptides not yet claimed by a picked meta protein.
+  vector<int> remaining(num_metas);
+  size_t max_remaining = 0;
+  for (int meta = 0; meta < num_metas; ++meta) {
+    remaining[meta] = meta_peptides[meta].size();
+    max_remaining = max(max_remaining, meta_peptides[meta].size());
+  }
+  vector< set<int> > buckets(max_remaining + 1);
+  for (int meta = 0; meta < num_metas; ++meta) {
+    buckets[remaining[meta]].insert(meta);
+  }
+  vector<bool> claimed(peptide_ids.size(), false);
 
   // greedy algorithm to pick off the meta proteins with
-  // most peptide mappings
-  while (!peps_vector.empty()) {
-    sort(peps_vector.begin(), peps_vector.end(), setsAreEqualSize);
-    pair<PeptideSet, MetaProtein> node = peps_vector.back();
-    peps_vector.pop_back();
-    if (node.first.size() == 0) { break; }// do not enter anything without peptide sizes
-    result.insert(node);
-    PeptideSet cur_peptides = node.first;
-    // update the peptide sets for the rest of meta proteins
-    for (vector< pair<PeptideSet, MetaProtein > >::iterator
-         iter = peps_vector.begin();
-         iter != peps_vector.end(); ++iter) {
-      PeptideSet peptides = (*iter).first;
-      PeptideSet difference(Peptide::lessThan);
-      set_difference(peptides.begin(), peptides.end(),
-                     cur_peptides.begin(), cur_peptides.end(),
-                     inserter(difference, difference.end()),
-                    Peptide::lessThan);
-      (*iter).first = difference;
+  // most peptide mappings. Ties go to the meta protein that comes first in
+  // meta_mapping_.
+  size_t top = max_remaining;
+  while (true) {
+    while (top > 0 && buckets[top].empty()) {
+      --top;
     }
+    if (top == 0) { break; } // do not enter anything without peptide sizes
+    int picked = *buckets[top].begin();
+    buckets[top].erase(buckets[top].begin());
+
+    // Enter the peptides of this meta protein that no earlier pick has
+    // claimed, and take them away from the rest of the meta proteins.
+    PeptideSet cur_peptides(Peptide::lessThan);
+    const PeptideSet& peptides = metas[picked]->first;
+    PeptideSet::const_iterator pep_iter = peptides.begin();
+    for (vector<int>::const_iterator id = meta_peptides[picked].begin();
+         id != meta_peptides[picked].end(); ++id, ++pep_iter) {
+      if (claimed[*id]) {
+        continue;
+      }
+      claimed[*id] = true;
+      cur_peptides.insert(cur_peptides.end(), *pep_iter);
+      for (vector<int>::const_iterator other = peptide_metas[*id].begin();
+           other != peptide_metas[*id].end(); ++other) {
+        if (*other == picked) {
+          continue;
+        }
+        int& count = remaining[*other];
+        if (buckets[count].erase(*other) > 0) {
+          buckets[--count].insert(*other);
+        }
+      }
+    }
+    result.insert(make_pair(cur_peptides, metas[picked]->second));
   }
   meta_mapping_ = result;
 }
@@ -1038,6 +1239,7 @@ vector<string> SpectralCounts::getOptions() const {
     "threshold-type",
     "input-ms2",
     "spectrum-parser",
+    "scan-index-cache",
     "fileroot",
     "output-dir",
     "overwrite",
@@ -1047,7 +1249,8 @@ vector<string> SpectralCounts::getOptions() const {
     "custom-threshold-name",
     "custom-threshold-min",
     "mzid-use-pass-threshold",
-    "protein-database"
+    "protein-database",
+    "num-threads"
   };
   return vector<string>(arr, arr + sizeof(arr) / sizeof(string));
 }
@@ -1130,16 +1333,6 @@ bool SpectralCounts::compareMetaProteins(MetaProtein set_one,
   return set_one.size() < set_two.size();
 }
 
-/**
- * Compare the size of the PeptideSets in the two given pairs.
- * \returns True if the PeptideSets are the same size, else false.
- */
-bool SpectralCounts::setsAreEqualSize(
-  const pair<PeptideSet, MetaProtein>& peps_one ,
-  const pair<PeptideSet, MetaProtein>& peps_two) {
-  return ((peps_one).first.size() < (peps_two).first.size());
-}
-
 bool SpectralCounts::compareMetaScorePair(
   const std::pair<FLOAT_T, MetaProtein>& x,
   const std::pair<FLOAT_T, MetaProtein>& y) {
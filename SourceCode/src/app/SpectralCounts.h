@@ -101,8 +101,9 @@ class SpectralCounts: public CruxApplication {
 
   void computeEmpai();
   void makeUniqueMapping();
-  FLOAT_T sumMatchIntensity(Crux::Match* match,
-                          Crux::SpectrumCollection* spectra);
+  void sumMatchIntensities(Crux::SpectrumCollection* spectra,
+                           const std::vector<Crux::Match*>& matches,
+                           std::vector<FLOAT_T>* intensities);
   SCORER_TYPE_T get_qval_type(MatchCollection* match_collection);
 
   void writeRankedPeptides();
@@ -178,8 +179,6 @@ class SpectralCounts: public CruxApplication {
   // comparison function declarations
   static bool comparePeptideSets(PeptideSet, PeptideSet);
   static bool compareMetaProteins(MetaProtein, MetaProtein);
-  static bool setsAreEqualSize(const std::pair<PeptideSet, MetaProtein>&,
-                               const std::pair<PeptideSet, MetaProtein>&);
   static bool compareMetaScorePair(const std::pair<FLOAT_T, MetaProtein>&,
                                    const std::pair<FLOAT_T, MetaProtein>&);
  
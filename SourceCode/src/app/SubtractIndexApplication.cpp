@@ -87,6 +87,10 @@ int SubtractIndexApplication::main(int argc, char** argv) {
     carp(CARP_FATAL, "Error reading index (%s)", proteins_file2.c_str());
   }
   carp(CARP_DEBUG, "Read %d proteins", proteins2.size());
+  if (pepHeader1.lazy_mods() != peptides_header2.peptides_header().lazy_mods()) {
+    carp(CARP_FATAL, "Cannot subtract an index built with lazy-mods from one built "
+                     "without it, or vice versa");
+  }
 
   //output files;
   const string index_out = Params::GetString("output index");
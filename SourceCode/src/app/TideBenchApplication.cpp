@@ -0,0 +1,413 @@
+/**
+ * \file TideBenchApplication.cpp
+ * \brief Reproducible tide-search throughput benchmark on synthetic data.
+ ***********************************************************/
+#include "TideBenchApplication.h"
+#include "TideIndexApplication.h"
+#include "TideSearchApplication.h"
+#include "io/carp.h"
+#include "io/SpectrumRecordWriter.h"
+#include "util/AminoAcidUtil.h"
+#include "util/crux-utils.h"
+#include "util/FileUtils.h"
+#include "util/mass.h"
+#include "util/Params.h"
+#include "util/StringUtils.h"
+#include "util/utils.h"
+
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+// Background amino acid frequencies (per 10000) for the synthetic proteome,
+// roughly those of UniProtKB/Swiss-Prot.
+static const char BENCH_AMINO_ACIDS[] = "ARNDCQEGHILKMFPSTWYV";
+static const int BENCH_AMINO_ACID_FREQS[] = {
+  825, 553, 406, 545, 137, 393, 675, 707, 227, 596,
+  966, 584, 242, 386, 470, 656, 534, 108, 292, 687
+};
+static const int BENCH_MIN_PROTEIN_LENGTH = 100;
+static const int BENCH_MAX_PROTEIN_LENGTH = 700;
+static const int BENCH_MIN_PEPTIDE_LENGTH = 7;
+static const int BENCH_MAX_PEPTIDE_LENGTH = 25;
+
+/**
+ * \returns a random number in [0, 1)
+ */
+static double benchRandomFraction() {
+  return myrandom_limit(1000000) / 1000000.0;
+}
+
+/**
+ * \returns true if trypsin cleaves after position i of the sequence.
+ */
+static bool benchCleavesAfter(const string& seq, size_t i) {
+  return (seq[i] == 'K' || seq[i] == 'R') &&
+         (i + 1 == seq.length() || seq[i + 1] != 'P');
+}
+
+/**
+ * \returns a blank TideBenchApplication object
+ */
+TideBenchApplication::TideBenchApplication() : index_seconds_(0) {
+}
+
+/**
+ * Destructor
+ */
+TideBenchApplication::~TideBenchApplication() {
+}
+
+/**
+ * main method for TideBenchApplication
+ */
+int TideBenchApplication::main(int argc, char** argv) {
+  carp(CARP_INFO, "Running tide-bench...");
+
+  int num_proteins = Params::GetInt("bench-proteins");
+  int num_spectra = Params::GetInt("bench-spectra");
+  string spectrumrecords_file = make_file_path("tide-bench.spectrumrecords");
+
+  TideSearchApplication search_app;
+  double start_time = wall_clock();
+  int ret = search_app.main(vector<string>(1, spectrumrecords_file),
+                            Params::GetString("tide database"));
+  if (ret != 0) {
+    return ret;
+  }
+  double search_seconds = (wall_clock() - start_time) / 1e6;
+
+  long spec_charges = search_app.getSearchedSpecCharges();
+  long candidates = search_app.getCandidatePeptides();
+  double spectra_per_second =
+    search_seconds > 0 ? spec_charges / search_seconds : 0;
+  double candidates_per_second =
+    search_seconds > 0 ? candidates / search_seconds : 0;
+  long peak_rss = peakRssKb();
+
+  carp(CARP_INFO, "Index time: %.3f s", index_seconds_);
+  carp(CARP_INFO, "Search time: %.3f s for %ld spectrum-charge combinations "
+       "and %ld candidates", search_seconds, spec_charges, candidates);
+  carp(CARP_INFO, "Spectra/second: %.1f", spectra_per_second);
+  carp(CARP_INFO, "Candidates/second: %.1f", candidates_per_second);
+  carp(CARP_INFO, "Peak RSS: %ld kB", peak_rss);
+
+  ofstream* report = create_stream_in_path(
+    make_file_path("tide-bench.txt").c_str(), NULL, Params::GetBool("overwrite"));
+  *report << "seed\tproteins\tspectra\tspectrum-charges\tcandidates\t"
+          << "index seconds\tsearch seconds\tspectra/second\t"
+          << "candidates/second\tpeak RSS (kB)" << endl;
+  *report << Params::GetString("seed") << '\t'
+          << num_proteins << '\t'
+          << num_spectra << '\t'
+          << spec_charges << '\t'
+          << candidates << '\t'
+          << fixed << setprecision(3)
+          << index_seconds_ << '\t'
+          << search_seconds << '\t'
+          << setprecision(1)
+          << spectra_per_second << '\t'
+          << candidates_per_second << '\t'
+          << peak_rss << endl;
+  report->close();
+  delete report;
+
+  return 0;
+}
+
+void TideBenchApplication::writeProteome(
+  const string& fasta_file,
+  int num_proteins,
+  vector<string>* proteins
+) {
+  int freq_total = 0;
+  vector<int> cumulative;
+  for (size_t i = 0; i < sizeof(BENCH_AMINO_ACID_FREQS) / sizeof(int); i++) {
+    freq_total += BENCH_AMINO_ACID_FREQS[i];
+    cumulative.push_back(freq_total);
+  }
+
+  ofstream* fasta = create_stream_in_path(
+    fasta_file.c_str(), NULL, Params::GetBool("overwrite"));
+  proteins->clear();
+  proteins->reserve(num_proteins);
+  for (int i = 0; i < num_proteins; i++) {
+    int length = BENCH_MIN_PROTEIN_LENGTH +
+      myrandom_limit(BENCH_MAX_PROTEIN_LENGTH - BENCH_MIN_PROTEIN_LENGTH + 1);
+    string seq(length, 'M');
+    for (int j = 1; j < length; j++) {
+      int draw = myrandom_limit(freq_total);
+      seq[j] = BENCH_AMINO_ACIDS[
+        upper_bound(cumulative.begin(), cumulative.end(), draw) - cumulative.begin()];
+    }
+    *fasta << ">BENCH_" << setw(6) << setfill('0') << i + 1 << endl;
+    for (int j = 0; j < length; j += 60) {
+      *fasta << seq.substr(j, 60) << endl;
+    }
+    proteins->push_back(seq);
+  }
+  fasta->close();
+  delete fasta;
+}
+
+void TideBenchApplication::writeSpectra(
+  const string& ms2_file,
+  int num_spectra,
+  const vector<string>& proteins
+) {
+  int min_length = max(BENCH_MIN_PEPTIDE_LENGTH, Params::GetInt("min-length"));
+  int max_length = min(BENCH_MAX_PEPTIDE_LENGTH, Params::GetInt("max-length"));
+  if (proteins.empty() || min_length > max_length) {
+    carp(CARP_FATAL, "Cannot generate spectra with peptide lengths %d-%d",
+         min_length, max_length);
+  }
+
+  ofstream* ms2 = create_stream_in_path(
+    ms2_file.c_str(), NULL, Params::GetBool("overwrite"));
+  *ms2 << "H\tExtractor\ttide-bench" << endl;
+  *ms2 << fixed;
+
+  vector<size_t> starts;
+  vector< pair<double, double> > peaks;
+  long attempts = 0;
+  for (int scan = 1; scan <= num_spectra; ) {
+    if (++attempts > 1000L * num_spectra) {
+      carp(CARP_FATAL, "Could not find enough tryptic peptides of length %d-%d",
+           min_length, max_length);
+    }
+    // Pick a random tryptic peptide.
+    const string& protein = proteins[myrandom_limit(proteins.size())];
+    starts.assign(1, 0);
+    for (size_t i = 0; i + 1 < protein.length(); i++) {
+      if (benchCleavesAfter(protein, i)) {
+        starts.push_back(i + 1);
+      }
+    }
+    starts.push_back(protein.length());
+    size_t site = myrandom_limit(starts.size() - 1);
+    string peptide = protein.substr(starts[site], starts[site + 1] - starts[site]);
+    if ((int)peptide.length() < min_length || (int)peptide.length() > max_length) {
+      continue;
+    }
+
+    // Residue masses include the default cysteine modification of tide-index.
+    vector<double> prefix(peptide.length() + 1, 0.0);
+    for (size_t i = 0; i < peptide.length(); i++) {
+      prefix[i + 1] = prefix[i] + AminoAcidUtil::GetMass(peptide[i]) +
+                      (peptide[i] == 'C' ? CYSTEINE_DEFAULT : 0.0);
+    }
+    double mass = prefix.back() + MASS_H2O_MONO;
+    int charge = benchRandomFraction() < 0.7 ? 2 : 3;
+
+    // b and y ions, some of them missing, plus as many noise peaks.
+    peaks.clear();
+    for (size_t i = 1; i < peptide.length(); i++) {
+      double ions[2] = { prefix[i] + MASS_PROTON,
+                         mass - prefix[i] + MASS_PROTON };
+      for (int j = 0; j < 2; j++) {
+        for (int z = 1; z < charge; z++) {
+          if (benchRandomFraction() < 0.2) {
+            continue;
+          }
+          double mz = (ions[j] + (z - 1) * MASS_PROTON) / z +
+                      (benchRandomFraction() - 0.5) * 0.04;
+          peaks.push_back(make_pair(mz, 10.0 + 90.0 * benchRandomFraction()));
+        }
+      }
+    }
+    for (size_t i = peaks.size(); i > 0; i--) {
+      peaks.push_back(make_pair(50.0 + (mass - 50.0) * benchRandomFraction(),
+                                1.0 + 19.0 * benchRandomFraction()));
+    }
+    sort(peaks.begin(), peaks.end());
+
+    *ms2 << "S\t" << scan << '\t' << scan << '\t' << setprecision(4)
+         << (mass + charge * MASS_PROTON) / charge << endl;
+    *ms2 << "Z\t" << charge << '\t' << mass + MASS_PROTON << endl;
+    for (vector< pair<double, double> >::const_iterator i = peaks.begin();
+         i != peaks.end();
+         i++) {
+      *ms2 << setprecision(4) << i->first << ' '
+           << setprecision(1) << i->second << endl;
+    }
+    scan++;
+  }
+  ms2->close();
+  delete ms2;
+}
+
+long TideBenchApplication::peakRssKb() {
+#ifdef _MSC_VER
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+    return 0;
+  }
+  return (long)(counters.PeakWorkingSetSize / 1024);
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024;  // bytes on OS X
+#else
+  return usage.ru_maxrss;
+#endif
+#endif
+}
+
+/**
+ * \returns the command name for TideBenchApplication
+ */
+string TideBenchApplication::getName() const {
+  return "tide-bench";
+}
+
+/**
+ * \returns the description for TideBenchApplication
+ */
+string TideBenchApplication::getDescription() const {
+  return
+    "[[nohtml:Measure tide-search throughput on synthetic data generated "
+    "from a seed.]]"
+    "[[html:<p>This command generates a random proteome and a set of spectra "
+    "from its tryptic peptides, both determined only by the seed and the "
+    "size options, so the same workload can be reproduced anywhere without "
+    "sharing real data. It then builds a tide index from the proteome, "
+    "searches the spectra with tide-search using CPU scoring, and reports "
+    "the number of spectra and candidate peptides scored per second and the "
+    "peak memory use of the process.</p>]]";
+}
+
+/**
+ * \returns the command arguments
+ */
+vector<string> TideBenchApplication::getArgs() const {
+  return vector<string>();
+}
+
+/**
+ * \returns the command options
+ */
+vector<string> TideBenchApplication::getOptions() const {
+  string arr[] = {
+    "bench-proteins",
+    "bench-spectra",
+    "seed"
+  };
+  vector<string> options(arr, arr + sizeof(arr) / sizeof(string));
+  addOptionsFrom<TideIndexApplication>(&options);
+  addOptionsFrom<TideSearchApplication>(&options);
+  removeOptionFrom(&options, "store-spectra");
+  removeOptionFrom(&options, "store-index");
+  removeOptionFrom(&options, "cpu-scoring");
+  removeOptionFrom(&options, "auto-precursor-window");
+  removeOptionFrom(&options, "auto-mz-bin-width");
+  return options;
+}
+
+/**
+ * \returns the command outputs
+ */
+vector< pair<string, string> > TideBenchApplication::getOutputs() const {
+  vector< pair<string, string> > outputs;
+  outputs.push_back(make_pair("tide-bench.txt",
+    "a tab-delimited text file with one row of timings: spectrum-charge "
+    "combinations and candidates searched, index and search time, spectra "
+    "and candidates per second, and peak resident memory in kB."));
+  outputs.push_back(make_pair("tide-bench.fasta",
+    "the generated proteome."));
+  outputs.push_back(make_pair("tide-bench.ms2",
+    "the generated spectra."));
+  outputs.push_back(make_pair("tide-bench.index",
+    "the tide index built from the generated proteome."));
+  outputs.push_back(make_pair("tide-search.target.txt",
+    "the PSMs found by the benchmark search, as written by tide-search."));
+  outputs.push_back(make_pair("tide-bench.params.txt",
+    "a file containing the name and value of all parameters/options for the "
+    "current operation. Not all parameters in the file may have been used in "
+    "the operation. The resulting file can be used with the --parameter-file "
+    "option for other crux programs."));
+  outputs.push_back(make_pair("tide-bench.log.txt",
+    "a log file containing a copy of all messages that were printed to stderr."));
+  return outputs;
+}
+
+/**
+ * \returns the filestem for TideBenchApplication
+ */
+string TideBenchApplication::getFileStem() const {
+  return "tide-bench";
+}
+
+/**
+ * \returns whether the application needs the output directory or not.
+ */
+bool TideBenchApplication::needsOutputDirectory() const {
+  return true;
+}
+
+/**
+ * Generates the synthetic data and has tide-search build the index from
+ * it. tide-index and tide-search both process their parameters before
+ * they are finalized, and tide-search needs its database to exist to do
+ * that, so this happens here rather than in main.
+ */
+void TideBenchApplication::processParams() {
+  // The output directory, the random number generator and the timer are
+  // otherwise only set up after the parameters are finalized.
+  wall_clock();
+  string output_dir = Params::GetString("output-dir");
+  if (!FileUtils::IsDir(output_dir) &&
+      create_output_directory(output_dir, Params::GetBool("overwrite")) == -1) {
+    carp(CARP_FATAL, "Unable to create output directory %s.", output_dir.c_str());
+  }
+  string seed = Params::GetString("seed");
+  mysrandom(seed == "time" ? (unsigned)time(NULL) :
+                             StringUtils::FromString<unsigned>(seed));
+
+  int num_proteins = Params::GetInt("bench-proteins");
+  int num_spectra = Params::GetInt("bench-spectra");
+  string fasta_file = make_file_path("tide-bench.fasta");
+  string ms2_file = make_file_path("tide-bench.ms2");
+  string spectrumrecords_file = make_file_path("tide-bench.spectrumrecords");
+
+  carp(CARP_INFO, "Generating %d proteins (seed %s)",
+       num_proteins, seed.c_str());
+  vector<string> proteins;
+  writeProteome(fasta_file, num_proteins, &proteins);
+  carp(CARP_INFO, "Generating %d spectra", num_spectra);
+  writeSpectra(ms2_file, num_spectra, proteins);
+
+  // Convert up front so the search timing does not include parsing the MS2.
+  if (!SpectrumRecordWriter::convert(ms2_file, spectrumrecords_file)) {
+    carp(CARP_FATAL, "Error converting %s to spectrumrecords format",
+         ms2_file.c_str());
+  }
+
+  Params::Set("cpu-scoring", true);
+  // Given a FASTA file, tide-search indexes it into store-index.
+  Params::Set("tide database", fasta_file);
+  Params::Set("store-index", make_file_path("tide-bench.index"));
+  double start_time = wall_clock();
+  TideSearchApplication search_app;
+  search_app.processParams();
+  index_seconds_ = (wall_clock() - start_time) / 1e6;
+}
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 2
+ * End:
+ */
@@ -0,0 +1,115 @@
+/**
+ * \file TideBenchApplication.h
+ * \brief Reproducible tide-search throughput benchmark on synthetic data.
+ *
+ * Generates a random proteome and spectra of its tryptic peptides from
+ * the seed parameter, builds a tide index from the proteome, searches
+ * the spectra with CPU scoring and reports spectra per second,
+ * candidates per second and peak memory use.
+ ***********************************************************/
+#ifndef TIDEBENCHAPPLICATION_H
+#define TIDEBENCHAPPLICATION_H
+
+#include "CruxApplication.h"
+
+#include <string>
+#include <vector>
+
+class TideBenchApplication : public CruxApplication {
+
+ public:
+
+  /**
+   * \returns a blank TideBenchApplication object
+   */
+  TideBenchApplication();
+
+  /**
+   * Destructor
+   */
+  ~TideBenchApplication();
+
+  /**
+   * main method for TideBenchApplication
+   */
+  virtual int main(int argc, char** argv);
+
+  /**
+   * \returns the command name for TideBenchApplication
+   */
+  virtual std::string getName() const;
+
+  /**
+   * \returns the description for TideBenchApplication
+   */
+  virtual std::string getDescription() const;
+
+  /**
+   * \returns the command arguments
+   */
+  virtual std::vector<std::string> getArgs() const;
+
+  /**
+   * \returns the command options
+   */
+  virtual std::vector<std::string> getOptions() const;
+
+  /**
+   * \returns the command outputs
+   */
+  virtual std::vector< std::pair<std::string, std::string> > getOutputs() const;
+
+  /**
+   * \returns the filestem for TideBenchApplication
+   */
+  virtual std::string getFileStem() const;
+
+  /**
+   * \returns whether the application needs the output directory or not.
+   */
+  virtual bool needsOutputDirectory() const;
+
+  /**
+   * Generates the synthetic data and builds the index before the
+   * parameters are finalized.
+   */
+  virtual void processParams();
+
+ protected:
+
+  double index_seconds_;
+
+  /**
+   * Writes num_proteins random protein sequences to a FASTA file.
+   */
+  static void writeProteome(
+    const std::string& fasta_file,
+    int num_proteins,
+    std::vector<std::string>* proteins ///< generated sequences -out
+  );
+
+  /**
+   * Writes num_spectra MS2 spectra, each made from the b and y ions of a
+   * random tryptic peptide of the given proteins plus noise peaks.
+   */
+  static void writeSpectra(
+    const std::string& ms2_file,
+    int num_spectra,
+    const std::vector<std::string>& proteins
+  );
+
+  /**
+   * \returns the peak resident set size of this process in kB, or 0 if it
+   * is not available on this platform.
+   */
+  static long peakRssKb();
+};
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 2
+ * End:
+ */
@@ -9,7 +9,10 @@
 #include "GeneratePeptides.h"
 #include "TideIndexApplication.h"
 #include "TideMatchSet.h"
+#include "TideShards.h"
+#include "app/tide/fragment_index.h"
 #include "app/tide/modifications.h"
+#include "app/tide/peptide_mods.h"
 #include "app/tide/records_to_vector-inl.h"
 
 #ifdef _MSC_VER
@@ -18,7 +21,8 @@
 
 extern void AddTheoreticalPeaks(const vector<const pb::Protein*>& proteins,
                                 const string& input_filename,
-                                const string& output_filename);
+                                const string& output_filename,
+                                bool store_peaks);
 extern void AddMods(HeadedRecordReader* reader,
                     string out_file,
                     string tmpDir,                    
@@ -109,7 +113,8 @@ int TideIndexApplication::main(
 
   if (!MassConstants::Init(var_mod_table.ParsedModTable(), 
     var_mod_table.ParsedNtpepModTable(), 
-    var_mod_table.ParsedCtpepModTable(), 0, 0)) {
+    var_mod_table.ParsedCtpepModTable(),
+    Params::GetDouble("mz-bin-width"), Params::GetDouble("mz-bin-offset"))) {
     carp(CARP_FATAL, "Error in MassConstants::Init");
   }
 
@@ -146,11 +151,13 @@ int TideIndexApplication::main(
     carp(CARP_FATAL, "Error creating index directory");
   } else if (FileUtils::Exists(out_proteins) ||
              FileUtils::Exists(out_peptides) ||
-             FileUtils::Exists(out_aux)) {
+             FileUtils::Exists(out_aux) ||
+             !TideShards::ShardFiles(index).empty()) {
     if (overwrite) {
       carp(CARP_DEBUG, "Cleaning old index file(s)");
       FileUtils::Remove(out_proteins);
       FileUtils::Remove(out_peptides);
+      TideShards::Remove(index);
       FileUtils::Remove(out_aux);
       FileUtils::Remove(modless_peptides);
       FileUtils::Remove(peakless_peptides);
@@ -202,11 +209,21 @@ int TideIndexApplication::main(
   del->mutable_unique_deltas()->Clear();
 
   bool need_mods = var_mod_table.Unique_delta_size() > 0;
+  // With lazy-mods, the unmodified peptides are the final peptides, and
+  // tide-search generates their modified forms from the header.
+  bool lazy_mods = need_mods && Params::GetBool("lazy-mods");
+  if (lazy_mods) {
+    pep_header.set_lazy_mods(true);
+    pep_header.set_min_mods(FLAGS_min_mods);
+    pep_header.set_max_mods(FLAGS_max_mods);
+    need_mods = false;
+  }
 
   string basic_peptides = need_mods ? modless_peptides : peakless_peptides;
   carp(CARP_DETAILED_DEBUG, "basic_peptides=%s", basic_peptides.c_str());
 
-  writePeptidesAndAuxLocs(peptideHeap, basic_peptides, out_aux, header_no_mods);
+  writePeptidesAndAuxLocs(peptideHeap, basic_peptides, out_aux,
+                          lazy_mods ? header_with_mods : header_no_mods);
   // Do some clean up
   for (vector<string*>::iterator i = proteinSequences.begin();
        i != proteinSequences.end();
@@ -241,9 +258,15 @@ int TideIndexApplication::main(
     // Iterate over all protocol buffer peptides
     unsigned int writeCountTargets = 0, writeCountDecoys = 0;
     HeadedRecordReader reader(peakless_peptides, NULL);
-    while (!reader.Done()) {
+    ModifiedPeptideReader* mod_reader = lazy_mods ?
+      new ModifiedPeptideReader(reader.Reader(), proteins, &var_mod_table, pep_header) : NULL;
+    while (mod_reader ? !mod_reader->Done() : !reader.Done()) {
       pb::Peptide* protobuf = new pb::Peptide;
-      reader.Read(protobuf);
+      if (mod_reader) {
+        mod_reader->Read(protobuf);
+      } else {
+        reader.Read(protobuf);
+      }
       pb::Peptide* peptide = protobuf;
       bool writeTarget = true;
       bool writeDecoy = false;
@@ -267,6 +290,7 @@ int TideIndexApplication::main(
       }
       delete peptide;
     }
+    delete mod_reader;
 
     // Iterate over saved decoys and output them
     for (vector< pair<string, double> >::iterator i = decoyPepStrs.begin();
@@ -291,8 +315,51 @@ int TideIndexApplication::main(
          writeCountTargets, writeCountDecoys);
   }
 
+  // The peaks of a lazy-mods index would be those of the unmodified
+  // peptides, not of the modified forms that are searched.
+  bool store_peaks = Params::GetBool("store-peaks");
+  if (store_peaks && lazy_mods) {
+    carp(CARP_WARNING, "Theoretical peaks cannot be stored in a lazy-mods index, "
+                       "ignoring store-peaks");
+    store_peaks = false;
+  }
   carp(CARP_INFO, "Precomputing theoretical spectra...");
-  AddTheoreticalPeaks(proteins, peakless_peptides, out_peptides);
+  AddTheoreticalPeaks(proteins, peakless_peptides, out_peptides, store_peaks);
+
+  int num_shards = Params::GetInt("index-shards");
+  if (Params::GetBool("fragment-index")) {
+    // Shards of a lazy-mods index number their modified peptides from 0, so
+    // they cannot share a fragment index.
+    if (lazy_mods && num_shards > 1) {
+      carp(CARP_FATAL, "fragment-index cannot be combined with lazy-mods and index-shards");
+    }
+    carp(CARP_INFO, "Building fragment ion index...");
+    pb::Header pepix_header;
+    HeadedRecordReader reader(out_peptides, &pepix_header);
+    ModifiedPeptideReader* mod_reader = lazy_mods ?
+      new ModifiedPeptideReader(reader.Reader(), proteins, &var_mod_table, pep_header) : NULL;
+    FragmentIndexBuilder builder(proteins, Params::GetDouble("mz-bin-width"),
+                                 Params::GetDouble("mz-bin-offset"));
+    pb::Peptide peptide;
+    while (mod_reader ? !mod_reader->Done() : !reader.Done()) {
+      if (mod_reader) {
+        mod_reader->Read(&peptide);
+      } else {
+        reader.Read(&peptide);
+      }
+      builder.Add(peptide);
+    }
+    delete mod_reader;
+    string out_fragments = FileUtils::Join(index, "fragix");
+    if (!builder.Write(out_fragments, pepix_header)) {
+      carp(CARP_FATAL, "Error writing fragment ion index %s", out_fragments.c_str());
+    }
+  }
+  if (num_shards > 1) {
+    carp(CARP_INFO, "Splitting peptides into %d shards...", num_shards);
+    TideShards::Split(out_peptides, index, num_shards);
+    FileUtils::Remove(out_peptides);
+  }
 
   // Clean up
   for (vector<const pb::Protein*>::iterator i = proteins.begin();
@@ -368,6 +435,7 @@ vector<string> TideIndexApplication::getOptions() const {
     "nterm-peptide-mods-spec",
     "max-mods",
     "min-mods",
+    "lazy-mods",
     "output-dir",
     "overwrite",
     "peptide-list",
@@ -376,7 +444,12 @@ vector<string> TideIndexApplication::getOptions() const {
     "clip-nterm-methionine",
     "verbosity",
     "allow-dups",
-    "temp-dir"
+    "temp-dir",
+    "index-shards",
+    "fragment-index",
+    "store-peaks",
+    "mz-bin-width",
+    "mz-bin-offset"
   };
   return vector<string>(arr, arr + sizeof(arr) / sizeof(string));
 }
@@ -25,6 +25,7 @@ std::string getModifiedPeptideSeq(const pb::Peptide* peptide, const ProteinVec*
 class TideIndexApplication : public CruxApplication {
 
   friend class TideSearchApplication;
+  friend class TideBenchApplication;
 
  public:
 
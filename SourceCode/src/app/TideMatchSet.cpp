@@ -1,10 +1,7 @@
 /*
- * There are two versions of the report function, which writes matches to output
- * files. The first version, which takes ofstreams as arguments, is used when
- * only tab-delimited output is required. It does not perform any object
- * conversions. The second version takes an OutputFiles object as an argument
- * and is used when any non-tab-delimited output is required. It must convert
- * the data from Tide into Crux objects, which increases runtime.
+ * Both versions of the report function hand every reported PSM to a
+ * TideMatchWriter, which writes the tab-delimited files and, if requested,
+ * the other output formats directly from the in-memory match data.
  */
 
 #include <fstream>
@@ -12,20 +9,24 @@
 
 #include "TideIndexApplication.h"
 #include "TideMatchSet.h"
+#include "TideMatchWriter.h"
 #include "TideSearchApplication.h"
-#include "util/Params.h"
+#include "TideSearchConfig.h"
+#include "TideSiteLocalizer.h"
 #include "util/StringUtils.h"
 
 string TideMatchSet::CleavageType;
 char TideMatchSet::match_collection_loc_[] = {0};
 char TideMatchSet::decoy_match_collection_loc_[] = {0};
 
-TideMatchSet::TideMatchSet(Arr* matches, double max_mz)
-  : matches_(matches), max_mz_(max_mz), exact_pval_search_(false), elution_window_(0) {
+TideMatchSet::TideMatchSet(Arr* matches, double max_mz, const TideSearchConfig& config)
+  : matches_(matches), max_mz_(max_mz), config_(config), localizer_(NULL), localizer_cache_(NULL),
+    exact_pval_search_(false), elution_window_(0) {
 }
 
-TideMatchSet::TideMatchSet(Peptide* peptide, double max_mz)
-  : peptide_(peptide), max_mz_(max_mz), exact_pval_search_(false), elution_window_(0) {
+TideMatchSet::TideMatchSet(Peptide* peptide, double max_mz, const TideSearchConfig& config)
+  : peptide_(peptide), max_mz_(max_mz), config_(config), localizer_(NULL), localizer_cache_(NULL),
+    exact_pval_search_(false), elution_window_(0) {
 }
 
 TideMatchSet::~TideMatchSet() {
@@ -33,16 +34,15 @@ TideMatchSet::~TideMatchSet() {
 
 /**
  * Write peptide centric matches to output files
- * This is for writing tab-delimited only
  */
 void TideMatchSet::report(
-  ofstream* target_file,  ///< target file to write to
-  ofstream* decoy_file, ///< decoy file to write to
+  TideMatchWriter* writer,  ///< writer to report matches to
   int top_matches,
   const ActivePeptideQueue* peptides, ///< peptide queue
   const ProteinVec& proteins, ///< proteins corresponding with peptides
   const vector<const pb::AuxLocation*>& locations,  ///< auxiliary locations
-  bool compute_sp ///< whether to compute sp or not
+  bool compute_sp, ///< whether to compute sp or not
+  boost::mutex * rwlock
 ) {
   if (peptide_->spectrum_matches_array.size() == 0) {
     return;
@@ -139,121 +139,82 @@ void TideMatchSet::report(
       peptide_->spectrum_matches_array[spScoreRank[i].second].spData_.sp_rank = i;
     }
   }  
-  // target peptide or concat search
-  ofstream* file =
-    (Params::GetBool("concat") || !peptide_->IsDecoy()) ? target_file : decoy_file;
-  writeToFile(file, peptides, proteins, locations, compute_sp);
+  writeToFile(writer, peptides, proteins, locations, compute_sp, rwlock);
 }
 
 /**
- * Helper function for tab delimited report function for peptide centric search
+ * Helper function for the peptide centric report function
  */
 void TideMatchSet::writeToFile(
-  ofstream* file,
+  TideMatchWriter* writer,
   const ActivePeptideQueue* peptides,
   const ProteinVec& proteins,
   const vector<const pb::AuxLocation*>& locations,
-  bool compute_sp ///< whether to compute sp or not
+  bool compute_sp, ///< whether to compute sp or not
+  boost::mutex * rwlock
 ) {
-  if (!file) {
+  if (!writer) {
     return;
   }
   int cur = 0;
 
   const Peptide* peptide = peptides->GetPeptide(0);
-  const pb::Protein* protein = proteins[peptide->FirstLocProteinId()];
-  int pos = peptide->FirstLocPos();
-  string proteinNames = getProteinName(*protein,
-      (!protein->has_target_pos()) ? pos : protein->target_pos());
-  string flankingAAs, n_term, c_term;
-  getFlankingAAs(peptide, protein, pos, &n_term, &c_term);
-  flankingAAs = n_term + c_term;
+  vector<TidePsmLocation> psmLocations;
+  const pb::Protein* protein = getLocations(peptide, proteins, locations, &psmLocations);
 
-  int precision = Params::GetInt("precision");
+  Crux::Peptide cruxPep = getCruxPeptide(peptide);
 
-  // look for other locations
-  if (peptide->HasAuxLocationsIndex()) {
-      const pb::AuxLocation* aux = locations[peptide->AuxLocationsIndex()];
-      for (int i = 0; i < aux->location_size(); ++i) {
-      const pb::Location& location = aux->location(i);
-      protein = proteins[location.protein_id()];
-      pos = location.pos();
-      proteinNames += "," + getProteinName(*protein,
-          (!protein->has_target_pos()) ? pos : protein->target_pos());
-      getFlankingAAs(peptide, protein, pos, &n_term, &c_term);
-      flankingAAs += "," + n_term + c_term;
-      }
+  TidePsm psm;
+  psm.spectrum_filename = NULL;
+  psm.peptide = peptide;
+  psm.crux_peptide = &cruxPep;
+  psm.locations = &psmLocations;
+  psm.original_target_sequence = getOriginalTargetSequence(peptide, protein, &cruxPep);
+  psm.peptide_centric = true;
+  psm.decoy = peptide->IsDecoy();
+  psm.delta_lcn = 0;
+  psm.xcorr_pval = 0;
+  psm.has_elution_score = elution_window_ > 0;
+  psm.elution_score = 0;
+  psm.localization = NULL;
+  if (config_.concat) {
+    psm.distinct_matches = peptides->ActiveTargets() + peptides->ActiveDecoys();
+  } else {
+    psm.distinct_matches = !peptide->IsDecoy() ? peptides->ActiveTargets() : peptides->ActiveDecoys();
   }
 
-  Crux::Peptide cruxPep = getCruxPeptide(peptide);
   for (vector<Peptide::spectrum_matches>::const_iterator 
         i = peptide_->spectrum_matches_array.begin(); 
         i != peptide_->spectrum_matches_array.end(); 
         ++i) {
-    Spectrum* spectrum = i->spectrum_;
-    
-    *file << spectrum->SpectrumNumber() << '\t'
-          << i->charge_ << '\t'
-          << spectrum->PrecursorMZ() << '\t'
-          << (spectrum->PrecursorMZ() - MASS_PROTON) * i->charge_ << '\t'
-          << cruxPep.calcModifiedMass() << '\t'
-          << i->d_cn_ << '\t';
-    SpScorer::SpScoreData spData;
-    if (compute_sp) {
-      *file << i->spData_.sp_score << '\t'
-          << i->spData_.sp_rank << '\t';
-    }
-
-    // Use scientific notation for exact p-value, but not refactored XCorr.
+    psm.spectrum = i->spectrum_;
+    psm.charge = i->charge_;
+    psm.delta_cn = i->d_cn_;
+    psm.sp_data = compute_sp ? &i->spData_ : NULL;
+    psm.sp_rank = i->spData_.sp_rank;
     if (exact_pval_search_) {
-      *file << StringUtils::ToString(i->score1_, precision, false) << '\t';
-      *file << StringUtils::ToString(i->score2_, precision, true) << '\t';
+      psm.xcorr_pval = i->score1_;
+      psm.xcorr_score = i->score2_;
     } else {
-      *file << StringUtils::ToString(i->score1_, precision, true) << '\t';
-    }
-    
-    if (elution_window_ ) {
-      *file << i->elution_score_ << '\t';
+      psm.xcorr_score = i->score1_;
     }
-
-    *file << ++cur << '\t';
-    if (compute_sp) {
-      *file << i->spData_.matched_ions << '\t'
-            << i->spData_.total_ions << '\t';
+    if (psm.has_elution_score) {
+      psm.elution_score = i->elution_score_;
     }
-    *file << i->score3_ << '\t';
+    psm.rank = ++cur;
+    psm.peptide_matches = i->score3_;
 
-    if (Params::GetBool("concat")) {
-      *file << peptides->ActiveTargets() + peptides->ActiveDecoys() << '\t';
-    } else {
-      *file << (!peptide->IsDecoy() ? peptides->ActiveTargets() : peptides->ActiveDecoys()) << '\t';
-    }
-    *file << cruxPep.getModifiedSequenceWithMasses() << '\t'
-          << cruxPep.getModsString() << '\t'
-          << CleavageType << '\t'
-          << proteinNames << '\t'
-          << flankingAAs  << '\t'
-          << cruxPep.getDecoyType();
-    if (peptide->IsDecoy() && !TideSearchApplication::proteinLevelDecoys()) {
-      // write target sequence
-      const string& residues = protein->residues();
-      *file << '\t'
-            << residues.substr(residues.length() - peptide->Len());
-    } else if (Params::GetBool("concat") && !TideSearchApplication::proteinLevelDecoys()) {
-      *file << '\t'
-            << cruxPep.getUnshuffledSequence();
-    }
-    *file << endl;
+    rwlock->lock();
+    writer->write(psm);
+    rwlock->unlock();
   }
 }
 
 /**
  * Write matches to output files
- * This is for writing tab-delimited only
  */
 void TideMatchSet::report(
-  ofstream* target_file,  ///< target file to write to
-  ofstream* decoy_file, ///< decoy file to write to
+  TideMatchWriter* writer,  ///< writer to report matches to
   int top_n,  ///< number of matches to report
   const string& spectrum_filename, ///< name of spectrum file
   const Spectrum* spectrum, ///< spectrum for matches
@@ -286,17 +247,17 @@ void TideMatchSet::report(
     computeSpData(targets, &sp_map, &sp_scorer, peptides);
     computeSpData(decoys, &sp_map, &sp_scorer, peptides);
   }
-  writeToFile(target_file, top_n, targets, spectrum_filename, spectrum, charge,
+  writeToFile(writer, top_n, targets, spectrum_filename, spectrum, charge,
               peptides, proteins, locations, delta_cn_map, delta_lcn_map, compute_sp ? &sp_map : NULL, rwlock);
-  writeToFile(decoy_file, top_n, decoys, spectrum_filename, spectrum, charge,
+  writeToFile(writer, top_n, decoys, spectrum_filename, spectrum, charge,
               peptides, proteins, locations, delta_cn_map, delta_lcn_map, compute_sp ? &sp_map : NULL, rwlock);
 }
 
 /**
- * Helper function for tab delimited report function
+ * Helper function for the spectrum centric report function
  */
 void TideMatchSet::writeToFile(
-  ofstream* file,
+  TideMatchWriter* writer,
   int top_n,
   const vector<Arr::iterator>& vec,
   const string& spectrum_filename,
@@ -310,162 +271,127 @@ void TideMatchSet::writeToFile(
   const map<Arr::iterator, pair<const SpScorer::SpScoreData, int> >* sp_map,
   boost::mutex * rwlock
 ) {
-  if (!file) {
+  if (!writer) {
     return;
   }
 
-  int massPrecision = Params::GetInt("mass-precision");
-  int precision = Params::GetInt("precision");
-
   int cur = 0;
+  bool concat = config_.concat;
   int concatDistinctMatches = peptides->ActiveTargets() + peptides->ActiveDecoys();
 
   const vector<Arr::iterator>::const_iterator cutoff =
     (vec.size() >= top_n) ? vec.begin() + top_n : vec.end();
 
+  TidePsm psm;
+  psm.spectrum_filename = &spectrum_filename;
+  psm.spectrum = spectrum;
+  psm.charge = charge;
+  psm.peptide_centric = false;
+  psm.sp_rank = 0;
+  psm.has_elution_score = false;
+  psm.elution_score = 0;
+  psm.peptide_matches = 0;
+
+  vector<TidePsmLocation> psmLocations;
+  SiteLocalization localization;
   for (vector<Arr::iterator>::const_iterator i = vec.begin(); i != cutoff; ++i) {
     const Peptide* peptide = peptides->GetPeptide((*i)->rank);
-    const pb::Protein* protein = proteins[peptide->FirstLocProteinId()];
-    int pos = peptide->FirstLocPos();
-    string proteinNames = getProteinName(*protein,
-      (!protein->has_target_pos()) ? pos : protein->target_pos());
-    string flankingAAs, n_term, c_term;
-    getFlankingAAs(peptide, protein, pos, &n_term, &c_term);
-    flankingAAs = n_term + c_term;
-
-    // look for other locations
-    if (peptide->HasAuxLocationsIndex()) {
-      const pb::AuxLocation* aux = locations[peptide->AuxLocationsIndex()];
-      for (int i = 0; i < aux->location_size(); ++i) {
-        const pb::Location& location = aux->location(i);
-        protein = proteins[location.protein_id()];
-        pos = location.pos();
-        proteinNames += "," + getProteinName(*protein,
-          (!protein->has_target_pos()) ? pos : protein->target_pos());
-        getFlankingAAs(peptide, protein, pos, &n_term, &c_term);
-        flankingAAs += "," + n_term + c_term;
-      }
-    }
-
+    const pb::Protein* protein = getLocations(peptide, proteins, locations, &psmLocations);
     Crux::Peptide cruxPep = getCruxPeptide(peptide);
-    const SpScorer::SpScoreData* sp_data = sp_map ? &(sp_map->at(*i).first) : NULL;
 
-    rwlock->lock();
-    if (Params::GetBool("file-column")) {
-      *file << spectrum_filename << '\t';
-    }
-    *file << spectrum->SpectrumNumber() << '\t'
-          << charge << '\t'
-          << StringUtils::ToString(spectrum->PrecursorMZ(), massPrecision) << '\t'
-          << StringUtils::ToString((spectrum->PrecursorMZ() - MASS_PROTON) * charge, massPrecision) << '\t'
-          << StringUtils::ToString(cruxPep.calcModifiedMass(), massPrecision) << '\t'
-          << delta_cn_map.at(*i) << '\t'
-          << delta_lcn_map.at(*i) << '\t';
+    psm.peptide = peptide;
+    psm.crux_peptide = &cruxPep;
+    psm.locations = &psmLocations;
+    psm.original_target_sequence = getOriginalTargetSequence(peptide, protein, &cruxPep);
+    psm.decoy = peptide->IsDecoy();
+    psm.delta_cn = delta_cn_map.at(*i);
+    psm.delta_lcn = delta_lcn_map.at(*i);
+    psm.sp_data = NULL;
     if (sp_map) {
-      *file << StringUtils::ToString(sp_data->sp_score, precision) << '\t'
-            << sp_map->at(*i).second << '\t';
+      psm.sp_data = &(sp_map->at(*i).first);
+      psm.sp_rank = sp_map->at(*i).second;
     }
-
-    // Use scientific notation for exact p-value, but not refactored XCorr.
-    if (exact_pval_search_) {
-      *file << StringUtils::ToString((*i)->xcorr_pval, precision, false) << '\t';
-      *file << StringUtils::ToString((*i)->xcorr_score, precision, true) << '\t';
+    psm.xcorr_score = (*i)->xcorr_score;
+    psm.xcorr_pval = (*i)->xcorr_pval;
+    psm.rank = ++cur;
+    if (concat) {
+      psm.distinct_matches = concatDistinctMatches;
     } else {
-      *file << StringUtils::ToString((*i)->xcorr_score, precision, true) << '\t';
-    }      
-    *file << ++cur << '\t';
-    if (sp_map) {
-      *file << sp_data->matched_ions << '\t'
-            << sp_data->total_ions << '\t';
+      psm.distinct_matches = !peptide->IsDecoy() ? peptides->ActiveTargets() : peptides->ActiveDecoys();
     }
-
-    if (Params::GetBool("concat")) {
-      *file << concatDistinctMatches << '\t';
-    } else {
-      *file << (!peptide->IsDecoy() ? peptides->ActiveTargets() : peptides->ActiveDecoys()) << '\t';
+    psm.localization = NULL;
+    if (localizer_ && cur == 1 &&
+        localizer_->localize(*peptide, localizer_cache_, charge, &localization)) {
+      psm.localization = &localization;
     }
 
-    *file << cruxPep.getModifiedSequenceWithMasses() << '\t'
-          << cruxPep.getModsString() << '\t'
-          << CleavageType << '\t'
-          << proteinNames << '\t'
-          << flankingAAs;
-    if (peptide->IsDecoy()) {
-      *file << "\tdecoy";
-    } else {
-      *file << "\ttarget";
-    }
-    if (peptide->IsDecoy() && !TideSearchApplication::proteinLevelDecoys()) {
-      // write target sequence
-      const string& residues = protein->residues();
-      *file << '\t'
-            << residues.substr(residues.length() - peptide->Len());
-    } else if (Params::GetBool("concat") && !TideSearchApplication::proteinLevelDecoys()) {
-      *file << '\t'
-            << cruxPep.getUnshuffledSequence();
-    }
-    *file << endl;
+    rwlock->lock();
+    writer->write(psm);
     rwlock->unlock();
   }
 }
 
 /**
- * Write headers for tab delimited file
+ * Fills in the protein locations of a peptide, first location first.
+ * \returns the protein of the last location.
  */
-void TideMatchSet::writeHeaders(ofstream* file, bool decoyFile, bool sp) {
-  if (!file) {
-    return;
-  }
-  const int headers[] = {
-    FILE_COL, SCAN_COL, CHARGE_COL, SPECTRUM_PRECURSOR_MZ_COL, SPECTRUM_NEUTRAL_MASS_COL,
-    PEPTIDE_MASS_COL, DELTA_CN_COL, DELTA_LCN_COL, SP_SCORE_COL, SP_RANK_COL,
-    XCORR_SCORE_COL, XCORR_RANK_COL, BY_IONS_MATCHED_COL, BY_IONS_TOTAL_COL,
-    DISTINCT_MATCHES_SPECTRUM_COL, SEQUENCE_COL, MODIFICATIONS_COL, CLEAVAGE_TYPE_COL,
-    PROTEIN_ID_COL, FLANKING_AA_COL, TARGET_DECOY_COL, ORIGINAL_TARGET_SEQUENCE_COL
-  };
-  size_t numHeaders = sizeof(headers) / sizeof(int);
-  bool writtenHeader = false;
-  for (size_t i = 0; i < numHeaders; ++i) {
-    int header = headers[i];
-    if (!sp &&
-        (header == SP_SCORE_COL || header == SP_RANK_COL ||
-         header == BY_IONS_MATCHED_COL || header == BY_IONS_TOTAL_COL)) {
-      continue;
-    } else if (header == ORIGINAL_TARGET_SEQUENCE_COL &&
-               (TideSearchApplication::proteinLevelDecoys() ||
-                (!decoyFile && !Params::GetBool("concat")))) {
-      continue;
-    }
-    if (writtenHeader) {
-      *file << '\t';
-    }
-    if (header == FILE_COL &&
-        (!Params::GetBool("file-column") || Params::GetBool("peptide-centric-search"))) {
-      continue;
-    }
-    if (header == XCORR_SCORE_COL && Params::GetBool("exact-p-value")) {
-      *file << get_column_header(EXACT_PVALUE_COL) << '\t'
-            << get_column_header(REFACTORED_SCORE_COL);
-      if (Params::GetInt("elution-window-size") > 0) {
-        *file << '\t' << get_column_header(ELUTION_WINDOW_COL);
-      }
-      writtenHeader = true;
-      continue;
-    }
-    if (header == DISTINCT_MATCHES_SPECTRUM_COL) {
-      if (Params::GetBool("peptide-centric-search")) {
-        *file << get_column_header(DISTINCT_MATCHES_PEPTIDE_COL) << '\t';
-        *file << get_column_header(DISTINCT_MATCHES_SPECTRUM_COL);
-      } else {
-        *file << get_column_header(DISTINCT_MATCHES_SPECTRUM_COL);
-      }
-      writtenHeader = true;
-      continue;
+const pb::Protein* TideMatchSet::getLocations(
+  const Peptide* peptide,
+  const ProteinVec& proteins,
+  const vector<const pb::AuxLocation*>& locations,
+  vector<TidePsmLocation>* out
+) {
+  out->clear();
+  const pb::Protein* protein = proteins[peptide->FirstLocProteinId()];
+  addLocation(peptide, protein, peptide->FirstLocPos(), out);
+
+  // look for other locations
+  if (peptide->HasAuxLocationsIndex()) {
+    const pb::AuxLocation* aux = locations[peptide->AuxLocationsIndex()];
+    for (int i = 0; i < aux->location_size(); ++i) {
+      const pb::Location& location = aux->location(i);
+      protein = proteins[location.protein_id()];
+      addLocation(peptide, protein, location.pos(), out);
     }
-    *file << get_column_header(header);
-    writtenHeader = true;
   }
-  *file << endl;
+  return protein;
+}
+
+void TideMatchSet::addLocation(
+  const Peptide* peptide,
+  const pb::Protein* protein,
+  int pos,
+  vector<TidePsmLocation>* out
+) {
+  out->push_back(TidePsmLocation());
+  TidePsmLocation& location = out->back();
+  location.protein_name = protein->name();
+  location.protein_pos = ((!protein->has_target_pos()) ? pos : protein->target_pos()) + 1;
+  string n_term, c_term;
+  getFlankingAAs(peptide, protein, pos, &n_term, &c_term);
+  location.n_flank = n_term[0];
+  location.c_flank = c_term[0];
+}
+
+/**
+ * \returns the sequence of the target a decoy was generated from, or of the
+ * unshuffled peptide in a concatenated search; empty if it is not reported.
+ */
+string TideMatchSet::getOriginalTargetSequence(
+  const Peptide* peptide,
+  const pb::Protein* protein,
+  const Crux::Peptide* cruxPep
+) {
+  if (TideSearchApplication::proteinLevelDecoys()) {
+    return "";
+  }
+  if (peptide->IsDecoy()) {
+    const string& residues = protein->residues();
+    return residues.substr(residues.length() - peptide->Len());
+  } else if (config_.concat) {
+    return cruxPep->getUnshuffledSequence();
+  }
+  return "";
 }
 
 void TideMatchSet::initModMap(const pb::ModTable& modTable, ModPosition position) {
@@ -520,7 +446,7 @@ void TideMatchSet::gatherTargetsAndDecoys(
     make_heap(matches_->begin(), matches_->end(), highScoreBest ? lessXcorrScore : moreXcorrScore);
   }
   
-  if (!Params::GetBool("concat") && TideSearchApplication::hasDecoys()) {
+  if (!config_.concat && TideSearchApplication::hasDecoys()) {
     for (Arr::iterator i = matches_->end(); i != matches_->begin(); ) {
       if (exact_pval_search_) {
         pop_heap(matches_->begin(), i--, highScoreBest ? lessXcorrPvalScore : moreXcorrPvalScore);
@@ -575,15 +501,6 @@ pb::Peptide* TideMatchSet::getPbPeptide(const Peptide& peptide) {
   return pb_peptide;
 }
 
-/**
- * Gets the protein name with the index appended.
- */
-string TideMatchSet::getProteinName(const pb::Protein& protein, int pos) {
-  stringstream proteinNameStream;
-  proteinNameStream << protein.name() << '(' << pos + 1 << ')';
-  return proteinNameStream.str();
-}
-
 /**
  * Gets the flanking AAs for a Tide peptide sequence
  */
@@ -609,14 +526,14 @@ void TideMatchSet::computeDeltaCns(
 ) {
   vector<FLOAT_T> scores;
   for (vector<Arr::iterator>::const_iterator i = vec.begin(); i != vec.end(); i++) {
-    if (Params::GetBool("exact-p-value")) {
+    if (config_.exact_pval) {
       scores.push_back((*i)->xcorr_pval);
     } else {
       scores.push_back((*i)->xcorr_score);
     }
   }
   vector< pair<FLOAT_T, FLOAT_T> > deltaCns = MatchCollection::calculateDeltaCns(
-    scores, !Params::GetBool("exact-p-value") ? XCORR : TIDE_SEARCH_EXACT_PVAL);
+    scores, !config_.exact_pval ? XCORR : TIDE_SEARCH_EXACT_PVAL);
   for (int i = 0; i < vec.size(); i++) {
     delta_cn_map->insert(make_pair(vec[i], deltaCns[i].first));
     delta_lcn_map->insert(make_pair(vec[i], deltaCns[i].second));
@@ -18,6 +18,11 @@ using namespace std;
 
 typedef vector<const pb::Protein*> ProteinVec;
 
+class TideMatchWriter;
+struct TidePsmLocation;
+class SiteLocalizer;
+class TideSearchConfig;
+
 class TideMatchSet {
 
  public:
@@ -46,34 +51,44 @@ class TideMatchSet {
   // counter in the matches buffer by decrementing the counter.
   TideMatchSet(
     Arr* matches,
-    double max_mz
+    double max_mz,
+    const TideSearchConfig& config
   );
   TideMatchSet(
     Peptide* peptide,
-    double max_mz
+    double max_mz,
+    const TideSearchConfig& config
   );
   
   ~TideMatchSet();
 
+  /**
+   * Localizes the modifications of the top target and top decoy match of a
+   * spectrum centric report against the XCorr cache of the spectrum.
+   */
+  void setLocalizer(const SiteLocalizer* localizer, const int* cache) {
+    localizer_ = localizer;
+    localizer_cache_ = cache;
+  }
+
     /**
    * Write peptide centric matches to output files
    */
   void report(
-    ofstream* target_file,  ///< target file to write to
-    ofstream* decoy_file, ///< decoy file to write to
+    TideMatchWriter* writer,  ///< writer to report matches to
     int top_matches,
     const ActivePeptideQueue* peptides, ///< peptide queue
     const ProteinVec& proteins, ///< proteins corresponding with peptides
     const vector<const pb::AuxLocation*>& locations,  ///< auxiliary locations
-    bool compute_sp ///< whether to compute sp or not
+    bool compute_sp, ///< whether to compute sp or not
+    boost::mutex * rwlock
   );
 
   /**
    * Write spectrum centric to output files
    */
   void report(
-    ofstream* target_file,  ///< target file to write to
-    ofstream* decoy_file, ///< decoy file to write to
+    TideMatchWriter* writer,  ///< writer to report matches to
     int top_n,  ///< number of matches to report
     const string& spectrum_filename, ///< name of spectrum file
     const Spectrum* spectrum, ///< spectrum for matches
@@ -86,12 +101,6 @@ class TideMatchSet {
     boost::mutex * rwlock
   );
 
-  static void writeHeaders(
-    ofstream* file,
-    bool decoyFile,
-    bool sp
-  );
-
   static void initModMap(const pb::ModTable& modTable, ModPosition position);
 
   static string CleavageType;
@@ -101,6 +110,9 @@ class TideMatchSet {
   Arr2* matches2_;
   Peptide* peptide_;  
   double max_mz_;
+  const TideSearchConfig& config_;
+  const SiteLocalizer* localizer_;
+  const int* localizer_cache_;
 
   // For allocation
   static char match_collection_loc_[sizeof(MatchCollection)];
@@ -123,21 +135,22 @@ class TideMatchSet {
   }
 
 /**
-   * Helper function for tab delimited report function for peptide centric
+   * Helper function for the peptide centric report function
    */
   void writeToFile(
-    ofstream* file,
+    TideMatchWriter* writer,
     const ActivePeptideQueue* peptides,
     const ProteinVec& proteins,
     const vector<const pb::AuxLocation*>& locations,
-    bool compute_sp ///< whether to compute sp or not
+    bool compute_sp, ///< whether to compute sp or not
+    boost::mutex * rwlock
   );
   
   /**
-   * Helper function for tab delimited report function
+   * Helper function for the spectrum centric report function
    */
   void writeToFile(
-    ofstream* file,
+    TideMatchWriter* writer,
     int top_n,
     const vector<Arr::iterator>& vec,
     const string& spectrum_filename,
@@ -172,11 +185,29 @@ class TideMatchSet {
   );
 
   /**
-   * Gets the protein name with the index appended.
+   * Gets all protein locations of a peptide, returns the last protein
+   */
+  static const pb::Protein* getLocations(
+    const Peptide* peptide,
+    const ProteinVec& proteins,
+    const vector<const pb::AuxLocation*>& locations,
+    vector<TidePsmLocation>* out
+  );
+
+  static void addLocation(
+    const Peptide* peptide,
+    const pb::Protein* protein,
+    int pos,
+    vector<TidePsmLocation>* out
+  );
+
+  /**
+   * Gets the original target sequence column, empty if not reported
    */
-  static string getProteinName(
-    const pb::Protein& protein,
-    int pos
+  string getOriginalTargetSequence(
+    const Peptide* peptide,
+    const pb::Protein* protein,
+    const Crux::Peptide* cruxPep
   );
 
   /**
@@ -190,7 +221,7 @@ class TideMatchSet {
     string* out_c ///< out parameter for c flank
   );
 
-  static void computeDeltaCns(
+  void computeDeltaCns(
     const vector<Arr::iterator>& vec, // xcorr*100000000.0, high to low
     map<Arr::iterator, FLOAT_T>* delta_cn_map, // map to add delta cn scores to
     map<Arr::iterator, FLOAT_T>* delta_lcn_map
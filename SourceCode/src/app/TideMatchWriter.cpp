@@ -0,0 +1,731 @@
+#include <cmath>
+
+#include "TideMatchWriter.h"
+#include "MakePinApplication.h"
+#include "TideMatchSet.h"
+#include "TideSearchApplication.h"
+#include "TideSiteLocalizer.h"
+#include "io/MatchCollectionParser.h"
+#include "io/MzIdentMLWriter.h"
+#include "io/PinWriter.h"
+#include "io/PMCPepXMLWriter.h"
+#include "io/PMCSQTWriter.h"
+#include "model/PeptideSrc.h"
+#include "model/ProteinMatchCollection.h"
+#include "util/FileUtils.h"
+#include "util/modifications.h"
+#include "util/Params.h"
+#include "util/StringUtils.h"
+
+/**
+ * Gets the comma separated protein ids, e.g. "P1(12),P2(40)", and flanking
+ * amino acids of a PSM, as written to the protein id and flanking aa columns.
+ */
+void TideMatchWriter::getProteinIds(
+  const TidePsm& psm,
+  string* protein_ids,
+  string* flanking_aas
+) {
+  for (vector<TidePsmLocation>::const_iterator i = psm.locations->begin();
+       i != psm.locations->end();
+       ++i) {
+    if (i != psm.locations->begin()) {
+      *protein_ids += ',';
+      *flanking_aas += ',';
+    }
+    *protein_ids += i->protein_name + '(' + StringUtils::ToString(i->protein_pos) + ')';
+    *flanking_aas += i->n_flank;
+    *flanking_aas += i->c_flank;
+  }
+}
+
+/**
+ * Gets the localization score, written only if there was more than one
+ * placement of the modifications, and the site probabilities, e.g.
+ * "S3[79.97]:0.912,T5[79.97]:0.088", by position.
+ */
+void TideMatchWriter::getLocalization(
+  const TidePsm& psm,
+  int precision,
+  int mod_precision,
+  string* score,
+  string* sites
+) {
+  const SiteLocalization* localization = psm.localization;
+  if (!localization) {
+    return;
+  }
+  if (localization->num_isoforms > 1) {
+    *score = StringUtils::ToString(localization->score, precision, true);
+  }
+  for (vector<SiteProbability>::const_iterator i = localization->sites.begin();
+       i != localization->sites.end();
+       ++i) {
+    if (i != localization->sites.begin()) {
+      *sites += ',';
+    }
+    *sites += i->residue + StringUtils::ToString(i->pos + 1) +
+      '[' + StringUtils::ToString(i->delta, mod_precision) + "]:" +
+      StringUtils::ToString(i->probability, 3);
+  }
+}
+
+TideMultiWriter::~TideMultiWriter() {
+  for (vector<TideMatchWriter*>::iterator i = writers_.begin(); i != writers_.end(); ++i) {
+    delete *i;
+  }
+}
+
+void TideMultiWriter::add(TideMatchWriter* writer) {
+  writers_.push_back(writer);
+}
+
+void TideMultiWriter::write(const TidePsm& psm) {
+  for (vector<TideMatchWriter*>::iterator i = writers_.begin(); i != writers_.end(); ++i) {
+    (*i)->write(psm);
+  }
+}
+
+void TideMultiWriter::close() {
+  for (vector<TideMatchWriter*>::iterator i = writers_.begin(); i != writers_.end(); ++i) {
+    (*i)->close();
+  }
+}
+
+TideDelimitedWriter::TideDelimitedWriter(ofstream* target_file, ofstream* decoy_file)
+  : target_file_(target_file), decoy_file_(decoy_file),
+    concat_(Params::GetBool("concat")),
+    file_column_(Params::GetBool("file-column")),
+    exact_pval_(Params::GetBool("exact-p-value")),
+    localize_(SiteLocalizer::enabled()),
+    delta_mass_(TideSearchApplication::fragmentFilter()),
+    mass_precision_(Params::GetInt("mass-precision")),
+    precision_(Params::GetInt("precision")),
+    mod_precision_(Params::GetInt("mod-precision")) {
+}
+
+TideDelimitedWriter::~TideDelimitedWriter() {
+  delete target_file_;
+  delete decoy_file_;
+}
+
+void TideDelimitedWriter::writeHeaders(bool sp) {
+  writeHeaders(target_file_, false, sp);
+  writeHeaders(decoy_file_, true, sp);
+}
+
+/**
+ * Writes one row. Peptide centric and spectrum centric searches have
+ * slightly different columns and number formatting.
+ */
+void TideDelimitedWriter::write(const TidePsm& psm) {
+  ofstream* file = (psm.decoy && !concat_) ? decoy_file_ : target_file_;
+  if (!file) {
+    return;
+  }
+  const Spectrum* spectrum = psm.spectrum;
+  Crux::Peptide* cruxPep = psm.crux_peptide;
+
+  if (!psm.peptide_centric && file_column_) {
+    *file << *psm.spectrum_filename << '\t';
+  }
+  *file << spectrum->SpectrumNumber() << '\t'
+        << psm.charge << '\t';
+  if (psm.peptide_centric) {
+    *file << spectrum->PrecursorMZ() << '\t'
+          << (spectrum->PrecursorMZ() - MASS_PROTON) * psm.charge << '\t'
+          << cruxPep->calcModifiedMass() << '\t'
+          << psm.delta_cn << '\t';
+    if (psm.sp_data) {
+      *file << psm.sp_data->sp_score << '\t'
+            << psm.sp_rank << '\t';
+    }
+  } else {
+    writeMassColumns(*file, psm);
+    *file << '\t'
+          << psm.delta_cn << '\t'
+          << psm.delta_lcn << '\t';
+    if (psm.sp_data) {
+      *file << StringUtils::ToString(psm.sp_data->sp_score, precision_) << '\t'
+            << psm.sp_rank << '\t';
+    }
+  }
+
+  // Use scientific notation for exact p-value, but not refactored XCorr.
+  if (exact_pval_) {
+    *file << StringUtils::ToString(psm.xcorr_pval, precision_, false) << '\t';
+    *file << StringUtils::ToString(psm.xcorr_score, precision_, true) << '\t';
+  } else {
+    *file << StringUtils::ToString(psm.xcorr_score, precision_, true) << '\t';
+  }
+  if (psm.has_elution_score) {
+    *file << psm.elution_score << '\t';
+  }
+  *file << psm.rank << '\t';
+  if (psm.sp_data) {
+    *file << psm.sp_data->matched_ions << '\t'
+          << psm.sp_data->total_ions << '\t';
+  }
+  if (psm.peptide_centric) {
+    *file << psm.peptide_matches << '\t';
+  }
+  *file << psm.distinct_matches << '\t';
+  writePeptideColumns(*file, psm);
+  *file << endl;
+}
+
+/**
+ * Writes the precursor m/z, spectrum neutral mass and peptide mass columns
+ * of a spectrum centric row.
+ */
+void TideDelimitedWriter::writeMassColumns(ostream& out, const TidePsm& psm) const {
+  const Spectrum* spectrum = psm.spectrum;
+  out << StringUtils::ToString(spectrum->PrecursorMZ(), mass_precision_) << '\t'
+      << StringUtils::ToString((spectrum->PrecursorMZ() - MASS_PROTON) * psm.charge, mass_precision_) << '\t'
+      << StringUtils::ToString(psm.crux_peptide->calcModifiedMass(), mass_precision_);
+}
+
+/**
+ * Writes the columns from the sequence to the end of the row.
+ */
+void TideDelimitedWriter::writePeptideColumns(ostream& out, const TidePsm& psm) const {
+  Crux::Peptide* cruxPep = psm.crux_peptide;
+  string proteinNames, flankingAAs;
+  getProteinIds(psm, &proteinNames, &flankingAAs);
+  out << cruxPep->getModifiedSequenceWithMasses() << '\t'
+      << cruxPep->getModsString() << '\t'
+      << TideMatchSet::CleavageType << '\t'
+      << proteinNames << '\t'
+      << flankingAAs << '\t';
+  if (psm.peptide_centric) {
+    out << cruxPep->getDecoyType();
+  } else {
+    out << (psm.decoy ? "decoy" : "target");
+  }
+  if (!psm.original_target_sequence.empty()) {
+    out << '\t' << psm.original_target_sequence;
+  }
+  if (delta_mass_) {
+    out << '\t' << StringUtils::ToString(
+      (psm.spectrum->PrecursorMZ() - MASS_PROTON) * psm.charge - cruxPep->calcModifiedMass(),
+      mass_precision_);
+  }
+  if (localize_) {
+    string score, sites;
+    getLocalization(psm, precision_, mod_precision_, &score, &sites);
+    out << '\t' << score << '\t' << sites;
+  }
+}
+
+/**
+ * Write headers for tab delimited file
+ */
+void TideDelimitedWriter::writeHeaders(ofstream* file, bool decoyFile, bool sp) {
+  if (!file) {
+    return;
+  }
+  const int headers[] = {
+    FILE_COL, SCAN_COL, CHARGE_COL, SPECTRUM_PRECURSOR_MZ_COL, SPECTRUM_NEUTRAL_MASS_COL,
+    PEPTIDE_MASS_COL, DELTA_CN_COL, DELTA_LCN_COL, SP_SCORE_COL, SP_RANK_COL,
+    XCORR_SCORE_COL, XCORR_RANK_COL, BY_IONS_MATCHED_COL, BY_IONS_TOTAL_COL,
+    DISTINCT_MATCHES_SPECTRUM_COL, SEQUENCE_COL, MODIFICATIONS_COL, CLEAVAGE_TYPE_COL,
+    PROTEIN_ID_COL, FLANKING_AA_COL, TARGET_DECOY_COL, ORIGINAL_TARGET_SEQUENCE_COL,
+    DELTA_MASS_COL, LOCALIZATION_SCORE_COL, SITE_PROBABILITIES_COL
+  };
+  size_t numHeaders = sizeof(headers) / sizeof(int);
+  bool writtenHeader = false;
+  for (size_t i = 0; i < numHeaders; ++i) {
+    int header = headers[i];
+    if (!sp &&
+        (header == SP_SCORE_COL || header == SP_RANK_COL ||
+         header == BY_IONS_MATCHED_COL || header == BY_IONS_TOTAL_COL)) {
+      continue;
+    } else if (header == ORIGINAL_TARGET_SEQUENCE_COL &&
+               (TideSearchApplication::proteinLevelDecoys() ||
+                (!decoyFile && !Params::GetBool("concat")))) {
+      continue;
+    } else if (header == DELTA_MASS_COL && !TideSearchApplication::fragmentFilter()) {
+      continue;
+    } else if ((header == LOCALIZATION_SCORE_COL || header == SITE_PROBABILITIES_COL) &&
+               !SiteLocalizer::enabled()) {
+      continue;
+    }
+    if (writtenHeader) {
+      *file << '\t';
+    }
+    if (header == FILE_COL &&
+        (!Params::GetBool("file-column") || Params::GetBool("peptide-centric-search"))) {
+      continue;
+    }
+    if (header == XCORR_SCORE_COL && Params::GetBool("exact-p-value")) {
+      *file << get_column_header(EXACT_PVALUE_COL) << '\t'
+            << get_column_header(REFACTORED_SCORE_COL);
+      if (Params::GetInt("elution-window-size") > 0) {
+        *file << '\t' << get_column_header(ELUTION_WINDOW_COL);
+      }
+      writtenHeader = true;
+      continue;
+    }
+    if (header == DISTINCT_MATCHES_SPECTRUM_COL) {
+      if (Params::GetBool("peptide-centric-search")) {
+        *file << get_column_header(DISTINCT_MATCHES_PEPTIDE_COL) << '\t';
+        *file << get_column_header(DISTINCT_MATCHES_SPECTRUM_COL);
+      } else {
+        *file << get_column_header(DISTINCT_MATCHES_SPECTRUM_COL);
+      }
+      writtenHeader = true;
+      continue;
+    }
+    *file << get_column_header(header);
+    writtenHeader = true;
+  }
+  *file << endl;
+}
+
+TideBinaryWriter::TideBinaryWriter(
+  const string& target_file_name,
+  const string& decoy_file_name,
+  bool compute_sp
+) : decoy_file_(NULL),
+    concat_(Params::GetBool("concat")),
+    exact_pval_(Params::GetBool("exact-p-value")),
+    precision_(Params::GetInt("precision")),
+    mod_precision_(Params::GetInt("mod-precision")) {
+  bool overwrite = Params::GetBool("overwrite");
+  target_file_ = new BinaryMatchFileWriter(target_file_name, overwrite);
+  addColumns(target_file_, false, compute_sp);
+  if (!decoy_file_name.empty()) {
+    decoy_file_ = new BinaryMatchFileWriter(decoy_file_name, overwrite);
+    addColumns(decoy_file_, true, compute_sp);
+  }
+}
+
+TideBinaryWriter::~TideBinaryWriter() {
+  delete target_file_;
+  delete decoy_file_;
+}
+
+/**
+ * Adds the columns that TideDelimitedWriter::writeHeaders would write.
+ */
+void TideBinaryWriter::addColumns(BinaryMatchFileWriter* file, bool decoyFile, bool sp) {
+  bool peptide_centric = Params::GetBool("peptide-centric-search");
+  if (Params::GetBool("file-column") && !peptide_centric) {
+    file->addColumn(FILE_COL, BinaryMatchFile::STRING_COLUMN);
+  }
+  file->addColumn(SCAN_COL, BinaryMatchFile::INT_COLUMN);
+  file->addColumn(CHARGE_COL, BinaryMatchFile::INT_COLUMN);
+  file->addColumn(SPECTRUM_PRECURSOR_MZ_COL, BinaryMatchFile::DOUBLE_COLUMN);
+  file->addColumn(SPECTRUM_NEUTRAL_MASS_COL, BinaryMatchFile::DOUBLE_COLUMN);
+  file->addColumn(PEPTIDE_MASS_COL, BinaryMatchFile::DOUBLE_COLUMN);
+  file->addColumn(DELTA_CN_COL, BinaryMatchFile::DOUBLE_COLUMN);
+  if (!peptide_centric) {
+    file->addColumn(DELTA_LCN_COL, BinaryMatchFile::DOUBLE_COLUMN);
+  }
+  if (sp) {
+    file->addColumn(SP_SCORE_COL, BinaryMatchFile::DOUBLE_COLUMN);
+    file->addColumn(SP_RANK_COL, BinaryMatchFile::INT_COLUMN);
+  }
+  if (exact_pval_) {
+    file->addColumn(EXACT_PVALUE_COL, BinaryMatchFile::DOUBLE_COLUMN);
+    file->addColumn(REFACTORED_SCORE_COL, BinaryMatchFile::DOUBLE_COLUMN);
+    if (Params::GetInt("elution-window-size") > 0) {
+      file->addColumn(ELUTION_WINDOW_COL, BinaryMatchFile::DOUBLE_COLUMN);
+    }
+  } else {
+    file->addColumn(XCORR_SCORE_COL, BinaryMatchFile::DOUBLE_COLUMN);
+  }
+  file->addColumn(XCORR_RANK_COL, BinaryMatchFile::INT_COLUMN);
+  if (sp) {
+    file->addColumn(BY_IONS_MATCHED_COL, BinaryMatchFile::INT_COLUMN);
+    file->addColumn(BY_IONS_TOTAL_COL, BinaryMatchFile::INT_COLUMN);
+  }
+  if (peptide_centric) {
+    file->addColumn(DISTINCT_MATCHES_PEPTIDE_COL, BinaryMatchFile::INT_COLUMN);
+  }
+  file->addColumn(DISTINCT_MATCHES_SPECTRUM_COL, BinaryMatchFile::INT_COLUMN);
+  file->addColumn(SEQUENCE_COL, BinaryMatchFile::STRING_COLUMN);
+  file->addColumn(MODIFICATIONS_COL, BinaryMatchFile::STRING_COLUMN);
+  file->addColumn(CLEAVAGE_TYPE_COL, BinaryMatchFile::STRING_COLUMN);
+  file->addColumn(PROTEIN_ID_COL, BinaryMatchFile::STRING_COLUMN);
+  file->addColumn(FLANKING_AA_COL, BinaryMatchFile::STRING_COLUMN);
+  file->addColumn(TARGET_DECOY_COL, BinaryMatchFile::STRING_COLUMN);
+  if (!TideSearchApplication::proteinLevelDecoys() && (decoyFile || concat_)) {
+    file->addColumn(ORIGINAL_TARGET_SEQUENCE_COL, BinaryMatchFile::STRING_COLUMN);
+  }
+  if (TideSearchApplication::fragmentFilter()) {
+    file->addColumn(DELTA_MASS_COL, BinaryMatchFile::DOUBLE_COLUMN);
+  }
+  // As formatted in the tab-delimited files, so unlocalized PSMs stay empty
+  if (SiteLocalizer::enabled()) {
+    file->addColumn(LOCALIZATION_SCORE_COL, BinaryMatchFile::STRING_COLUMN);
+    file->addColumn(SITE_PROBABILITIES_COL, BinaryMatchFile::STRING_COLUMN);
+  }
+}
+
+void TideBinaryWriter::write(const TidePsm& psm) {
+  BinaryMatchFileWriter* file = (psm.decoy && !concat_) ? decoy_file_ : target_file_;
+  if (!file) {
+    return;
+  }
+  const Spectrum* spectrum = psm.spectrum;
+  Crux::Peptide* cruxPep = psm.crux_peptide;
+
+  if (psm.spectrum_filename) {
+    file->setString(FILE_COL, *psm.spectrum_filename);
+  }
+  file->setInt(SCAN_COL, spectrum->SpectrumNumber());
+  file->setInt(CHARGE_COL, psm.charge);
+  file->setDouble(SPECTRUM_PRECURSOR_MZ_COL, spectrum->PrecursorMZ());
+  file->setDouble(SPECTRUM_NEUTRAL_MASS_COL, (spectrum->PrecursorMZ() - MASS_PROTON) * psm.charge);
+  file->setDouble(PEPTIDE_MASS_COL, cruxPep->calcModifiedMass());
+  file->setDouble(DELTA_CN_COL, psm.delta_cn);
+  file->setDouble(DELTA_LCN_COL, psm.delta_lcn);
+  if (psm.sp_data) {
+    file->setDouble(SP_SCORE_COL, psm.sp_data->sp_score);
+    file->setInt(SP_RANK_COL, psm.sp_rank);
+    file->setInt(BY_IONS_MATCHED_COL, psm.sp_data->matched_ions);
+    file->setInt(BY_IONS_TOTAL_COL, psm.sp_data->total_ions);
+  }
+  if (exact_pval_) {
+    file->setDouble(EXACT_PVALUE_COL, psm.xcorr_pval);
+    file->setDouble(REFACTORED_SCORE_COL, psm.xcorr_score);
+  } else {
+    file->setDouble(XCORR_SCORE_COL, psm.xcorr_score);
+  }
+  if (psm.has_elution_score) {
+    file->setDouble(ELUTION_WINDOW_COL, psm.elution_score);
+  }
+  file->setInt(XCORR_RANK_COL, psm.rank);
+  file->setInt(DISTINCT_MATCHES_PEPTIDE_COL, psm.peptide_matches);
+  file->setInt(DISTINCT_MATCHES_SPECTRUM_COL, psm.distinct_matches);
+
+  string proteinNames, flankingAAs;
+  getProteinIds(psm, &proteinNames, &flankingAAs);
+  file->setString(SEQUENCE_COL, cruxPep->getModifiedSequenceWithMasses());
+  file->setString(MODIFICATIONS_COL, cruxPep->getModsString());
+  file->setString(CLEAVAGE_TYPE_COL, TideMatchSet::CleavageType);
+  file->setString(PROTEIN_ID_COL, proteinNames);
+  file->setString(FLANKING_AA_COL, flankingAAs);
+  if (psm.peptide_centric) {
+    file->setString(TARGET_DECOY_COL, cruxPep->getDecoyType());
+  } else {
+    file->setString(TARGET_DECOY_COL, psm.decoy ? "decoy" : "target");
+  }
+  file->setString(ORIGINAL_TARGET_SEQUENCE_COL, psm.original_target_sequence);
+  file->setDouble(DELTA_MASS_COL,
+                  (spectrum->PrecursorMZ() - MASS_PROTON) * psm.charge - cruxPep->calcModifiedMass());
+  string localizationScore, siteProbabilities;
+  if (psm.localization) {
+    getLocalization(psm, precision_, mod_precision_, &localizationScore, &siteProbabilities);
+  }
+  file->setString(LOCALIZATION_SCORE_COL, localizationScore);
+  file->setString(SITE_PROBABILITIES_COL, siteProbabilities);
+  file->writeRow();
+}
+
+void TideBinaryWriter::close() {
+  target_file_->close();
+  if (decoy_file_) {
+    decoy_file_->close();
+  }
+}
+
+TideConvertingWriter::TideConvertingWriter(
+  CruxApplication* application,
+  bool compute_sp,
+  bool has_decoys,
+  const string& make_pin_file
+) : application_(application),
+    database_file_(Params::GetString("protein-database")),
+    concat_(Params::GetBool("concat")),
+    exact_pval_(Params::GetBool("exact-p-value")),
+    compute_sp_(compute_sp),
+    peptide_centric_(Params::GetBool("peptide-centric-search")),
+    make_pin_(NULL),
+    make_pin_targets_(0),
+    make_pin_decoys_(0),
+    digestion_(string_to_digest_type(TideMatchSet::CleavageType)),
+    decoy_prefix_(Params::GetString("decoy-prefix")),
+    batch_matches_(0),
+    last_spectrum_(NULL),
+    last_charge_(0) {
+  if (database_file_.empty()) {
+    database_ = new Database();
+    carp(CARP_INFO, "Database not provided, will use empty database");
+  } else {
+    database_ = new Database(database_file_.c_str(), false);
+    carp(CARP_INFO, "Created Database using Fasta File");
+  }
+
+  num_outputs_ = (!concat_ && has_decoys) ? 2 : 1;
+  if (concat_) {
+    outputs_[0].file_base = "tide-search.";
+  } else {
+    outputs_[0].file_base = "tide-search.target.";
+    outputs_[1].file_base = "tide-search.decoy.";
+  }
+  for (int i = 0; i < num_outputs_; i++) {
+    outputs_[i].matches = newCollection();
+    openWriters(&outputs_[i]);
+  }
+  if (!make_pin_file.empty()) {
+    make_pin_ = new PinWriter();
+    make_pin_->openFile(application_, make_pin_file, PSMWriter::PSMS);
+    MakePinApplication::enableFeatures(make_pin_, outputs_[0].matches,
+                                       Params::GetInt("max-precursor-charge"));
+    make_pin_->printHeader();
+  }
+}
+
+TideConvertingWriter::~TideConvertingWriter() {
+  for (int i = 0; i < num_outputs_; i++) {
+    delete outputs_[i].matches;
+    delete outputs_[i].pin;
+    delete outputs_[i].pepxml;
+    delete outputs_[i].mzid;
+    delete outputs_[i].sqt;
+  }
+  delete make_pin_;
+  Database::freeDatabase(database_);
+}
+
+bool TideConvertingWriter::enabled() {
+  return Params::GetBool("pin-output") || Params::GetBool("pepxml-output") ||
+         Params::GetBool("mzid-output") || Params::GetBool("sqt-output");
+}
+
+/**
+ * Makes an empty collection with the columns that the tab-delimited reader
+ * would have found.
+ */
+MatchCollection* TideConvertingWriter::newCollection() const {
+  MatchCollection* collection = new MatchCollection();
+  collection->preparePostProcess();
+  collection->setHasDistinctMatches(true);
+  collection->setScoredType(DELTA_CN, true);
+  collection->setScoredType(DELTA_LCN, !peptide_centric_);
+  collection->setScoredType(SP, compute_sp_);
+  collection->setScoredType(XCORR, !exact_pval_);
+  collection->setScoredType(TIDE_SEARCH_EXACT_PVAL, exact_pval_);
+  collection->setScoredType(TIDE_SEARCH_REFACTORED_XCORR, exact_pval_);
+  collection->setScoredType(BY_IONS_MATCHED, compute_sp_);
+  collection->setScoredType(BY_IONS_TOTAL, compute_sp_);
+  return collection;
+}
+
+/**
+ * Opens the files of the enabled formats and writes everything that comes
+ * before the matches. The SQT header counts the proteins of all matches, so
+ * it is written in front of the matches when the writer is closed.
+ */
+void TideConvertingWriter::openWriters(Output* output) {
+  if (Params::GetBool("pin-output")) {
+    output->pin = new PinWriter();
+    output->pin->openFile(application_, make_file_path(output->file_base + "pin"),
+                          PSMWriter::PSMS);
+    // The charge features cannot wait for the charges of all matches, so
+    // there is one for every charge that can be searched.
+    output->pin->enableFeatures(output->matches, Params::GetInt("max-precursor-charge"));
+    output->pin->printHeader();
+  }
+  if (Params::GetBool("pepxml-output")) {
+    output->pepxml = new PMCPepXMLWriter();
+    output->pepxml->openFile(application_, make_file_path(output->file_base + "pep.xml"),
+                             PSMWriter::PSMS);
+    output->pepxml->writeHeader();
+  }
+  if (Params::GetBool("mzid-output")) {
+    output->mzid = new MzIdentMLWriter();
+    output->mzid->openFile(application_, make_file_path(output->file_base + "mzid"),
+                           PSMWriter::PSMS);
+  }
+  if (Params::GetBool("sqt-output")) {
+    output->sqt_body = make_file_path(output->file_base + "sqt.tmp");
+    output->sqt = new PMCSQTWriter();
+    output->sqt->openFile(application_, output->sqt_body, PSMWriter::PSMS);
+  }
+}
+
+/**
+ * Writes the matches converted so far to the open writers and frees them.
+ */
+void TideConvertingWriter::writeBatch() {
+  int top_match = Params::GetInt("top-match");
+  if (make_pin_) {
+    vector<MatchCollection*> decoys;
+    if (num_outputs_ > 1) {
+      decoys.push_back(outputs_[1].matches);
+    }
+    make_pin_->write(outputs_[0].matches, decoys, top_match);
+  }
+  for (int i = 0; i < num_outputs_; i++) {
+    Output* output = &outputs_[i];
+    if (output->pin) {
+      output->pin->write(output->matches, vector<MatchCollection*>(), top_match);
+    }
+    if (output->pepxml || output->sqt) {
+      ProteinMatchCollection protein_collection(output->matches);
+      if (output->pepxml) {
+        output->pepxml->writePSMs(&protein_collection);
+      }
+      if (output->sqt) {
+        output->sqt->writePSMs(&protein_collection);
+      }
+    }
+    if (output->mzid) {
+      output->mzid->write(output->matches, database_file_);
+    }
+    delete output->matches;
+    output->matches = newCollection();
+  }
+  batch_matches_ = 0;
+}
+
+void TideConvertingWriter::closeWriters(Output* output) {
+  if (output->pin) {
+    output->pin->closeFile();
+  }
+  if (output->pepxml) {
+    output->pepxml->writeFooter();
+    output->pepxml->closeFile();
+  }
+  if (output->mzid) {
+    output->mzid->closeFile();
+  }
+  if (output->sqt) {
+    output->sqt->closeFile();
+    string sqt_file = make_file_path(output->file_base + "sqt");
+    PMCSQTWriter header;
+    header.openFile(application_, sqt_file, PSMWriter::PSMS);
+    header.writeHeader(database_file_, output->proteins.size());
+    header.closeFile();
+    ofstream sqt(sqt_file.c_str(), ios::out | ios::app | ios::binary);
+    ifstream body(output->sqt_body.c_str(), ios::in | ios::binary);
+    sqt << body.rdbuf();
+    body.close();
+    sqt.close();
+    FileUtils::Remove(output->sqt_body);
+  }
+}
+
+void TideConvertingWriter::write(const TidePsm& psm) {
+  // A batch is only written between spectra, so that all matches of a
+  // spectrum are written together.
+  if (batch_matches_ >= BATCH_SIZE &&
+      (psm.spectrum != last_spectrum_ || psm.charge != last_charge_)) {
+    writeBatch();
+  }
+  last_spectrum_ = psm.spectrum;
+  last_charge_ = psm.charge;
+  ++batch_matches_;
+
+  Output* output = (psm.decoy && num_outputs_ > 1) ? &outputs_[1] : &outputs_[0];
+
+  Crux::Spectrum* spectrum = new Crux::Spectrum(
+    psm.spectrum->SpectrumNumber(), psm.spectrum->SpectrumNumber(),
+    psm.spectrum->PrecursorMZ(), vector<int>(1, psm.charge),
+    psm.spectrum_filename ? *psm.spectrum_filename : "");
+
+  Crux::Peptide* peptide = new Crux::Peptide();
+  MODIFIED_AA_T* modified_seq;
+  peptide->setLength(convert_to_mod_aa_seq(
+    psm.crux_peptide->getModifiedSequenceWithMasses(), &modified_seq));
+  peptide->setModifiedAASequence(modified_seq, false);
+  peptide->setMods(psm.crux_peptide->getVarMods());
+  addPeptideSrcs(peptide, psm, output->sqt ? &output->proteins : NULL);
+
+  Crux::Match* match = new Crux::Match(peptide, spectrum, spectrum->getZState(0), false);
+  match->setPostProcess(true);
+  if (psm.spectrum_filename) {
+    match->setFilePath(*psm.spectrum_filename);
+  }
+  if (psm.sp_data) {
+    match->setScore(SP, psm.sp_data->sp_score);
+    match->setRank(SP, psm.sp_rank);
+    match->setScore(BY_IONS_MATCHED, psm.sp_data->matched_ions);
+    match->setScore(BY_IONS_TOTAL, psm.sp_data->total_ions);
+  } else {
+    match->setScore(SP, NOT_SCORED);
+    match->setRank(SP, 0);
+  }
+  if (exact_pval_) {
+    match->setScore(TIDE_SEARCH_EXACT_PVAL, psm.xcorr_pval);
+    match->setScore(TIDE_SEARCH_REFACTORED_XCORR, psm.xcorr_score);
+  } else {
+    match->setScore(XCORR, psm.xcorr_score);
+  }
+  match->setRank(XCORR, psm.rank);
+  match->setScore(DELTA_CN, psm.delta_cn);
+  if (!psm.peptide_centric) {
+    match->setScore(DELTA_LCN, psm.delta_lcn);
+  }
+
+  match->setTargetExperimentSize(psm.distinct_matches);
+  match->setLnExperimentSize(psm.distinct_matches > 0 ? log((FLOAT_T)psm.distinct_matches) : 0);
+  SpectrumZState zState((psm.spectrum->PrecursorMZ() - MASS_PROTON) * psm.charge, psm.charge);
+  match->setZState(zState);
+  if (!psm.locations->empty() &&
+      StringUtils::StartsWith(psm.locations->front().protein_name, decoy_prefix_)) {
+    match->setNullPeptide(true);
+  }
+  if (match->getNullPeptide()) {
+    ++make_pin_decoys_;
+  } else {
+    ++make_pin_targets_;
+  }
+  output->matches->addMatchToPostMatchCollection(match);
+}
+
+void TideConvertingWriter::addPeptideSrcs(
+  Crux::Peptide* peptide,
+  const TidePsm& psm,
+  set<Crux::Protein*>* proteins
+) {
+  string sequence = psm.peptide->Seq();
+  for (vector<TidePsmLocation>::const_iterator i = psm.locations->begin();
+       i != psm.locations->end();
+       ++i) {
+    string protein_id = i->protein_name;
+    bool is_decoy;
+    Crux::Protein* protein = MatchCollectionParser::getProtein(
+      database_, NULL, protein_id, is_decoy);
+
+    PeptideSrc* peptide_src = new PeptideSrc();
+    if (protein->isPostProcess()) {
+      peptide_src->setStartIdxOriginal(i->protein_pos);
+    }
+    string prev_aa(1, i->n_flank), next_aa(1, i->c_flank);
+    peptide_src->setParentProtein(protein);
+    peptide_src->setDigest(digestion_);
+    peptide_src->setStartIdx(protein->findStart(sequence, prev_aa, next_aa));
+    peptide->addPeptideSrc(peptide_src);
+    if (proteins) {
+      proteins->insert(protein);
+    }
+  }
+}
+
+void TideConvertingWriter::close() {
+  writeBatch();
+  for (int i = 0; i < num_outputs_; i++) {
+    closeWriters(&outputs_[i]);
+  }
+  if (make_pin_) {
+    make_pin_->closeFile();
+    carp(CARP_INFO, "There are %d target matches and %d decoys",
+         make_pin_targets_, make_pin_decoys_);
+    if (make_pin_targets_ == 0) {
+      carp(CARP_FATAL, "No target matches found!");
+    } else if (make_pin_decoys_ == 0) {
+      carp(CARP_FATAL, "No decoy matches found!  Did you set 'decoy-prefix' properly?");
+    }
+  }
+}
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 2
+ * End:
+ */
@@ -0,0 +1,268 @@
+#ifndef TIDE_MATCH_WRITER_H
+#define TIDE_MATCH_WRITER_H
+
+#include <fstream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "tide/peptide.h"
+#include "tide/sp_scorer.h"
+#include "tide/spectrum_collection.h"
+
+#include "io/BinaryMatchFile.h"
+#include "io/PSMWriter.h"
+#include "model/Database.h"
+#include "model/MatchCollection.h"
+#include "model/Peptide.h"
+
+using namespace std;
+
+class CruxApplication;
+class MzIdentMLWriter;
+class PinWriter;
+class PMCPepXMLWriter;
+class PMCSQTWriter;
+struct SiteLocalization;
+
+/**
+ * One protein location of a reported peptide.
+ */
+struct TidePsmLocation {
+  string protein_name;
+  int protein_pos;  ///< 1-based position written after the protein name
+  char n_flank;
+  char c_flank;
+};
+
+/**
+ * Everything the writers need to know about a single reported PSM. Built by
+ * TideMatchSet from its in-memory match data; pointers are only valid for the
+ * duration of the TideMatchWriter::write call.
+ */
+struct TidePsm {
+  const string* spectrum_filename;
+  const Spectrum* spectrum;
+  int charge;
+  const Peptide* peptide;
+  Crux::Peptide* crux_peptide;
+  const vector<TidePsmLocation>* locations;
+  string original_target_sequence;  ///< empty if not reported
+  bool peptide_centric;
+  bool decoy;
+  double delta_cn;
+  double delta_lcn;
+  const SpScorer::SpScoreData* sp_data;  ///< NULL if sp was not computed
+  int sp_rank;
+  double xcorr_score;
+  double xcorr_pval;
+  bool has_elution_score;
+  double elution_score;
+  int rank;
+  int peptide_matches;  ///< only used for peptide centric search
+  int distinct_matches;
+  const SiteLocalization* localization;  ///< NULL if not localized
+};
+
+/**
+ * Interface that TideMatchSet reports PSMs into. Callers hold the output lock
+ * while calling write(), so implementations do not need their own locking.
+ */
+class TideMatchWriter {
+ public:
+  virtual ~TideMatchWriter() {}
+
+  virtual void write(const TidePsm& psm) = 0;
+
+  /**
+   * Called once after all spectrum files have been searched.
+   */
+  virtual void close() {}
+
+ protected:
+  static void getProteinIds(
+    const TidePsm& psm,
+    string* protein_ids,
+    string* flanking_aas
+  );
+
+  /**
+   * Gets the localization score and site probabilities columns of a PSM,
+   * empty if it was not localized.
+   */
+  static void getLocalization(
+    const TidePsm& psm,
+    int precision,
+    int mod_precision,
+    string* score,
+    string* sites
+  );
+};
+
+/**
+ * Forwards every PSM to a list of writers, which it owns.
+ */
+class TideMultiWriter : public TideMatchWriter {
+ public:
+  TideMultiWriter() {}
+  ~TideMultiWriter();
+
+  void add(TideMatchWriter* writer);
+  bool empty() const { return writers_.empty(); }
+
+  void write(const TidePsm& psm);
+  void close();
+
+ protected:
+  vector<TideMatchWriter*> writers_;
+};
+
+/**
+ * Writes the tab-delimited tide-search.[target|decoy].txt files.
+ */
+class TideDelimitedWriter : public TideMatchWriter {
+ public:
+  TideDelimitedWriter(
+    ofstream* target_file,  ///< target (or concatenated) file, owned
+    ofstream* decoy_file  ///< decoy file, owned, may be NULL
+  );
+  ~TideDelimitedWriter();
+
+  void writeHeaders(bool sp);
+  void write(const TidePsm& psm);
+
+  static void writeHeaders(
+    ofstream* file,
+    bool decoyFile,
+    bool sp
+  );
+
+ protected:
+  void writeMassColumns(ostream& out, const TidePsm& psm) const;
+  void writePeptideColumns(ostream& out, const TidePsm& psm) const;
+
+  ofstream* target_file_;
+  ofstream* decoy_file_;
+  bool concat_;
+  bool file_column_;
+  bool exact_pval_;
+  bool localize_;
+  bool delta_mass_;
+  int mass_precision_;
+  int precision_;
+  int mod_precision_;
+};
+
+/**
+ * Writes the binary tide-search.[target|decoy].psm.bin files, with the same
+ * columns as the tab-delimited files.
+ */
+class TideBinaryWriter : public TideMatchWriter {
+ public:
+  TideBinaryWriter(
+    const string& target_file_name,
+    const string& decoy_file_name,  ///< empty for no decoy file
+    bool compute_sp
+  );
+  ~TideBinaryWriter();
+
+  void write(const TidePsm& psm);
+  void close();
+
+ protected:
+  void addColumns(BinaryMatchFileWriter* file, bool decoyFile, bool sp);
+
+  BinaryMatchFileWriter* target_file_;
+  BinaryMatchFileWriter* decoy_file_;
+  bool concat_;
+  bool exact_pval_;
+  int precision_;
+  int mod_precision_;
+};
+
+/**
+ * Converts PSMs to Crux matches as they are reported and writes them with the
+ * PSMWriters for pin, pepXML, mzIdentML and SQT output. This replaces
+ * re-parsing the tab-delimited output with PSMConvertApplication.
+ *
+ * The matches are written in batches of about BATCH_SIZE, so only one batch
+ * of Crux matches is held at a time. The same batches can also be written to
+ * a pin file in the layout of make-pin, with the targets and decoys together,
+ * so that a pipeline does not have to run make-pin on the results files.
+ */
+class TideConvertingWriter : public TideMatchWriter {
+ public:
+  TideConvertingWriter(
+    CruxApplication* application,
+    bool compute_sp,
+    bool has_decoys,
+    const string& make_pin_file  ///< empty for no make-pin file
+  );
+  ~TideConvertingWriter();
+
+  /**
+   * \returns true if any of the formats handled by this writer are enabled.
+   */
+  static bool enabled();
+
+  void write(const TidePsm& psm);
+  void close();
+
+ protected:
+  static const int BATCH_SIZE = 10000;
+
+  /**
+   * The matches and writers of one set of output files, either the targets,
+   * the decoys or both.
+   */
+  struct Output {
+    Output()
+      : matches(NULL), pin(NULL), pepxml(NULL), mzid(NULL), sqt(NULL) {}
+
+    MatchCollection* matches;
+    string file_base;
+    PinWriter* pin;
+    PMCPepXMLWriter* pepxml;
+    MzIdentMLWriter* mzid;
+    PMCSQTWriter* sqt;  ///< writes the matches to sqt_body, without header
+    string sqt_body;
+    set<Crux::Protein*> proteins;  ///< counted in the SQT header
+  };
+
+  MatchCollection* newCollection() const;
+  void openWriters(Output* output);
+  void writeBatch();
+  void closeWriters(Output* output);
+  void addPeptideSrcs(
+    Crux::Peptide* peptide,
+    const TidePsm& psm,
+    set<Crux::Protein*>* proteins  ///< proteins are added here if not NULL
+  );
+
+  CruxApplication* application_;
+  string database_file_;
+  Database* database_;
+  Output outputs_[2];  ///< targets, then decoys if they have their own files
+  int num_outputs_;
+  bool concat_;
+  bool exact_pval_;
+  bool compute_sp_;
+  bool peptide_centric_;
+  PinWriter* make_pin_;
+  int make_pin_targets_;
+  int make_pin_decoys_;
+  DIGEST_T digestion_;
+  string decoy_prefix_;
+  int batch_matches_;
+  const Spectrum* last_spectrum_;
+  int last_charge_;
+};
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 2
+ * End:
+ */
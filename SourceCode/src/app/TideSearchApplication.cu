@@ -1,4 +1,8 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
 #include <cstdio>
+#include <functional>
 #include "app/tide/abspath.h"
 #include "app/tide/records_to_vector-inl.h"
 
@@ -8,9 +12,11 @@
 #include "TideIndexApplication.h"
 #include "TideSearchApplication.h"
 #include "ParamMedicApplication.h"
-#include "PSMConvertApplication.h"
 #include "tide/mass_constants.h"
+#include "tide/compiler.h"
+#include "tide/indexed_spectra.h"
 #include "TideMatchSet.h"
+#include "TideShards.h"
 #include "util/Params.h"
 #include "util/FileUtils.h"
 #include "util/StringUtils.h"
@@ -67,10 +73,18 @@ __global__ void ComputeCache2nd(int *gSpec, int aSize, bool FP_, bool NL_, int B
 //float* time_check = new float(0);
 
 TideSearchApplication::TideSearchApplication():
-  exact_pval_search_(false), remove_index_(""), spectrum_flag_(NULL) {
+  exact_pval_search_(false), remove_index_(""), spectrum_flag_(NULL),
+  searched_spec_charges_(0), candidate_peptides_(0),
+  checkpoint_(NULL), localizer_(NULL), fragment_index_(NULL),
+  fragment_candidates_(0), fragment_peaks_(0), config_(NULL),
+  wrote_make_pin_(false) {
 }
 
 TideSearchApplication::~TideSearchApplication() {
+  delete checkpoint_;
+  delete localizer_;
+  delete fragment_index_;
+  delete config_;
   if (!remove_index_.empty()) {
     carp(CARP_DEBUG, "Removing temp index '%s'", remove_index_.c_str());
     FileUtils::Remove(remove_index_);
@@ -87,6 +101,9 @@ int TideSearchApplication::main(const vector<string>& input_files) {
 int TideSearchApplication::main(const vector<string>& input_files, const string input_index) {
   carp(CARP_INFO, "Running tide-search...");
 
+  delete config_;
+  config_ = new TideSearchConfig();
+
   // prevent different output formats from using threading
   if (Params::GetBool("peptide-centric-search") == true) {
     NUM_THREADS = 1;
@@ -108,6 +125,38 @@ int TideSearchApplication::main(const vector<string>& input_files, const string
   string proteins_file = FileUtils::Join(index, "protix");
   string auxlocs_file = FileUtils::Join(index, "auxlocs");
 
+  // A sharded index is searched one shard at a time, each into its own
+  // partial results file, and the partial results are then merged. With
+  // index-shard, only that shard is searched, and with merge-shards, the
+  // partial results of earlier searches are only merged.
+  vector<string> shard_files = TideShards::ShardFiles(index);
+  bool sharded = !shard_files.empty();
+  int index_shard = Params::GetInt("index-shard");
+  bool merge_shards = Params::GetBool("merge-shards");
+  vector<int> search_shards;
+  if (!sharded) {
+    if (index_shard >= 0 || merge_shards) {
+      carp(CARP_FATAL, "The index %s was not built with index-shards, so "
+                       "index-shard and merge-shards cannot be used", index.c_str());
+    }
+    shard_files.push_back(peptides_file);
+    search_shards.push_back(0);
+  } else if (index_shard >= 0 && merge_shards) {
+    carp(CARP_FATAL, "index-shard and merge-shards cannot be used together");
+  } else if (index_shard >= (int)shard_files.size()) {
+    carp(CARP_FATAL, "The index %s only has %d shards", index.c_str(), (int)shard_files.size());
+  } else if (index_shard >= 0) {
+    search_shards.push_back(index_shard);
+  } else if (!merge_shards) {
+    for (int i = 0; i < (int)shard_files.size(); i++) {
+      search_shards.push_back(i);
+    }
+  }
+  if (sharded) {
+    carp(CARP_INFO, "Index has %d shards", (int)shard_files.size());
+    peptides_file = shard_files[search_shards.empty() ? 0 : search_shards[0]];
+  }
+
   double window = Params::GetDouble("precursor-window");
   WINDOW_TYPE_T window_type = string_to_window_type(Params::GetString("precursor-window-type"));
 
@@ -228,11 +277,28 @@ int TideSearchApplication::main(const vector<string>& input_files, const string
       &aaf_peptides_header.peptides_header().nterm_mods(), 
       &aaf_peptides_header.peptides_header().cterm_mods(),
                         bin_width_, bin_offset_);
+    // The frequencies are those of the whole index, even when searching
+    // only one shard, so that the p-values do not depend on the sharding.
+    vector<HeadedRecordReader*> aaf_shard_readers;
+    vector<RecordReader*> more_readers;
+    for (size_t i = 0; i < shard_files.size(); i++) {
+      if (shard_files[i] != peptides_file) {
+        aaf_shard_readers.push_back(new HeadedRecordReader(shard_files[i]));
+        more_readers.push_back(aaf_shard_readers.back()->Reader());
+      }
+    }
     ActivePeptideQueue* active_peptide_queue =
       new ActivePeptideQueue(aaf_peptide_reader.Reader(), proteins);
+    if (aaf_peptides_header.peptides_header().lazy_mods()) {
+      active_peptide_queue->EnumerateMods(aaf_peptides_header.peptides_header());
+    }
     nAA = active_peptide_queue->CountAAFrequency(bin_width_, bin_offset_,
-                                                 &aaFreqN, &aaFreqI, &aaFreqC, &aaMass);
+                                                 &aaFreqN, &aaFreqI, &aaFreqC, &aaMass,
+                                                 &more_readers);
     delete active_peptide_queue;
+    for (size_t i = 0; i < aaf_shard_readers.size(); i++) {
+      delete aaf_shard_readers[i];
+    }
   } // End calculation AA frequencies
 
   // Read auxlocs index file
@@ -266,11 +332,54 @@ int TideSearchApplication::main(const vector<string>& input_files, const string
 
   MassConstants::Init(&pepHeader.mods(), &pepHeader.nterm_mods(), 
     &pepHeader.cterm_mods(), bin_width_, bin_offset_);
+  // Theoretical peaks stored by tide-index with store-peaks are only valid for
+  // the bin width and offset they were computed with.
+  bool stored_peaks = pepHeader.has_peaks_bin_width() && !pepHeader.lazy_mods();
+  if (stored_peaks && (fabs(pepHeader.peaks_bin_width() - bin_width_) > 1e-9 ||
+                       fabs(pepHeader.peaks_bin_offset() - bin_offset_) > 1e-9)) {
+    carp(CARP_WARNING, "The index stores theoretical peaks for mz-bin-width %g and "
+                       "mz-bin-offset %g, so they are computed for this search instead",
+         pepHeader.peaks_bin_width(), pepHeader.peaks_bin_offset());
+    stored_peaks = false;
+  }
+  // Only the programs compiled for cpu-scoring are built from the stored
+  // peaks; the GPU and exact-p-value paths compute the ion masses themselves.
+  if (stored_peaks && (!config_->cpu_scoring || exact_pval_search_)) {
+    carp(CARP_DEBUG, "The theoretical peaks stored in the index are only used "
+                     "with cpu-scoring");
+    stored_peaks = false;
+  }
+
   ModificationDefinition::ClearAll();
   TideMatchSet::initModMap(pepHeader.mods(), ANY);
   TideMatchSet::initModMap(pepHeader.nterm_mods(), PEPTIDE_N);
   TideMatchSet::initModMap(pepHeader.cterm_mods(), PEPTIDE_C);
 
+  if (SiteLocalizer::enabled()) {
+    localizer_ = new SiteLocalizer(pepHeader.mods(), pepHeader.nterm_mods(),
+                                   pepHeader.cterm_mods());
+  } else if (Params::GetBool("localize-mods")) {
+    carp(CARP_WARNING, "Modifications can only be localized in spectrum-centric "
+                       "searches without exact-p-value, ignoring localize-mods");
+  }
+
+  if (fragmentFilter()) {
+    string fragments_file = FileUtils::Join(index, "fragix");
+    fragment_index_ = new FragmentIndex();
+    if (!FileUtils::Exists(fragments_file) || !fragment_index_->Read(fragments_file)) {
+      carp(CARP_FATAL, "Error reading the fragment index (%s). Was the index built "
+                       "with fragment-index?", fragments_file.c_str());
+    }
+    fragment_candidates_ = Params::GetInt("fragment-candidates");
+    fragment_peaks_ = Params::GetInt("fragment-peaks");
+    carp(CARP_INFO, "Scoring the %d candidates of each spectrum that share the "
+                    "most fragment ions with its %d most intense peaks",
+         fragment_candidates_, fragment_peaks_);
+  } else if (Params::GetInt("fragment-candidates") > 0) {
+    carp(CARP_WARNING, "Candidates can only be prefiltered in spectrum-centric "
+                       "searches without exact-p-value, ignoring fragment-candidates");
+  }
+
   ofstream* target_file = NULL;
   ofstream* decoy_file = NULL;
 
@@ -279,37 +388,142 @@ int TideSearchApplication::main(const vector<string>& input_files, const string
   stringstream ss;
   ss << Params::GetString("enzyme") << '-' << Params::GetString("digestion");
   TideMatchSet::CleavageType = ss.str();
+  // The binary files can replace the tab-delimited ones if txt-output is off.
+  bool binary_output = Params::GetBool("binary-output");
+  bool txt_output = !binary_output || Params::GetBool("txt-output");
+  if (sharded && (binary_output || TideConvertingWriter::enabled() ||
+                  Params::GetBool("peptide-centric-search"))) {
+    carp(CARP_FATAL, "Sharded indexes can only be searched spectrum-centric, "
+                     "with only tab-delimited output");
+  }
+  // Searching a single shard only writes its partial results
+  if (index_shard >= 0) {
+    txt_output = false;
+  }
+
+  // A checkpoint records which spectrum-charges have been searched and how
+  // much of the tab-delimited output has been written, so that an interrupted
+  // search can be resumed. The checkpoint does not record how much of the
+  // other output formats has been written, so they cannot be resumed. The
+  // make-pin file for the caller is given up instead, so that it runs make-pin
+  // on the output files.
+  string make_pin_file = sharded ? "" : make_pin_file_;
+  wrote_make_pin_ = false;
+  bool resume = false;
+  int checkpoint_interval = Params::GetInt("checkpoint-interval");
+  if (checkpoint_interval > 0) {
+    if (binary_output || TideConvertingWriter::enabled() ||
+        Params::GetBool("peptide-centric-search") || spectrum_flag_ != NULL ||
+        sharded) {
+      carp(CARP_WARNING, "Checkpoints are only supported for spectrum-centric "
+                         "searches of an unsharded index with only tab-delimited "
+                         "output, ignoring checkpoint-interval");
+    } else {
+      make_pin_file.clear();
+      delete checkpoint_;
+      checkpoint_ = new TideSearchCheckpoint(
+        make_file_path("tide-search.checkpoint.txt"),
+        TideSearchCheckpoint::Fingerprint(getOptions(), input_files, input_index),
+        checkpoint_interval);
+      resume = checkpoint_->load();
+    }
+  }
+
+  string target_bin_name, decoy_bin_name;
   if (!concat) {
     string target_file_name = make_file_path("tide-search.target.txt");
-    target_file = create_stream_in_path(target_file_name.c_str(), NULL, overwrite);
-    output_file_name_ = target_file_name;
+    target_bin_name = make_file_path(string("tide-search.target") + BinaryMatchFile::EXTENSION);
+    if (resume) {
+      target_file = TideSearchCheckpoint::ReopenOutput(target_file_name, checkpoint_->targetOffset());
+    } else if (txt_output) {
+      target_file = create_stream_in_path(target_file_name.c_str(), NULL, overwrite);
+    }
+    output_file_name_ = txt_output ? target_file_name : target_bin_name;
     if (HAS_DECOYS) {
       string decoy_file_name = make_file_path("tide-search.decoy.txt");
-      decoy_file = create_stream_in_path(decoy_file_name.c_str(), NULL, overwrite);
+      decoy_bin_name = make_file_path(string("tide-search.decoy") + BinaryMatchFile::EXTENSION);
+      if (resume) {
+        decoy_file = TideSearchCheckpoint::ReopenOutput(decoy_file_name, checkpoint_->decoyOffset());
+      } else if (txt_output) {
+        decoy_file = create_stream_in_path(decoy_file_name.c_str(), NULL, overwrite);
+      }
     }
   } else {
     string concat_file_name = make_file_path("tide-search.txt");
-    target_file = create_stream_in_path(concat_file_name.c_str(), NULL, overwrite);
-    output_file_name_ = concat_file_name;
+    target_bin_name = make_file_path(string("tide-search") + BinaryMatchFile::EXTENSION);
+    if (resume) {
+      target_file = TideSearchCheckpoint::ReopenOutput(concat_file_name, checkpoint_->targetOffset());
+    } else if (txt_output) {
+      target_file = create_stream_in_path(concat_file_name.c_str(), NULL, overwrite);
+    }
+    output_file_name_ = txt_output ? concat_file_name : target_bin_name;
+  }
+  if (index_shard >= 0) {
+    output_file_name_ = TideShards::ResultFile(index_shard);
+  }
+  if (checkpoint_) {
+    checkpoint_->setOutputs(target_file, decoy_file);
+  }
+
+  // All output formats are written from the in-memory matches as they are
+  // reported, so the tab-delimited files never need to be parsed again.
+  TideMultiWriter writer;
+  TideShardMerger* merger = NULL;
+  if (target_file && sharded) {
+    merger = new TideShardMerger(target_file, decoy_file, compute_sp);
+    merger->writeHeaders(compute_sp);
+    writer.add(merger);
+  } else if (target_file) {
+    TideDelimitedWriter* delimited_writer = new TideDelimitedWriter(target_file, decoy_file);
+    if (!resume) {
+      delimited_writer->writeHeaders(compute_sp);
+    }
+    writer.add(delimited_writer);
   }
-
-  if (target_file) {
-    TideMatchSet::writeHeaders(target_file, false, compute_sp);
-    TideMatchSet::writeHeaders(decoy_file, true, compute_sp);
+  if (binary_output) {
+    writer.add(new TideBinaryWriter(target_bin_name, decoy_bin_name, compute_sp));
+  }
+  // The make-pin file for the next stage of a pipeline is written from the
+  // same converted matches as the other output formats.
+  if (TideConvertingWriter::enabled() || !make_pin_file.empty()) {
+    writer.add(new TideConvertingWriter(this, compute_sp, HAS_DECOYS, make_pin_file));
   }
 
-  // Try to read all spectrum files as spectrumrecords, convert those that fail
+  // Try to read all spectrum files as spectrumrecords, convert those that fail.
+  // Merging only reads the partial results, so it needs no spectra.
+  vector<string> search_files;
+  if (!search_shards.empty()) {
+    search_files = input_files;
+  }
+  // The spectra are kept for the search, so each file is only read once,
+  // and each file's spectra are freed after its last search pass.
   vector<InputFile> input_sr;
-  for (vector<string>::const_iterator f = input_files.begin(); f != input_files.end(); f++) {
-    SpectrumCollection spectra;
+  vector<SpectrumCollection*> spectrum_sets;
+  // The peaks of spectra in version 2 files are decoded as each spectrum is
+  // searched, except in peptide-centric searches, which keep every spectrum's
+  // matches until the end.
+  bool lazy_spectra = !config_->peptide_centric;
+  for (vector<string>::const_iterator f = search_files.begin(); f != search_files.end(); f++) {
+    if (checkpoint_ && checkpoint_->fileDone(*f)) {
+      carp(CARP_INFO, "Skipping %s, which was searched before the checkpoint", f->c_str());
+      continue;
+    }
+    SpectrumCollection* spectra_ptr = new SpectrumCollection();
+    SpectrumCollection& spectra = *spectra_ptr;
     pb::Header spectrum_header;
     string spectrumrecords = *f;
     bool keepSpectrumrecords = true;
-    if (!spectra.ReadSpectrumRecords(spectrumrecords, &spectrum_header)) {
+    string converted = checkpoint_ ? checkpoint_->convertedFile(*f) : "";
+    if (!converted.empty() && spectra.ReadSpectrumRecords(converted, &spectrum_header, lazy_spectra)) {
+      // Converted before the checkpoint
+      carp(CARP_INFO, "Using %s converted before the checkpoint", converted.c_str());
+      spectrumrecords = converted;
+      keepSpectrumrecords = !config_->store_spectra.empty();
+    } else if (!spectra.ReadSpectrumRecords(spectrumrecords, &spectrum_header, lazy_spectra)) {
       // Failed, try converting to spectrumrecords file
       carp(CARP_INFO, "Converting %s to spectrumrecords format", f->c_str());
       carp(CARP_INFO, "Elapsed time starting conversion: %.3g s", wall_clock() / 1e6);
-      spectrumrecords = Params::GetString("store-spectra");
+      spectrumrecords = config_->store_spectra;
       keepSpectrumrecords = !spectrumrecords.empty();
       if (!keepSpectrumrecords) {
         spectrumrecords = make_file_path(FileUtils::BaseName(*f) + ".spectrumrecords.tmp");
@@ -323,144 +537,190 @@ int TideSearchApplication::main(const vector<string>& input_files, const string
       }
       carp(CARP_DEBUG, "Reading converted spectra file %s", spectrumrecords.c_str());
       // Re-read converted file as spectrumrecords file
-      if (!spectra.ReadSpectrumRecords(spectrumrecords, &spectrum_header)) {
+      if (!spectra.ReadSpectrumRecords(spectrumrecords, &spectrum_header, lazy_spectra)) {
         carp(CARP_DEBUG, "Deleting %s", spectrumrecords.c_str());
         remove(spectrumrecords.c_str());
         carp(CARP_FATAL, "Error reading spectra file %s", spectrumrecords.c_str());
       }
+      if (checkpoint_) {
+        checkpoint_->setConverted(*f, spectrumrecords);
+      }
     }
+    carp(CARP_INFO, "Read %d spectra from %s", (int)spectra.Spectra()->size(), f->c_str());
     input_sr.push_back(InputFile(*f, spectrumrecords, keepSpectrumrecords));
-  }
-
-  // Loop through spectrum files
-  for (vector<InputFile>::const_iterator f = input_sr.begin();
-       f != input_sr.end();
-       f++) {
-
-    if (!peptide_reader[0]) {
-      for (int i = 0; i < NUM_THREADS; i++) {
-        peptide_reader[i] = new HeadedRecordReader(peptides_file, &peptides_header);
+    spectrum_sets.push_back(spectra_ptr);
+  }
+
+  // The spectrum-charges of all files are sorted together by neutral mass,
+  // each tagged with its file, so that the index is read and decoded once for
+  // all of them. Peptide-centric searches report each peptide's matches
+  // among the spectra of a pass, so they still search one file per pass.
+  bool single_pass = !config_->peptide_centric;
+  vector<string> spectrum_filenames;
+  vector<SearchPass> passes;
+  carp(CARP_INFO, "Sorting spectra");
+  for (size_t i = 0; i < spectrum_sets.size(); i++) {
+    SpectrumCollection* spectra = spectrum_sets[i];
+    if (window_type != WINDOW_MZ) {
+      spectra->Sort();
+    } else {
+      spectra->Sort<ScSortByMz>(ScSortByMz(window));
+    }
+    if (passes.empty() || !single_pass) {
+      passes.push_back(SearchPass());
+    }
+    SearchPass& pass = passes.back();
+    pass.files.push_back(i);
+    pass.highest_mz = max(pass.highest_mz, spectra->FindHighestMZ());
+    const vector<SpectrumCollection::SpecCharge>* spec_charges = spectra->SpecCharges();
+    for (vector<SpectrumCollection::SpecCharge>::const_iterator sc = spec_charges->begin();
+         sc != spec_charges->end();
+         ++sc) {
+      pass.spec_charges.push_back(*sc);
+      pass.spec_charges.back().file_index = i;
+    }
+    spectrum_filenames.push_back(input_sr[i].OriginalName);
+  }
+  for (vector<SearchPass>::iterator pass = passes.begin(); pass != passes.end(); ++pass) {
+    if (pass->files.size() > 1) {
+      carp(CARP_INFO, "Searching %d spectrum-charges of %d spectrum files in one pass",
+           (int)pass->spec_charges.size(), (int)pass->files.size());
+      if (window_type != WINDOW_MZ) {
+        stable_sort(pass->spec_charges.begin(), pass->spec_charges.end());
+      } else {
+        stable_sort(pass->spec_charges.begin(), pass->spec_charges.end(), ScSortByMz(window));
       }
     }
+  }
 
-    vector<ActivePeptideQueue*> active_peptide_queue;
-    for (int i = 0; i < NUM_THREADS; i++) {
-      active_peptide_queue.push_back(new ActivePeptideQueue(peptide_reader[i]->Reader(), proteins));
-      active_peptide_queue[i]->SetBinSize(bin_width_, bin_offset_);
-    }
+  // Each shard's partial results hold one more match per spectrum than the
+  // final results, for delta LCn and Sp rank after merging.
+  int top_match = Params::GetInt("top-match") + (sharded ? 1 : 0);
 
-    string spectra_file = f->SpectrumRecords;
-    carp(CARP_INFO, "Reading spectra file %s", spectra_file.c_str());
-    // Try to read file as spectrumrecords file
-    SpectrumCollection spectra;
-    pb::Header spectrum_header;
-    if (!spectra.ReadSpectrumRecords(spectra_file, &spectrum_header)) {
-      // This should never happen since we would have failed earlier
-      carp(CARP_FATAL, "Error reading spectra file %s", spectra_file.c_str());
-    }
+  // Loop through index shards
+  for (vector<int>::const_iterator shard = search_shards.begin();
+       shard != search_shards.end();
+       ++shard) {
 
-    carp(CARP_INFO, "Sorting spectra");
-    if (window_type != WINDOW_MZ) {
-      spectra.Sort();
-    } else {
-      spectra.Sort<ScSortByMz>(ScSortByMz(window));
+    TideMatchWriter* search_writer = &writer;
+    if (sharded) {
+      carp(CARP_INFO, "Searching index shard %d of %d", *shard, (int)shard_files.size());
+      peptides_file = shard_files[*shard];
+      search_writer = new TideShardWriter(
+        TideShards::ResultFile(*shard), *shard, shard_files.size());
     }
 
-    double highest_mz = spectra.FindHighestMZ();
-    unsigned int spectrum_num = spectra.SpecCharges()->size();
-    if (spectrum_num > 0 && exact_pval_search_) {
-      highest_mz = spectra.SpecCharges()->at(spectrum_num - 1).neutral_mass;
-    }
-    carp(CARP_DEBUG, "Max m/z %f", highest_mz);
-    MaxBin::SetGlobalMax(highest_mz);
-    // Do the search
-    carp(CARP_INFO, "Running search");
-    if (spectrum_flag_ == NULL) {
-      resetMods();
-    }
-    search(f->OriginalName, spectra.SpecCharges(), active_peptide_queue, proteins,
-           locations, window, window_type, Params::GetDouble("spectrum-min-mz"),
-           Params::GetDouble("spectrum-max-mz"), min_scan, max_scan,
-           Params::GetInt("min-peaks"), charge_to_search,
-           Params::GetInt("top-match"), spectra.FindHighestMZ(),
-           target_file, decoy_file, compute_sp,
-           nAA, aaFreqN, aaFreqI, aaFreqC, aaMass, negative_isotope_errors);
-
-    PSMConvertApplication converter;
-    
-    // convert tab delimited to other file formats.
-    if (!concat) {
-      string target_file_name = make_file_path("tide-search.target.txt");
-      if (Params::GetBool("pin-output")) {
-        converter.convertFile("tsv", "pin", target_file_name, "tide-search.target.", Params::GetString("protein-database"), true);
-      }
-      if (Params::GetBool("pepxml-output")) {
-        converter.convertFile("tsv", "pepxml", target_file_name, "tide-search.target.", Params::GetString("protein-database"), true);
-      }
-      if (Params::GetBool("mzid-output")) {
-        converter.convertFile("tsv", "mzidentml", target_file_name, "tide-search.target.", Params::GetString("protein-database"), true);
-      }
-      if (Params::GetBool("sqt-output")) {
-        converter.convertFile("tsv", "sqt", target_file_name, "tide-search.target.", Params::GetString("protein-database"), true);
-      }
+    // Loop through search passes
+    for (vector<SearchPass>::const_iterator pass = passes.begin();
+         pass != passes.end();
+         ++pass) {
 
-      if (HAS_DECOYS) {
-        string decoy_file_name = make_file_path("tide-search.decoy.txt");
-        if (Params::GetBool("pin-output")) {
-          converter.convertFile("tsv", "pin", decoy_file_name, "tide-search.decoy.", Params::GetString("protein-database"), true);
+      if (!peptide_reader[0]) {
+        for (int i = 0; i < NUM_THREADS; i++) {
+          peptide_reader[i] = new HeadedRecordReader(peptides_file, &peptides_header);
         }
-        if (Params::GetBool("pepxml-output")) {
-          converter.convertFile("tsv", "pepxml", decoy_file_name, "tide-search.decoy.", Params::GetString("protein-database"), true);
-        }
-        if (Params::GetBool("mzid-output")) {
-          converter.convertFile("tsv", "mzidentml", decoy_file_name, "tide-search.decoy.", Params::GetString("protein-database"), true);
+      }
+
+      vector<ActivePeptideQueue*> active_peptide_queue;
+      for (int i = 0; i < NUM_THREADS; i++) {
+        active_peptide_queue.push_back(new ActivePeptideQueue(peptide_reader[i]->Reader(), proteins));
+        active_peptide_queue[i]->SetBinSize(bin_width_, bin_offset_);
+        if (pepHeader.lazy_mods()) {
+          active_peptide_queue[i]->EnumerateMods(pepHeader);
         }
-        if (Params::GetBool("sqt-output")) {
-          converter.convertFile("tsv", "sqt", decoy_file_name, "tide-search.decoy.", Params::GetString("protein-database"), true);
+        if (stored_peaks) {
+          active_peptide_queue[i]->UseStoredPeaks();
         }
       }
-    } else {
-      string concat_file_name = make_file_path("tide-search.txt");
-      if (Params::GetBool("pin-output")) {
-        converter.convertFile("tsv", "pin", concat_file_name, "tide-search.", Params::GetString("protein-database"), true);
+
+      double highest_mz = pass->highest_mz;
+      unsigned int spectrum_num = pass->spec_charges.size();
+      if (spectrum_num > 0 && exact_pval_search_) {
+        highest_mz = pass->spec_charges[spectrum_num - 1].neutral_mass;
       }
-      if (Params::GetBool("pepxml-output")) {
-        converter.convertFile("tsv", "pepxml", concat_file_name, "tide-search.", Params::GetString("protein-database"), true);
+      carp(CARP_DEBUG, "Max m/z %f", highest_mz);
+      MaxBin::SetGlobalMax(highest_mz);
+      // Do the search
+      carp(CARP_INFO, "Running search");
+      if (spectrum_flag_ == NULL) {
+        resetMods();
       }
-      if (Params::GetBool("mzid-output")) {
-        converter.convertFile("tsv", "mzidentml", concat_file_name, "tide-search.", Params::GetString("protein-database"), true);
+      if (checkpoint_) {
+        vector<string> pass_files;
+        for (vector<int>::const_iterator i = pass->files.begin(); i != pass->files.end(); ++i) {
+          pass_files.push_back(spectrum_filenames[*i]);
+        }
+        checkpoint_->beginPass(pass_files, spectrum_num);
+      }
+      search(spectrum_filenames, &pass->spec_charges, active_peptide_queue, proteins,
+             locations, window, window_type, Params::GetDouble("spectrum-min-mz"),
+             Params::GetDouble("spectrum-max-mz"), min_scan, max_scan,
+             Params::GetInt("min-peaks"), charge_to_search,
+             top_match, pass->highest_mz,
+             search_writer, compute_sp,
+             nAA, aaFreqN, aaFreqI, aaFreqC, aaMass, negative_isotope_errors);
+      if (checkpoint_) {
+        checkpoint_->endPass();
       }
-      if (Params::GetBool("sqt-output")) {
-        converter.convertFile("tsv", "sqt", concat_file_name, "tide-search.", Params::GetString("protein-database"), true);
+
+      // Clean up
+      for (int i = 0; i < NUM_THREADS; i++) {
+        delete active_peptide_queue[i];
+        delete peptide_reader[i];
+        peptide_reader[i] = NULL;
       }
+      // After the last shard, the spectra of this pass are not searched again.
+      if (shard + 1 == search_shards.end()) {
+        for (vector<int>::const_iterator i = pass->files.begin(); i != pass->files.end(); ++i) {
+          delete spectrum_sets[*i];
+          spectrum_sets[*i] = NULL;
+        }
+      }
+
+    } // End of search pass loop
+
+    if (sharded) {
+      delete search_writer;
     }
-    
-    // Delete temporary spectrumrecords file
+  } // End of index shard loop
+
+  // Delete temporary spectrumrecords files
+  for (vector<InputFile>::const_iterator f = input_sr.begin(); f != input_sr.end(); f++) {
     if (!f->Keep) {
-      carp(CARP_DEBUG, "Deleting %s", spectra_file.c_str());
-      remove(spectra_file.c_str());
+      carp(CARP_DEBUG, "Deleting %s", f->SpectrumRecords.c_str());
+      remove(f->SpectrumRecords.c_str());
     }
+  }
+  for (int i = 0; i < NUM_THREADS; i++) {
+    delete peptide_reader[i];
+  }
 
-    // Clean up
-    for (int i = 0; i < NUM_THREADS; i++) {
-      delete active_peptide_queue[i];
-      delete peptide_reader[i];
-      peptide_reader[i] = NULL;
+  if (merger) {
+    vector<string> result_files;
+    for (size_t i = 0; i < shard_files.size(); i++) {
+      result_files.push_back(TideShards::ResultFile(i));
+    }
+    merger->merge(input_files, result_files);
+    if (!merge_shards) {
+      for (size_t i = 0; i < result_files.size(); i++) {
+        FileUtils::Remove(result_files[i]);
+      }
     }
+  }
 
-  } // End of spectrum file loop
+  writer.close();
+  wrote_make_pin_ = !make_pin_file.empty();
+  if (checkpoint_) {
+    checkpoint_->finish();
+    delete checkpoint_;
+    checkpoint_ = NULL;
+  }
 
   delete negative_isotope_errors;
   
   for (ProteinVec::iterator i = proteins.begin(); i != proteins.end(); ++i) {
     delete *i;
   }
-  if (target_file) {
-    delete target_file;
-    if (decoy_file) {
-      delete decoy_file;
-    }
-  }
   delete[] aaFreqN;
   delete[] aaFreqI;
   delete[] aaFreqC;
@@ -472,7 +732,7 @@ int TideSearchApplication::main(const vector<string>& input_files, const string
 void TideSearchApplication::search(void* threadarg) {
   struct thread_data *my_data = (struct thread_data *) threadarg;
 
-  const string& spectrum_filename = my_data->spectrum_filename;
+  const vector<string>& spectrum_filenames = *my_data->spectrum_filenames;
   const vector<SpectrumCollection::SpecCharge>* spec_charges = my_data->spec_charges;
   ActivePeptideQueue* active_peptide_queue = my_data->active_peptide_queue;
   ProteinVec& proteins = my_data->proteins;
@@ -487,8 +747,7 @@ void TideSearchApplication::search(void* threadarg) {
   int search_charge = my_data->search_charge;
   int top_matches = my_data->top_matches;
   double highest_mz = my_data->highest_mz;
-  ofstream* target_file = my_data -> target_file;
-  ofstream* decoy_file = my_data->decoy_file;
+  TideMatchWriter* writer = my_data->writer;
   bool compute_sp = my_data->compute_sp;
   int64_t thread_num = my_data->thread_num;
   int64_t num_threads = my_data->num_threads;
@@ -505,35 +764,46 @@ void TideSearchApplication::search(void* threadarg) {
   bool exact_pval_search = my_data->exact_pval_search;
   map<pair<string, unsigned int>, bool>* spectrum_flag = my_data->spectrum_flag;
 
-  int* sc_index = my_data->sc_index;
-  int* total_candidate_peptides = my_data->total_candidate_peptides;
+  boost::atomic<int>* sc_index = my_data->sc_index;
+  boost::atomic<long>* total_candidate_peptides = my_data->total_candidate_peptides;
 
   // params
-  bool peptide_centric = Params::GetBool("peptide-centric-search");
-  bool use_neutral_loss_peaks = Params::GetBool("use-neutral-loss-peaks");
-  bool use_flanking_peaks = Params::GetBool("use-flanking-peaks");
-  int max_charge = Params::GetInt("max-precursor-charge");
+  const TideSearchConfig& config = *config_;
+  bool peptide_centric = config.peptide_centric;
+  int max_charge = config.max_precursor_charge;
 
   // This is the main search loop.
-  ObservedPeakSet observed(bin_width, bin_offset,
-                           use_neutral_loss_peaks,
-                           use_flanking_peaks);    
+  ObservedPeakSet observed(bin_width, bin_offset, config.preprocess);
+  // Peaks of lazily read spectra, decoded for the spectrum being searched.
+  Spectrum decoded_spectrum(0, 0);
+  SpectrumBlockCache block_cache;
+  // Theoretical peaks of the candidates scored after fragment filtering.
+  ST_TheoreticalPeakSet workspace(2000);
 
   // cycle through spectrum-charge pairs, sorted by neutral mass
   FLOAT_T sc_total = (FLOAT_T)spec_charges->size();
-  int print_interval = Params::GetInt("print-search-progress");
+  int print_interval = config.print_search_progress;
 
   for (vector<SpectrumCollection::SpecCharge>::const_iterator sc = spec_charges->begin()+thread_num;
        sc < spec_charges->begin() + (spec_charges->size());
        sc = sc + num_threads) {
-    
-    locks_array[3]->lock();
-    ++(*sc_index);
-    if (print_interval > 0 && *sc_index > 0 && *sc_index % print_interval == 0) {
+
+    // Skip spectrum-charges searched before the checkpoint; the step marks
+    // this one as searched once it is done, however the iteration ends.
+    size_t sc_idx = sc - spec_charges->begin();
+    if (checkpoint_ && checkpoint_->isDone(sc_idx)) {
+      continue;
+    }
+    TideSearchCheckpoint::Step checkpoint_step(checkpoint_, sc_idx);
+    const string& spectrum_filename = spectrum_filenames[sc->file_index];
+
+    // Only the thread whose increment reaches a multiple of the interval
+    // reports progress, so no lock is needed.
+    int searched = ++(*sc_index);
+    if (print_interval > 0 && searched > 0 && searched % print_interval == 0) {
       carp(CARP_INFO, "%d spectrum-charge combinations searched, %.0f%% complete",
-           *sc_index, *sc_index / sc_total * 100);
+           searched, searched / sc_total * 100);
     }
-    locks_array[3]->unlock();
 
     Spectrum* spectrum = sc->spectrum;
     double precursor_mz = spectrum->PrecursorMZ();
@@ -553,10 +823,15 @@ void TideSearchApplication::search(void* threadarg) {
 
     if (precursor_mz < spectrum_min_mz || precursor_mz > spectrum_max_mz ||
         scan_num < min_scan || scan_num > max_scan ||
-        spectrum->Size() < min_peaks ||
+        spectrum->NumPeaks() < min_peaks ||
         (search_charge != 0 && charge != search_charge) || charge > max_charge) {
       continue;
     }
+    // Only the peaks of spectra that are searched are decoded.
+    if (spectrum->Lazy()) {
+      spectrum->Decode(&decoded_spectrum, &block_cache);
+      spectrum = &decoded_spectrum;
+    }
 
     // clock_t thread_time = clock();
     // The active peptide queue holds the candidate peptides for spectrum.
@@ -566,7 +841,60 @@ void TideSearchApplication::search(void* threadarg) {
     vector<bool>* candidatePeptideStatus = new vector<bool>();
     double min_range, max_range;
     computeWindow(*sc, window_type, precursor_window, max_charge, negative_isotope_errors, min_mass, max_mass, &min_range, &max_range);
-    if (!exact_pval_search) {  //execute original tide-search program
+    if (!exact_pval_search && config.cpu_scoring) {  // original tide-search program, scored on the CPU
+
+      // Same preprocessing as the GPU path, but the cache is filled here and
+      // the candidates are scored by the programs SetActiveRange compiles.
+      observed.PreprocessSpectrumHiXCorr(*spectrum, charge);
+      observed.ComputeCacheHiXCorr();
+      int nCandPeptide = active_peptide_queue->SetActiveRange(min_mass, max_mass, min_range, max_range, candidatePeptideStatus);
+      if (nCandPeptide == 0) {
+        delete min_mass;
+        delete max_mass;
+        delete candidatePeptideStatus;
+        continue;
+      }
+      (*total_candidate_peptides) += nCandPeptide;
+
+      int candidatePeptideStatusSize = candidatePeptideStatus->size();
+      TideMatchSet::Arr2 scores(candidatePeptideStatusSize);
+      if (fragment_index_ && nCandPeptide > fragment_candidates_) {
+        nCandPeptide = filterCandidates(active_peptide_queue, spectrum, charge,
+                                        candidatePeptideStatus, nCandPeptide);
+        scoreCandidates(active_peptide_queue, observed, *candidatePeptideStatus,
+                        charge, &workspace, &scores);
+      } else {
+        collectScoresCompiled(active_peptide_queue, spectrum, observed, &scores,
+                              candidatePeptideStatusSize, charge);
+      }
+
+      TideMatchSet::Arr match_arr(nCandPeptide);
+      deque<Peptide*>::const_iterator iter_ = active_peptide_queue->iter_;
+      for (int peidx = 0; peidx < candidatePeptideStatusSize; peidx++, ++iter_) {
+        if (!(*candidatePeptideStatus)[peidx]) {
+          continue;
+        }
+        // scores[peidx].second is the same back index the GPU path computes
+        int score = scores[peidx].first;
+        if (peptide_centric) {
+          (*iter_)->AddHit(spectrum, score, 0.0, scores[peidx].second, charge);
+        } else {
+          TideMatchSet::Scores curScore;
+          curScore.xcorr_score = (double)(score / XCORR_SCALING);
+          curScore.rank = scores[peidx].second;
+          match_arr.push_back(curScore);
+        }
+      }
+
+      if (!peptide_centric) {
+        TideMatchSet matches(&match_arr, highest_mz, config);
+        matches.exact_pval_search_ = exact_pval_search;
+        matches.setLocalizer(localizer_, observed.GetCache());
+        matches.report(writer, top_matches, spectrum_filename,
+                         spectrum, charge, active_peptide_queue, proteins,
+                         locations, compute_sp, true, locks_array[0]);
+      }
+    } else if (!exact_pval_search) {  //execute original tide-search program
 
       // Normalize the observed spectrum and compute the cache of
       // frequently-needed values for taking dot products with theoretical
@@ -589,14 +917,18 @@ void TideSearchApplication::search(void* threadarg) {
       if (nCandPeptide == 0) {
         continue;
       }
-      locks_array[2]->lock();
       (*total_candidate_peptides) += nCandPeptide;
-      locks_array[2]->unlock();
+      if (fragment_index_) {
+        nCandPeptide = filterCandidates(active_peptide_queue, spectrum, charge,
+                                        candidatePeptideStatus, nCandPeptide);
+      }
 
       int candidatePeptideStatusSize = candidatePeptideStatus->size();
       int lMax = active_peptide_queue->lMax;
 
-      int subloop = candidatePeptideStatusSize/SUBCAND + 1;
+      // Batch over the candidates left after the prefilter, so that kernels
+      // only run over slots filled for this spectrum.
+      int subloop = (nCandPeptide + SUBCAND - 1) / SUBCAND;
       int peidx = 0;
       deque<Peptide*>::const_iterator iter_ = active_peptide_queue->iter_;
       deque<Peptide*>::const_iterator iter_1 = active_peptide_queue->iter_;
@@ -605,8 +937,7 @@ void TideSearchApplication::search(void* threadarg) {
       int index = 0;
 
       for(int i=0; i<subloop; i++) {
-        int subSize = SUBCAND;
-        if(i==subloop-1) subSize = nCandPeptide-(i*SUBCAND);
+        int subSize = min(SUBCAND, nCandPeptide - i*SUBCAND);
         if(peidx >= candidatePeptideStatusSize) break;
         index = 0;
         memset(residues[thread_num], '\0', lMax*subSize*sizeof(char));
@@ -662,9 +993,15 @@ void TideSearchApplication::search(void* threadarg) {
       }
 
       if (!peptide_centric) {
-        TideMatchSet matches(&match_arr, highest_mz);
+        TideMatchSet matches(&match_arr, highest_mz, config);
         matches.exact_pval_search_ = exact_pval_search;
-        matches.report(target_file, decoy_file, top_matches, spectrum_filename,
+        if (localizer_) {
+          // The scores were computed against the cache on the device, so
+          // compute it here too for localizing the top matches.
+          observed.ComputeCacheHiXCorr();
+          matches.setLocalizer(localizer_, observed.GetCache());
+        }
+        matches.report(writer, top_matches, spectrum_filename,
                          spectrum, charge, active_peptide_queue, proteins,
                          locations, compute_sp, true, locks_array[0]);
       }
@@ -676,9 +1013,7 @@ void TideSearchApplication::search(void* threadarg) {
       int maxPrecurMass = floor(MaxBin::Global().CacheBinEnd() + 50.0); // TODO works, but is this the best way to get?
       int nCandPeptide = active_peptide_queue->SetActiveRangeBIons(min_mass, max_mass, min_range, max_range, candidatePeptideStatus);
       int candidatePeptideStatusSize = candidatePeptideStatus->size();
-      locks_array[2]->lock();
       (*total_candidate_peptides) += nCandPeptide;
-      locks_array[2]->unlock();
 
       TideMatchSet::Arr match_arr(nCandPeptide); //scored peptides will go here
   
@@ -825,10 +1160,10 @@ void TideSearchApplication::search(void* threadarg) {
         // matches will arrange the results in a heap by score, return the top
         // few, and recover the association between counter and peptide. We output
         // the top matches.
-        TideMatchSet matches(&match_arr, highest_mz);
+        TideMatchSet matches(&match_arr, highest_mz, config);
         matches.exact_pval_search_ = exact_pval_search;
 
-        matches.report(target_file, decoy_file, top_matches, spectrum_filename,
+        matches.report(writer, top_matches, spectrum_filename,
                        spectrum, charge, active_peptide_queue, proteins,
                        locations, compute_sp, false, locks_array[0]);
         
@@ -847,7 +1182,7 @@ void TideSearchApplication::search(void* threadarg) {
 }
 
 void TideSearchApplication::search(
-  const string& spectrum_filename,
+  const vector<string>& spectrum_filenames,
   const vector<SpectrumCollection::SpecCharge>* spec_charges,
   vector<ActivePeptideQueue*> active_peptide_queue,
   ProteinVec& proteins,
@@ -862,8 +1197,7 @@ void TideSearchApplication::search(
   int search_charge,
   int top_matches,
   double highest_mz,
-  ofstream* target_file,
-  ofstream* decoy_file,
+  TideMatchWriter* writer,
   bool compute_sp,
   int nAA, 
   double* aaFreqN,
@@ -872,24 +1206,23 @@ void TideSearchApplication::search(
   int* aaMass,
   vector<int>* negative_isotope_errors
 ) {
-  // Create an array of 4 locks.
+  // Create an array of 2 locks. The progress and candidate counters are
+  // atomic.
   // Lock #0: Results file output
   // Lock #1: Only used by cascade-search on spectrum_flag (map)
-  // Lock #2: Updating # of candidate peptides
-  // Lock #3: Updating sc_index and reporting progress
-  int num_locks = 4;
+  int num_locks = 2;
   vector<boost::mutex *> locks_array;
 
   for (int i = 0; i < num_locks; i++) {
     locks_array.push_back(new boost::mutex());
   }
 
-  int elution_window = Params::GetInt("elution-window-size");
-  bool peptide_centric = Params::GetBool("peptide-centric-search");
+  int elution_window = config_->elution_window_size;
+  bool peptide_centric = config_->peptide_centric;
 
   // initialize fields required for output
-  int* sc_index = new int(-1);
-  int* total_candidate_peptides = new int(0);
+  boost::atomic<int>* sc_index = new boost::atomic<int>(-1);
+  boost::atomic<long>* total_candidate_peptides = new boost::atomic<long>(0);
   FLOAT_T sc_total = (FLOAT_T)spec_charges->size();
 
   if (peptide_centric == false) {
@@ -914,56 +1247,64 @@ void TideSearchApplication::search(
   }
 
   for (int i = 0; i < NUM_THREADS; i++) {
-    active_peptide_queue[i]->SetOutputs(NULL, &locations, top_matches, compute_sp, target_file, decoy_file, highest_mz);
+    active_peptide_queue[i]->SetOutputs(NULL, &locations, top_matches, compute_sp, writer, locks_array[0], highest_mz, config_);
     active_peptide_queue[i]->lMax = -1;
   }
 
-  cudaMalloc((double **)&nterm_mono_table, 256*sizeof(double));
-  cudaMalloc((double **)&cterm_mono_table, 256*sizeof(double));
-  cudaMalloc((double **)&mono_table, 256*sizeof(double));
-  cudaMemcpy(nterm_mono_table, MassConstants::nterm_mono_table, 256*sizeof(double), cudaMemcpyHostToDevice);
-  cudaMemcpy(cterm_mono_table, MassConstants::cterm_mono_table, 256*sizeof(double), cudaMemcpyHostToDevice);
-  cudaMemcpy(mono_table, MassConstants::mono_table, 256*sizeof(double), cudaMemcpyHostToDevice);
-
-  cudaMalloc((double **)&unique_deltas_, MassConstants::unique_deltas_.size()*sizeof(double));
-  cudaMemcpy(unique_deltas_, &MassConstants::unique_deltas_[0], MassConstants::unique_deltas_.size()*sizeof(double), cudaMemcpyHostToDevice);
-
-  gBin = (int**)malloc(NUM_THREADS*MaxBin::Global().CacheBinEnd()*sizeof(int));
-  gIon = (int**)malloc(NUM_THREADS*MaxBin::Global().CacheBinEnd()*sizeof(int));
-  gSpec = (int**)malloc(NUM_THREADS*MaxBin::Global().CacheBinEnd()*NUM_PEAK_TYPES*sizeof(int));
-  gChar = (char**)malloc(NUM_THREADS*200*SUBCAND*sizeof(char));
-  gMod = (int**)malloc(NUM_THREADS*10*SUBCAND*sizeof(int));
-  gLen = (int**)malloc(NUM_THREADS*SUBCAND*sizeof(int));
-  gModLen= (int**)malloc(NUM_THREADS*SUBCAND*sizeof(int));
-  result = (int**)malloc(NUM_THREADS*SUBCAND*sizeof(int));
+  // The GPU buffers are only needed when scoring on the GPU.
+  bool use_gpu = !config_->cpu_scoring;
+  if (!use_gpu && !exact_pval_search_) {
+    carp(CARP_INFO, "Scoring on the CPU with %s dot-product programs.",
+         TheoreticalPeakCompiler::IsaName(TheoreticalPeakCompiler::HostIsa()));
+  }
+  if (use_gpu) {
+    cudaMalloc((double **)&nterm_mono_table, 256*sizeof(double));
+    cudaMalloc((double **)&cterm_mono_table, 256*sizeof(double));
+    cudaMalloc((double **)&mono_table, 256*sizeof(double));
+    cudaMemcpy(nterm_mono_table, MassConstants::nterm_mono_table, 256*sizeof(double), cudaMemcpyHostToDevice);
+    cudaMemcpy(cterm_mono_table, MassConstants::cterm_mono_table, 256*sizeof(double), cudaMemcpyHostToDevice);
+    cudaMemcpy(mono_table, MassConstants::mono_table, 256*sizeof(double), cudaMemcpyHostToDevice);
+
+    cudaMalloc((double **)&unique_deltas_, MassConstants::unique_deltas_.size()*sizeof(double));
+    cudaMemcpy(unique_deltas_, &MassConstants::unique_deltas_[0], MassConstants::unique_deltas_.size()*sizeof(double), cudaMemcpyHostToDevice);
+
+    gBin = (int**)malloc(NUM_THREADS*MaxBin::Global().CacheBinEnd()*sizeof(int));
+    gIon = (int**)malloc(NUM_THREADS*MaxBin::Global().CacheBinEnd()*sizeof(int));
+    gSpec = (int**)malloc(NUM_THREADS*MaxBin::Global().CacheBinEnd()*NUM_PEAK_TYPES*sizeof(int));
+    gChar = (char**)malloc(NUM_THREADS*200*SUBCAND*sizeof(char));
+    gMod = (int**)malloc(NUM_THREADS*10*SUBCAND*sizeof(int));
+    gLen = (int**)malloc(NUM_THREADS*SUBCAND*sizeof(int));
+    gModLen= (int**)malloc(NUM_THREADS*SUBCAND*sizeof(int));
+    result = (int**)malloc(NUM_THREADS*SUBCAND*sizeof(int));
   
-  residues = (char**) malloc(NUM_THREADS*200*SUBCAND*sizeof(char));
-  mod = (int**) malloc(NUM_THREADS*10*SUBCAND*sizeof(int));
-  leng = (int**) malloc(NUM_THREADS*SUBCAND*sizeof(int));
-  modleng = (int**) malloc(NUM_THREADS*SUBCAND*sizeof(int));
-
-  streams = (cudaStream_t *) malloc(NUM_THREADS * sizeof(cudaStream_t));
-
-  for (int i= 0; i < NUM_THREADS; i++) {
-    cudaMalloc((int **)&gBin[i], MaxBin::Global().CacheBinEnd()*sizeof(int));
-    cudaMalloc((int **)&gIon[i], MaxBin::Global().CacheBinEnd()*sizeof(int));
-    cudaMalloc((int **)&gSpec[i], MaxBin::Global().CacheBinEnd()*NUM_PEAK_TYPES*sizeof(int));
-    cudaMalloc((char**)&gChar[i], 200*SUBCAND*sizeof(char));
-    cudaMalloc((int **)&gMod[i], 10*SUBCAND*sizeof(int));
-    cudaMalloc((int **)&gLen[i], SUBCAND*sizeof(int));
-    cudaMalloc((int **)&gModLen[i], SUBCAND*sizeof(int));
-    cudaMalloc((int **)&result[i], SUBCAND*sizeof(int));
-
-    // residues[i] = (char*) malloc(200*SUBCAND*sizeof(char));
-    // mod[i] = (int*) malloc(10*SUBCAND*sizeof(int));
-    // leng[i] = (int*) malloc(SUBCAND*sizeof(int));
-    // modleng[i] = (int*) malloc(SUBCAND*sizeof(int));
-    cudaMallocHost((char**)&residues[i], 200*SUBCAND*sizeof(char));
-    cudaMallocHost((int**)&mod[i], 10*SUBCAND*sizeof(int));
-    cudaMallocHost((int**)&leng[i], SUBCAND*sizeof(int));
-    cudaMallocHost((int**)&modleng[i], SUBCAND*sizeof(int));
-
-    cudaStreamCreate(&(streams[i]));
+    residues = (char**) malloc(NUM_THREADS*200*SUBCAND*sizeof(char));
+    mod = (int**) malloc(NUM_THREADS*10*SUBCAND*sizeof(int));
+    leng = (int**) malloc(NUM_THREADS*SUBCAND*sizeof(int));
+    modleng = (int**) malloc(NUM_THREADS*SUBCAND*sizeof(int));
+
+    streams = (cudaStream_t *) malloc(NUM_THREADS * sizeof(cudaStream_t));
+
+    for (int i= 0; i < NUM_THREADS; i++) {
+      cudaMalloc((int **)&gBin[i], MaxBin::Global().CacheBinEnd()*sizeof(int));
+      cudaMalloc((int **)&gIon[i], MaxBin::Global().CacheBinEnd()*sizeof(int));
+      cudaMalloc((int **)&gSpec[i], MaxBin::Global().CacheBinEnd()*NUM_PEAK_TYPES*sizeof(int));
+      cudaMalloc((char**)&gChar[i], 200*SUBCAND*sizeof(char));
+      cudaMalloc((int **)&gMod[i], 10*SUBCAND*sizeof(int));
+      cudaMalloc((int **)&gLen[i], SUBCAND*sizeof(int));
+      cudaMalloc((int **)&gModLen[i], SUBCAND*sizeof(int));
+      cudaMalloc((int **)&result[i], SUBCAND*sizeof(int));
+
+      // residues[i] = (char*) malloc(200*SUBCAND*sizeof(char));
+      // mod[i] = (int*) malloc(10*SUBCAND*sizeof(int));
+      // leng[i] = (int*) malloc(SUBCAND*sizeof(int));
+      // modleng[i] = (int*) malloc(SUBCAND*sizeof(int));
+      cudaMallocHost((char**)&residues[i], 200*SUBCAND*sizeof(char));
+      cudaMallocHost((int**)&mod[i], 10*SUBCAND*sizeof(int));
+      cudaMallocHost((int**)&leng[i], SUBCAND*sizeof(int));
+      cudaMallocHost((int**)&modleng[i], SUBCAND*sizeof(int));
+
+      cudaStreamCreate(&(streams[i]));
+    }
   }
 
   // Creating structs to hold information required for each thread to search through
@@ -971,16 +1312,20 @@ void TideSearchApplication::search(
 
   vector<thread_data> thread_data_array;
   for (int i= 0; i < NUM_THREADS; i++) {
-      thread_data_array.push_back(thread_data(spectrum_filename, spec_charges, active_peptide_queue[i],
+      thread_data_array.push_back(thread_data(&spectrum_filenames, spec_charges, active_peptide_queue[i],
       proteins, locations, precursor_window, window_type, spectrum_min_mz,
       spectrum_max_mz, min_scan, max_scan, min_peaks, search_charge, top_matches,
-      highest_mz, target_file, decoy_file, compute_sp,
+      highest_mz, writer, compute_sp,
       i, NUM_THREADS, nAA, aaFreqN, aaFreqI, aaFreqC, aaMass, locks_array, 
       bin_width_, bin_offset_, exact_pval_search_, spectrum_flag_, sc_index, total_candidate_peptides, negative_isotope_errors));
   }
 
   boost::thread_group threadgroup;
 
+  // Messages of the search threads are written in the background, so that
+  // logging does not hold them up.
+  carp_begin_async();
+
   // Launch threads
   for (int64_t t = 1; t < NUM_THREADS; t++) {
     boost::thread * currthread = new boost::thread(boost::bind(&TideSearchApplication::search, this, (void *) &(thread_data_array[t])));
@@ -992,6 +1337,7 @@ void TideSearchApplication::search(
 
   // Join threads
   threadgroup.join_all();
+  carp_end_async();
 
   carp(CARP_INFO, "Time per spectrum-charge combination: %lf s.", wall_clock() / (1e6*sc_total));
   carp(CARP_INFO, "Average number of candidates per spectrum-charge combination: %lf ",
@@ -1001,9 +1347,14 @@ void TideSearchApplication::search(
   for (int i = 0; i < num_locks; i++) {
     delete locks_array[i];
   }
+  searched_spec_charges_ += *sc_index + 1;
+  candidate_peptides_ += *total_candidate_peptides;
   delete sc_index;
   delete total_candidate_peptides;
 
+  if (!use_gpu) {
+    return;
+  }
   cudaFree(nterm_mono_table);
   cudaFree(cterm_mono_table);
   cudaFree(mono_table);
@@ -1045,118 +1396,6 @@ void TideSearchApplication::search(
 
 }
 
-void TideSearchApplication::collectScoresCompiled(
-  ActivePeptideQueue* active_peptide_queue,
-  const Spectrum* spectrum,
-  const ObservedPeakSet& observed,
-  TideMatchSet::Arr2* match_arr,
-  int queue_size,
-  int charge
-) {
-  if (!active_peptide_queue->HasNext()) {
-    return;
-  }
-  // prog gets the address of the dot-product program for the first peptide
-  // in the active queue.
-  const void* prog = active_peptide_queue->NextPeptide()->Prog(charge);
-  const int* cache = observed.GetCache();
-  // results will get (score, counter) pairs, where score is the dot product
-  // of the observed peak set with a candidate peptide. The candidate
-  // peptide is given by counter, which refers to the index within the
-  // ActivePeptideQueue, counting from the back. This complication
-  // simplifies the generated programs, which now simply dump the counter.
-  pair<int, int>* results = match_arr->data();
-
-  // See compiler.h for a description of the programs beginning at prog and
-  // how they are generated. Here we initialize certain registers to the
-  // values expected by the programs and call the first one (*prog).
-  //
-  // See gnu assembler format for more on this format. We tell the compiler
-  // to set these registers:
-  // edx/rdx points to the cache.
-  // eax/rax points to the first program.
-  // ecx/rcx is the counter and gets the size of the active queue.
-  // edi/rdi points to the results buffer.
-  //
-  // The push and pop operations are a workaround for a compiler that
-  // doesn't understand that %ecx and %edi (or %rcx and %rdi) get
-  // clobbered. Since they're already input registers, they can't be
-  // included in the clobber list.
-
-#ifdef _MSC_VER
-#ifdef _WIN64
-  DWORD64 rcx;
-  DWORD64 rdi;
-
-  volatile bool restored = false;
-  CONTEXT context;
-  RtlCaptureContext(&context);
-  if (!restored) {
-    rcx = context.Rcx;
-    rdi = context.Rdi;
-
-    context.Rdx = (DWORD64)cache;
-    context.Rax = (DWORD64)prog;
-    context.Rcx = (DWORD64)queue_size;
-    context.Rdi = (DWORD64)results;
-
-    restored = true;
-    RtlRestoreContext(&context, NULL);
-  } else {
-    ((void(*)(void))prog)();
-  }
-
-  restored = false;
-  RtlCaptureContext(&context);
-  if (!restored) {
-    context.Rcx = rcx;
-    context.Rdi = rdi;
-
-    restored = true;
-    RtlRestoreContext(&context, NULL);
-  }
-#else
-  __asm {
-    cld
-    push ecx
-    push edi
-    mov edx, cache
-    mov eax, prog
-    mov ecx, queue_size
-    mov edi, results
-    call eax
-    pop edi
-    pop ecx
-  }
-#endif
-#else
-  __asm__ __volatile__("cld\n" // stos operations increment edi
-#ifdef __x86_64__
-                       "push %%rcx\n"
-                       "push %%rdi\n"
-                       "call *%%rax\n"
-                       "pop %%rdi\n"
-                       "pop %%rcx\n"
-#else
-                       "push %%ecx\n"
-                       "push %%edi\n"
-                       "call *%%eax\n"
-                       "pop %%edi\n"
-                       "pop %%ecx\n"
-#endif
-                       : // no outputs
-                       : "d" (cache),
-                         "a" (prog),
-                         "c" (queue_size),
-                         "D" (results)
-  );
-#endif
-
-  // match_arr is filled by the compiled programs, not by calls to
-  // push_back(). We have to set the final size explicitly.
-  match_arr->set_size(queue_size);
-}
-
 void TideSearchApplication::computeWindow(
   const SpectrumCollection::SpecCharge& sc,
   WINDOW_TYPE_T window_type,
@@ -1215,6 +1454,11 @@ bool TideSearchApplication::proteinLevelDecoys() {
   return PROTEIN_LEVEL_DECOYS;
 }
 
+bool TideSearchApplication::fragmentFilter() {
+  return Params::GetInt("fragment-candidates") > 0 && !Params::GetBool("exact-p-value") &&
+         !Params::GetBool("peptide-centric-search");
+}
+
 string TideSearchApplication::getName() const {
   return "tide-search";
 }
@@ -1274,12 +1518,20 @@ vector<string> TideSearchApplication::getOptions() const {
     "scan-number",
     "top-match",
     "store-spectra",
+    "spectrumrecords-version",
     "store-index",
     "concat",
     "compute-sp",
+    "cpu-scoring",
+    "localize-mods",
+    "fragment-candidates",
+    "fragment-peaks",
     "remove-precursor-peak",
     "remove-precursor-tolerance",
     "print-search-progress",
+    "checkpoint-interval",
+    "index-shard",
+    "merge-shards",
     "spectrum-parser",
     "use-z-line",
     "txt-output",
@@ -1287,6 +1539,7 @@ vector<string> TideSearchApplication::getOptions() const {
     "pepxml-output",
     "mzid-output",
     "pin-output",
+    "binary-output",
     "fileroot",
     "file-column",
     "output-dir",
@@ -1329,6 +1582,10 @@ vector< pair<string, string> > TideSearchApplication::getOutputs() const {
   outputs.push_back(make_pair("tide-search.decoy.txt",
     "a tab-delimited text file containing the decoy PSMs. This file will only "
     "be created if the index was created with decoys."));
+  outputs.push_back(make_pair("tide-search.target.psm.bin",
+    "a binary file containing the same target PSMs, which crux post-processing "
+    "commands read faster than the tab-delimited file. This file will only be "
+    "created if binary-output is enabled."));
   outputs.push_back(make_pair("tide-search.params.txt",
     "a file containing the name and value of all parameters/options for the "
     "current operation. Not all parameters in the file may have been used in "
@@ -1507,7 +1764,7 @@ void TideSearchApplication::processParams() {
   } else {
     // Index is Tide index directory
     pb::Header peptides_header;
-    string peptides_file = FileUtils::Join(index, "pepix");
+    string peptides_file = TideShards::HeaderFile(index);
     HeadedRecordReader peptide_reader(peptides_file, &peptides_header);
     if ((peptides_header.file_type() != pb::Header::PEPTIDES) ||
         !peptides_header.has_peptides_header()) {
@@ -1575,6 +1832,14 @@ string TideSearchApplication::getOutputFileName() {
   return output_file_name_;
 }
 
+long TideSearchApplication::getSearchedSpecCharges() const {
+  return searched_spec_charges_;
+}
+
+long TideSearchApplication::getCandidatePeptides() const {
+  return candidate_peptides_;
+}
+
 __global__ void CalculateScore(int *gSpec, double *gMass, int *result, int mSize) {
   int charge = threadIdx.x;
   int peak = blockIdx.x*blockDim.x + threadIdx.y;
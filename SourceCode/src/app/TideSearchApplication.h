@@ -3,13 +3,19 @@
 
 #include "CruxApplication.h"
 #include "TideMatchSet.h"
+#include "TideMatchWriter.h"
+#include "TideSearchCheckpoint.h"
+#include "TideSearchConfig.h"
+#include "TideSiteLocalizer.h"
 
 #include <iostream>
 #include <fstream>
 #include <iomanip>
+#include <boost/atomic.hpp>
 #include <gflags/gflags.h>
 #include "peptides.pb.h"
 #include "spectrum.pb.h"
+#include "tide/fragment_index.h"
 #include "tide/theoretical_peak_set.h"
 #include "tide/max_mz.h"
 
@@ -53,7 +59,7 @@ class TideSearchApplication : public CruxApplication {
     *                           -> search(void* threadarg)
     */
   void search(
-    const string& spectrum_filename,
+    const vector<string>& spectrum_filenames,  ///< indexed by SpecCharge::file_index
     const vector<SpectrumCollection::SpecCharge>* spec_charges,
     vector<ActivePeptideQueue*> active_peptide_queue,
     ProteinVec& proteins,
@@ -68,8 +74,7 @@ class TideSearchApplication : public CruxApplication {
     int search_charge,
     int top_matches,
     double highest_mz,
-    ofstream* target_file,
-    ofstream* decoy_file,
+    TideMatchWriter* writer,
     bool compute_sp,
     int nAA, 
     double* aaFreqN,
@@ -88,6 +93,23 @@ class TideSearchApplication : public CruxApplication {
     int charge
   );
 
+  int filterCandidates(
+    const ActivePeptideQueue* active_peptide_queue,
+    const Spectrum* spectrum,
+    int charge,
+    vector<bool>* candidatePeptideStatus,
+    int num_candidates
+  ) const;
+
+  void scoreCandidates(
+    const ActivePeptideQueue* active_peptide_queue,
+    const ObservedPeakSet& observed,
+    const vector<bool>& candidatePeptideStatus,
+    int charge,
+    ST_TheoreticalPeakSet* workspace,
+    TideMatchSet::Arr2* match_arr
+  ) const;
+
   void computeWindow(
     const SpectrumCollection::SpecCharge& sc,
     WINDOW_TYPE_T window_type,
@@ -114,6 +136,31 @@ class TideSearchApplication : public CruxApplication {
 
   std::string remove_index_;
 
+  // Totals over all search() calls, for reporting throughput.
+  long searched_spec_charges_;
+  long candidate_peptides_;
+
+  // Progress of the search, if checkpoint-interval is set; NULL otherwise.
+  TideSearchCheckpoint* checkpoint_;
+
+  // Localizes the modifications of the top matches, if localize-mods is set;
+  // NULL otherwise.
+  SiteLocalizer* localizer_;
+
+  // Fragment ion index of the peptides, if fragment-candidates is set; NULL
+  // otherwise. Only the fragment_candidates_ candidates sharing the most ions
+  // with the fragment_peaks_ most intense peaks of a spectrum are scored.
+  FragmentIndex* fragment_index_;
+  int fragment_candidates_;
+  int fragment_peaks_;
+
+  // Parameters read during the search, resolved at the start of main().
+  const TideSearchConfig* config_;
+
+  // make-pin file written by the searches, see writeMakePin().
+  string make_pin_file_;
+  bool wrote_make_pin_;
+
   struct InputFile {
     std::string OriginalName;
     std::string SpectrumRecords;
@@ -124,6 +171,17 @@ class TideSearchApplication : public CruxApplication {
       OriginalName(name), SpectrumRecords(spectrumrecords), Keep(keep) {}
   };
 
+  /**
+   * Spectrum-charges of one or more spectrum files that are searched in a
+   * single pass over the index, sorted together.
+   */
+  struct SearchPass {
+    std::vector<int> files;  ///< indices of the spectrum files
+    std::vector<SpectrumCollection::SpecCharge> spec_charges;
+    double highest_mz;  ///< highest m/z of the spectra
+    SearchPass() : highest_mz(0) {}
+  };
+
  public:
 
   // See TideSearchApplication.cpp for descriptions of these two constants
@@ -153,9 +211,28 @@ class TideSearchApplication : public CruxApplication {
 
   int main(const vector<string>& input_files, const string input_index);
 
+  /**
+   * Writes the matches of the following searches to pin_file, as make-pin
+   * would write them, while they are reported. A pipeline then does not have
+   * to run make-pin on the output files. Sharded indexes and checkpointed
+   * searches are not supported.
+   */
+  void writeMakePin(const string& pin_file) { make_pin_file_ = pin_file; }
+
+  /**
+   * \returns true if the last search wrote the file set by writeMakePin().
+   */
+  bool wroteMakePin() const { return wrote_make_pin_; }
+
   static bool hasDecoys();
   static bool proteinLevelDecoys();
 
+  /**
+   * Returns whether candidates are prefiltered with the fragment index, in
+   * which case the matches have a delta mass column.
+   */
+  static bool fragmentFilter();
+
   /**
    * Returns the command name
    */
@@ -193,7 +270,7 @@ class TideSearchApplication : public CruxApplication {
    */
   struct thread_data {
 
-    string spectrum_filename;
+    const vector<string>* spectrum_filenames;
     const vector<SpectrumCollection::SpecCharge>* spec_charges;
     ActivePeptideQueue* active_peptide_queue;
     ProteinVec proteins;
@@ -208,8 +285,7 @@ class TideSearchApplication : public CruxApplication {
     int search_charge;
     int top_matches;
     double highest_mz;
-    ofstream* target_file;
-    ofstream* decoy_file;
+    TideMatchWriter* writer;
     bool compute_sp;
     int64_t thread_num;
     int64_t num_threads;
@@ -223,25 +299,25 @@ class TideSearchApplication : public CruxApplication {
     double bin_offset;
     bool exact_pval_search;
     map<pair<string, unsigned int>, bool>* spectrum_flag;
-    int* sc_index;
-    int* total_candidate_peptides;
+    boost::atomic<int>* sc_index;
+    boost::atomic<long>* total_candidate_peptides;
     vector<int>* negative_isotope_errors;
 
-    thread_data (const string& spectrum_filename_, const vector<SpectrumCollection::SpecCharge>* spec_charges_,
+    thread_data (const vector<string>* spectrum_filenames_, const vector<SpectrumCollection::SpecCharge>* spec_charges_,
             ActivePeptideQueue* active_peptide_queue_, ProteinVec proteins_,
             vector<const pb::AuxLocation*> locations_, double precursor_window_,
             WINDOW_TYPE_T window_type_, double spectrum_min_mz_, double spectrum_max_mz_,
             int min_scan_, int max_scan_, int min_peaks_, int search_charge_, int top_matches_,
-            double highest_mz_, ofstream* target_file_,
-            ofstream* decoy_file_, bool compute_sp_, int64_t thread_num_, int64_t num_threads_, int nAA_,
+            double highest_mz_, TideMatchWriter* writer_,
+            bool compute_sp_, int64_t thread_num_, int64_t num_threads_, int nAA_,
             double* aaFreqN_, double* aaFreqI_, double* aaFreqC_, int* aaMass_, vector<boost::mutex*> locks_array_,  
             double bin_width_, double bin_offset_, bool exact_pval_search_, map<pair<string, unsigned int>, bool>* spectrum_flag_,
-            int* sc_index_, int* total_candidate_peptides_, vector<int>* negative_isotope_errors_) :
-            spectrum_filename(spectrum_filename_), spec_charges(spec_charges_), active_peptide_queue(active_peptide_queue_),
+            boost::atomic<int>* sc_index_, boost::atomic<long>* total_candidate_peptides_, vector<int>* negative_isotope_errors_) :
+            spectrum_filenames(spectrum_filenames_), spec_charges(spec_charges_), active_peptide_queue(active_peptide_queue_),
             proteins(proteins_), locations(locations_), precursor_window(precursor_window_), window_type(window_type_),
             spectrum_min_mz(spectrum_min_mz_), spectrum_max_mz(spectrum_max_mz_), min_scan(min_scan_), max_scan(max_scan_),
             min_peaks(min_peaks_), search_charge(search_charge_), top_matches(top_matches_), highest_mz(highest_mz_),
-            target_file(target_file_), decoy_file(decoy_file_), compute_sp(compute_sp_),
+            writer(writer_), compute_sp(compute_sp_),
             thread_num(thread_num_), num_threads(num_threads_), nAA(nAA_), aaFreqN(aaFreqN_), aaFreqI(aaFreqI_), aaFreqC(aaFreqC_), 
             aaMass(aaMass_), locks_array(locks_array_), bin_width(bin_width_), bin_offset(bin_offset_), exact_pval_search(exact_pval_search_), 
             spectrum_flag(spectrum_flag_), sc_index(sc_index_), total_candidate_peptides(total_candidate_peptides_), negative_isotope_errors(negative_isotope_errors_) {}
@@ -264,6 +340,8 @@ class TideSearchApplication : public CruxApplication {
   );
   
   void setSpectrumFlag(map<pair<string, unsigned int>, bool>* spectrum_flag);
+  long getSearchedSpecCharges() const;
+  long getCandidatePeptides() const;
   virtual void processParams();
   string getOutputFileName();
 };
@@ -0,0 +1,308 @@
+#include <cstdio>
+#include <sstream>
+
+#include "TideSearchCheckpoint.h"
+#include "io/carp.h"
+#include "util/FileUtils.h"
+#include "util/Params.h"
+#include "util/StringUtils.h"
+
+/**
+ * Options that do not change the search results, so they may differ between
+ * the interrupted run and the resumed one.
+ */
+static const char* const UNCHECKED_OPTIONS[] = {
+  "overwrite", "verbosity", "num-threads", "print-search-progress",
+  "parameter-file", "checkpoint-interval"
+};
+
+TideSearchCheckpoint::TideSearchCheckpoint(
+  const string& path,
+  const string& fingerprint,
+  int interval
+) : path_(path), fingerprint_(fingerprint), interval_(interval),
+    last_save_(time(NULL)), saving_(false),
+    target_file_(NULL), decoy_file_(NULL), target_offset_(0), decoy_offset_(0),
+    loaded_size_(0) {
+}
+
+TideSearchCheckpoint::~TideSearchCheckpoint() {
+}
+
+/**
+ * Hashes "name=value" lines for the options, followed by the spectrum files
+ * and the index, with 64-bit FNV-1a.
+ */
+string TideSearchCheckpoint::Fingerprint(
+  const vector<string>& options,
+  const vector<string>& input_files,
+  const string& index
+) {
+  stringstream ss;
+  size_t num_unchecked = sizeof(UNCHECKED_OPTIONS) / sizeof(UNCHECKED_OPTIONS[0]);
+  for (vector<string>::const_iterator i = options.begin(); i != options.end(); ++i) {
+    bool checked = true;
+    for (size_t j = 0; j < num_unchecked; j++) {
+      if (*i == UNCHECKED_OPTIONS[j]) {
+        checked = false;
+        break;
+      }
+    }
+    if (checked && Params::Exists(*i)) {
+      ss << *i << '=' << Params::GetString(*i) << '\n';
+    }
+  }
+  for (vector<string>::const_iterator i = input_files.begin(); i != input_files.end(); ++i) {
+    ss << "spectra=" << *i << '\n';
+  }
+  ss << "index=" << index << '\n';
+
+  string values = ss.str();
+  unsigned long long hash = 14695981039346656037ULL;
+  for (string::const_iterator i = values.begin(); i != values.end(); ++i) {
+    hash ^= (unsigned char)*i;
+    hash *= 1099511628211ULL;
+  }
+  char hex[17];
+  sprintf(hex, "%016llx", hash);
+  return hex;
+}
+
+ofstream* TideSearchCheckpoint::ReopenOutput(const string& path, long long offset) {
+  if (!FileUtils::Exists(path) || FileUtils::Size(path) < offset) {
+    carp(CARP_FATAL, "Cannot resume from checkpoint: '%s' is missing or shorter "
+                     "than when the checkpoint was written", path.c_str());
+  }
+  FileUtils::Resize(path, offset);
+  ofstream* file = new ofstream(path.c_str(), ios::in | ios::out);
+  if (!file->good()) {
+    carp(CARP_FATAL, "Failed to reopen file: %s", path.c_str());
+  }
+  file->seekp(0, ios::end);
+  return file;
+}
+
+bool TideSearchCheckpoint::load() {
+  if (!FileUtils::Exists(path_)) {
+    return false;
+  }
+  ifstream file(path_.c_str());
+  string line;
+  bool matches = false;
+  while (getline(file, line)) {
+    vector<string> fields = StringUtils::Split(line, '\t');
+    if (fields.empty() || fields[0].empty() || fields[0][0] == '#') {
+      continue;
+    }
+    const string& key = fields[0];
+    if (key == "fingerprint" && fields.size() == 2) {
+      matches = fields[1] == fingerprint_;
+      if (!matches) {
+        break;
+      }
+    } else if (key == "target-offset" && fields.size() == 2) {
+      target_offset_ = StringUtils::FromString<long long>(fields[1]);
+    } else if (key == "decoy-offset" && fields.size() == 2) {
+      decoy_offset_ = StringUtils::FromString<long long>(fields[1]);
+    } else if (key == "converted" && fields.size() == 3) {
+      converted_[fields[1]] = fields[2];
+    } else if (key == "done" && fields.size() == 2) {
+      done_files_.insert(fields[1]);
+    } else if (key == "current" && fields.size() >= 4) {
+      loaded_size_ = StringUtils::FromString<size_t>(fields[1]);
+      vector<string> ranges = !fields[2].empty() ?
+        StringUtils::Split(fields[2], ',') : vector<string>();
+      loaded_files_.assign(fields.begin() + 3, fields.end());
+      for (vector<string>::const_iterator i = ranges.begin(); i != ranges.end(); ++i) {
+        vector<size_t> range = StringUtils::Split<size_t>(*i, '-');
+        if (range.size() != 2 || range[0] > range[1] || range[1] >= loaded_size_) {
+          carp(CARP_FATAL, "Invalid range '%s' in checkpoint %s", i->c_str(), path_.c_str());
+        }
+        loaded_ranges_.push_back(make_pair(range[0], range[1]));
+      }
+    } else {
+      carp(CARP_FATAL, "Invalid line in checkpoint %s: %s", path_.c_str(), line.c_str());
+    }
+  }
+
+  if (!matches) {
+    carp(CARP_WARNING, "Ignoring checkpoint %s, which was written by a search with "
+                       "different parameters or input files", path_.c_str());
+    target_offset_ = decoy_offset_ = 0;
+    done_files_.clear();
+    converted_.clear();
+    loaded_files_.clear();
+    loaded_ranges_.clear();
+    return false;
+  }
+  carp(CARP_INFO, "Resuming search from checkpoint %s: %d spectrum files done",
+       path_.c_str(), (int)done_files_.size());
+  return true;
+}
+
+void TideSearchCheckpoint::setOutputs(ofstream* target_file, ofstream* decoy_file) {
+  target_file_ = target_file;
+  decoy_file_ = decoy_file;
+}
+
+bool TideSearchCheckpoint::fileDone(const string& spectrum_file) const {
+  return done_files_.find(spectrum_file) != done_files_.end();
+}
+
+string TideSearchCheckpoint::convertedFile(const string& spectrum_file) const {
+  map<string, string>::const_iterator i = converted_.find(spectrum_file);
+  return i != converted_.end() ? i->second : "";
+}
+
+void TideSearchCheckpoint::setConverted(const string& spectrum_file, const string& spectrumrecords) {
+  boost::unique_lock<boost::shared_mutex> lock(search_lock_);
+  converted_[spectrum_file] = spectrumrecords;
+  save();
+}
+
+void TideSearchCheckpoint::beginPass(const vector<string>& spectrum_files, size_t num_spec_charges) {
+  boost::unique_lock<boost::shared_mutex> lock(search_lock_);
+  current_files_ = spectrum_files;
+  done_.assign(num_spec_charges, 0);
+  if (spectrum_files != loaded_files_) {
+    return;
+  }
+  if (num_spec_charges != loaded_size_) {
+    carp(CARP_FATAL, "Cannot resume from checkpoint: %s now has %d spectrum-charges, "
+                     "but had %d", StringUtils::Join(spectrum_files, ',').c_str(),
+         (int)num_spec_charges, (int)loaded_size_);
+  }
+  size_t num_done = 0;
+  for (vector<pair<size_t, size_t> >::const_iterator i = loaded_ranges_.begin();
+       i != loaded_ranges_.end();
+       ++i) {
+    for (size_t j = i->first; j <= i->second; j++) {
+      done_[j] = 1;
+    }
+    num_done += i->second - i->first + 1;
+  }
+  carp(CARP_INFO, "Skipping %d of %d spectrum-charges searched before the checkpoint",
+       (int)num_done, (int)num_spec_charges);
+  loaded_files_.clear();
+  loaded_ranges_.clear();
+}
+
+void TideSearchCheckpoint::endPass() {
+  boost::unique_lock<boost::shared_mutex> lock(search_lock_);
+  done_files_.insert(current_files_.begin(), current_files_.end());
+  current_files_.clear();
+  done_.clear();
+  save();
+}
+
+void TideSearchCheckpoint::finish() {
+  FileUtils::Remove(path_);
+}
+
+/**
+ * Marks a spectrum-charge as done. Called while holding its step.
+ * \returns true if the interval has passed and the caller should write a
+ * checkpoint once it has released the step.
+ */
+bool TideSearchCheckpoint::markDone(size_t sc_idx) {
+  boost::mutex::scoped_lock lock(state_lock_);
+  done_[sc_idx] = 1;
+  if (saving_ || time(NULL) - last_save_ < interval_) {
+    return false;
+  }
+  saving_ = true;
+  return true;
+}
+
+/**
+ * Writes a checkpoint once all steps in progress have finished.
+ */
+void TideSearchCheckpoint::saveBetweenSteps() {
+  boost::unique_lock<boost::shared_mutex> lock(search_lock_);
+  save();
+  boost::mutex::scoped_lock state(state_lock_);
+  saving_ = false;
+}
+
+/**
+ * Flushes the output files and writes the checkpoint to a temporary file,
+ * which then replaces the old checkpoint. The caller holds search_lock_
+ * exclusively.
+ */
+void TideSearchCheckpoint::save() {
+  if (target_file_) {
+    target_file_->flush();
+    target_offset_ = target_file_->tellp();
+  }
+  if (decoy_file_) {
+    decoy_file_->flush();
+    decoy_offset_ = decoy_file_->tellp();
+  }
+
+  string temp_path = path_ + ".tmp";
+  ofstream file(temp_path.c_str());
+  file << "# tide-search checkpoint" << endl
+       << "fingerprint\t" << fingerprint_ << endl
+       << "target-offset\t" << target_offset_ << endl
+       << "decoy-offset\t" << decoy_offset_ << endl;
+  for (map<string, string>::const_iterator i = converted_.begin(); i != converted_.end(); ++i) {
+    file << "converted\t" << i->first << '\t' << i->second << endl;
+  }
+  for (set<string>::const_iterator i = done_files_.begin(); i != done_files_.end(); ++i) {
+    file << "done\t" << *i << endl;
+  }
+  if (!current_files_.empty()) {
+    boost::mutex::scoped_lock lock(state_lock_);
+    file << "current\t" << done_.size() << '\t';
+    bool first = true;
+    for (size_t i = 0; i < done_.size(); i++) {
+      if (!done_[i]) {
+        continue;
+      }
+      size_t end = i;
+      while (end + 1 < done_.size() && done_[end + 1]) {
+        ++end;
+      }
+      file << (first ? "" : ",") << i << '-' << end;
+      first = false;
+      i = end;
+    }
+    for (vector<string>::const_iterator i = current_files_.begin(); i != current_files_.end(); ++i) {
+      file << '\t' << *i;
+    }
+    file << endl;
+  }
+  file.close();
+  if (!file) {
+    carp(CARP_WARNING, "Failed to write checkpoint %s", temp_path.c_str());
+    return;
+  }
+  FileUtils::Rename(temp_path, path_);
+  boost::mutex::scoped_lock lock(state_lock_);
+  last_save_ = time(NULL);
+  carp(CARP_DEBUG, "Wrote checkpoint %s", path_.c_str());
+}
+
+TideSearchCheckpoint::Step::Step(TideSearchCheckpoint* checkpoint, size_t sc_idx)
+  : checkpoint_(checkpoint), sc_idx_(sc_idx) {
+  if (checkpoint_) {
+    checkpoint_->search_lock_.lock_shared();
+  }
+}
+
+TideSearchCheckpoint::Step::~Step() {
+  if (checkpoint_) {
+    bool save = checkpoint_->markDone(sc_idx_);
+    checkpoint_->search_lock_.unlock_shared();
+    if (save) {
+      checkpoint_->saveBetweenSteps();
+    }
+  }
+}
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 2
+ * End:
+ */
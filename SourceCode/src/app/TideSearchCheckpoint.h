@@ -0,0 +1,140 @@
+#ifndef TIDE_SEARCH_CHECKPOINT_H
+#define TIDE_SEARCH_CHECKPOINT_H
+
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
+
+using namespace std;
+
+/**
+ * Records the progress of a tide-search so that an interrupted run can be
+ * resumed. The checkpoint file lists the spectrum files that were searched
+ * completely, the spectrumrecords files that were converted, the ranges of
+ * spectrum-charges (by their index in the sorted spectrum-charge list) that
+ * were searched in the current pass over the index, which may cover several
+ * spectrum files, and the length of the
+ * tab-delimited output files at that point. On resume, the output files are
+ * truncated to those lengths and appended to.
+ */
+class TideSearchCheckpoint {
+ public:
+  TideSearchCheckpoint(
+    const string& path,  ///< checkpoint file
+    const string& fingerprint,  ///< identifies the search parameters
+    int interval  ///< seconds between checkpoints
+  );
+  ~TideSearchCheckpoint();
+
+  /**
+   * \returns a hash of the values of the given options, the spectrum files
+   * and the index, which a checkpoint has to match to be resumed.
+   */
+  static string Fingerprint(
+    const vector<string>& options,
+    const vector<string>& input_files,
+    const string& index
+  );
+
+  /**
+   * Opens an existing output file for appending, after truncating it to
+   * offset bytes.
+   */
+  static ofstream* ReopenOutput(const string& path, long long offset);
+
+  /**
+   * Reads the checkpoint file, if there is one.
+   * \returns true if it was written by a search with the same fingerprint.
+   */
+  bool load();
+
+  long long targetOffset() const { return target_offset_; }
+  long long decoyOffset() const { return decoy_offset_; }
+
+  /**
+   * Sets the output files whose lengths are recorded. Not owned.
+   */
+  void setOutputs(ofstream* target_file, ofstream* decoy_file);
+
+  bool fileDone(const string& spectrum_file) const;
+
+  /**
+   * \returns the spectrumrecords file that spectrum_file was converted to, or
+   * an empty string.
+   */
+  string convertedFile(const string& spectrum_file) const;
+  void setConverted(const string& spectrum_file, const string& spectrumrecords);
+
+  /**
+   * Starts a pass over the index for the spectrum files, with
+   * num_spec_charges spectrum-charges, restoring its searched ranges if it
+   * is the pass the checkpoint was in.
+   */
+  void beginPass(const vector<string>& spectrum_files, size_t num_spec_charges);
+  bool isDone(size_t sc_idx) const { return done_[sc_idx] != 0; }
+  void endPass();
+
+  /**
+   * Removes the checkpoint file once the search has finished.
+   */
+  void finish();
+
+  /**
+   * Held by a search thread while it searches a spectrum-charge and writes
+   * its matches. Checkpoints are only written while no steps are held, so
+   * the output never contains part of a spectrum-charge's matches. Marks the
+   * spectrum-charge as done when destroyed.
+   */
+  class Step {
+   public:
+    Step(TideSearchCheckpoint* checkpoint, size_t sc_idx);
+    ~Step();
+   protected:
+    TideSearchCheckpoint* checkpoint_;
+    size_t sc_idx_;
+  };
+
+ protected:
+  bool markDone(size_t sc_idx);
+  void saveBetweenSteps();
+  void save();
+
+  string path_;
+  string fingerprint_;
+  int interval_;
+  time_t last_save_;
+  bool saving_;
+
+  boost::shared_mutex search_lock_;  ///< shared by steps, exclusive for saving
+  boost::mutex state_lock_;  ///< guards done_, last_save_ and saving_
+
+  ofstream* target_file_;
+  ofstream* decoy_file_;
+  long long target_offset_;
+  long long decoy_offset_;
+
+  set<string> done_files_;
+  map<string, string> converted_;
+  vector<string> current_files_;
+  vector<char> done_;  ///< per spectrum-charge of the current pass
+
+  // Searched ranges of the pass the loaded checkpoint was in
+  vector<string> loaded_files_;
+  size_t loaded_size_;
+  vector<pair<size_t, size_t> > loaded_ranges_;
+};
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 2
+ * End:
+ */
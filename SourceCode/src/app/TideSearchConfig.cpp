@@ -0,0 +1,36 @@
+#include "TideSearchConfig.h"
+#include "io/carp.h"
+#include "util/Params.h"
+
+TideSearchConfig::TideSearchConfig()
+  : concat(Params::GetBool("concat")),
+    cpu_scoring(Params::GetBool("cpu-scoring")),
+    exact_pval(Params::GetBool("exact-p-value")),
+    peptide_centric(Params::GetBool("peptide-centric-search")),
+    preprocess(readPreprocessOptions()),
+    max_precursor_charge(Params::GetInt("max-precursor-charge")),
+    elution_window_size(Params::GetInt("elution-window-size")),
+    print_search_progress(Params::GetInt("print-search-progress")),
+    store_spectra(Params::GetString("store-spectra")) {
+  if (preprocess.remove_precursor_peak && preprocess.remove_precursor_tolerance < 0) {
+    carp(CARP_FATAL, "remove-precursor-tolerance must not be negative, but is %g",
+         preprocess.remove_precursor_tolerance);
+  }
+}
+
+PreprocessOptions TideSearchConfig::readPreprocessOptions() {
+  PreprocessOptions options;
+  options.use_neutral_loss_peaks = Params::GetBool("use-neutral-loss-peaks");
+  options.use_flanking_peaks = Params::GetBool("use-flanking-peaks");
+  options.skip_preprocessing = Params::GetBool("skip-preprocessing");
+  options.remove_precursor_peak = Params::GetBool("remove-precursor-peak");
+  options.remove_precursor_tolerance = Params::GetDouble("remove-precursor-tolerance");
+  return options;
+}
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 2
+ * End:
+ */
@@ -0,0 +1,43 @@
+#ifndef TIDE_SEARCH_CONFIG_H
+#define TIDE_SEARCH_CONFIG_H
+
+#include <string>
+
+#include "tide/spectrum_preprocess.h"
+
+/**
+ * The parameters that tide-search reads while searching, resolved once from
+ * Params when the search starts. Params lookups go through a map keyed by
+ * name, so the per-spectrum and per-match code reads these fields instead.
+ * The search does not change parameters once it has started, so the values
+ * stay valid for the whole search.
+ */
+class TideSearchConfig {
+ public:
+  TideSearchConfig();
+
+  const bool concat;
+  const bool cpu_scoring;
+  const bool exact_pval;
+  const bool peptide_centric;
+  const PreprocessOptions preprocess;
+  const int max_precursor_charge;
+  const int elution_window_size;
+  const int print_search_progress;
+  const std::string store_spectra;
+
+ private:
+  static PreprocessOptions readPreprocessOptions();
+
+  TideSearchConfig(const TideSearchConfig&);
+  TideSearchConfig& operator=(const TideSearchConfig&);
+};
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 2
+ * End:
+ */
@@ -0,0 +1,279 @@
+/**
+ * \file TideSearchCpuScoring.cpp
+ * \brief The parts of tide-search that score candidates on the CPU.
+ *
+ * These do not use CUDA, so they are kept out of TideSearchApplication.cu.
+ ***********************************************************/
+#include <algorithm>
+#include <climits>
+#include <functional>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#endif
+
+#include "io/carp.h"
+#include "TideSearchApplication.h"
+#include "tide/mass_constants.h"
+
+void TideSearchApplication::collectScoresCompiled(
+  ActivePeptideQueue* active_peptide_queue,
+  const Spectrum* spectrum,
+  const ObservedPeakSet& observed,
+  TideMatchSet::Arr2* match_arr,
+  int queue_size,
+  int charge
+) {
+  if (!active_peptide_queue->HasNext()) {
+    return;
+  }
+  // prog gets the address of the dot-product program for the first peptide
+  // in the active queue.
+  const void* prog = active_peptide_queue->NextPeptide()->Prog(charge);
+  const int* cache = observed.GetCache();
+  // results will get (score, counter) pairs, where score is the dot product
+  // of the observed peak set with a candidate peptide. The candidate
+  // peptide is given by counter, which refers to the index within the
+  // ActivePeptideQueue, counting from the back. This complication
+  // simplifies the generated programs, which now simply dump the counter.
+  pair<int, int>* results = match_arr->data();
+
+  // See compiler.h for a description of the programs beginning at prog and
+  // how they are generated. Here we initialize certain registers to the
+  // values expected by the programs and call the first one (*prog).
+  //
+  // See gnu assembler format for more on this format. We tell the compiler
+  // to set these registers:
+  // edx/rdx points to the cache.
+  // eax/rax points to the first program.
+  // ecx/rcx is the counter and gets the size of the active queue.
+  // edi/rdi points to the results buffer.
+  //
+  // On 32-bit x86, the push and pop operations are a workaround for a
+  // compiler that doesn't understand that %ecx and %edi get clobbered. Since
+  // they're already input registers, they can't be included in the clobber
+  // list.
+
+#ifdef _MSC_VER
+#ifdef _WIN64
+  DWORD64 rcx;
+  DWORD64 rdi;
+
+  volatile bool restored = false;
+  CONTEXT context;
+  RtlCaptureContext(&context);
+  if (!restored) {
+    rcx = context.Rcx;
+    rdi = context.Rdi;
+
+    context.Rdx = (DWORD64)cache;
+    context.Rax = (DWORD64)prog;
+    context.Rcx = (DWORD64)queue_size;
+    context.Rdi = (DWORD64)results;
+
+    restored = true;
+    RtlRestoreContext(&context, NULL);
+  } else {
+    ((void(*)(void))prog)();
+  }
+
+  restored = false;
+  RtlCaptureContext(&context);
+  if (!restored) {
+    context.Rcx = rcx;
+    context.Rdi = rdi;
+
+    restored = true;
+    RtlRestoreContext(&context, NULL);
+  }
+#else
+  __asm {
+    cld
+    push ecx
+    push edi
+    mov edx, cache
+    mov eax, prog
+    mov ecx, queue_size
+    mov edi, results
+    call eax
+    pop edi
+    pop ecx
+  }
+#endif
+#else
+#ifdef __x86_64__
+  // The programs may also use the vector registers below for the gathers
+  // (see TheoreticalPeakCompiler::Isa), and the call must not overwrite the
+  // red zone below the stack pointer, where the compiler may keep locals.
+  long counter = queue_size;
+  __asm__ __volatile__("cld\n" // stos operations increment edi
+                       "sub $128, %%rsp\n"
+                       "call *%%rax\n"
+                       "add $128, %%rsp\n"
+                       : "+a" (prog),
+                         "+c" (counter),
+                         "+D" (results)
+                       : "d" (cache)
+                       : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3"
+#ifdef __AVX512F__
+                         , "k1"
+#endif
+  );
+#else
+  __asm__ __volatile__("cld\n" // stos operations increment edi
+                       "push %%ecx\n"
+                       "push %%edi\n"
+                       "call *%%eax\n"
+                       "pop %%edi\n"
+                       "pop %%ecx\n"
+                       : // no outputs
+                       : "d" (cache),
+                         "a" (prog),
+                         "c" (queue_size),
+                         "D" (results)
+  );
+#endif
+#endif
+
+  // match_arr is filled by the compiled programs, not by calls to
+  // push_back(). We have to set the final size explicitly.
+  match_arr->set_size(queue_size);
+}
+
+/**
+ * Clears the status of all but the fragment_candidates_ candidates that share
+ * the most fragment index bins with the fragment_peaks_ most intense peaks of
+ * the spectrum. Above charge 2, each peak also counts as a doubly charged
+ * ion. Ties are broken in favor of the lighter candidates.
+ * \returns the number of candidates left.
+ */
+int TideSearchApplication::filterCandidates(
+  const ActivePeptideQueue* active_peptide_queue,
+  const Spectrum* spectrum,
+  int charge,
+  vector<bool>* candidatePeptideStatus,
+  int num_candidates
+) const {
+  if (num_candidates <= fragment_candidates_) {
+    return num_candidates;
+  }
+  int size = candidatePeptideStatus->size();
+  int first_id = INT_MAX;
+  int last_id = -1;
+  deque<Peptide*>::const_iterator iter = active_peptide_queue->iter_;
+  for (int i = 0; i < size; i++, ++iter) {
+    if ((*candidatePeptideStatus)[i]) {
+      first_id = min(first_id, (*iter)->Id());
+      last_id = max(last_id, (*iter)->Id());
+    }
+  }
+  if (last_id >= fragment_index_->NumPeptides()) {
+    carp(CARP_FATAL, "The fragment index does not match the peptides of the index");
+  }
+
+  vector<pair<double, double> > peaks;  // (intensity, m/z)
+  peaks.reserve(spectrum->Size());
+  for (int i = 0; i < spectrum->Size(); i++) {
+    peaks.push_back(make_pair(spectrum->Intensity(i), spectrum->M_Z(i)));
+  }
+  int num_peaks = min((int)peaks.size(), fragment_peaks_);
+  partial_sort(peaks.begin(), peaks.begin() + num_peaks, peaks.end(),
+               greater<pair<double, double> >());
+  vector<int> counts(last_id - first_id + 1, 0);
+  for (int i = 0; i < num_peaks; i++) {
+    double mz = peaks[i].second;
+    fragment_index_->Count(fragment_index_->Bin(mz), first_id, &counts);
+    if (charge > 2) {
+      fragment_index_->Count(fragment_index_->Bin(2 * mz - MassConstants::proton),
+                             first_id, &counts);
+    }
+  }
+
+  vector<int> ranked;
+  ranked.reserve(num_candidates);
+  iter = active_peptide_queue->iter_;
+  for (int i = 0; i < size; i++, ++iter) {
+    if ((*candidatePeptideStatus)[i]) {
+      ranked.push_back(counts[(*iter)->Id() - first_id]);
+    }
+  }
+  if ((int)ranked.size() <= fragment_candidates_) {
+    return ranked.size();
+  }
+  nth_element(ranked.begin(), ranked.begin() + fragment_candidates_ - 1, ranked.end(),
+              greater<int>());
+  // The count of the last candidate kept, and how many with that count fit.
+  int threshold = ranked[fragment_candidates_ - 1];
+  int num_at_threshold = fragment_candidates_;
+  for (int i = 0; i < fragment_candidates_; i++) {
+    if (ranked[i] > threshold) {
+      num_at_threshold--;
+    }
+  }
+
+  iter = active_peptide_queue->iter_;
+  for (int i = 0; i < size; i++, ++iter) {
+    if (!(*candidatePeptideStatus)[i]) {
+      continue;
+    }
+    int count = counts[(*iter)->Id() - first_id];
+    if (count < threshold) {
+      (*candidatePeptideStatus)[i] = false;
+    } else if (count == threshold) {
+      if (num_at_threshold > 0) {
+        num_at_threshold--;
+      } else {
+        (*candidatePeptideStatus)[i] = false;
+      }
+    }
+  }
+  return fragment_candidates_;
+}
+
+/**
+ * Computes the XCorr of the candidates left by filterCandidates() one by one,
+ * since the compiled programs score the whole active range. The results are
+ * laid out as collectScoresCompiled() lays them out, and the scores are the
+ * same: the dot products of the cache with the same de-duplicated peaks the
+ * programs are compiled from.
+ */
+void TideSearchApplication::scoreCandidates(
+  const ActivePeptideQueue* active_peptide_queue,
+  const ObservedPeakSet& observed,
+  const vector<bool>& candidatePeptideStatus,
+  int charge,
+  ST_TheoreticalPeakSet* workspace,
+  TideMatchSet::Arr2* match_arr
+) const {
+  int size = candidatePeptideStatus.size();
+  const int* cache = observed.GetCache();
+  int cache_end = MaxBin::Global().CacheBinEnd() * NUM_PEAK_TYPES;
+  int num_arrs = charge > 2 ? 2 : 1;
+  pair<int, int>* results = match_arr->data();
+  deque<Peptide*>::const_iterator iter = active_peptide_queue->iter_;
+  for (int i = 0; i < size; i++, ++iter) {
+    int score = 0;
+    if (candidatePeptideStatus[i]) {
+      workspace->Clear();
+      (*iter)->ComputeTheoreticalPeaks(workspace);
+      const TheoreticalPeakArr* peaks = workspace->GetPeaks();
+      for (int j = 0; j < num_arrs; j++) {
+        for (TheoreticalPeakArr::const_iterator peak = peaks[j].begin();
+             peak != peaks[j].end(); ++peak) {
+          if (peak->Code() < cache_end) {
+            score += cache[peak->Code()];
+          }
+        }
+      }
+    }
+    results[i] = make_pair(score, size - i);
+  }
+  match_arr->set_size(size);
+}
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 2
+ * End:
+ */
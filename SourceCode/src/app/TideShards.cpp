@@ -0,0 +1,396 @@
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include "TideShards.h"
+#include "TideSearchApplication.h"
+#include "app/tide/records.h"
+#include "io/carp.h"
+#include "util/crux-utils.h"
+#include "util/FileUtils.h"
+#include "util/Params.h"
+#include "util/StringUtils.h"
+
+/**
+ * Number of columns before the peptide columns in a shard results file: the
+ * spectrum file, scan, charge, precursor m/z, decoy flag, xcorr, p-value, sp,
+ * matched and total ions, distinct matches and the three mass columns.
+ */
+static const size_t SHARD_RESULT_COLUMNS = 14;
+
+string TideShards::ShardFile(const string& index, int shard) {
+  return FileUtils::Join(index, "pepix.shard-" + StringUtils::ToString(shard));
+}
+
+vector<string> TideShards::ShardFiles(const string& index) {
+  vector<string> shards;
+  while (FileUtils::Exists(ShardFile(index, shards.size()))) {
+    shards.push_back(ShardFile(index, shards.size()));
+  }
+  return shards;
+}
+
+string TideShards::HeaderFile(const string& index) {
+  string peptides_file = FileUtils::Join(index, "pepix");
+  if (!FileUtils::Exists(peptides_file) && FileUtils::Exists(ShardFile(index, 0))) {
+    return ShardFile(index, 0);
+  }
+  return peptides_file;
+}
+
+void TideShards::Split(const string& peptides_file, const string& index, int num_shards) {
+  pb::Header header;
+  pb::Peptide peptide;
+
+  // Count the peptides first, so that the shards can be of equal size
+  int num_peptides = 0;
+  {
+    HeadedRecordReader reader(peptides_file, &header);
+    while (!reader.Done()) {
+      reader.Read(&peptide);
+      ++num_peptides;
+    }
+    if (!reader.OK()) {
+      carp(CARP_FATAL, "Error reading index (%s)", peptides_file.c_str());
+    }
+  }
+  int shard_size = (num_peptides + num_shards - 1) / num_shards;
+
+  // Every shard gets the header of the whole index. Done() may only be
+  // called once per record, so remember whether there is another peptide.
+  HeadedRecordReader reader(peptides_file, &header);
+  bool more = !reader.Done();
+  for (int shard = 0; shard < num_shards; shard++) {
+    string shard_file = ShardFile(index, shard);
+    HeadedRecordWriter writer(shard_file, header);
+    int written = 0;
+    for (; written < shard_size && more; written++) {
+      reader.Read(&peptide);
+      if (!writer.Write(&peptide)) {
+        carp(CARP_FATAL, "Error writing index shard (%s)", shard_file.c_str());
+      }
+      more = !reader.Done();
+    }
+    carp(CARP_DEBUG, "Wrote %d peptides to %s", written, shard_file.c_str());
+  }
+  if (!reader.OK()) {
+    carp(CARP_FATAL, "Error reading index (%s)", peptides_file.c_str());
+  }
+}
+
+void TideShards::Remove(const string& index) {
+  vector<string> shards = ShardFiles(index);
+  for (vector<string>::const_iterator i = shards.begin(); i != shards.end(); ++i) {
+    FileUtils::Remove(*i);
+  }
+}
+
+string TideShards::ResultFile(int shard) {
+  return make_file_path("tide-search.shard-" + StringUtils::ToString(shard) + ".txt");
+}
+
+/**
+ * Scores are written with enough digits to be read back exactly.
+ */
+static void writeExact(ostream& out, double value) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.17g", value);
+  out << buffer;
+}
+
+TideShardWriter::TideShardWriter(
+  const string& file_name,
+  int shard,
+  int num_shards
+) : TideDelimitedWriter(
+      create_stream_in_path(file_name.c_str(), NULL, Params::GetBool("overwrite")), NULL) {
+  *target_file_ << "# tide-search shard " << shard << " of " << num_shards << endl;
+}
+
+void TideShardWriter::write(const TidePsm& psm) {
+  ofstream* file = target_file_;
+  const SpScorer::SpScoreData* sp_data = psm.sp_data;
+  *file << *psm.spectrum_filename << '\t'
+        << psm.spectrum->SpectrumNumber() << '\t'
+        << psm.charge << '\t';
+  writeExact(*file, psm.spectrum->PrecursorMZ());
+  *file << '\t' << (psm.decoy ? 1 : 0) << '\t';
+  writeExact(*file, psm.xcorr_score);
+  *file << '\t';
+  writeExact(*file, psm.xcorr_pval);
+  *file << '\t';
+  writeExact(*file, sp_data ? sp_data->sp_score : 0);
+  *file << '\t'
+        << (sp_data ? sp_data->matched_ions : 0) << '\t'
+        << (sp_data ? sp_data->total_ions : 0) << '\t'
+        << psm.distinct_matches << '\t';
+  writeMassColumns(*file, psm);
+  *file << '\t';
+  writePeptideColumns(*file, psm);
+  *file << '\n';
+}
+
+/**
+ * Opens a shard results file and checks its first line.
+ */
+static void openResults(ifstream* file, const string& file_name, int shard, int num_shards) {
+  file->open(file_name.c_str());
+  if (!file->is_open()) {
+    carp(CARP_FATAL, "Error opening %s. Has shard %d been searched?",
+         file_name.c_str(), shard);
+  }
+  string line;
+  string expected = "# tide-search shard " + StringUtils::ToString(shard) +
+    " of " + StringUtils::ToString(num_shards);
+  if (!getline(*file, line) || line != expected) {
+    carp(CARP_FATAL, "%s does not hold the results of shard %d of %d",
+         file_name.c_str(), shard, num_shards);
+  }
+}
+
+/**
+ * Parses a row written by TideShardWriter.
+ */
+static TideShardMerger::Match* parseMatch(const string& line, int shard) {
+  vector<string> fields = StringUtils::Split(line, '\t');
+  if (fields.size() <= SHARD_RESULT_COLUMNS) {
+    carp(CARP_FATAL, "Invalid shard result: %s", line.c_str());
+  }
+  TideShardMerger::Match* match = new TideShardMerger::Match();
+  match->shard = shard;
+  match->scan = atoi(fields[1].c_str());
+  match->charge = atoi(fields[2].c_str());
+  match->precursor_mz = strtod(fields[3].c_str(), NULL);
+  match->decoy = fields[4] == "1";
+  match->xcorr_score = strtod(fields[5].c_str(), NULL);
+  match->xcorr_pval = strtod(fields[6].c_str(), NULL);
+  match->sp_score = strtod(fields[7].c_str(), NULL);
+  match->matched_ions = atoi(fields[8].c_str());
+  match->total_ions = atoi(fields[9].c_str());
+  match->distinct_matches = atoi(fields[10].c_str());
+  match->mass_columns = fields[11] + '\t' + fields[12] + '\t' + fields[13];
+  match->peptide_columns = StringUtils::Join(
+    vector<string>(fields.begin() + SHARD_RESULT_COLUMNS, fields.end()), '\t');
+  return match;
+}
+
+/**
+ * Spectra that share a scan number, such as those of the precursors of one
+ * scan, are told apart by their precursor m/z.
+ */
+static bool lessSpectrum(const TideShardMerger::Match* x, const TideShardMerger::Match* y) {
+  if (x->scan != y->scan) {
+    return x->scan < y->scan;
+  } else if (x->charge != y->charge) {
+    return x->charge < y->charge;
+  }
+  return x->precursor_mz < y->precursor_mz;
+}
+
+static bool moreXcorrScore(const TideShardMerger::Match* x, const TideShardMerger::Match* y) {
+  return x->xcorr_score > y->xcorr_score;
+}
+
+static bool lessXcorrPval(const TideShardMerger::Match* x, const TideShardMerger::Match* y) {
+  return x->xcorr_pval < y->xcorr_pval;
+}
+
+static bool moreSpScore(const pair<double, size_t>& x, const pair<double, size_t>& y) {
+  return x.first > y.first;
+}
+
+TideShardMerger::TideShardMerger(
+  ofstream* target_file,
+  ofstream* decoy_file,
+  bool compute_sp
+) : TideDelimitedWriter(target_file, decoy_file),
+    compute_sp_(compute_sp),
+    top_n_(Params::GetInt("top-match")) {
+}
+
+/**
+ * All spectrum files are searched in one pass, so their rows are interleaved
+ * in the results files. The rows are first split by spectrum file into
+ * temporary files, each holding the rows of all shards, so that only the
+ * matches of one spectrum file are held at a time. Spectra are written in
+ * order of scan, charge and precursor m/z.
+ */
+void TideShardMerger::merge(
+  const vector<string>& spectrum_files,
+  const vector<string>& result_files
+) {
+  map<string, size_t> file_indices;
+  vector<string> split_names;
+  vector<ofstream*> split_files;
+  for (size_t i = 0; i < spectrum_files.size(); i++) {
+    file_indices[spectrum_files[i]] = i;
+    split_names.push_back(make_file_path(
+      "tide-search.shard-merge-" + StringUtils::ToString(i) + ".tmp"));
+    split_files.push_back(create_stream_in_path(split_names.back().c_str(), NULL, true));
+  }
+  for (size_t shard = 0; shard < result_files.size(); shard++) {
+    ifstream results;
+    openResults(&results, result_files[shard], shard, result_files.size());
+    string line;
+    while (getline(results, line)) {
+      string spectrum_file = line.substr(0, line.find('\t'));
+      map<string, size_t>::const_iterator i = file_indices.find(spectrum_file);
+      if (i == file_indices.end()) {
+        carp(CARP_FATAL, "%s has results for %s, which is not one of the spectrum "
+                         "files being merged", result_files[shard].c_str(),
+                         spectrum_file.c_str());
+      }
+      *split_files[i->second] << shard << '\t' << line << '\n';
+    }
+  }
+  for (size_t i = 0; i < split_files.size(); i++) {
+    delete split_files[i];
+  }
+
+  for (size_t i = 0; i < spectrum_files.size(); i++) {
+    carp(CARP_INFO, "Merging shard results for %s", spectrum_files[i].c_str());
+    vector<Match*> matches;
+    ifstream split(split_names[i].c_str());
+    string line;
+    while (getline(split, line)) {
+      size_t tab = line.find('\t');
+      matches.push_back(parseMatch(line.substr(tab + 1), atoi(line.substr(0, tab).c_str())));
+    }
+    split.close();
+    FileUtils::Remove(split_names[i]);
+
+    stable_sort(matches.begin(), matches.end(), lessSpectrum);
+    vector<Match*>::const_iterator begin = matches.begin();
+    while (begin != matches.end()) {
+      vector<Match*>::const_iterator end = begin + 1;
+      while (end != matches.end() && !lessSpectrum(*begin, *end)) {
+        ++end;
+      }
+      mergeSpectrum(spectrum_files[i], begin, end);
+      begin = end;
+    }
+    for (vector<Match*>::iterator j = matches.begin(); j != matches.end(); ++j) {
+      delete *j;
+    }
+  }
+}
+
+/**
+ * Splits the matches of a spectrum into targets and decoys, as
+ * TideMatchSet::gatherTargetsAndDecoys does, and writes both lists.
+ */
+void TideShardMerger::mergeSpectrum(
+  const string& spectrum_file,
+  vector<Match*>::const_iterator begin,
+  vector<Match*>::const_iterator end
+) {
+  bool split = !concat_ && TideSearchApplication::hasDecoys();
+  vector<Match*> targets, decoys;
+  for (vector<Match*>::const_iterator i = begin; i != end; ++i) {
+    (split && (*i)->decoy ? decoys : targets).push_back(*i);
+  }
+  writeList(spectrum_file, targets);
+  writeList(spectrum_file, decoys);
+}
+
+/**
+ * Ranks the matches of all shards together, keeps the best top-match + 1 of
+ * them for delta LCn and Sp rank, and writes the best top-match. Ties keep
+ * the order of the shards. The shards hold disjoint peptides, so the distinct
+ * matches are the sum of those of the shards.
+ */
+void TideShardMerger::writeList(
+  const string& spectrum_file,
+  vector<Match*>& list
+) {
+  if (list.empty()) {
+    return;
+  }
+
+  int distinct_matches = 0;
+  set<int> shards;
+  for (vector<Match*>::const_iterator i = list.begin(); i != list.end(); ++i) {
+    if (shards.insert((*i)->shard).second) {
+      distinct_matches += (*i)->distinct_matches;
+    }
+  }
+
+  stable_sort(list.begin(), list.end(), exact_pval_ ? lessXcorrPval : moreXcorrScore);
+  if (list.size() > (size_t)top_n_ + 1) {
+    list.resize(top_n_ + 1);
+  }
+
+  vector<FLOAT_T> scores;
+  for (vector<Match*>::const_iterator i = list.begin(); i != list.end(); ++i) {
+    scores.push_back(exact_pval_ ? (*i)->xcorr_pval : (*i)->xcorr_score);
+  }
+  vector< pair<FLOAT_T, FLOAT_T> > deltaCns = MatchCollection::calculateDeltaCns(
+    scores, !exact_pval_ ? XCORR : TIDE_SEARCH_EXACT_PVAL);
+
+  vector<int> sp_ranks(list.size(), 0);
+  if (compute_sp_) {
+    vector< pair<double, size_t> > sp_scores;
+    for (size_t i = 0; i < list.size(); i++) {
+      sp_scores.push_back(make_pair(list[i]->sp_score, i));
+    }
+    stable_sort(sp_scores.begin(), sp_scores.end(), moreSpScore);
+    for (size_t i = 0; i < sp_scores.size(); i++) {
+      sp_ranks[sp_scores[i].second] = i + 1;
+    }
+  }
+
+  // Same columns as TideDelimitedWriter::write for spectrum centric rows
+  size_t num_written = min(list.size(), (size_t)top_n_);
+  for (size_t i = 0; i < num_written; i++) {
+    const Match* match = list[i];
+    ofstream* file = (match->decoy && !concat_) ? decoy_file_ : target_file_;
+    if (!file) {
+      continue;
+    }
+    double delta_cn = deltaCns[i].first;
+    double delta_lcn = deltaCns[i].second;
+    if (file_column_) {
+      *file << spectrum_file << '\t';
+    }
+    *file << match->scan << '\t'
+          << match->charge << '\t'
+          << match->mass_columns << '\t'
+          << delta_cn << '\t'
+          << delta_lcn << '\t';
+    if (compute_sp_) {
+      *file << StringUtils::ToString(match->sp_score, precision_) << '\t'
+            << sp_ranks[i] << '\t';
+    }
+    if (exact_pval_) {
+      *file << StringUtils::ToString(match->xcorr_pval, precision_, false) << '\t';
+      *file << StringUtils::ToString(match->xcorr_score, precision_, true) << '\t';
+    } else {
+      *file << StringUtils::ToString(match->xcorr_score, precision_, true) << '\t';
+    }
+    *file << i + 1 << '\t';
+    if (compute_sp_) {
+      *file << match->matched_ions << '\t'
+            << match->total_ions << '\t';
+    }
+    *file << distinct_matches << '\t';
+    if (localize_ && i > 0) {
+      // Only the top match of each list is localized, and a shard's top
+      // match can rank lower here, so clear the last two columns.
+      const string& columns = match->peptide_columns;
+      size_t sites = columns.rfind('\t');
+      size_t score = columns.rfind('\t', sites - 1);
+      *file << columns.substr(0, score) << "\t\t" << endl;
+    } else {
+      *file << match->peptide_columns << endl;
+    }
+  }
+}
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 2
+ * End:
+ */
@@ -0,0 +1,127 @@
+#ifndef TIDE_SHARDS_H
+#define TIDE_SHARDS_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "TideMatchWriter.h"
+
+using namespace std;
+
+/**
+ * Helpers for an index whose peptides tide-index split into shards with
+ * index-shards. Each shard is a peptides file like pepix, holding a range of
+ * consecutive peptide masses, and named pepix.shard-<n>. The proteins and
+ * auxiliary locations are shared by all shards.
+ */
+class TideShards {
+ public:
+  static string ShardFile(const string& index, int shard);
+
+  /**
+   * \returns the shards of the index in order, or nothing if it is not
+   * sharded.
+   */
+  static vector<string> ShardFiles(const string& index);
+
+  /**
+   * \returns the file to read the peptides header of the index from.
+   */
+  static string HeaderFile(const string& index);
+
+  /**
+   * Splits a mass-sorted peptides file into num_shards shards of (nearly)
+   * equal size in the index directory.
+   */
+  static void Split(const string& peptides_file, const string& index, int num_shards);
+
+  static void Remove(const string& index);
+
+  /**
+   * \returns the partial results file for a shard in the output directory.
+   */
+  static string ResultFile(int shard);
+};
+
+/**
+ * Writes the partial results of searching one shard. Each row holds the
+ * scores of one of the top-match + 1 matches of a spectrum, at full
+ * precision, along with the number of candidates of its kind in the shard
+ * and the columns that do not depend on the other shards, already formatted.
+ * Targets and decoys go to the same file.
+ */
+class TideShardWriter : public TideDelimitedWriter {
+ public:
+  TideShardWriter(
+    const string& file_name,
+    int shard,
+    int num_shards
+  );
+
+  void write(const TidePsm& psm);
+};
+
+/**
+ * Merges the partial results of all shards into the tab-delimited results
+ * of an unsharded search. For each spectrum, the matches of all shards are
+ * ranked together and delta Cn, delta LCn, Sp rank and distinct matches are
+ * computed from the merged lists, the same way TideMatchSet does.
+ */
+class TideShardMerger : public TideDelimitedWriter {
+ public:
+  TideShardMerger(
+    ofstream* target_file,  ///< target (or concatenated) file, owned
+    ofstream* decoy_file,  ///< decoy file, owned, may be NULL
+    bool compute_sp
+  );
+
+  /**
+   * Merges the results files of the shards, in shard order, for the
+   * spectrum files that were searched.
+   */
+  void merge(
+    const vector<string>& spectrum_files,
+    const vector<string>& result_files
+  );
+
+  struct Match {
+    int shard;
+    int scan;
+    int charge;
+    double precursor_mz;
+    bool decoy;
+    double xcorr_score;
+    double xcorr_pval;
+    double sp_score;
+    int matched_ions;
+    int total_ions;
+    int distinct_matches;  ///< candidates of the same kind in the shard
+    string mass_columns;
+    string peptide_columns;
+  };
+
+ protected:
+  void mergeSpectrum(
+    const string& spectrum_file,
+    vector<Match*>::const_iterator begin,
+    vector<Match*>::const_iterator end
+  );
+
+  void writeList(
+    const string& spectrum_file,
+    vector<Match*>& list
+  );
+
+  bool compute_sp_;
+  int top_n_;
+};
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 2
+ * End:
+ */
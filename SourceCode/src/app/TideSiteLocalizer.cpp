@@ -0,0 +1,296 @@
+#include <cmath>
+
+#include "TideSiteLocalizer.h"
+#include "TideSearchApplication.h"
+#include "tide/mass_constants.h"
+#include "tide/max_mz.h"
+#include "tide/theoretical_peak_pair.h"
+#include "util/Params.h"
+
+const double SiteLocalizer::SCORE_SCALE = 0.1;
+const int SiteLocalizer::MAX_ISOFORMS = 1000;
+
+/**
+ * State of the enumeration for one peptide. Movable modifications are
+ * grouped by mass; placement holds the group placed on each residue, or -1.
+ */
+struct SiteLocalizer::Workspace {
+  int len;
+  const char* residues;
+  const int* cache;
+  int cache_end;  ///< bins in the cache
+  bool charge2;  ///< whether charge 2 ions are scored
+  vector<double> prefix;  ///< mass of residues before each cleavage, without movable mods
+  double total_delta;  ///< mass of the movable mods
+
+  vector<double> deltas;  ///< per group
+  vector<vector<char> > allowed;  ///< per group and residue
+  vector<vector<int> > available;  ///< per group, allowed residues from each position on
+  vector<int> remaining;  ///< per group, mods left to place
+  vector<int> placement;
+
+  vector<long long> scores;
+  vector<vector<int> > placements;
+  bool overflow;
+};
+
+SiteLocalizer::SiteLocalizer(
+  const pb::ModTable& mods,
+  const pb::ModTable& nterm_mods,
+  const pb::ModTable& cterm_mods
+) : residues_(mods.unique_deltas_size()),
+    nterm_residues_(mods.unique_deltas_size()),
+    cterm_residues_(mods.unique_deltas_size()) {
+  readResidues(mods, mods, &residues_);
+  readResidues(nterm_mods, mods, &nterm_residues_);
+  readResidues(cterm_mods, mods, &cterm_residues_);
+}
+
+/**
+ * Adds the residues of each variable modification in table to the entry of
+ * its delta, indexed like the unique deltas of mods, which the index uses
+ * for the terminal tables too.
+ */
+void SiteLocalizer::readResidues(
+  const pb::ModTable& table,
+  const pb::ModTable& mods,
+  vector<string>* residues
+) {
+  for (int i = 0; i < table.variable_mod_size(); i++) {
+    const pb::Modification& mod = table.variable_mod(i);
+    for (int j = 0; j < mods.unique_deltas_size(); j++) {
+      if (fabs(mods.unique_deltas(j) - mod.delta()) < 1e-6) {
+        (*residues)[j] += mod.amino_acids();
+        break;
+      }
+    }
+  }
+}
+
+bool SiteLocalizer::enabled() {
+  return Params::GetBool("localize-mods") && !Params::GetBool("exact-p-value") &&
+         !Params::GetBool("peptide-centric-search");
+}
+
+bool SiteLocalizer::localize(
+  const Peptide& peptide,
+  const int* cache,
+  int charge,
+  SiteLocalization* out
+) const {
+  Workspace ws;
+  ws.len = peptide.Len();
+  ws.residues = peptide.residues_;
+  ws.cache = cache;
+  ws.cache_end = MaxBin::Global().CacheBinEnd();
+  ws.charge2 = charge > 2;  // same ions as the compiled programs
+  ws.total_delta = 0;
+  ws.placement.assign(ws.len, -1);
+  ws.overflow = false;
+
+  // Residue masses as in Peptide::AddIons, with only the terminal and other
+  // unmovable modifications added.
+  vector<double> aa_masses(ws.len);
+  for (int i = 0; i < ws.len; i++) {
+    char aa = ws.residues[i];
+    if (i == 0) {
+      aa_masses[i] = MassConstants::nterm_mono_table[aa];
+    } else if (i == ws.len - 1) {
+      aa_masses[i] = MassConstants::cterm_mono_table[aa];
+    } else {
+      aa_masses[i] = MassConstants::mono_table[aa];
+    }
+  }
+  vector<int> group_of_delta(residues_.size(), -1);
+  vector<int> reported(ws.len, -1);
+  // Mods are only coded by delta, so a mod on a terminal residue whose delta
+  // a terminal mod of that residue also has is taken to be the terminal mod,
+  // once per terminus.
+  bool nterm_placed = false;
+  bool cterm_placed = false;
+  const ModCoder::Mod* mods;
+  int num_mods = peptide.Mods(&mods);
+  for (int i = 0; i < num_mods; i++) {
+    int index, delta_index;
+    MassConstants::mod_coder_.DecodeMod(mods[i], &index, &delta_index);
+    double delta = MassConstants::unique_deltas_[delta_index];
+    if (delta_index >= (int)residues_.size()) {
+      aa_masses[index] += delta;
+      continue;
+    }
+    char aa = ws.residues[index];
+    if (index == 0 && !nterm_placed &&
+        nterm_residues_[delta_index].find(aa) != string::npos) {
+      nterm_placed = true;
+      aa_masses[index] += delta;
+      continue;
+    }
+    if (index == ws.len - 1 && !cterm_placed &&
+        cterm_residues_[delta_index].find(aa) != string::npos) {
+      cterm_placed = true;
+      aa_masses[index] += delta;
+      continue;
+    }
+    if (reported[index] >= 0 || residues_[delta_index].find(aa) == string::npos) {
+      aa_masses[index] += delta;
+      continue;
+    }
+    int group = group_of_delta[delta_index];
+    if (group < 0) {
+      group = group_of_delta[delta_index] = ws.deltas.size();
+      ws.deltas.push_back(delta);
+      ws.allowed.push_back(vector<char>(ws.len, 0));
+      ws.remaining.push_back(0);
+      for (int j = 0; j < ws.len; j++) {
+        ws.allowed[group][j] = residues_[delta_index].find(ws.residues[j]) != string::npos;
+      }
+    }
+    ws.remaining[group]++;
+    ws.total_delta += delta;
+    reported[index] = group;
+  }
+  if (ws.deltas.empty()) {
+    return false;
+  }
+
+  ws.prefix.assign(ws.len + 1, 0);
+  for (int i = 0; i < ws.len; i++) {
+    ws.prefix[i + 1] = ws.prefix[i] + aa_masses[i];
+  }
+  ws.available.assign(ws.deltas.size(), vector<int>(ws.len + 1, 0));
+  for (size_t g = 0; g < ws.deltas.size(); g++) {
+    for (int i = ws.len - 1; i >= 0; i--) {
+      ws.available[g][i] = ws.available[g][i + 1] + ws.allowed[g][i];
+    }
+  }
+
+  place(&ws, 0, 0, 0);
+  if (ws.overflow) {
+    return false;
+  }
+
+  int num_isoforms = ws.scores.size();
+  long long max_score = ws.scores[0];
+  long long reported_score = 0;
+  long long best_other = 0;
+  bool has_other = false;
+  for (int k = 0; k < num_isoforms; k++) {
+    max_score = max(max_score, ws.scores[k]);
+    if (ws.placements[k] == reported) {
+      reported_score = ws.scores[k];
+    } else if (!has_other || ws.scores[k] > best_other) {
+      best_other = ws.scores[k];
+      has_other = true;
+    }
+  }
+
+  vector<double> weights(num_isoforms);
+  double total_weight = 0;
+  for (int k = 0; k < num_isoforms; k++) {
+    double diff = (ws.scores[k] - max_score) / TideSearchApplication::XCORR_SCALING;
+    weights[k] = exp(diff / SCORE_SCALE);
+    total_weight += weights[k];
+  }
+
+  out->num_isoforms = num_isoforms;
+  out->score = has_other ?
+    (reported_score - best_other) / TideSearchApplication::XCORR_SCALING : 0;
+  out->sites.clear();
+  for (int i = 0; i < ws.len; i++) {
+    for (size_t g = 0; g < ws.deltas.size(); g++) {
+      if (!ws.allowed[g][i]) {
+        continue;
+      }
+      SiteProbability site;
+      site.pos = i;
+      site.residue = ws.residues[i];
+      site.delta = ws.deltas[g];
+      site.probability = 0;
+      for (int k = 0; k < num_isoforms; k++) {
+        if (ws.placements[k][i] == (int)g) {
+          site.probability += weights[k];
+        }
+      }
+      site.probability /= total_weight;
+      out->sites.push_back(site);
+    }
+  }
+  return true;
+}
+
+/**
+ * Decides whether a movable modification goes on residue pos, given the
+ * mass delta of those placed before it, then scores the cleavage after the
+ * residue and continues with the next one.
+ */
+void SiteLocalizer::place(Workspace* ws, int pos, double delta, long long score) const {
+  if (ws->overflow) {
+    return;
+  }
+  size_t num_groups = ws->deltas.size();
+  if (pos == ws->len) {
+    for (size_t g = 0; g < num_groups; g++) {
+      if (ws->remaining[g] > 0) {
+        return;
+      }
+    }
+    if ((int)ws->scores.size() >= MAX_ISOFORMS) {
+      ws->overflow = true;
+      return;
+    }
+    ws->scores.push_back(score);
+    ws->placements.push_back(ws->placement);
+    return;
+  }
+  for (size_t g = 0; g < num_groups; g++) {
+    if (ws->remaining[g] > ws->available[g][pos]) {
+      return;
+    }
+  }
+
+  bool last = pos + 1 == ws->len;
+  place(ws, pos + 1, delta, last ? score : score + scoreCleavage(*ws, pos + 1, delta));
+  for (size_t g = 0; g < num_groups; g++) {
+    if (ws->remaining[g] == 0 || !ws->allowed[g][pos]) {
+      continue;
+    }
+    double placed = delta + ws->deltas[g];
+    ws->remaining[g]--;
+    ws->placement[pos] = g;
+    place(ws, pos + 1, placed, last ? score : score + scoreCleavage(*ws, pos + 1, placed));
+    ws->placement[pos] = -1;
+    ws->remaining[g]++;
+  }
+}
+
+/**
+ * Sums the cache entries of the b and y ions of a cleavage, where delta is
+ * the mass of the movable modifications on the b ion side.
+ */
+long long SiteLocalizer::scoreCleavage(const Workspace& ws, int cleavage, double delta) const {
+  double b_mass = ws.prefix[cleavage] + delta + MassConstants::B + MassConstants::proton;
+  double y_mass = ws.prefix[ws.len] - ws.prefix[cleavage] + ws.total_delta - delta +
+                  MassConstants::Y + MassConstants::proton;
+  int max_charge = ws.charge2 ? 2 : 1;
+  long long score = 0;
+  for (int charge = 1; charge <= max_charge; charge++) {
+    int b_bin = MassConstants::mass2bin(b_mass, charge);
+    int y_bin = MassConstants::mass2bin(y_mass, charge);
+    int b_type = charge == 1 ? PeakCombinedB1 : PeakCombinedB2;
+    int y_type = charge == 1 ? PeakCombinedY1 : PeakCombinedY2;
+    if (b_bin < ws.cache_end) {
+      score += ws.cache[b_bin * NUM_PEAK_TYPES + b_type];
+    }
+    if (y_bin < ws.cache_end) {
+      score += ws.cache[y_bin * NUM_PEAK_TYPES + y_type];
+    }
+  }
+  return score;
+}
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 2
+ * End:
+ */
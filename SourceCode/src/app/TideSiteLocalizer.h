@@ -0,0 +1,107 @@
+#ifndef TIDE_SITE_LOCALIZER_H
+#define TIDE_SITE_LOCALIZER_H
+
+#include <string>
+#include <vector>
+
+#include "header.pb.h"
+#include "tide/peptide.h"
+
+using namespace std;
+
+/**
+ * Probability that one of the candidate residues carries a modification.
+ */
+struct SiteProbability {
+  int pos;  ///< 0-based position in the peptide
+  char residue;
+  double delta;
+  double probability;
+};
+
+/**
+ * Result of localizing the variable modifications of a PSM.
+ */
+struct SiteLocalization {
+  int num_isoforms;  ///< placements scored, including the reported one
+  double score;  ///< XCorr of the reported placement minus the best other one
+  vector<SiteProbability> sites;  ///< every candidate site, by position
+};
+
+/**
+ * Scores the positional isoforms of a matched peptide: the peptides with the
+ * same residues and the same variable modifications on other residues that
+ * may carry them. Terminal modifications stay where they are.
+ *
+ * The isoforms are enumerated depth-first along the peptide, placing or not
+ * placing a modification on each residue in turn. The b and y ions of a
+ * cleavage only depend on the modifications placed before it, so each ion is
+ * scored once for all isoforms that share the placements up to it, and only
+ * the ladder segments after a moved site are rescored. Ions are scored
+ * against the same XCorr cache as the search, but without the
+ * de-duplication of coinciding peaks that the compiled programs do, so
+ * isoform scores can differ slightly from the reported XCorr.
+ *
+ * Isoform probabilities are proportional to exp(XCorr / SCORE_SCALE), and a
+ * site's probability is the sum of the probabilities of the isoforms that
+ * place the modification on it.
+ */
+class SiteLocalizer {
+ public:
+  /**
+   * Reads which residues each variable modification applies to, and which
+   * residues the peptide N- and C-terminal variable modifications apply to.
+   * MassConstants has to be initialized with the same tables.
+   */
+  SiteLocalizer(
+    const pb::ModTable& mods,
+    const pb::ModTable& nterm_mods,
+    const pb::ModTable& cterm_mods
+  );
+
+  /**
+   * \returns whether tide-search localizes modifications.
+   */
+  static bool enabled();
+
+  /**
+   * Localizes the variable modifications of peptide against an XCorr cache,
+   * as computed by ObservedPeakSet for the spectrum at charge.
+   * \returns false if the peptide has no modifications that can move, or too
+   * many isoforms to score.
+   */
+  bool localize(
+    const Peptide& peptide,
+    const int* cache,
+    int charge,
+    SiteLocalization* out
+  ) const;
+
+  static const double SCORE_SCALE;
+  static const int MAX_ISOFORMS;
+
+ protected:
+  struct Workspace;
+
+  void place(Workspace* ws, int pos, double delta, long long score) const;
+  long long scoreCleavage(const Workspace& ws, int cleavage, double delta) const;
+
+  static void readResidues(
+    const pb::ModTable& table,
+    const pb::ModTable& mods,
+    vector<string>* residues
+  );
+
+  vector<string> residues_;  ///< residues for each unique delta, by index
+  vector<string> nterm_residues_;  ///< the same for N-terminal mods
+  vector<string> cterm_residues_;  ///< the same for C-terminal mods
+};
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 2
+ * End:
+ */
@@ -2685,6 +2685,14 @@ int Barista :: crux_set_command_line_options(int argc, char *argv[])
 	  }
 	set_input_dir(output_directory);
 	set_output_dir(output_directory);
+	//the tables only need to reach disk if they outlive the run
+	if(skip_cleanup_flag != 1)
+	  {
+	    parser->set_table_store(&tables);
+	    qr.set_table_store(&tables);
+	    pr.set_table_store(&tables);
+	    set_table_store(&tables);
+	  }
 	            
         if(!parser->set_database_source(db_source))
 	  carp(CARP_FATAL, "could not find the database");
@@ -120,6 +120,7 @@ class Barista : public CruxApplication
 
   inline void set_input_dir(string input_dir) {in_dir = input_dir; d.set_input_dir(input_dir);}
   inline void set_output_dir(string output_dir){out_dir = output_dir;}
+  inline void set_table_store(TableStore* store){d.set_table_store(store);}
 
   /* CruxApplication Methods */
   virtual int main(int argc, char** argv);
@@ -139,6 +140,8 @@ class Barista : public CruxApplication
   string file_extension(string str); 
  protected:
   SQTParser* parser;
+  //parser tables handed to the datasets without a round trip through out_dir
+  TableStore tables;
   int verbose;
   int skip_cleanup_flag;
   int overwrite_flag;
@@ -46,7 +46,7 @@ void BipartiteGraph::create_bipartite_graph(map<int, set<int> > data)
 }
 
 
-void BipartiteGraph::save(ofstream &os)
+void BipartiteGraph::save(ostream &os)
 {
   os.write((char*)(&nranges),sizeof(int));
   os.write((char*)(&nindices),sizeof(int));
@@ -54,7 +54,7 @@ void BipartiteGraph::save(ofstream &os)
   os.write((char*)indices,sizeof(int)*nindices);
 }
 
-void BipartiteGraph::load(ifstream &is)
+void BipartiteGraph::load(istream &is)
 {
   is.read((char*)(&nranges),sizeof(int));
   is.read((char*)(&nindices),sizeof(int));
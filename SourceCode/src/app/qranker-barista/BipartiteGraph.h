@@ -25,8 +25,8 @@ class BipartiteGraph{
   int get_range_length(int r){return ranges[r].len;}
   int* get_range_indices(int r){return (indices+ranges[r].p);}
 
-  void save(ofstream &os);
-  void load(ifstream &is);
+  void save(ostream &os);
+  void load(istream &is);
  private:
   int nranges; //how many ranges
   int nindices; //size of the index array
@@ -7,6 +7,7 @@
 #include "CruxParser.h"
 #include "model/Peptide.h"
 #include "io/MatchFileReader.h"
+#include "io/BinaryMatchFile.h"
 #include "model/PeptideSrc.h"
 #include "model/Match.h"
 #include "io/MatchColumns.h"
@@ -19,8 +20,8 @@ using namespace std;
 /**
  * Default constructor
  */
-CruxParser :: CruxParser() 
-  : SQTParser(){
+CruxParser :: CruxParser(const string& extension) 
+  : SQTParser(), extension_(extension){
 }
 
 /**
@@ -31,12 +32,13 @@ CruxParser :: ~CruxParser(){
 
  
 /**
- * Parse tab delimited file.
+ * Parse tab delimited or binary match file.
  * Generates the same QRanker internal tables.
- * Set the matches in the tab delimited file. 
+ * Set the matches in the file. 
  */
+template<class Reader>
 void CruxParser ::readMatches(
-  MatchFileReader& reader, ///< Reader for the delimited file.
+  Reader& reader, ///< Reader for the delimited or binary file.
   int final_hits,  ///< Total number of matches
   enzyme enz, ///< Enzyme used in search
   bool decoy ///< Are all the matches decoy?
@@ -148,6 +150,15 @@ bool CruxParser :: read_search_results(
   bool decoy ///< is this a file of decoys?
   ) {
 
+  if (BinaryMatchFile::isBinaryMatchFile(cur_fname)) {
+    BinaryMatchFileReader reader(cur_fname, NULL);
+    if (!reader.read()) {
+      return false;
+    }
+    readMatches(reader, fhps, e, decoy);
+    return true;
+  }
+
   //read file 
   MatchFileReader reader(cur_fname);
 
@@ -163,10 +174,10 @@ bool CruxParser :: read_search_results(
 }
 
 /**
- *\returns txt file extension  
+ *\returns extension of the search result files  
  */
 std::string CruxParser::get_parser_extension() {
-  return ".txt";
+  return extension_;
 }
 
 /*
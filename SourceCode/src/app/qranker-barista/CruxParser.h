@@ -34,17 +34,22 @@ using namespace std;
 class CruxParser:public SQTParser{
  public:
 
-  CruxParser();
+  /**
+   * extension is that of the search result files, .txt or the binary
+   * match file extension.
+   */
+  CruxParser(const string& extension = ".txt");
   virtual ~CruxParser();
 
  
 /**
- * Parse tab delimited file.
+ * Parse tab delimited or binary match file.
  * Generates the same QRanker internal tables.
- * Set the matches in the tab delimited file. 
+ * Set the matches in the file. 
  */
+  template<class Reader>
   void readMatches(
-    MatchFileReader& reader,///<Reader for the delimted file.
+    Reader& reader,///<Reader for the delimted or binary file.
     int final_hits,///<Total number of matches
     enzyme enz, ///<Enzyme in used on search 
     bool decoy ///< Are all the matches decoy?
@@ -62,6 +67,7 @@ class CruxParser:public SQTParser{
 
 
  protected:
+  string extension_;
   ofstream f_pepind2flanking_aa;
   ofstream f_psmind2xcorr_rank;
   ofstream f_psmind2match_spectrum;
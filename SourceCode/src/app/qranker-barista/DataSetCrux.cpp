@@ -21,7 +21,8 @@ Dataset::Dataset()
     psmind_to_matches_spectrum((int*)0),
     psmind_to_by_ions_matched((double*)0),
     psmind_to_by_ions_total((double*)0),
-    psmind_to_peptide_position((int*)0)
+    psmind_to_peptide_position((int*)0),
+    table_store((TableStore*)0)
 {
 }
 
@@ -59,12 +60,26 @@ Dataset::~Dataset()
 
 /****************************************************************************/
 
+//frees a table the parser handed over in memory once it has been read
+//for the last time
+void Dataset :: release_table(const string &name)
+{
+  if(table_store)
+    table_store->remove(name);
+}
+
+void Dataset :: release_tables()
+{
+  if(table_store)
+    table_store->clear();
+}
+
 void Dataset :: load_data_psm_training()
 {
 
   ostringstream fname;
   fname << in_dir << "/summary";
-  ifstream f_summary(fname.str().c_str());
+  TableIStream f_summary(fname.str(), table_store, ios::in);
   f_summary >> num_features;
   f_summary >> num_psms;
   f_summary >> num_pos_psms;
@@ -74,7 +89,7 @@ void Dataset :: load_data_psm_training()
 
   //psm features
   fname << in_dir << "/" << "psm";
-  ifstream f_psm_feat(fname.str().c_str(),ios::binary);
+  TableIStream f_psm_feat(fname.str(), table_store);
   if(!f_psm_feat.is_open())
     {
       cout << "could not open file " << fname.str() <<  " for reading data\n";
@@ -83,6 +98,7 @@ void Dataset :: load_data_psm_training()
   psmind_to_features = new double[num_psms*num_features];
   f_psm_feat.read((char*)psmind_to_features,sizeof(double)*num_psms*num_features);
   f_psm_feat.close();
+  release_table(fname.str());
   fname.str("");
 }
 
@@ -95,7 +111,7 @@ void Dataset :: load_labels_psm_training()
 {
   ostringstream fname;
   fname << in_dir << "/summary";
-  ifstream f_summary(fname.str().c_str());
+  TableIStream f_summary(fname.str(), table_store, ios::in);
   f_summary >> num_features;
   f_summary >> num_psms;
   f_summary >> num_pos_psms;
@@ -105,7 +121,7 @@ void Dataset :: load_labels_psm_training()
 
   //psmind_to_label
   fname << in_dir << "/psmind_to_label";
-  ifstream f_psmind_to_label(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_label(fname.str(), table_store);
   psmind_to_label = new int[num_psms];
   f_psmind_to_label.read((char*)psmind_to_label,sizeof(int)*num_psms);
   f_psmind_to_label.close();
@@ -122,7 +138,7 @@ void Dataset :: load_data_psm_results()
 
   ostringstream fname;
   fname << in_dir << "/summary";
-  ifstream f_summary(fname.str().c_str());
+  TableIStream f_summary(fname.str(), table_store, ios::in);
   f_summary >> num_features;
   f_summary >> num_psms;
   f_summary >> num_pos_psms;
@@ -132,7 +148,7 @@ void Dataset :: load_data_psm_results()
 
   //psmind_to_pepind
   fname << in_dir << "/psmind_to_pepind";
-  ifstream f_psmind_to_pepind(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_pepind(fname.str(), table_store);
   if(!f_psmind_to_pepind.is_open())
     {
       cout << "could not open file " << fname.str() <<  " for reading data\n";
@@ -145,7 +161,7 @@ void Dataset :: load_data_psm_results()
   
   //psmind_to_scan
   fname << in_dir << "/psmind_to_scan";
-  ifstream f_psmind_to_scan(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_scan(fname.str(), table_store);
   if(!f_psmind_to_scan.is_open())
     {
       cout << "could not open file " << fname.str() <<  " for reading data\n";
@@ -158,7 +174,7 @@ void Dataset :: load_data_psm_results()
 
   //psmind_to_charge
   fname << in_dir << "/psmind_to_charge";
-  ifstream f_psmind_to_charge(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_charge(fname.str(), table_store);
   if(!f_psmind_to_charge.is_open())
     {
       cout << "could not open file " << fname.str() <<  " for reading data\n";
@@ -171,7 +187,7 @@ void Dataset :: load_data_psm_results()
 
   //psmind_to_xcorr
   fname << in_dir << "/psmind_to_xcorr";
-  ifstream f_psmind_to_xcorr(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_xcorr(fname.str(), table_store);
   if(!f_psmind_to_xcorr.is_open())
     {
       cout << "could not open file " << fname.str() <<  " for reading data\n";
@@ -184,7 +200,7 @@ void Dataset :: load_data_psm_results()
 
   //psmind_to_deltaCn
   fname << in_dir << "/psmind_to_deltaCn";
-  ifstream f_psmind_to_deltaCn(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_deltaCn(fname.str(), table_store);
   if(!f_psmind_to_deltaCn.is_open())
     {
       cout << "could not open file " << fname.str() <<  " for reading data\n";
@@ -197,7 +213,7 @@ void Dataset :: load_data_psm_results()
   
   //psmind_to_spscore
   fname << in_dir << "/psmind_to_spscore";
-  ifstream f_psmind_to_spscore(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_spscore(fname.str(), table_store);
   if(!f_psmind_to_spscore.is_open())
     {
       cout << "could not open file " << fname.str() <<  " for reading data\n";
@@ -210,7 +226,7 @@ void Dataset :: load_data_psm_results()
 
   //psmind_to_calculated_mass
   fname << in_dir << "/psmind_to_calculated_mass";
-  ifstream f_psmind_to_calculated_mass(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_calculated_mass(fname.str(), table_store);
   if(!f_psmind_to_calculated_mass.is_open())
     {
       cout << "could not open file " << fname.str() <<  " for reading data\n";
@@ -223,7 +239,7 @@ void Dataset :: load_data_psm_results()
 
   //psmind_to_precursor_mass
   fname << in_dir << "/psmind_to_precursor_mass";
-  ifstream f_psmind_to_precursor_mass(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_precursor_mass(fname.str(), table_store);
   if(!f_psmind_to_precursor_mass.is_open())
     {
       cout << "could not open file " << fname.str() <<  " for reading data\n";
@@ -236,7 +252,7 @@ void Dataset :: load_data_psm_results()
   
   //fileind_to_fname
   fname << in_dir << "/fileind_to_fname";
-  ifstream f_fileind_to_fname(fname.str().c_str(),ios::binary);
+  TableIStream f_fileind_to_fname(fname.str(), table_store);
   if(!f_fileind_to_fname.is_open())
     {
       cout << "could not open file " << fname.str() <<  " for reading data\n";
@@ -257,7 +273,7 @@ void Dataset :: load_data_psm_results()
   
   //psmind_to_filename
   fname << in_dir << "/psmind_to_fileind";
-  ifstream f_psmind_to_fileind(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_fileind(fname.str(), table_store);
   if(!f_psmind_to_fileind.is_open())
     {
       cout << "could not open file " << fname.str() <<  " for reading data\n";
@@ -270,7 +286,7 @@ void Dataset :: load_data_psm_results()
 
   //ind_to_pep
   fname << in_dir << "/ind_to_pep";
-  ifstream f_ind_to_pep(fname.str().c_str(),ios::binary);
+  TableIStream f_ind_to_pep(fname.str(), table_store);
   string pep;
   f_ind_to_pep >> ind;
   f_ind_to_pep >> pep;
@@ -285,7 +301,7 @@ void Dataset :: load_data_psm_results()
 
   //ind_to_prot
   fname << in_dir << "/ind_to_prot";
-  ifstream f_ind_to_prot(fname.str().c_str(),ios::binary);
+  TableIStream f_ind_to_prot(fname.str(), table_store);
  
   string prot;
   f_ind_to_prot >> ind;
@@ -301,7 +317,7 @@ void Dataset :: load_data_psm_results()
 
   //pepind_to_protinds
   fname << in_dir << "/pepind_to_protinds";
-  ifstream f_pepind_to_protinds(fname.str().c_str(),ios::binary);
+  TableIStream f_pepind_to_protinds(fname.str(), table_store);
   if(!f_pepind_to_protinds.is_open())
     {
       cout << "could not open file " << fname.str() <<  " for reading data\n";
@@ -313,7 +329,7 @@ void Dataset :: load_data_psm_results()
   
   //psmind_to_Sp_rank 
   fname << in_dir << "/psmind_to_sp_rank";
-  ifstream f_psmind_to_sp_rank(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_sp_rank(fname.str(), table_store);
   if(!f_psmind_to_sp_rank.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -326,7 +342,7 @@ void Dataset :: load_data_psm_results()
 
   //psmind_to_xcorr_rank 
   fname << in_dir << "/psmind_to_xcorr_rank";
-  ifstream f_psmind_to_xcorr_rank(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_xcorr_rank(fname.str(), table_store);
   if(!f_psmind_to_xcorr_rank.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -338,7 +354,7 @@ void Dataset :: load_data_psm_results()
 
   //psmind_to_by_ions_matched 
   fname << in_dir << "/psmind_to_by_ions_matched";
-  ifstream f_psmind_to_by_ions_matched(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_by_ions_matched(fname.str(), table_store);
   if(!f_psmind_to_by_ions_matched.is_open()){ 
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -350,7 +366,7 @@ void Dataset :: load_data_psm_results()
 
   //psmind_to_by_ions_total 
   fname << in_dir << "/psmind_to_by_ions_total";
-  ifstream f_psmind_to_by_ions_total(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_by_ions_total(fname.str(), table_store);
   if(!f_psmind_to_by_ions_total.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -362,7 +378,7 @@ void Dataset :: load_data_psm_results()
   
   //psmind_to_matches_spectrum 
   fname << in_dir << "/psmind_to_matches_spectrum";
-  ifstream f_psmind_to_matches_spectrum(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_matches_spectrum(fname.str(), table_store);
   if(!f_psmind_to_matches_spectrum.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -374,7 +390,7 @@ void Dataset :: load_data_psm_results()
   
   //psmind_to_peptide_position 
   fname << in_dir << "/psmind_to_peptide_position";
-  ifstream f_psmind_to_peptide_position(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_peptide_position(fname.str(), table_store);
   if(!f_psmind_to_peptide_position.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -383,6 +399,8 @@ void Dataset :: load_data_psm_results()
   f_psmind_to_peptide_position.read((char*)psmind_to_peptide_position,sizeof(int)*num_psms);
   f_psmind_to_peptide_position.close();
   fname.str("");
+  //nothing is read after the results
+  release_tables();
 
 }
 
@@ -422,7 +440,7 @@ void Dataset :: load_data_prot_training()
 
   ostringstream fname;
   fname << in_dir << "/summary";
-  ifstream f_summary(fname.str().c_str());
+  TableIStream f_summary(fname.str(), table_store, ios::in);
   if(!f_summary.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -442,7 +460,7 @@ void Dataset :: load_data_prot_training()
   
   //psm features
   fname << in_dir << "/" << "psm";
-  ifstream f_psm_feat(fname.str().c_str(),ios::binary);
+  TableIStream f_psm_feat(fname.str(), table_store);
   if(!f_psm_feat.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -450,23 +468,25 @@ void Dataset :: load_data_prot_training()
   psmind_to_features = new double[num_psms*num_features];
   f_psm_feat.read((char*)psmind_to_features,sizeof(double)*num_psms*num_features);
   f_psm_feat.close();
+  release_table(fname.str());
   fname.str("");
 
 
   //pepind_to_psminds
   fname << in_dir << "/pepind_to_psminds";
-  ifstream f_pepind_to_psminds(fname.str().c_str(),ios::binary);
+  TableIStream f_pepind_to_psminds(fname.str(), table_store);
   if(!f_pepind_to_psminds.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
   }
   pepind_to_psminds.load(f_pepind_to_psminds);
   f_pepind_to_psminds.close();
+  release_table(fname.str());
   fname.str("");
   
   //protind_to_num_all_pep
   fname << in_dir << "/protind_to_num_all_pep";
-  ifstream f_protind_to_num_all_pep(fname.str().c_str(),ios::binary);
+  TableIStream f_protind_to_num_all_pep(fname.str(), table_store);
   if(!f_protind_to_num_all_pep.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -474,11 +494,12 @@ void Dataset :: load_data_prot_training()
   protind_to_num_all_pep = new int[num_prot];
   f_protind_to_num_all_pep.read((char*)protind_to_num_all_pep,sizeof(int)*num_prot);
   f_protind_to_num_all_pep.close();
+  release_table(fname.str());
   fname.str("");
 
   //protind_to_pepinds
   fname << in_dir << "/protind_to_pepinds";
-  ifstream f_protind_to_pepinds(fname.str().c_str(),ios::binary);
+  TableIStream f_protind_to_pepinds(fname.str(), table_store);
   if(!f_protind_to_pepinds.is_open())
     {
       cout << "could not open file " << fname.str() <<  " for reading data\n";
@@ -486,11 +507,12 @@ void Dataset :: load_data_prot_training()
     }
   protind_to_pepinds.load(f_protind_to_pepinds);
   f_protind_to_pepinds.close();
+  release_table(fname.str());
   fname.str("");
 
   //pepind_to_protinds
   fname << in_dir << "/pepind_to_protinds";
-  ifstream f_pepind_to_protinds(fname.str().c_str(),ios::binary);
+  TableIStream f_pepind_to_protinds(fname.str(), table_store);
   if(!f_pepind_to_protinds.is_open())
     {
       cout << "could not open file " << fname.str() <<  " for reading data\n";
@@ -513,7 +535,7 @@ void Dataset :: load_labels_prot_training()
 
   ostringstream fname;
   fname << in_dir << "/summary";
-  ifstream f_summary(fname.str().c_str());
+  TableIStream f_summary(fname.str(), table_store, ios::in);
   if(!f_summary.is_open())
     {
       cout << "could not open file " << fname.str() <<  " for reading data\n";
@@ -534,7 +556,7 @@ void Dataset :: load_labels_prot_training()
 
   //psmind_to_label
   fname << in_dir << "/psmind_to_label";
-  ifstream f_psmind_to_label(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_label(fname.str(), table_store);
   if(!f_psmind_to_label.is_open())
     {
       cout << "could not open file " << fname.str() <<  " for reading data\n";
@@ -547,7 +569,7 @@ void Dataset :: load_labels_prot_training()
   
   //pepind_to_label
   fname << in_dir << "/pepind_to_label";
-  ifstream f_pepind_to_label(fname.str().c_str(),ios::binary);
+  TableIStream f_pepind_to_label(fname.str(), table_store);
   if(!f_pepind_to_label.is_open())
     {
       cout << "could not open file " << fname.str() <<  " for reading data\n";
@@ -560,7 +582,7 @@ void Dataset :: load_labels_prot_training()
   
   //protind_to_label
   fname << in_dir << "/protind_to_label";
-  ifstream f_protind_to_label(fname.str().c_str(),ios::binary);
+  TableIStream f_protind_to_label(fname.str(), table_store);
   if(!f_protind_to_label.is_open())
     {
       cout << "could not open file " << fname.str() <<  " for reading data\n";
@@ -573,7 +595,7 @@ void Dataset :: load_labels_prot_training()
 
   //ind_to_pep
   fname << in_dir << "/ind_to_pep";
-  ifstream f_ind_to_pep(fname.str().c_str(),ios::binary);
+  TableIStream f_ind_to_pep(fname.str(), table_store);
   int ind;
   string pep;
   f_ind_to_pep >> ind;
@@ -604,7 +626,7 @@ void Dataset :: load_data_all_results(){
 
   //ind_to_pep
   fname << in_dir << "/ind_to_pep";
-  ifstream f_ind_to_pep(fname.str().c_str(),ios::binary);
+  TableIStream f_ind_to_pep(fname.str(), table_store);
   int ind;
   string pep;
   f_ind_to_pep >> ind;
@@ -619,7 +641,7 @@ void Dataset :: load_data_all_results(){
 
   //ind_to_prot
   fname << in_dir << "/ind_to_prot";
-  ifstream f_ind_to_prot(fname.str().c_str(),ios::binary);
+  TableIStream f_ind_to_prot(fname.str(), table_store);
  
   string prot;
   f_ind_to_prot >> ind;
@@ -634,7 +656,7 @@ void Dataset :: load_data_all_results(){
 
   //protind_to_length
   fname << in_dir << "/protind_to_length";
-  ifstream f_protind_to_length(fname.str().c_str(),ios::binary);
+  TableIStream f_protind_to_length(fname.str(), table_store);
   if(!f_protind_to_length.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -647,7 +669,7 @@ void Dataset :: load_data_all_results(){
 
   //protind_to_label
   fname << in_dir << "/protind_to_label";
-  ifstream f_protind_to_label(fname.str().c_str(),ios::binary);
+  TableIStream f_protind_to_label(fname.str(), table_store);
   if(!f_protind_to_label.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -661,7 +683,7 @@ void Dataset :: load_data_all_results(){
 
   //psmind_to_pepind
   fname << in_dir << "/psmind_to_pepind";
-  ifstream f_psmind_to_pepind(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_pepind(fname.str(), table_store);
   if(!f_psmind_to_pepind.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -673,7 +695,7 @@ void Dataset :: load_data_all_results(){
   
   //psmind_to_scan
   fname << in_dir << "/psmind_to_scan";
-  ifstream f_psmind_to_scan(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_scan(fname.str(), table_store);
   if(!f_psmind_to_scan.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -685,7 +707,7 @@ void Dataset :: load_data_all_results(){
 
   //psmind_to_charge
   fname << in_dir << "/psmind_to_charge";
-  ifstream f_psmind_to_charge(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_charge(fname.str(), table_store);
   if(!f_psmind_to_charge.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -697,7 +719,7 @@ void Dataset :: load_data_all_results(){
 
   //psmind_to_xcorr
   fname << in_dir << "/psmind_to_xcorr";
-  ifstream f_psmind_to_xcorr(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_xcorr(fname.str(), table_store);
   if(!f_psmind_to_xcorr.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -709,7 +731,7 @@ void Dataset :: load_data_all_results(){
 
   //psmind_to_deltaCn
   fname << in_dir << "/psmind_to_deltaCn";
-  ifstream f_psmind_to_deltaCn(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_deltaCn(fname.str(), table_store);
   if(!f_psmind_to_deltaCn.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -721,7 +743,7 @@ void Dataset :: load_data_all_results(){
   
   //psmind_to_sp_score
   fname << in_dir << "/psmind_to_spscore";
-  ifstream f_psmind_to_spscore(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_spscore(fname.str(), table_store);
   if(!f_psmind_to_spscore.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -733,7 +755,7 @@ void Dataset :: load_data_all_results(){
 
   //psmind_to_calculated_mass
   fname << in_dir << "/psmind_to_calculated_mass";
-  ifstream f_psmind_to_calculated_mass(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_calculated_mass(fname.str(), table_store);
   if(!f_psmind_to_calculated_mass.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -745,7 +767,7 @@ void Dataset :: load_data_all_results(){
 
   //psmind_to_precursor_mass
   fname << in_dir << "/psmind_to_precursor_mass";
-  ifstream f_psmind_to_precursor_mass(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_precursor_mass(fname.str(), table_store);
   if(!f_psmind_to_precursor_mass.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -757,7 +779,7 @@ void Dataset :: load_data_all_results(){
   
   //fileind_to_fname
   fname << in_dir << "/fileind_to_fname";
-  ifstream f_fileind_to_fname(fname.str().c_str(),ios::binary);
+  TableIStream f_fileind_to_fname(fname.str(), table_store);
   if(!f_fileind_to_fname.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -776,7 +798,7 @@ void Dataset :: load_data_all_results(){
   
   //psmind_to_filename
   fname << in_dir << "/psmind_to_fileind";
-  ifstream f_psmind_to_fileind(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_fileind(fname.str(), table_store);
   if(!f_psmind_to_fileind.is_open())
     {
       cout << "could not open file " << fname.str() <<  " for reading data\n";
@@ -789,7 +811,7 @@ void Dataset :: load_data_all_results(){
 
   //psmind_to_sp_rank
   fname << in_dir << "/psmind_to_sp_rank";
-  ifstream f_psmind_to_sp_rank(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_sp_rank(fname.str(), table_store);
   if(!f_psmind_to_sp_rank.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -801,7 +823,7 @@ void Dataset :: load_data_all_results(){
   
   //psmind_to_xcorr_rank
   fname << in_dir << "/psmind_to_xcorr_rank";
-  ifstream f_psmind_to_xcorr_rank(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_xcorr_rank(fname.str(), table_store);
   if(!f_psmind_to_xcorr_rank.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -813,7 +835,7 @@ void Dataset :: load_data_all_results(){
     
   //psmind_to_match_spectrum
   fname << in_dir << "/psmind_to_matches_spectrum";
-  ifstream f_psmind_to_matches_spectrum(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_matches_spectrum(fname.str(), table_store);
   if(!f_psmind_to_matches_spectrum.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -825,7 +847,7 @@ void Dataset :: load_data_all_results(){
    
   //psmind_to_by_ions_matched
   fname << in_dir << "/psmind_to_by_ions_matched";
-  ifstream f_psmind_to_by_ions_matched(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_by_ions_matched(fname.str(), table_store);
   if(!f_psmind_to_by_ions_matched.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -837,7 +859,7 @@ void Dataset :: load_data_all_results(){
  
   //psmind_to_by_ions_total
   fname << in_dir << "/psmind_to_by_ions_total";
-  ifstream f_psmind_to_by_ions_total(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_by_ions_total(fname.str(), table_store);
   if(!f_psmind_to_by_ions_total.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -849,7 +871,7 @@ void Dataset :: load_data_all_results(){
   
   //psmind_to_peptide_position
   fname << in_dir << "/psmind_to_peptide_position";
-  ifstream f_psmind_to_peptide_position(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_peptide_position(fname.str(), table_store);
   if(!f_psmind_to_peptide_position.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -858,6 +880,8 @@ void Dataset :: load_data_all_results(){
   f_psmind_to_peptide_position.read((char*)psmind_to_peptide_position,sizeof(int)*num_psms);
   f_psmind_to_peptide_position.close();
   fname.str("");
+  //nothing is read after the results
+  release_tables();
 }
 
 void Dataset :: clear_data_all_results()
@@ -918,7 +942,7 @@ int Dataset :: print_features(string &filename)
   ostringstream fname;
   //psmind_to_label
   fname << in_dir << "/psmind_to_label";
-  ifstream f_psmind_to_label(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_label(fname.str(), table_store);
   psmind_to_label = new int[num_psms];
   f_psmind_to_label.read((char*)psmind_to_label,sizeof(int)*num_psms);
   f_psmind_to_label.close();
@@ -926,7 +950,7 @@ int Dataset :: print_features(string &filename)
   
   //psmind_to_scan
   fname << in_dir << "/psmind_to_scan";
-  ifstream f_psmind_to_scan(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_scan(fname.str(), table_store);
   psmind_to_scan = new int[num_psms];
   f_psmind_to_scan.read((char*)psmind_to_scan,sizeof(int)*num_psms);
   f_psmind_to_scan.close();
@@ -958,7 +982,7 @@ void Dataset :: load_data_pep_training()
 
   ostringstream fname;
   fname << in_dir << "/summary";
-  ifstream f_summary(fname.str().c_str());
+  TableIStream f_summary(fname.str(), table_store, ios::in);
   if(!f_summary.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -978,7 +1002,7 @@ void Dataset :: load_data_pep_training()
   
   //psm features
   fname << in_dir << "/" << "psm";
-  ifstream f_psm_feat(fname.str().c_str(),ios::binary);
+  TableIStream f_psm_feat(fname.str(), table_store);
   if(!f_psm_feat.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -986,18 +1010,20 @@ void Dataset :: load_data_pep_training()
   psmind_to_features = new double[num_psms*num_features];
   f_psm_feat.read((char*)psmind_to_features,sizeof(double)*num_psms*num_features);
   f_psm_feat.close();
+  release_table(fname.str());
   fname.str("");
 
 
   //pepind_to_psminds
   fname << in_dir << "/pepind_to_psminds";
-  ifstream f_pepind_to_psminds(fname.str().c_str(),ios::binary);
+  TableIStream f_pepind_to_psminds(fname.str(), table_store);
   if(!f_pepind_to_psminds.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
   }
   pepind_to_psminds.load(f_pepind_to_psminds);
   f_pepind_to_psminds.close();
+  release_table(fname.str());
   fname.str("");
   
 }
@@ -1013,7 +1039,7 @@ void Dataset :: load_labels_pep_training()
 
   ostringstream fname;
   fname << in_dir << "/summary";
-  ifstream f_summary(fname.str().c_str());
+  TableIStream f_summary(fname.str(), table_store, ios::in);
   if(!f_summary.is_open())
     {
       cout << "could not open file " << fname.str() <<  " for reading data\n";
@@ -1034,7 +1060,7 @@ void Dataset :: load_labels_pep_training()
 
   //psmind_to_label
   fname << in_dir << "/psmind_to_label";
-  ifstream f_psmind_to_label(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_label(fname.str(), table_store);
   if(!f_psmind_to_label.is_open())
     {
       cout << "could not open file " << fname.str() <<  " for reading data\n";
@@ -1047,7 +1073,7 @@ void Dataset :: load_labels_pep_training()
   
   //pepind_to_label
   fname << in_dir << "/pepind_to_label";
-  ifstream f_pepind_to_label(fname.str().c_str(),ios::binary);
+  TableIStream f_pepind_to_label(fname.str(), table_store);
   if(!f_pepind_to_label.is_open())
     {
       cout << "could not open file " << fname.str() <<  " for reading data\n";
@@ -1072,7 +1098,7 @@ void Dataset :: load_data_pep_results()
 
   //ind_to_pep
   fname << in_dir << "/ind_to_pep";
-  ifstream f_ind_to_pep(fname.str().c_str(),ios::binary);
+  TableIStream f_ind_to_pep(fname.str(), table_store);
   int ind;
   string pep;
   f_ind_to_pep >> ind;
@@ -1087,7 +1113,7 @@ void Dataset :: load_data_pep_results()
 
   //pepind_to_protinds
   fname << in_dir << "/pepind_to_protinds";
-  ifstream f_pepind_to_protinds(fname.str().c_str(),ios::binary);
+  TableIStream f_pepind_to_protinds(fname.str(), table_store);
   if(!f_pepind_to_protinds.is_open())
     {
       cout << "could not open file " << fname.str() <<  " for reading data\n";
@@ -1099,7 +1125,7 @@ void Dataset :: load_data_pep_results()
 
   //ind_to_prot
   fname << in_dir << "/ind_to_prot";
-  ifstream f_ind_to_prot(fname.str().c_str(),ios::binary);
+  TableIStream f_ind_to_prot(fname.str(), table_store);
  
   string prot;
   f_ind_to_prot >> ind;
@@ -1114,7 +1140,7 @@ void Dataset :: load_data_pep_results()
 
   //protind_to_length
   fname << in_dir << "/protind_to_length";
-  ifstream f_protind_to_length(fname.str().c_str(),ios::binary);
+  TableIStream f_protind_to_length(fname.str(), table_store);
   if(!f_protind_to_length.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -1127,7 +1153,7 @@ void Dataset :: load_data_pep_results()
 
   //protind_to_label
   fname << in_dir << "/protind_to_label";
-  ifstream f_protind_to_label(fname.str().c_str(),ios::binary);
+  TableIStream f_protind_to_label(fname.str(), table_store);
   if(!f_protind_to_label.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -1143,7 +1169,7 @@ void Dataset :: load_data_pep_results()
 
   //psmind_to_pepind
   fname << in_dir << "/psmind_to_pepind";
-  ifstream f_psmind_to_pepind(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_pepind(fname.str(), table_store);
   if(!f_psmind_to_pepind.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -1155,7 +1181,7 @@ void Dataset :: load_data_pep_results()
   
   //psmind_to_scan
   fname << in_dir << "/psmind_to_scan";
-  ifstream f_psmind_to_scan(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_scan(fname.str(), table_store);
   if(!f_psmind_to_scan.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -1167,7 +1193,7 @@ void Dataset :: load_data_pep_results()
 
   //psmind_to_charge
   fname << in_dir << "/psmind_to_charge";
-  ifstream f_psmind_to_charge(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_charge(fname.str(), table_store);
   if(!f_psmind_to_charge.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -1179,7 +1205,7 @@ void Dataset :: load_data_pep_results()
 
   //psmind_to_xcorr
   fname << in_dir << "/psmind_to_xcorr";
-  ifstream f_psmind_to_xcorr(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_xcorr(fname.str(), table_store);
   if(!f_psmind_to_xcorr.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -1191,7 +1217,7 @@ void Dataset :: load_data_pep_results()
 
   //psmind_to_deltaCn
   fname << in_dir << "/psmind_to_deltaCn";
-  ifstream f_psmind_to_deltaCn(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_deltaCn(fname.str(), table_store);
   if(!f_psmind_to_deltaCn.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -1203,7 +1229,7 @@ void Dataset :: load_data_pep_results()
   
   //psmind_to_sp_score
   fname << in_dir << "/psmind_to_spscore";
-  ifstream f_psmind_to_spscore(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_spscore(fname.str(), table_store);
   if(!f_psmind_to_spscore.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -1215,7 +1241,7 @@ void Dataset :: load_data_pep_results()
 
   //psmind_to_calculated_mass
   fname << in_dir << "/psmind_to_calculated_mass";
-  ifstream f_psmind_to_calculated_mass(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_calculated_mass(fname.str(), table_store);
   if(!f_psmind_to_calculated_mass.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -1227,7 +1253,7 @@ void Dataset :: load_data_pep_results()
 
   //psmind_to_precursor_mass
   fname << in_dir << "/psmind_to_precursor_mass";
-  ifstream f_psmind_to_precursor_mass(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_precursor_mass(fname.str(), table_store);
   if(!f_psmind_to_precursor_mass.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -1239,7 +1265,7 @@ void Dataset :: load_data_pep_results()
   
   //fileind_to_fname
   fname << in_dir << "/fileind_to_fname";
-  ifstream f_fileind_to_fname(fname.str().c_str(),ios::binary);
+  TableIStream f_fileind_to_fname(fname.str(), table_store);
   if(!f_fileind_to_fname.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -1258,7 +1284,7 @@ void Dataset :: load_data_pep_results()
   
   //psmind_to_filename
   fname << in_dir << "/psmind_to_fileind";
-  ifstream f_psmind_to_fileind(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_fileind(fname.str(), table_store);
   if(!f_psmind_to_fileind.is_open())
     {
       cout << "could not open file " << fname.str() <<  " for reading data\n";
@@ -1271,7 +1297,7 @@ void Dataset :: load_data_pep_results()
 
   //psmind_to_sp_rank
   fname << in_dir << "/psmind_to_sp_rank";
-  ifstream f_psmind_to_sp_rank(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_sp_rank(fname.str(), table_store);
   if(!f_psmind_to_sp_rank.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -1283,7 +1309,7 @@ void Dataset :: load_data_pep_results()
   
   //psmind_to_xcorr_rank
   fname << in_dir << "/psmind_to_xcorr_rank";
-  ifstream f_psmind_to_xcorr_rank(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_xcorr_rank(fname.str(), table_store);
   if(!f_psmind_to_xcorr_rank.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -1295,7 +1321,7 @@ void Dataset :: load_data_pep_results()
     
   //psmind_to_match_spectrum
   fname << in_dir << "/psmind_to_matches_spectrum";
-  ifstream f_psmind_to_matches_spectrum(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_matches_spectrum(fname.str(), table_store);
   if(!f_psmind_to_matches_spectrum.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -1307,7 +1333,7 @@ void Dataset :: load_data_pep_results()
    
   //psmind_to_by_ions_matched
   fname << in_dir << "/psmind_to_by_ions_matched";
-  ifstream f_psmind_to_by_ions_matched(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_by_ions_matched(fname.str(), table_store);
   if(!f_psmind_to_by_ions_matched.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -1319,7 +1345,7 @@ void Dataset :: load_data_pep_results()
  
   //psmind_to_by_ions_total
   fname << in_dir << "/psmind_to_by_ions_total";
-  ifstream f_psmind_to_by_ions_total(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_by_ions_total(fname.str(), table_store);
   if(!f_psmind_to_by_ions_total.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -1331,7 +1357,7 @@ void Dataset :: load_data_pep_results()
   
   //psmind_to_peptide_position
   fname << in_dir << "/psmind_to_peptide_position";
-  ifstream f_psmind_to_peptide_position(fname.str().c_str(),ios::binary);
+  TableIStream f_psmind_to_peptide_position(fname.str(), table_store);
   if(!f_psmind_to_peptide_position.is_open()){
       cout << "could not open file " << fname.str() <<  " for reading data\n";
       return;
@@ -1340,6 +1366,8 @@ void Dataset :: load_data_pep_results()
   f_psmind_to_peptide_position.read((char*)psmind_to_peptide_position,sizeof(int)*num_psms);
   f_psmind_to_peptide_position.close();
   fname.str("");
+  //nothing is read after the results
+  release_tables();
 }
 
 void Dataset :: clear_data_pep_results()
@@ -7,6 +7,7 @@
 #include <cmath>
 #include <map>
 #include "BipartiteGraph.h"
+#include "TableStore.h"
 using namespace std;
 
 
@@ -39,6 +40,8 @@ class Dataset
   void clear_data_pep_results();
 
   inline void set_input_dir(string input_dir){in_dir = input_dir;}
+  //read the tables the parser kept in memory instead of in_dir
+  inline void set_table_store(TableStore* store){table_store = store;}
   void normalize_psms();
   int print_features(string &filename);
   
@@ -86,6 +89,9 @@ class Dataset
 
 
  protected:
+  void release_table(const string &name);
+  void release_tables();
+
   int num_psms;
   int num_pos_psms;
   int num_neg_psms;
@@ -134,6 +140,7 @@ class Dataset
   map <int, string> ind_to_prot;
 
   string in_dir;
+  TableStore* table_store;
 };
 
 
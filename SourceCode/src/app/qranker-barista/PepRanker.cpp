@@ -1046,6 +1046,11 @@ int PepRanker :: crux_set_command_line_options(int argc, char *argv[])
         //set input and output for the leaning algo (in and out are the same as the out for the parser)
         set_input_dir(output_directory);
         set_output_dir(output_directory);
+        //the tables only need to reach disk if they outlive the run
+        if(skip_cleanup_flag != 1){
+          parser->set_table_store(&tables);
+          set_table_store(&tables);
+        }
       
         if(separate_search_flag){
 	  if(!parser->set_input_sources(ms2_source, sqt_source, sqt_decoy_source)){
@@ -72,6 +72,7 @@ public:
   inline void set_overwrite_flag(int flag) {overwrite_flag = flag;}
   inline void set_input_dir(string &input_dir) {in_dir = input_dir; d.set_input_dir(input_dir);}
   inline void set_output_dir(string &output_dir){out_dir = output_dir;}
+  inline void set_table_store(TableStore* store){d.set_table_store(store);}
   void print_description();
   int set_command_line_options(int argc, char **argv);
   int crux_set_command_line_options(int argc, char *argv[]);
@@ -140,6 +141,8 @@ protected:
     
     TabDelimParser pars;
     SQTParser* parser; 
+    //parser tables handed to d without a round trip through out_dir
+    TableStore tables;
      
 
 };
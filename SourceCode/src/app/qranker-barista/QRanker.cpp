@@ -2,6 +2,7 @@
 #include "util/modifications.h"
 #include "util/Params.h"
 #include "app/ComputeQValues.h"
+#include "io/BinaryMatchFile.h"
 
 QRanker::QRanker() :  
   seed(0),
@@ -925,7 +926,10 @@ string QRanker:: file_extension (string str){
 FILE_FORMAT_T QRanker::check_file_format(string& source) {
   string ext = file_extension(source);
 
-    if (ext=="sqt") 
+    // binary match files hold the same columns as delimited ones
+    if (BinaryMatchFile::isBinaryMatchFile(source))
+      return DELIMITED_FORMAT;
+    else if (ext=="sqt") 
       return SQT_FORMAT;
     else if (ext=="txt") 
       return DELIMITED_FORMAT;
@@ -1014,12 +1018,13 @@ int QRanker :: crux_set_command_line_options(int argc, char *argv[])
 	  break;
         case DELIMITED_FORMAT:
           file_format_="txt";
-	  parser = new CruxParser();
+	  parser = new CruxParser(BinaryMatchFile::isBinaryMatchFile(files[i]) ?
+	                          BinaryMatchFile::EXTENSION : ".txt");
 	  break;
         case INVALID_FORMAT:
           file_format_="NULL";
         default:
-	  carp(CARP_FATAL, "Please enter .sqt or .txt search results"); 
+	  carp(CARP_FATAL, "Please enter .sqt, .txt or .psm.bin search results"); 
         }
 
         parser->set_decoy_prefix(decoy_prefix);
@@ -1057,6 +1062,11 @@ int QRanker :: crux_set_command_line_options(int argc, char *argv[])
         //set input and output for the leaning algo (in and out are the same as the out for the parser)
         set_input_dir(output_directory);
         set_output_dir(output_directory);
+        //the tables only need to reach disk if they outlive the run
+        if(skip_cleanup_flag != 1){
+          parser->set_table_store(&tables);
+          set_table_store(&tables);
+        }
       
         if(separate_search_flag){
 	  if(!parser->set_input_sources(ms2_source, sqt_source, sqt_decoy_source)){
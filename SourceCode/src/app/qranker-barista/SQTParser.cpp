@@ -28,6 +28,7 @@ SQTParser :: SQTParser()
     xs(0), 
     protind_to_num_all_pep(0),
     protind_to_length(0),
+    table_store((TableStore*)0),
     cur_fileind(0)
 {
 
@@ -420,7 +421,7 @@ void SQTParser :: fill_graphs_and_save_data(string &out_dir)
 
   //ind_to_pep
   fname << out_dir << "/ind_to_pep";
-  ofstream f_ind_to_pep(fname.str().c_str());
+  TableOStream f_ind_to_pep(fname.str(), table_store, ios::out);
   for(map<int,string>::iterator it = ind_to_pep.begin(); it != ind_to_pep.end(); it++)
     f_ind_to_pep << it->first << " " << it->second << "\n";
   f_ind_to_pep.close();
@@ -429,7 +430,7 @@ void SQTParser :: fill_graphs_and_save_data(string &out_dir)
 
   //pep_to_ind
   fname << out_dir << "/pep_to_ind";
-  ofstream f_pep_to_ind(fname.str().c_str());
+  TableOStream f_pep_to_ind(fname.str(), table_store, ios::out);
   for(map<string,int>::iterator it = pep_to_ind.begin(); it != pep_to_ind.end(); it++)
     f_pep_to_ind << it->first << " " << it->second << "\n";
   f_pep_to_ind.close();
@@ -438,7 +439,7 @@ void SQTParser :: fill_graphs_and_save_data(string &out_dir)
 
   //prot_to_ind
   fname << out_dir << "/prot_to_ind";
-  ofstream f_prot_to_ind(fname.str().c_str(),ios::binary);
+  TableOStream f_prot_to_ind(fname.str(), table_store);
   for(map<string,int>::iterator it = prot_to_ind.begin(); it != prot_to_ind.end(); it++)
     f_prot_to_ind << it->first << " " << it->second << "\n";
   f_prot_to_ind.close();
@@ -447,7 +448,7 @@ void SQTParser :: fill_graphs_and_save_data(string &out_dir)
 
   //ind_to_prot
   fname << out_dir << "/ind_to_prot";
-  ofstream f_ind_to_prot(fname.str().c_str(),ios::binary);
+  TableOStream f_ind_to_prot(fname.str(), table_store);
   for(map<int,string>::iterator it = ind_to_prot.begin(); it != ind_to_prot.end(); it++)
     f_ind_to_prot << it->first << " " << it->second << "\n";
   f_ind_to_prot.close();
@@ -458,7 +459,7 @@ void SQTParser :: fill_graphs_and_save_data(string &out_dir)
   pepind_to_psminds.create_bipartite_graph(pepind_to_psminds_map);
   pepind_to_psminds_map.clear();
   fname << out_dir << "/pepind_to_psminds";
-  ofstream f_pepind_to_psminds(fname.str().c_str(),ios::binary);
+  TableOStream f_pepind_to_psminds(fname.str(), table_store);
   pepind_to_psminds.save(f_pepind_to_psminds);
   f_pepind_to_psminds.close();
   fname.str("");
@@ -468,7 +469,7 @@ void SQTParser :: fill_graphs_and_save_data(string &out_dir)
   pepind_to_protinds.create_bipartite_graph(pepind_to_protinds_map);
   pepind_to_protinds_map.clear();
   fname << out_dir << "/pepind_to_protinds";
-  ofstream f_pepind_to_protinds(fname.str().c_str(),ios::binary);
+  TableOStream f_pepind_to_protinds(fname.str(), table_store);
   pepind_to_protinds.save(f_pepind_to_protinds);
   f_pepind_to_protinds.close();
   fname.str("");
@@ -478,7 +479,7 @@ void SQTParser :: fill_graphs_and_save_data(string &out_dir)
   protind_to_pepinds.create_bipartite_graph(protind_to_pepinds_map);
   protind_to_pepinds_map.clear();
   fname << out_dir << "/protind_to_pepinds";
-  ofstream f_protind_to_pepinds(fname.str().c_str(),ios::binary);
+  TableOStream f_protind_to_pepinds(fname.str(), table_store);
   protind_to_pepinds.save(f_protind_to_pepinds);
   f_protind_to_pepinds.close();
   fname.str("");
@@ -486,7 +487,7 @@ void SQTParser :: fill_graphs_and_save_data(string &out_dir)
   
   //write out data summary
   fname << out_dir << "/summary";
-  ofstream f_summary(fname.str().c_str());
+  TableOStream f_summary(fname.str(), table_store, ios::out);
   //psm info
   f_summary << num_total_features << " " << num_psm << " " << num_pos_psm << " " << num_neg_psm << endl;
   //peptide info
@@ -920,7 +921,7 @@ void SQTParser :: read_sqt_file(ifstream &is, string &decoy_prefix, int final_hi
 
 int SQTParser :: check_file(ostringstream &fname)
 {
-  ifstream f(fname.str().c_str());
+  TableIStream f(fname.str(), table_store, ios::in);
   if(!f.is_open())
     {
       carp(CARP_INFO,"could not open %s", fname.str().c_str());
@@ -1288,110 +1289,110 @@ void SQTParser :: open_files(string &out_dir)
   ostringstream fname;
 
   fname << out_dir << "/psm";
-  f_psm.open(fname.str().c_str(), ios::binary);
+  f_psm.open(fname.str(), table_store);
   fname.str("");
   
   //psmind_to_label
   fname << out_dir << "/psmind_to_label";
-  f_psmind_to_label.open(fname.str().c_str(),ios::binary);
+  f_psmind_to_label.open(fname.str(), table_store);
   fname.str("");
   
   //psmind_to_pepind
   fname << out_dir << "/psmind_to_pepind";
-  f_psmind_to_pepind.open(fname.str().c_str(),ios::binary);
+  f_psmind_to_pepind.open(fname.str(), table_store);
   fname.str("");
   
   //psmind_to_scan
   fname << out_dir << "/psmind_to_scan";
-  f_psmind_to_scan.open(fname.str().c_str(),ios::binary);
+  f_psmind_to_scan.open(fname.str(), table_store);
   fname.str("");
   
   //psmind_to_charge
   fname << out_dir << "/psmind_to_charge";
-  f_psmind_to_charge.open(fname.str().c_str(),ios::binary );
+  f_psmind_to_charge.open(fname.str(), table_store);
   fname.str("");
   
   //psmind_to_precursor_mass
   fname << out_dir << "/psmind_to_precursor_mass";
-  f_psmind_to_precursor_mass.open(fname.str().c_str(),ios::binary );
+  f_psmind_to_precursor_mass.open(fname.str(), table_store);
   fname.str("");
   
   //psmind_to_sp_rank 
   fname << out_dir << "/psmind_to_sp_rank";
-  f_psmind_to_sp_rank.open(fname.str().c_str(),ios::binary );
+  f_psmind_to_sp_rank.open(fname.str(), table_store);
   fname.str("");
 
   //psmind_to_xcorr_rank 
   fname << out_dir << "/psmind_to_xcorr_rank";
-  f_psmind_to_xcorr_rank.open(fname.str().c_str(),ios::binary );
+  f_psmind_to_xcorr_rank.open(fname.str(), table_store);
   fname.str("");
      
   //psmind_to_matches_spectrum 
   fname << out_dir << "/psmind_to_matches_spectrum";
-  f_pmsind_to_matches_spectrum.open(fname.str().c_str(),ios::binary );
+  f_pmsind_to_matches_spectrum.open(fname.str(), table_store);
   fname.str("");
   ///additional info
   //psmind_to_xcorr
   fname << out_dir << "/psmind_to_xcorr";
-  f_psmind_to_xcorr.open(fname.str().c_str(),ios::binary );
+  f_psmind_to_xcorr.open(fname.str(), table_store);
   fname.str("");
   
   //psmind_to_spscore
   fname << out_dir << "/psmind_to_spscore";
-  f_psmind_to_spscore.open(fname.str().c_str(),ios::binary );
+  f_psmind_to_spscore.open(fname.str(), table_store);
   fname.str("");
   
   //psmind_to_deltaCn
   fname << out_dir << "/psmind_to_deltaCn";
-  f_psmind_to_deltaCn.open(fname.str().c_str(),ios::binary );
+  f_psmind_to_deltaCn.open(fname.str(), table_store);
   fname.str("");
   
   //psmind_to_calculated_mass
   fname << out_dir << "/psmind_to_calculated_mass";
-  f_psmind_to_calculated_mass.open(fname.str().c_str(),ios::binary );
+  f_psmind_to_calculated_mass.open(fname.str(), table_store);
   fname.str("");
 
   //psmind_to_by_ions_matched
   fname << out_dir << "/psmind_to_by_ions_matched";
-  f_psmind_to_by_ions_matched.open(fname.str().c_str(),ios::binary );
+  f_psmind_to_by_ions_matched.open(fname.str(), table_store);
   fname.str("");
   
   //psmind_to_by_ions_total
   fname << out_dir << "/psmind_to_by_ions_total";
-  f_psmind_to_by_ions_total.open(fname.str().c_str(),ios::binary );
+  f_psmind_to_by_ions_total.open(fname.str(), table_store);
   fname.str("");
 
   //psmind_to_peptide_position
   fname << out_dir << "/psmind_to_peptide_position";
-  f_psmind_to_peptide_position.open(fname.str().c_str(),ios::binary );
+  f_psmind_to_peptide_position.open(fname.str(), table_store);
   fname.str("");
   
   //end of additional info
   
   //pepind_to_label
   fname << out_dir << "/pepind_to_label";
-  f_pepind_to_label.open(fname.str().c_str(),ios::binary);
+  f_pepind_to_label.open(fname.str(), table_store);
   fname.str("");
   
   //protind_to_label
   fname << out_dir << "/protind_to_label";
-  f_protind_to_label.open(fname.str().c_str(),ios::binary);
+  f_protind_to_label.open(fname.str(), table_store);
   fname.str("");
   
   fname << out_dir << "/protind_to_num_all_pep";
-  f_protind_to_num_all_pep.open(fname.str().c_str(),ios::binary);
+  f_protind_to_num_all_pep.open(fname.str(), table_store);
   fname.str("");
 
   fname << out_dir << "/protind_to_length";
-  f_protind_to_length.open(fname.str().c_str(),ios::binary);
+  f_protind_to_length.open(fname.str(), table_store);
   fname.str("");
   
   fname << out_dir << "/fileind_to_fname";
-  f_fileind_to_fname.open(fname.str().c_str(),ios::binary);
+  f_fileind_to_fname.open(fname.str(), table_store);
   fname.str("");
   
   fname << out_dir << "/psmind_to_fileind";
-  f_psmind_to_fileind.open(fname.str().c_str(),ios::binary);
+  f_psmind_to_fileind.open(fname.str(), table_store);
   fname.str("");
   
 }
@@ -20,6 +20,7 @@
 #include <cstring>
 #include "SpecFeatures.h"
 #include "BipartiteGraph.h"
+#include "TableStore.h"
 
 #include "app/CruxApplication.h"
 #include "io/carp.h"
@@ -73,6 +74,8 @@ class SQTParser{
   inline void set_input_dir(string input_dir){in_dir = input_dir;}
   inline void set_input_dir_ms2(string input_dir){in_dir_ms2 = input_dir;}
   inline string& get_input_dir(){return in_dir;}
+  //tables are kept in the store instead of being written to out_dir
+  inline void set_table_store(TableStore* store){table_store = store;}
   inline void set_db_name(string database){db_name = database;}
   inline void set_decoy_prefix(string prefix){decoy_prefix = prefix;}
   inline void set_num_hits_per_spectrum(int hits_per_spectrum){fhps = hits_per_spectrum;}
@@ -198,35 +201,36 @@ class SQTParser{
   vector<string> sqt_file_names;
   vector<string> ms2_file_names;
   vector<string> db_file_names;
+  TableStore* table_store;
 
   string cur_fname;
   int cur_fileind;
   
   //files for writing out data
-  ofstream f_psm;
-  ofstream f_psmind_to_label;
-  ofstream f_psmind_to_scan;
-  ofstream f_psmind_to_charge;
-  ofstream f_psmind_to_precursor_mass;
-  ofstream f_psmind_to_pepind;
-  ofstream f_pepind_to_label;
-  ofstream f_protind_to_label;
-  ofstream f_protind_to_num_all_pep;
-  ofstream f_protind_to_length;
-  ofstream f_fileind_to_fname;
-  ofstream f_psmind_to_fileind;
-  
-  ofstream f_psmind_to_xcorr;
-  ofstream f_psmind_to_spscore;
-  ofstream f_psmind_to_deltaCn;
-  ofstream f_psmind_to_calculated_mass;
-  
-  ofstream f_psmind_to_sp_rank;//sp rank
-  ofstream f_pmsind_to_matches_spectrum; //matches_spectrum  
-  ofstream f_psmind_to_xcorr_rank;//xcorr rank 
-  ofstream f_psmind_to_by_ions_matched;// b/y ions match  
-  ofstream f_psmind_to_by_ions_total;  //b/y ions total   
-  ofstream f_psmind_to_peptide_position; //peptide position 
+  TableOStream f_psm;
+  TableOStream f_psmind_to_label;
+  TableOStream f_psmind_to_scan;
+  TableOStream f_psmind_to_charge;
+  TableOStream f_psmind_to_precursor_mass;
+  TableOStream f_psmind_to_pepind;
+  TableOStream f_pepind_to_label;
+  TableOStream f_protind_to_label;
+  TableOStream f_protind_to_num_all_pep;
+  TableOStream f_protind_to_length;
+  TableOStream f_fileind_to_fname;
+  TableOStream f_psmind_to_fileind;
+  
+  TableOStream f_psmind_to_xcorr;
+  TableOStream f_psmind_to_spscore;
+  TableOStream f_psmind_to_deltaCn;
+  TableOStream f_psmind_to_calculated_mass;
+  
+  TableOStream f_psmind_to_sp_rank;//sp rank
+  TableOStream f_pmsind_to_matches_spectrum; //matches_spectrum  
+  TableOStream f_psmind_to_xcorr_rank;//xcorr rank 
+  TableOStream f_psmind_to_by_ions_matched;// b/y ions match  
+  TableOStream f_psmind_to_by_ions_total;  //b/y ions total   
+  TableOStream f_psmind_to_peptide_position; //peptide position 
   
   //final hits per spectrum
   int fhps;
@@ -41,11 +41,12 @@ void SpecFeaturesGenerator :: read_spectrum()
   mz_values_.clear();
   intens_values_.clear();
 
-  for (PeakIterator i = spectrum_->begin(); i != spectrum_->end(); ++i) {
-    Peak* peak = *i;
-    FLOAT_T mz = peak->getLocation();
+  const vector<FLOAT_T>& peak_mzs = spectrum_->getPeakMzs();
+  const vector<FLOAT_T>& peak_intensities = spectrum_->getPeakIntensities();
+  for (size_t i = 0; i < peak_mzs.size(); ++i) {
+    FLOAT_T mz = peak_mzs[i];
     mz_values_.push_back(mz);
-    intens_values_.push_back(peak->getIntensity());
+    intens_values_.push_back(peak_intensities[i]);
     /*int mz_bin = (int)(mz / bin_width_mono + 0.5);
     if (mz_bin >= max_mz_) {
       max_mz_ = mz_bin + 1;
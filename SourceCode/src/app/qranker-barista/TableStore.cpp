@@ -0,0 +1,107 @@
+#include "TableStore.h"
+
+string& TableStore :: create(const string &name)
+{
+  string &table = tables[name];
+  table.clear();
+  return table;
+}
+
+const string* TableStore :: find(const string &name) const
+{
+  map<string,string>::const_iterator it = tables.find(name);
+  if(it == tables.end())
+    return (string*)0;
+  return &(it->second);
+}
+
+/******************************/
+
+TableWriteBuf::int_type TableWriteBuf :: overflow(int_type c)
+{
+  if(out == 0)
+    return traits_type::eof();
+  if(!traits_type::eq_int_type(c, traits_type::eof()))
+    out->push_back(traits_type::to_char_type(c));
+  return traits_type::not_eof(c);
+}
+
+streamsize TableWriteBuf :: xsputn(const char *s, streamsize n)
+{
+  if(out == 0)
+    return 0;
+  out->append(s, n);
+  return n;
+}
+
+void TableReadBuf :: attach(const string &table)
+{
+  char *b = const_cast<char*>(table.data());
+  setg(b, b, b + table.size());
+}
+
+/******************************/
+
+TableOStream :: TableOStream(const string &name, TableStore *store, ios::openmode mode)
+  : ostream((streambuf*)0), mem_open(false)
+{
+  open(name, store, mode);
+}
+
+void TableOStream :: open(const string &name, TableStore *store, ios::openmode mode)
+{
+  close();
+  if(store)
+    {
+      mem.attach(&store->create(name));
+      mem_open = true;
+      rdbuf(&mem);
+    }
+  else if(file.open(name.c_str(), mode | ios::out))
+    rdbuf(&file);
+  else
+    setstate(ios::failbit);
+}
+
+void TableOStream :: close()
+{
+  if(mem_open)
+    {
+      mem.attach((string*)0);
+      mem_open = false;
+    }
+  else if(file.is_open())
+    file.close();
+  rdbuf((streambuf*)0);
+}
+
+TableIStream :: TableIStream(const string &name, TableStore *store, ios::openmode mode)
+  : istream((streambuf*)0), mem_open(false)
+{
+  open(name, store, mode);
+}
+
+void TableIStream :: open(const string &name, TableStore *store, ios::openmode mode)
+{
+  close();
+  //tables that were never handed over in memory are read from disk
+  const string *table = store ? store->find(name) : (string*)0;
+  if(table)
+    {
+      mem.attach(*table);
+      mem_open = true;
+      rdbuf(&mem);
+    }
+  else if(file.open(name.c_str(), mode | ios::in))
+    rdbuf(&file);
+  else
+    setstate(ios::failbit);
+}
+
+void TableIStream :: close()
+{
+  mem_open = false;
+  if(file.is_open())
+    file.close();
+  rdbuf((streambuf*)0);
+}
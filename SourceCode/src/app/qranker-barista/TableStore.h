@@ -0,0 +1,88 @@
+#ifndef TABLESTORE_H
+#define TABLESTORE_H
+
+#include <iostream>
+#include <fstream>
+#include <streambuf>
+#include <string>
+#include <map>
+using namespace std;
+
+/*
+ * In-memory stand-in for the directory of tables that the parsers write
+ * and Dataset reads back (psm, psmind_to_pepind, summary, ...).  Tables
+ * are keyed by the same path that would be used on disk, so the parser
+ * and the Dataset only need to agree on the store, not on a new naming
+ * scheme.  When no store is given, or a table was never written to it,
+ * the streams below fall back to files.
+ */
+class TableStore{
+ public:
+  TableStore(){}
+  ~TableStore(){clear();}
+
+  //creates (or truncates) the table and returns its buffer
+  string& create(const string &name);
+  //returns 0 if the table has not been written
+  const string* find(const string &name) const;
+  //frees tables once nothing will read them again
+  void remove(const string &name){tables.erase(name);}
+  void clear(){tables.clear();}
+
+ private:
+  map<string,string> tables;
+};
+
+//appends everything written to a string owned by the TableStore
+class TableWriteBuf : public streambuf{
+ public:
+ TableWriteBuf():out((string*)0){}
+  void attach(string *table){out = table;}
+ protected:
+  virtual int_type overflow(int_type c);
+  virtual streamsize xsputn(const char *s, streamsize n);
+ private:
+  string *out;
+};
+
+//reads straight out of a table without copying it
+class TableReadBuf : public streambuf{
+ public:
+  void attach(const string &table);
+};
+
+/*
+ * Output stream for one table: a file when the store is null, otherwise
+ * a table in the store.  Has the subset of the ofstream interface the
+ * parsers use.
+ */
+class TableOStream : public ostream{
+ public:
+ TableOStream():ostream((streambuf*)0),mem_open(false){}
+  TableOStream(const string &name, TableStore *store, ios::openmode mode = ios::out | ios::binary);
+  void open(const string &name, TableStore *store, ios::openmode mode = ios::out | ios::binary);
+  bool is_open() const {return mem_open || file.is_open();}
+  void close();
+ private:
+  filebuf file;
+  TableWriteBuf mem;
+  bool mem_open;
+};
+
+/*
+ * Input stream for one table; see TableOStream.
+ */
+class TableIStream : public istream{
+ public:
+ TableIStream():istream((streambuf*)0),mem_open(false){}
+  TableIStream(const string &name, TableStore *store, ios::openmode mode = ios::in | ios::binary);
+  void open(const string &name, TableStore *store, ios::openmode mode = ios::in | ios::binary);
+  bool is_open() const {return mem_open || file.is_open();}
+  void close();
+ private:
+  filebuf file;
+  TableReadBuf mem;
+  bool mem_open;
+};
+
+#endif //TABLESTORE_H
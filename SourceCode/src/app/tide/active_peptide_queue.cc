@@ -5,6 +5,7 @@
 #include "records.h"
 #include "peptides.pb.h"
 #include "peptide.h"
+#include "peptide_mods.h"
 #include "active_peptide_queue.h"
 #include "records_to_vector-inl.h"
 #include "theoretical_peak_set.h"
@@ -18,6 +19,9 @@ ActivePeptideQueue::ActivePeptideQueue(RecordReader* reader,
                                        const vector<const pb::Protein*>&
                                        proteins)
   : reader_(reader),
+    mod_table_(NULL),
+    mod_reader_(NULL),
+    stored_peaks_(false),
     proteins_(proteins),
     theoretical_peak_set_(2000),   // probably overkill, but no harm
     theoretical_b_peak_set_(200),  // probably overkill, but no harm
@@ -42,6 +46,31 @@ ActivePeptideQueue::~ActivePeptideQueue() {
 
   delete compiler_prog1_;
   delete compiler_prog2_;
+  delete mod_reader_;
+  delete mod_table_;
+}
+
+void ActivePeptideQueue::EnumerateMods(const pb::Header::PeptidesHeader& header) {
+  mod_table_ = new VariableModTable;
+  if (!mod_table_->Load(header.mods(), header.nterm_mods(), header.cterm_mods())) {
+    carp(CARP_FATAL, "Error reading modifications from the index");
+  }
+  mod_reader_ = new ModifiedPeptideReader(reader_, proteins_, mod_table_, header);
+}
+
+bool ActivePeptideQueue::ReaderDone(double min_mass) {
+  if (!mod_reader_)
+    return reader_->Done();
+  mod_reader_->SkipBelow(min_mass);
+  return mod_reader_->Done();
+}
+
+void ActivePeptideQueue::ReadPeptide() {
+  if (mod_reader_) {
+    mod_reader_->Read(&current_pb_peptide_);
+  } else {
+    reader_->Read(&current_pb_peptide_);
+  }
 }
 
 // Compute the theoretical peaks of the peptide in the "back" of the queue
@@ -49,6 +78,11 @@ ActivePeptideQueue::~ActivePeptideQueue() {
 void ActivePeptideQueue::ComputeTheoreticalPeaksBack() {
   theoretical_peak_set_.Clear();
   Peptide* peptide = queue_.back();
+  if (stored_peaks_) {
+    peptide->CompileStoredPeaks(&theoretical_peak_set_, current_pb_peptide_,
+                                compiler_prog1_, compiler_prog2_);
+    return;
+  }
   peptide->ComputeTheoreticalPeaks(&theoretical_peak_set_, current_pb_peptide_,
                                    compiler_prog1_, compiler_prog2_);
 }
@@ -109,9 +143,9 @@ int ActivePeptideQueue::SetActiveRange(vector<double>* min_mass, vector<double>*
     if (!queue_.empty()) {
       ComputeTheoreticalPeaksBack();
     }
-    while (!(done = reader_->Done())) {
+    while (!(done = ReaderDone(min_range))) {
       // read all peptides lighter than max_range
-      reader_->Read(&current_pb_peptide_);
+      ReadPeptide();
       if (current_pb_peptide_.mass() < min_range) {
         // we would delete current_pb_peptide_;
         continue; // skip peptides that fall below min_range
@@ -205,9 +239,9 @@ int ActivePeptideQueue::SetActiveRangeBIons(vector<double>* min_mass, vector<dou
   // fifo_alloc_peptides_.
   bool done;
   if (queue_.empty() || queue_.back()->Mass() <= max_range) {
-    while (!(done = reader_->Done())) {
+    while (!(done = ReaderDone(min_range))) {
       // read all peptides lighter than max_range
-      reader_->Read(&current_pb_peptide_);
+      ReadPeptide();
       if (current_pb_peptide_.mass() < min_range) {
         // we would delete current_pb_peptide_;
         continue; // skip peptides that fall below min_range
@@ -266,7 +300,8 @@ int ActivePeptideQueue::CountAAFrequency(
   double** dAAFreqN,
   double** dAAFreqI,
   double** dAAFreqC,
-  int** dAAMass
+  int** dAAMass,
+  const vector<RecordReader*>* more_readers
 ) {
 
     unsigned int i = 0;
@@ -280,8 +315,20 @@ int ActivePeptideQueue::CountAAFrequency(
     memset(nvAAMassCounterC, 0, MaxModifiedAAMassBin * sizeof(unsigned int));
     memset(nvAAMassCounterI, 0, MaxModifiedAAMassBin * sizeof(unsigned int));
 
-    while (!(reader_->Done())) { // read all peptides in index
-      reader_->Read(&current_pb_peptide_);
+    RecordReader* own_reader = reader_;
+    size_t next_reader = 0;
+    while (true) { // read all peptides in index
+      if (ReaderDone()) {
+        if (more_readers == NULL || next_reader >= more_readers->size()) {
+          break;
+        }
+        reader_ = (*more_readers)[next_reader++];
+        if (mod_reader_) {
+          mod_reader_->SetReader(reader_);
+        }
+        continue;
+      }
+      ReadPeptide();
       Peptide* peptide = new(&fifo_alloc_peptides_) Peptide(current_pb_peptide_, proteins_, &fifo_alloc_peptides_);
 
       double* dAAResidueMass = peptide->getAAMasses(); //retrieves the amino acid masses, modifications included
@@ -298,6 +345,7 @@ int ActivePeptideQueue::CountAAFrequency(
       delete[] dAAResidueMass;
       fifo_alloc_peptides_.ReleaseAll();
     }
+    reader_ = own_reader;
 
   //calculate the unique masses
   unsigned int uiUniqueMasses = 0;
@@ -335,13 +383,13 @@ void ActivePeptideQueue::ReportPeptideHits(Peptide* peptide) {
     }
 
     current_peptide_ = peptide;
-    TideMatchSet matches(peptide, highest_mz_);
+    TideMatchSet matches(peptide, highest_mz_, *config_);
     matches.exact_pval_search_ = exact_pval_search_;
     matches.elution_window_ = elution_window_;
 
     if (!output_files_) { //only tab-delimited output is supported
-        matches.report(target_file_, decoy_file_, top_matches_,
-                       this, proteins_, *locations_, compute_sp_);
+        matches.report(writer_, top_matches_,
+                       this, proteins_, *locations_, compute_sp_, output_lock_);
     }
 }
 
@@ -370,9 +418,9 @@ int ActivePeptideQueue::SetActiveRangeBYIonsGPU(vector<double>* min_mass, vector
   // fifo_alloc_peptides_.
   bool done = false;
   if (queue_.empty() || queue_.back()->Mass() <= max_range) {
-    while (!(done = reader_->Done())) {
+    while (!(done = ReaderDone(min_range))) {
       // read all peptides lighter than max_range
-      reader_->Read(&current_pb_peptide_);
+      ReadPeptide();
       if (current_pb_peptide_.mass() < min_range) {
         // we would delete current_pb_peptide_;
         continue; // skip peptides that fall below min_range
@@ -15,6 +15,8 @@
 // GetPeptide() to get a specific peptide in the window.
 
 #include <deque>
+#include <boost/thread/mutex.hpp>
+#include "header.pb.h"
 #include "peptides.pb.h"
 #include "peptide.h"
 #include "theoretical_peak_set.h"
@@ -27,6 +29,10 @@
 #define ACTIVE_PEPTIDE_QUEUE_H
 
 class TheoreticalPeakCompiler;
+class TideMatchWriter;
+class TideSearchConfig;
+class VariableModTable;
+class ModifiedPeptideReader;
 
 class ActivePeptideQueue {
  public:
@@ -35,6 +41,15 @@ class ActivePeptideQueue {
 
   ~ActivePeptideQueue();
 
+  // For an index built with lazy-mods: generate the modified forms of the
+  // unmodified peptides read, from the modifications in the header.
+  void EnumerateMods(const pb::Header::PeptidesHeader& header);
+
+  // For an index built with store-peaks, binned as the search is: compile the
+  // programs of the peptides read from the peaks stored in the index instead
+  // of computing the peaks.
+  void UseStoredPeaks() { stored_peaks_ = true; }
+
   bool isWithinIsotope(vector<double>* min_mass, vector<double>* max_mass, double mass, int* isotope_idx);
   
   // See above for usage and .cc for implementation details.
@@ -57,22 +72,27 @@ class ActivePeptideQueue {
 
   int lMax;
  
+  // Peptides from more_readers (the other shards of a sharded index) are
+  // counted after those from the queue's own reader.
   int CountAAFrequency(double binWidth, double binOffset, double** dAAFreqN,
-                       double** dAAFreqI, double** dAAFreqC, int** dAAMass);
+                       double** dAAFreqI, double** dAAFreqC, int** dAAMass,
+                       const vector<RecordReader*>* more_readers = NULL);
   
   int ActiveTargets() const { return active_targets_; }
   int ActiveDecoys() const { return active_decoys_; }
 
   void ReportPeptideHits(Peptide* peptide);
   void SetOutputs(OutputFiles* output_files, const vector<const pb::AuxLocation*>* locations, int top_matches,
-                  bool compute_sp, ofstream* target_file, ofstream* decoy_file, double highest_mz) {
+                  bool compute_sp, TideMatchWriter* writer, boost::mutex* output_lock, double highest_mz,
+                  const TideSearchConfig* config) {
       locations_ = locations;
       output_files_ = output_files;
       top_matches_ = top_matches;
       compute_sp_ = compute_sp;
-      target_file_ = target_file;
-      decoy_file_ = decoy_file;
+      writer_ = writer;
+      output_lock_ = output_lock;
       highest_mz_ = highest_mz;
+      config_ = config;
   }
   void setPeptideCentric(bool peptide_centric) {
     peptide_centric_ = peptide_centric;
@@ -92,9 +112,10 @@ class ActivePeptideQueue {
   OutputFiles* output_files_;
   int top_matches_;
   bool compute_sp_;
-  ofstream* target_file_;
-  ofstream* decoy_file_;
+  TideMatchWriter* writer_;
+  boost::mutex* output_lock_;
   double highest_mz_;
+  const TideSearchConfig* config_;
   Peptide* current_peptide_;
   bool exact_pval_search_;
   bool peptide_centric_;
@@ -108,8 +129,17 @@ class ActivePeptideQueue {
   void ComputeTheoreticalPeaksBack();
   void ComputeBTheoreticalPeaksBack();
 
+  // Read the next peptide from reader_, or from mod_reader_ if the
+  // modifications are enumerated at search time. Peptides lighter than
+  // min_mass are skipped by the caller, so mod_reader_ only counts them.
+  bool ReaderDone(double min_mass = 0);
+  void ReadPeptide();
+
   RecordReader* reader_;
   pb::Peptide current_pb_peptide_;
+  VariableModTable* mod_table_;
+  ModifiedPeptideReader* mod_reader_;
+  bool stored_peaks_;
 
   // All amino acid sequences from which the peptides are drawn.
   const vector<const pb::Protein*>& proteins_; 
@@ -0,0 +1,98 @@
+// CPU feature detection for the programs generated by TheoreticalPeakCompiler.
+//
+// Gather instructions need the CPU to support them (CPUID) and the OS to save
+// the wider registers on context switches (XGETBV). Both are checked once and
+// the result is kept for the life of the process.
+
+#include "peptides.pb.h"
+#include "max_mz.h"
+#include "fifo_alloc.h"
+#include "theoretical_peak_set.h"
+#include "compiler.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define TIDE_COMPILER_X86_64
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#ifdef TIDE_COMPILER_X86_64
+
+// Returns the registers of CPUID leaf 'leaf', subleaf 'sub', or false if the
+// leaf is not supported.
+static bool Cpuid(unsigned int leaf, unsigned int sub, unsigned int regs[4]) {
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, leaf & 0x80000000);
+  if ((unsigned int) info[0] < leaf)
+    return false;
+  __cpuidex(info, leaf, sub);
+  for (int i = 0; i < 4; ++i)
+    regs[i] = info[i];
+#else
+  if (__get_cpuid_max(leaf & 0x80000000, 0) < leaf)
+    return false;
+  __cpuid_count(leaf, sub, regs[0], regs[1], regs[2], regs[3]);
+#endif
+  return true;
+}
+
+// Returns the XCR0 register, i.e. which register states the OS saves.
+static uint64_t Xcr0() {
+#ifdef _MSC_VER
+  return _xgetbv(0);
+#else
+  unsigned int eax, edx;
+  __asm__ volatile(".byte 0x0f, 0x01, 0xd0" // xgetbv
+                   : "=a"(eax), "=d"(edx) : "c"(0));
+  return ((uint64_t) edx << 32) | eax;
+#endif
+}
+
+static TheoreticalPeakCompiler::Isa DetectIsa() {
+  unsigned int regs[4]; // eax, ebx, ecx, edx
+  if (!Cpuid(1, 0, regs))
+    return TheoreticalPeakCompiler::ISA_X86;
+  bool osxsave = (regs[2] >> 27) & 1;
+  bool avx = (regs[2] >> 28) & 1;
+  if (!osxsave || !avx)
+    return TheoreticalPeakCompiler::ISA_X86;
+  uint64_t xcr0 = Xcr0();
+  if ((xcr0 & 0x6) != 0x6) // XMM and YMM state
+    return TheoreticalPeakCompiler::ISA_X86;
+  if (!Cpuid(7, 0, regs))
+    return TheoreticalPeakCompiler::ISA_X86;
+  bool avx2 = (regs[1] >> 5) & 1;
+  bool avx512f = (regs[1] >> 16) & 1;
+  if (avx512f && (xcr0 & 0xe6) == 0xe6) // also opmask and ZMM state
+    return TheoreticalPeakCompiler::ISA_AVX512;
+  if (avx2)
+    return TheoreticalPeakCompiler::ISA_AVX2;
+  return TheoreticalPeakCompiler::ISA_X86;
+}
+
+#endif
+
+TheoreticalPeakCompiler::Isa TheoreticalPeakCompiler::HostIsa() {
+#ifdef TIDE_COMPILER_X86_64
+  static const Isa isa = DetectIsa();
+  return isa;
+#else
+  return ISA_X86;
+#endif
+}
+
+const char* TheoreticalPeakCompiler::IsaName(Isa isa) {
+  switch (isa) {
+  case ISA_AVX2:
+    return "AVX2";
+  case ISA_AVX512:
+    return "AVX-512";
+  default:
+    return "x86";
+  }
+}
+
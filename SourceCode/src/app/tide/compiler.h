@@ -75,26 +75,70 @@
 //    loop +1 // equivalent to dec %ecx; if (ecx != 0) skip one instruction
 //    ret
 //    ... (next program here)
+//
+// On x86-64 machines whose CPU and OS support AVX2 or AVX-512 (checked once
+// with CPUID at run time), the positive peaks are instead added in groups of
+// 8 (AVX2) or 16 (AVX-512) with gather instructions. The cache indices of the
+// gathered peaks are stored inline at the start of the program, behind a jump
+// that skips over them:
+//
+//    jmp code
+//    .int 72, 195, 546, ... // gather indices
+//  code:
+//    vpxor %ymm0, %ymm0, %ymm0
+//    vmovdqu indices(%rip), %ymm1 // (vmovdqu32 ... %zmm1 for AVX-512)
+//    vpcmpeqd %ymm2, %ymm2, %ymm2 // all-ones gather mask (kxnorw for AVX-512)
+//    vpgatherdd %ymm2, (%rdx,%ymm1,4), %ymm3 // ymm3[i] = cache[ymm1[i]]
+//    vpaddd %ymm3, %ymm0, %ymm0
+//    ... (one gather per group of peaks)
+//    ... (horizontal sum of ymm0 into eax)
+//    vzeroupper
+//    add (%rdx+disp), %eax // remaining peaks, as above
+//    ...
+//    stosl ... (same coda as above)
+//
+// Programs of both kinds use the same registers on entry and the same coda,
+// so they may be freely mixed in the chain, and the caller does not need to
+// know which instruction set was used. Otherwise the plain x86 code above is
+// generated.
 
 #ifndef COMPILER_H
 #define COMPILER_H
 
+#include <assert.h>
 #include <stdint.h>
+#include <string.h>
+#include <vector>
 
 class TheoreticalPeakCompiler {
  public:
+  // Instruction sets the generated programs may use.
+  enum Isa {
+    ISA_X86,     // mov/add/sub from the cache, one peak at a time
+    ISA_AVX2,    // 8-wide gathers for the positive peaks
+    ISA_AVX512   // 16-wide gathers, then at most one 8-wide gather
+  };
+
   explicit TheoreticalPeakCompiler(FifoAllocator* fifo_alloc) 
-    : fifo_alloc_(fifo_alloc), last_alloc_end_(NULL) {
+    : fifo_alloc_(fifo_alloc), last_alloc_end_(NULL), isa_(HostIsa()) {
       // fifo_alloc_ will make room for generated programs.
   }
 
+  // Best instruction set supported by both the CPU and the OS, determined
+  // with CPUID on first use. ISA_X86 on anything but x86-64.
+  static Isa HostIsa();
+  static const char* IsaName(Isa isa);
+
+  Isa GetIsa() const { return isa_; }
+
   void* Init(int pos_size, int neg_size) {
     // Init() gets called once per candidate peptide.
     // pos_size is the number of cache entries to be added together, neg_size
-    // is the number to be subtracted.
-    // add or sub instructions take six bytes. The coda (containing the
-    // storage of results etc.) takes seven bytes.
-    int total_size = 6*(pos_size + neg_size) + 7;
+    // is the number to be subtracted. The peaks are collected by the Add
+    // functions and the program is written by Done(), so that the peaks can
+    // be grouped for the gather instructions. ProgramSize() is the room
+    // needed in the worst case, i.e. when no peak is past the cache end.
+    int total_size = ProgramSize(pos_size, neg_size);
     pos_ = (unsigned char*) fifo_alloc_->New(total_size); 
     // last_alloc_end points just beyond the last allocated program. By the
     // end of this block, we will ensure that there is enough room for a five
@@ -112,7 +156,8 @@ class TheoreticalPeakCompiler {
         AddJump(last_alloc_end_ - jmp_size, pos_);
       last_alloc_end_ = pos_ + total_size;
     }
-    first_ = true; // first theoretical peak gets handled a bit differently. 
+    pos_peaks_.clear();
+    neg_peaks_.clear();
     return pos_; 
   }
 
@@ -120,40 +165,54 @@ class TheoreticalPeakCompiler {
   // doesn't point past end of cache.
     
   void AddPositive(const TheoreticalPeakArr& peaks) {
-    // Write an add instruction for each entry in peaks.
+    // Collect each entry in peaks for an add instruction.
     int end = MaxBin::Global().CacheBinEnd() * NUM_PEAK_TYPES;
     for (int i = 0; i < peaks.size(); ++i)
       if (peaks[i].Code() < end)
-        AddPositive(peaks[i].Code());
+        pos_peaks_.push_back(peaks[i].Code());
   }
 
   void AddPositive(const google::protobuf::RepeatedField<int>& peaks) {
-    // Write an add instruction for each entry in peaks.
+    // Collect each entry in peaks for an add instruction.
     int end = MaxBin::Global().CacheBinEnd() * NUM_PEAK_TYPES;
     int total = 0;
     google::protobuf::RepeatedField<int>::const_iterator i = peaks.begin();
     for (; i != peaks.end(); ++i) {
       if ((total += *i) >= end)
         break;
-      AddPositive(total);
+      pos_peaks_.push_back(total);
     }
   }
 
   void AddNegative(const google::protobuf::RepeatedField<int>& peaks) {
-    // Write a sub instruction for each entry in peaks.
+    // Collect each entry in peaks for a sub instruction.
     int end = MaxBin::Global().CacheBinEnd() * NUM_PEAK_TYPES;
     int total = 0;
     google::protobuf::RepeatedField<int>::const_iterator i = peaks.begin();
     for (; i != peaks.end(); ++i) {
       if ((total += *i) >= end)
         break;
-      AddNegative(total);
+      neg_peaks_.push_back(total);
     }
   }
 
   void Done() {
-    // Write the coda instructions which will store results and update
-    // counter. See comments above.
+    // Write the program body for the collected peaks, then the coda
+    // instructions which will store results and update counter. See
+    // comments above.
+    first_ = true; // first theoretical peak gets handled a bit differently. 
+    int num_pos = pos_peaks_.size();
+    int vec_peaks = VectorPeaks(num_pos);
+    if (vec_peaks > 0)
+      AddGathers(vec_peaks);
+    for (int i = vec_peaks; i < num_pos; ++i)
+      AddPositive(pos_peaks_[i]);
+    for (size_t i = 0; i < neg_peaks_.size(); ++i)
+      AddNegative(neg_peaks_[i]);
+    if (first_) { // no peaks at all: score is 0
+      *pos_++ = 0x31; // xor %eax, %eax
+      *pos_++ = 0xc0;
+    }
     // Poke machine code into the next 7 bytes at pos_.
     // (int*) pos_ must be a four byte pointer!
     *((int*) pos_) = 0xc889ab; // stosl; mov %ecx, %eax
@@ -174,6 +233,101 @@ class TheoreticalPeakCompiler {
 
   static const int jmp_size = 5;
 
+  // Sizes of the instruction sequences written by AddGathers().
+  static const int vpxor_size = 4;
+  static const int gather8_size = 22;
+  static const int reduce16_size = 11;
+  static const int reduce8_size = 35;
+
+  // Number of positive peaks (a multiple of 8) that are added with gathers.
+  int VectorPeaks(int num_pos) const {
+    return isa_ == ISA_X86 ? 0 : num_pos - num_pos % 8;
+  }
+
+  // Upper bound on the size of a program for num_pos positive and num_neg
+  // negative peaks, and for any smaller number of peaks left after dropping
+  // those past the cache end. Each group of peaks is counted as an 8-wide
+  // gather, which takes more room per peak than a 16-wide one.
+  int ProgramSize(int num_pos, int num_neg) const {
+    int vec_peaks = VectorPeaks(num_pos);
+    int size = 6*(num_pos - vec_peaks + num_neg) + 2 + 7; // +2 for xor
+    if (vec_peaks > 0)
+      size += jmp_size + vpxor_size + reduce16_size + reduce8_size +
+              (vec_peaks / 8) * (4*8 + gather8_size);
+    return size;
+  }
+
+  void Emit(const unsigned char* code, int size) {
+    memcpy(pos_, code, size);
+    pos_ += size;
+  }
+
+  // Writes 4-byte displacement from the end of the current instruction,
+  // which ends right after the displacement, to target.
+  void EmitRipDisplacement(const unsigned char* target) {
+    *((int*) pos_) = target - (pos_ + 4);
+    pos_ += 4;
+  }
+
+  void AddGathers(int vec_peaks) {
+    static const unsigned char vpxor_ymm0[] = { 0xc5, 0xfd, 0xef, 0xc0 };
+    // vmovdqu disp32(%rip), %ymm1 (disp32 follows)
+    static const unsigned char vmovdqu_ymm1[] = { 0xc5, 0xfe, 0x6f, 0x0d };
+    static const unsigned char gather8[] = {
+      0xc5, 0xed, 0x76, 0xd2,             // vpcmpeqd %ymm2, %ymm2, %ymm2
+      0xc4, 0xe2, 0x6d, 0x90, 0x1c, 0x8a, // vpgatherdd %ymm2, (%rdx,%ymm1,4), %ymm3
+      0xc5, 0xfd, 0xfe, 0xc3              // vpaddd %ymm3, %ymm0, %ymm0
+    };
+    // vmovdqu32 disp32(%rip), %zmm1 (disp32 follows)
+    static const unsigned char vmovdqu32_zmm1[] = { 0x62, 0xf1, 0x7e, 0x48, 0x6f, 0x0d };
+    static const unsigned char gather16[] = {
+      0xc5, 0xf4, 0x46, 0xc9,                   // kxnorw %k1, %k1, %k1
+      0x62, 0xf2, 0x7d, 0x49, 0x90, 0x1c, 0x8a, // vpgatherdd (%rdx,%zmm1,4), %zmm3{%k1}
+      0x62, 0xf1, 0x7d, 0x48, 0xfe, 0xc3        // vpaddd %zmm3, %zmm0, %zmm0
+    };
+    static const unsigned char reduce16[] = {
+      0x62, 0xf3, 0xfd, 0x48, 0x3b, 0xc1, 0x01, // vextracti64x4 $1, %zmm0, %ymm1
+      0xc5, 0xfd, 0xfe, 0xc1                    // vpaddd %ymm1, %ymm0, %ymm0
+    };
+    static const unsigned char reduce8[] = {
+      0xc4, 0xe3, 0x7d, 0x39, 0xc1, 0x01, // vextracti128 $1, %ymm0, %xmm1
+      0xc5, 0xf9, 0xfe, 0xc1,             // vpaddd %xmm1, %xmm0, %xmm0
+      0xc5, 0xf9, 0x70, 0xc8, 0x4e,       // vpshufd $0x4e, %xmm0, %xmm1
+      0xc5, 0xf9, 0xfe, 0xc1,             // vpaddd %xmm1, %xmm0, %xmm0
+      0xc5, 0xf9, 0x70, 0xc8, 0xb1,       // vpshufd $0xb1, %xmm0, %xmm1
+      0xc5, 0xf9, 0xfe, 0xc1,             // vpaddd %xmm1, %xmm0, %xmm0
+      0xc5, 0xf9, 0x7e, 0xc0,             // vmovd %xmm0, %eax
+      0xc5, 0xf8, 0x77                    // vzeroupper
+    };
+
+    // Jump over the gather indices, which are stored first.
+    int index_bytes = 4*vec_peaks;
+    *pos_ = jmp_relative;
+    *((int*) (pos_ + 1)) = index_bytes;
+    pos_ += jmp_size;
+    const unsigned char* indices = pos_;
+    Emit((const unsigned char*) &pos_peaks_[0], index_bytes);
+
+    Emit(vpxor_ymm0, vpxor_size);
+    int done = 0;
+    if (isa_ == ISA_AVX512) {
+      for (; vec_peaks - done >= 16; done += 16) {
+        Emit(vmovdqu32_zmm1, sizeof(vmovdqu32_zmm1));
+        EmitRipDisplacement(indices + 4*done);
+        Emit(gather16, sizeof(gather16));
+      }
+      if (done > 0)
+        Emit(reduce16, reduce16_size);
+    }
+    for (; done < vec_peaks; done += 8) {
+      Emit(vmovdqu_ymm1, sizeof(vmovdqu_ymm1));
+      EmitRipDisplacement(indices + 4*done);
+      Emit(gather8, sizeof(gather8));
+    }
+    Emit(reduce8, reduce8_size);
+    first_ = false; // eax holds the sum so far
+  }
+
   void AddPositive(int peak) {
     if (first_) { // First theoretical peak uses a 'mov' rather than an 'add'
       *((uint16_t*) pos_) = mov_to_eax_at_edx_plus;
@@ -187,6 +341,11 @@ class TheoreticalPeakCompiler {
   }
 
   void AddNegative(int peak) {
+    if (first_) { // Nothing to subtract from yet
+      *pos_++ = 0x31; // xor %eax, %eax
+      *pos_++ = 0xc0;
+      first_ = false;
+    }
     *((uint16_t*) pos_) = sub_from_eax_at_edx_plus;
     pos_ += 2;
     *((int*) pos_) = peak << 2; // Store 4 * the peak position.
@@ -203,6 +362,10 @@ class TheoreticalPeakCompiler {
   unsigned char* last_alloc_end_;
   unsigned char* pos_; // "cursor position" as we write out instructions.
   bool first_;
+  Isa isa_;
+  // Peaks collected between Init() and Done(), as cache indices.
+  std::vector<int> pos_peaks_;
+  std::vector<int> neg_peaks_;
 };
 
 #endif // COMPILER_H
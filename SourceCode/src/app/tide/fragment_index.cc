@@ -0,0 +1,132 @@
+// See fragment_index.h.
+
+#include <algorithm>
+#include "fragment_index.h"
+#include "records.h"
+#include "peptide.h"
+#include "theoretical_peak_set.h"
+
+using namespace std;
+
+// Collects the m/z of the singly charged b and y ions of a peptide.
+class FragmentIonSet : public TheoreticalPeakSet {
+ public:
+  void Clear() { mzs_.clear(); }
+  void AddBIon(double mass, int charge) {
+    if (charge == 1)
+      mzs_.push_back(mass + MassConstants::B + MassConstants::proton);
+  }
+  void AddYIon(double mass, int charge) {
+    if (charge == 1)
+      mzs_.push_back(mass + MassConstants::Y + MassConstants::proton);
+  }
+  void GetPeaks(TheoreticalPeakArr* peaks_charge_1,
+                TheoreticalPeakArr* negs_charge_1,
+                TheoreticalPeakArr* peaks_charge_2,
+                TheoreticalPeakArr* negs_charge_2,
+                const pb::Peptide* peptide = NULL) {
+  }
+  const vector<double>& MZs() const { return mzs_; }
+
+ private:
+  vector<double> mzs_;
+};
+
+FragmentIndexBuilder::FragmentIndexBuilder(
+    const vector<const pb::Protein*>& proteins,
+    double bin_width, double bin_offset)
+  : proteins_(proteins), bin_width_(bin_width), bin_offset_(bin_offset),
+    num_peptides_(0) {
+}
+
+void FragmentIndexBuilder::Add(const pb::Peptide& pb_peptide) {
+  if (pb_peptide.id() != num_peptides_) {
+    carp(CARP_FATAL, "Peptide %d added to the fragment index as peptide %d",
+         pb_peptide.id(), num_peptides_);
+  }
+  ++num_peptides_;
+  Peptide peptide(pb_peptide, proteins_);
+  FragmentIonSet ions;
+  peptide.ComputeTheoreticalPeaks(&ions);
+  for (vector<double>::const_iterator i = ions.MZs().begin();
+       i != ions.MZs().end(); ++i) {
+    int bin = (int)(*i / bin_width_ + 1.0 - bin_offset_);
+    if (bin < 0)
+      continue;
+    if (bin >= bins_.size())
+      bins_.resize(bin + 1);
+    // A b and a y ion can fall in the same bin.
+    if (bins_[bin].empty() || bins_[bin].back() != pb_peptide.id())
+      bins_[bin].push_back(pb_peptide.id());
+  }
+}
+
+bool FragmentIndexBuilder::Write(const string& filename,
+                                 const pb::Header& peptides_header) {
+  pb::Header header;
+  header.set_file_type(pb::Header::FRAGMENTS);
+  pb::Header_Source* source = header.add_source();
+  source->mutable_header()->CopyFrom(peptides_header);
+  pb::Header_FragmentsHeader* fragments_header = header.mutable_fragments_header();
+  fragments_header->set_bin_width(bin_width_);
+  fragments_header->set_bin_offset(bin_offset_);
+  fragments_header->set_num_peptides(num_peptides_);
+
+  HeadedRecordWriter writer(filename, header);
+  if (!writer.OK())
+    return false;
+  pb::FragmentBin fragment_bin;
+  for (int bin = 0; bin < bins_.size(); ++bin) {
+    if (bins_[bin].empty())
+      continue;
+    fragment_bin.Clear();
+    fragment_bin.set_bin(bin);
+    int last = 0;
+    for (vector<int>::const_iterator i = bins_[bin].begin();
+         i != bins_[bin].end(); ++i) {
+      fragment_bin.add_peptide_ids(*i - last);
+      last = *i;
+    }
+    if (!writer.Write(&fragment_bin))
+      return false;
+  }
+  return true;
+}
+
+bool FragmentIndex::Read(const string& filename) {
+  pb::Header header;
+  HeadedRecordReader reader(filename, &header);
+  if (!reader.OK() || header.file_type() != pb::Header::FRAGMENTS ||
+      !header.has_fragments_header())
+    return false;
+  bin_width_ = header.fragments_header().bin_width();
+  bin_offset_ = header.fragments_header().bin_offset();
+  num_peptides_ = header.fragments_header().num_peptides();
+
+  starts_.clear();
+  ids_.clear();
+  pb::FragmentBin fragment_bin;
+  while (!reader.Done()) {
+    if (!reader.Read(&fragment_bin))
+      return false;
+    // Bins without ions have no record and start where the next one does.
+    starts_.resize(fragment_bin.bin() + 1, ids_.size());
+    int id = 0;
+    for (int i = 0; i < fragment_bin.peptide_ids_size(); ++i) {
+      id += fragment_bin.peptide_ids(i);
+      ids_.push_back(id);
+    }
+  }
+  starts_.push_back(ids_.size());
+  return true;
+}
+
+void FragmentIndex::Count(int bin, int first_id, vector<int>* counts) const {
+  if (bin < 0 || bin + 1 >= starts_.size())
+    return;
+  const int* begin = &ids_[0] + starts_[bin];
+  const int* end = &ids_[0] + starts_[bin + 1];
+  int end_id = first_id + counts->size();
+  for (const int* i = lower_bound(begin, end, first_id); i != end && *i < end_id; ++i)
+    ++(*counts)[*i - first_id];
+}
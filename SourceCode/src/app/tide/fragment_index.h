@@ -0,0 +1,70 @@
+// FragmentIndex is an inverted index from the m/z bins of the singly charged
+// b and y ions of the peptides in an index to the ids of the peptides with an
+// ion in each bin. tide-index writes it to the fragix file of the index when
+// fragment-index is set. Open modification searches use wide precursor
+// windows, which admit so many candidates that scoring all of them with
+// XCorr dominates the search; with fragment-candidates, tide-search instead
+// counts the ions each candidate shares with the most intense peaks of the
+// spectrum, and scores only the candidates with the highest counts.
+//
+// Peptide ids are those of the peptides file, which numbers peptides
+// sequentially in order of mass, so the candidates of a spectrum are a
+// range of ids, and each bin's ids are sorted so that the range can be
+// found by binary search.
+
+#ifndef FRAGMENT_INDEX_H
+#define FRAGMENT_INDEX_H
+
+#include <string>
+#include <vector>
+#include "header.pb.h"
+#include "peptides.pb.h"
+#include "raw_proteins.pb.h"
+
+using namespace std;
+
+class FragmentIndexBuilder {
+ public:
+  FragmentIndexBuilder(const vector<const pb::Protein*>& proteins,
+                       double bin_width, double bin_offset);
+
+  // Peptides have to be added in order of id, starting from 0.
+  void Add(const pb::Peptide& peptide);
+
+  bool Write(const string& filename, const pb::Header& peptides_header);
+
+ private:
+  const vector<const pb::Protein*>& proteins_;
+  double bin_width_;
+  double bin_offset_;
+  int num_peptides_;
+  vector<vector<int> > bins_;  // ids of the peptides with an ion in each bin
+};
+
+class FragmentIndex {
+ public:
+  FragmentIndex() : bin_width_(0), bin_offset_(0), num_peptides_(0) {}
+
+  bool Read(const string& filename);
+
+  // Same discretization as MassConstants::mass2bin, with the bin width and
+  // offset the index was built with.
+  int Bin(double mz) const {
+    return (int)(mz / bin_width_ + 1.0 - bin_offset_);
+  }
+
+  // Adds 1 to (*counts)[id - first_id] for each peptide with an ion in bin
+  // whose id is in [first_id, first_id + counts->size()).
+  void Count(int bin, int first_id, vector<int>* counts) const;
+
+  int NumPeptides() const { return num_peptides_; }
+
+ private:
+  double bin_width_;
+  double bin_offset_;
+  int num_peptides_;
+  vector<int> starts_;  // offset in ids_ of the ids of each bin, and the end
+  vector<int> ids_;
+};
+
+#endif // FRAGMENT_INDEX_H
@@ -0,0 +1,309 @@
+// See indexed_spectra.h.
+
+#include <algorithm>
+#include <cstdio>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include "indexed_spectra.h"
+#include "mass_constants.h"
+
+using namespace std;
+using google::protobuf::uint8;
+using google::protobuf::uint32;
+using google::protobuf::uint64;
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::io::CodedOutputStream;
+
+#define SPECTRA_FOOTER_MAGIC  0xfead5678ul
+
+static const int kBlockSize = 1 << 16;  // uncompressed bytes of peaks per block
+static const int kIndexPartSize = 1 << 16;  // spectra per SpectrumIndex record
+
+SpectraWriter::SpectraWriter(const string& filename, const pb::Header& header,
+                             int version)
+  : filename_(filename), header_(header), records_(NULL), fd_(-1) {
+  if (version < 2) {
+    records_ = new HeadedRecordWriter(filename, header_);
+    return;
+  }
+  header_.mutable_spectra_header()->set_version(2);
+  if ((fd_ = open(filename.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644)) < 0) {
+    carp(CARP_FATAL, "Couldn't open file %s for write (errno %d: %s).",
+         filename.c_str(), errno, strerror(errno));
+  }
+  spill_name_ = filename + ".unsorted";
+  spill_.open(spill_name_.c_str(), ios::out | ios::trunc | ios::binary);
+  if (!spill_) {
+    carp(CARP_FATAL, "Couldn't open file %s for write.", spill_name_.c_str());
+  }
+  spill_offsets_.push_back(0);
+}
+
+SpectraWriter::~SpectraWriter() {
+  delete records_;
+  if (fd_ >= 0)
+    close(fd_);
+  if (!spill_name_.empty()) {
+    spill_.close();
+    remove(spill_name_.c_str());
+  }
+}
+
+bool SpectraWriter::Write(const pb::Spectrum* spectrum) {
+  if (records_)
+    return records_->Write(spectrum);
+  double mass = spectrum->precursor_m_z();
+  if (spectrum->charge_state_size() > 0)
+    mass = (mass - MassConstants::proton) * spectrum->charge_state(0);
+  order_.push_back(make_pair(mass, (int)order_.size()));
+  string serialized = spectrum->SerializeAsString();
+  spill_.write(serialized.data(), serialized.size());
+  spill_offsets_.push_back(spill_offsets_.back() + serialized.size());
+  return !spill_.fail();
+}
+
+bool SpectraWriter::Close() {
+  if (records_) {
+    bool ok = records_->OK();
+    delete records_;  // writes the end-of-records marker
+    records_ = NULL;
+    return ok;
+  }
+  if (fd_ < 0)
+    return false;
+  spill_.close();
+  bool ok = !spill_.fail() && WriteIndexed();
+  ok = close(fd_) == 0 && ok;
+  fd_ = -1;
+  remove(spill_name_.c_str());
+  spill_name_.clear();
+  return ok;
+}
+
+static void AppendVarint(uint64 value, string* out) {
+  uint8 buf[10];  // longest varint
+  uint8* end = CodedOutputStream::WriteVarint64ToArray(value, buf);
+  out->append((const char*)buf, end - buf);
+}
+
+// Compresses block and writes it at *offset, recording where it went in
+// index.
+static void WriteBlock(CodedOutputStream* out, uint64* offset, string* block,
+                       pb::SpectrumIndex* index) {
+  namespace io = boost::iostreams;
+  string compressed;
+  {
+    io::filtering_ostream zipper;
+    zipper.push(io::zlib_compressor(io::zlib::best_speed));
+    zipper.push(io::back_inserter(compressed));
+    zipper.write(block->data(), block->size());
+  }
+  index->add_block_start(*offset);
+  index->add_block_length(compressed.size());
+  index->add_block_raw_length(block->size());
+  out->WriteRaw(compressed.data(), compressed.size());
+  *offset += compressed.size();
+  block->clear();
+}
+
+bool SpectraWriter::WriteIndexed() {
+  google::protobuf::io::FileOutputStream raw_output(fd_);
+  CodedOutputStream out(&raw_output);
+  out.WriteLittleEndian32(MAGIC_NUMBER);
+  out.WriteVarint32(header_.ByteSize());
+  header_.SerializeWithCachedSizes(&out);
+  out.WriteVarint32(0);  // version 1 readers stop here
+  // CodedOutputStream counts bytes in an int, so the offset is kept here.
+  uint64 offset = sizeof(uint32) +
+    CodedOutputStream::VarintSize32(header_.GetCachedSize()) +
+    header_.GetCachedSize() + CodedOutputStream::VarintSize32(0);
+
+  // The spilled spectra are read back in order of mass from a mapping of the
+  // file, so that only the pages being encoded need to be resident.
+  boost::iostreams::mapped_file_source spilled;
+  if (!order_.empty()) {
+    try {
+      spilled.open(spill_name_);
+    } catch (const std::exception& e) {
+      carp(CARP_ERROR, "Cannot map %s: %s", spill_name_.c_str(), e.what());
+      return false;
+    }
+    if (!spilled.is_open() || spilled.size() != spill_offsets_.back())
+      return false;
+  }
+
+  // Each index part holds the fields of its spectra, and of the blocks
+  // written while they were added; the reader concatenates them.
+  sort(order_.begin(), order_.end());
+  vector<string> footer;
+  pb::SpectrumIndex part;
+  pb::Spectrum spectrum;
+  string block;
+  int num_blocks = 0;
+  bool block_used = false;
+  for (vector<pair<double, int> >::const_iterator i = order_.begin();
+       i != order_.end(); ++i) {
+    uint64 start = spill_offsets_[i->second];
+    if (!spectrum.ParseFromArray(spilled.data() + start,
+                                 spill_offsets_[i->second + 1] - start))
+      return false;
+    part.add_spectrum_number(spectrum.spectrum_number());
+    part.add_precursor_m_z(spectrum.precursor_m_z());
+    part.add_rtime(spectrum.rtime());
+    part.add_num_charge_states(spectrum.charge_state_size());
+    for (int j = 0; j < spectrum.charge_state_size(); ++j)
+      part.add_charge_state(spectrum.charge_state(j));
+
+    int size = spectrum.peak_m_z_size();
+    if (size != spectrum.peak_intensity_size())
+      return false;
+    part.add_num_peaks(size);
+    part.add_peak_m_z_denominator(spectrum.peak_m_z_denominator());
+    part.add_peak_intensity_denominator(spectrum.peak_intensity_denominator());
+    part.add_peaks_block(num_blocks);
+    block_used = true;
+    part.add_peaks_offset(block.size());
+    uint64 total = 0;
+    for (int j = 0; j < size; ++j) {
+      total += spectrum.peak_m_z(j);
+      AppendVarint(spectrum.peak_m_z(j), &block);
+    }
+    for (int j = 0; j < size; ++j)
+      AppendVarint(spectrum.peak_intensity(j), &block);
+    part.add_max_m_z(size > 0 ? total / (double)spectrum.peak_m_z_denominator() : 0);
+
+    if (block.size() >= kBlockSize) {
+      WriteBlock(&out, &offset, &block, &part);
+      ++num_blocks;
+      block_used = false;
+    }
+    if (part.spectrum_number_size() == kIndexPartSize) {
+      footer.push_back(part.SerializeAsString());
+      part.Clear();
+    }
+  }
+  if (block_used)
+    WriteBlock(&out, &offset, &block, &part);
+  footer.push_back(part.SerializeAsString());
+  order_.clear();
+  spill_offsets_.clear();
+
+  uint64 footer_start = offset;
+  for (vector<string>::const_iterator i = footer.begin(); i != footer.end(); ++i) {
+    out.WriteVarint32(i->size());
+    out.WriteRaw(i->data(), i->size());
+  }
+  out.WriteVarint32(0);
+  out.WriteLittleEndian64(footer_start);
+  out.WriteLittleEndian32(SPECTRA_FOOTER_MAGIC);
+  return !out.HadError();
+}
+
+bool IndexedSpectra::Open(const string& filename) {
+  try {
+    file_.open(filename);
+  } catch (const std::exception& e) {
+    carp(CARP_ERROR, "Cannot map %s: %s", filename.c_str(), e.what());
+    return false;
+  }
+  const int kTrailerSize = 12;
+  const uint8* data = (const uint8*)file_.data();
+  if (!file_.is_open() || file_.size() < kTrailerSize)
+    return false;
+  const uint8* trailer = data + file_.size() - kTrailerSize;
+  uint64 footer_start;
+  uint32 magic;
+  CodedInputStream::ReadLittleEndian32FromArray(
+    CodedInputStream::ReadLittleEndian64FromArray(trailer, &footer_start), &magic);
+  if (magic != SPECTRA_FOOTER_MAGIC || footer_start > (uint64)(trailer - data))
+    return false;
+
+  index_.Clear();
+  const uint8* p = data + footer_start;
+  while (true) {
+    CodedInputStream input(p, trailer - p);
+    uint32 size;
+    if (!input.ReadVarint32(&size))
+      return false;
+    p += input.CurrentPosition();
+    if (size == 0)
+      break;
+    if (size > (uint32)(trailer - p))
+      return false;
+    CodedInputStream part(p, size);
+    if (!index_.MergeFromCodedStream(&part))
+      return false;
+    p += size;
+  }
+
+  int num_spectra = Size();
+  int num_blocks = index_.block_start_size();
+  if (index_.precursor_m_z_size() != num_spectra ||
+      index_.rtime_size() != num_spectra ||
+      index_.num_charge_states_size() != num_spectra ||
+      index_.num_peaks_size() != num_spectra ||
+      index_.max_m_z_size() != num_spectra ||
+      index_.peak_m_z_denominator_size() != num_spectra ||
+      index_.peak_intensity_denominator_size() != num_spectra ||
+      index_.peaks_block_size() != num_spectra ||
+      index_.peaks_offset_size() != num_spectra ||
+      index_.block_length_size() != num_blocks ||
+      index_.block_raw_length_size() != num_blocks)
+    return false;
+  for (int i = 0; i < num_blocks; ++i) {
+    if (index_.block_start(i) < 0 || index_.block_length(i) < 0 ||
+        index_.block_start(i) + index_.block_length(i) > footer_start)
+      return false;
+  }
+  charge_starts_.resize(num_spectra);
+  int charge_start = 0;
+  for (int i = 0; i < num_spectra; ++i) {
+    int block = index_.peaks_block(i);
+    if (block < 0 || block >= num_blocks || index_.peaks_offset(i) < 0 ||
+        index_.peaks_offset(i) > index_.block_raw_length(block))
+      return false;
+    charge_starts_[i] = charge_start;
+    charge_start += index_.num_charge_states(i);
+  }
+  return charge_start == index_.charge_state_size();
+}
+
+const uint8* IndexedSpectra::Peaks(int spectrum, SpectrumBlockCache* cache,
+                                   const uint8** end) const {
+  int block = index_.peaks_block(spectrum);
+  SpectrumBlockCache::Entry* entry = cache->entries;
+  for (int i = 0; i < SpectrumBlockCache::kNumEntries; ++i) {
+    SpectrumBlockCache::Entry* e = cache->entries + i;
+    if (e->source == this && e->block == block) {
+      entry = e;
+      break;
+    }
+    if (e->used < entry->used)
+      entry = e;
+  }
+  if (entry->source != this || entry->block != block) {
+    namespace io = boost::iostreams;
+    streamsize raw_size = index_.block_raw_length(block);
+    entry->source = NULL;
+    entry->data.resize(raw_size);
+    try {
+      io::filtering_istream unzipper;
+      unzipper.push(io::zlib_decompressor());
+      unzipper.push(io::array_source(file_.data() + index_.block_start(block),
+                                     index_.block_length(block)));
+      unzipper.read(&entry->data[0], raw_size);
+      if (unzipper.gcount() != raw_size)
+        carp(CARP_FATAL, "Block %d of the spectra is truncated", block);
+    } catch (const io::zlib_error& e) {
+      carp(CARP_FATAL, "Cannot decompress block %d of the spectra: %s", block, e.what());
+    }
+    entry->source = this;
+    entry->block = block;
+  }
+  entry->used = ++cache->clock;
+  const uint8* data = (const uint8*)entry->data.data();
+  *end = data + entry->data.size();
+  return data + index_.peaks_offset(spectrum);
+}
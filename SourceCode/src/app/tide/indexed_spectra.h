@@ -0,0 +1,108 @@
+// Version 2 of the spectrumrecords format lets tide-search keep the peaks of
+// its spectra encoded until it searches them. A version 1 file is a file of
+// records (see records.h) of a header and one pb::Spectrum per spectrum,
+// which can only be read in order and in full. A version 2 file is laid out
+// as:
+//
+//   magic number, header record, end-of-records marker
+//   blocks of peaks, each compressed with zlib
+//   footer: SpectrumIndex records (see spectrum.proto), end-of-records marker
+//   offset of the footer (8 bytes), SPECTRA_FOOTER_MAGIC (4 bytes)
+//
+// so readers of version 1 files see a header and no spectra. Spectra are
+// stored in order of the neutral mass of their first charge state, which is
+// the order in which tide-search searches them, so the spectra searched one
+// after another share blocks. Within a block, the peaks of each spectrum are
+// the varint-encoded m/z deltas and intensities of its pb::Spectrum.
+//
+// IndexedSpectra maps a version 2 file into memory and reads the footer; the
+// index gives the scan number, precursor m/z, charge states and highest m/z
+// of each spectrum without touching its peaks. Peaks() decompresses the block
+// of a spectrum into a SpectrumBlockCache owned by the caller. The spectrum-
+// charges a search thread visits lie in as many regions of the file as the
+// spectra have charge states, so the cache keeps the last few blocks, and the
+// thread decompresses each of them once for the spectra it searches in it.
+
+#ifndef INDEXED_SPECTRA_H
+#define INDEXED_SPECTRA_H
+
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <google/protobuf/stubs/common.h>
+#include "header.pb.h"
+#include "spectrum.pb.h"
+#include "records.h"
+
+using namespace std;
+
+class IndexedSpectra;
+
+// The blocks a reader decompressed last, replaced least recently used first.
+struct SpectrumBlockCache {
+  SpectrumBlockCache() : clock(0) {}
+
+  struct Entry {
+    Entry() : source(NULL), block(-1), used(0) {}
+
+    const IndexedSpectra* source;
+    int block;
+    unsigned long used;  // clock when last read
+    string data;
+  };
+
+  static const int kNumEntries = 8;
+  Entry entries[kNumEntries];
+  unsigned long clock;
+};
+
+// Writes a spectrumrecords file of the given version. Version 1 writes each
+// spectrum as it is added; version 2 spills the serialized spectra to a
+// temporary file next to the output, keeping only their masses and offsets,
+// until Close() writes them in order of mass.
+class SpectraWriter {
+ public:
+  SpectraWriter(const string& filename, const pb::Header& header, int version);
+  ~SpectraWriter();
+
+  bool OK() const { return records_ ? records_->OK() : fd_ >= 0; }
+  bool Write(const pb::Spectrum* spectrum);
+  bool Close();
+
+ private:
+  bool WriteIndexed();
+
+  string filename_;
+  pb::Header header_;
+  HeadedRecordWriter* records_;  // version 1
+  int fd_;  // version 2
+  vector<pair<double, int> > order_;  // neutral mass and number of each spectrum
+  string spill_name_;  // version 2: serialized spectra in the order written
+  ofstream spill_;
+  vector<google::protobuf::uint64> spill_offsets_;  // start of each, and the end
+};
+
+class IndexedSpectra {
+ public:
+  // Maps the file and reads its footer. The file has to be version 2.
+  bool Open(const string& filename);
+
+  const pb::SpectrumIndex& Index() const { return index_; }
+  int Size() const { return index_.spectrum_number_size(); }
+  int ChargeStart(int spectrum) const { return charge_starts_[spectrum]; }
+
+  // Returns the encoded peaks of a spectrum, decompressing its block into
+  // cache unless it is there already. *end is set to the end of the block,
+  // which stays valid until kNumEntries other blocks have been read.
+  const google::protobuf::uint8* Peaks(int spectrum, SpectrumBlockCache* cache,
+                                       const google::protobuf::uint8** end) const;
+
+ private:
+  boost::iostreams::mapped_file_source file_;
+  pb::SpectrumIndex index_;
+  vector<int> charge_starts_;  // offset of each spectrum's charge states
+};
+
+#endif // INDEXED_SPECTRA_H
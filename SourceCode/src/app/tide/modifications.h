@@ -1,5 +1,8 @@
 // Benjamin Diament
 
+#ifndef MODIFICATIONS_H
+#define MODIFICATIONS_H
+
 #include<climits>
 #include<algorithm>
 #include<iostream>
@@ -193,6 +196,32 @@ class VariableModTable {
     }
     return true;
   }
+  // Rebuilds the table from the mod tables that tide-index stored in a
+  // peptides header, so that modified peptides can be enumerated at search
+  // time. The tables are read in the order they were parsed at indexing time,
+  // which determines the indices into MaxCounts() and OriginalDeltas().
+  bool Load(const pb::ModTable& mods, const pb::ModTable& nterm_mods,
+            const pb::ModTable& cterm_mods) {
+    ClearTables();
+    pb_mod_table_.CopyFrom(mods);
+    pb_ctpep_mod_table_.CopyFrom(cterm_mods);
+    pb_ntpep_mod_table_.CopyFrom(nterm_mods);
+    const pb::ModTable* tables[] = {
+      &pb_mod_table_, &pb_ctpep_mod_table_, &pb_ntpep_mod_table_
+    };
+    for (int i = 0; i < 3; ++i) {
+      for (int j = 0; j < tables[i]->variable_mod_size(); ++j) {
+        const pb::Modification& mod = tables[i]->variable_mod(j);
+        original_deltas_.push_back(mod.delta());
+        max_counts_.push_back(mod.max_count());
+      }
+    }
+    unique_delta_.assign(mods.unique_deltas().begin(), mods.unique_deltas().end());
+    coder_.Init(unique_delta_.size());
+    return Init(pb_mod_table_) && Init(pb_ctpep_mod_table_) &&
+           Init(pb_ntpep_mod_table_);
+  }
+
   void ClearTables() {
     pb_mod_table_.Clear();
     pb_ntpep_mod_table_.Clear();
@@ -350,3 +379,4 @@ class VariableModTable {
   pb::ModTable pb_ctpro_mod_table_; //modification table for c-terminal protein modifications
 };
 
+#endif // MODIFICATIONS_H
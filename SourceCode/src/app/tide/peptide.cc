@@ -244,6 +244,14 @@ void Peptide::ComputeTheoreticalPeaks(ST_TheoreticalPeakSet* workspace,
 #endif
 }
 
+void Peptide::CompileStoredPeaks(ST_TheoreticalPeakSet* workspace,
+                                 const pb::Peptide& pb_peptide,
+                                 TheoreticalPeakCompiler* compiler_prog1,
+                                 TheoreticalPeakCompiler* compiler_prog2) {
+  workspace->SetStoredPeaks(pb_peptide);
+  Compile(workspace->GetPeaks(), pb_peptide, compiler_prog1, compiler_prog2);
+}
+
 // return the amino acid masses in the current peptide
 double* Peptide::getAAMasses(){
   double* masses_charge = new double[Len()];
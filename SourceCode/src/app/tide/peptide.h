@@ -175,6 +175,12 @@ class Peptide {
                                const pb::Peptide& pb_peptide,
                                TheoreticalPeakCompiler* compiler_prog1,
                                TheoreticalPeakCompiler* compiler_prog2);
+  // Like the second version, but the peaks are read from pb_peptide, in which
+  // tide-index stored them with store-peaks (see peptide_peaks.cc).
+  void CompileStoredPeaks(ST_TheoreticalPeakSet* workspace,
+                          const pb::Peptide& pb_peptide,
+                          TheoreticalPeakCompiler* compiler_prog1,
+                          TheoreticalPeakCompiler* compiler_prog2);
   void ComputeBTheoreticalPeaks(TheoreticalPeakSetBIons* workspace) const;
 
   // Return the appropriate program depending on the precursor charge.
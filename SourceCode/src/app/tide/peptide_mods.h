@@ -0,0 +1,120 @@
+// ModsEnumerator generates the modified forms of a peptide allowed by the
+// variable modifications of a VariableModTable. tide-index uses it (see
+// ModsOutputter in peptide_mods3.cc) to write every modified peptide to the
+// index. For an index built with lazy-mods, which holds only unmodified
+// peptides, ModifiedPeptideReader uses it at search time to generate the same
+// modified peptides, in the same order, as they are read.
+
+#ifndef PEPTIDE_MODS_H
+#define PEPTIDE_MODS_H
+
+#include <vector>
+#include "records.h"
+#include "header.pb.h"
+#include "raw_proteins.pb.h"
+#include "peptides.pb.h"
+#include "modifications.h"
+
+using namespace std;
+
+class ModsEnumerator {
+ public:
+  ModsEnumerator(const vector<const pb::Protein*>& proteins,
+                 VariableModTable* var_mod_table,
+                 int min_mods, int max_mods);
+  virtual ~ModsEnumerator() {}
+
+  // Calls Emit() once for each modified form of peptide. Terminal
+  // modifications count toward min_mods and max_mods.
+  void Enumerate(pb::Peptide* peptide);
+
+  // Mass added to a peptide by the modifications in counts, summed the same
+  // way for every form so that equal forms get equal masses.
+  double TotalDelta(const vector<int>& counts) const;
+
+  // Lower and upper bounds on TotalDelta() over all forms.
+  double MinTotalDelta() const;
+  double MaxTotalDelta() const;
+
+ protected:
+  // peptide_ holds the modifications of the form; its mass is still that of
+  // the unmodified peptide. counts holds the number of each variable
+  // modification, indexed like VariableModTable::MaxCounts().
+  virtual void Emit(const vector<int>& counts) = 0;
+
+  const vector<const pb::Protein*>& proteins_;
+  VariableModTable* mod_table_;
+  const vector<int>& max_counts_;
+  int min_mods_;
+  int max_mods_;
+
+  pb::Peptide* peptide_;
+  const char* residues_;
+
+ private:
+  void OutputMods(int pos, vector<int>& counts);
+  void OutputNtermMods(int pos, vector<int>& counts);
+  void OutputCtermMods(int pos, vector<int>& counts);
+  void EmitIfEnoughMods(const vector<int>& counts);
+  int TotalMods(const vector<int>& counts) const;
+};
+
+// Reads a file of unmodified peptides of non-decreasing mass, as written by
+// tide-index with lazy-mods, and returns all of their modified forms in order
+// of mass, as if they had been read from an index of modified peptides. Forms
+// are generated only once the unmodified peptides are heavy enough that no
+// lighter form can follow, so the forms held in memory are those of the
+// peptides within the range of the modification masses. Forms of peptides
+// whose heaviest form is below the mass given to SkipBelow() are only
+// counted, so that the ids of the forms that are read stay the same.
+class ModifiedPeptideReader : public ModsEnumerator {
+ public:
+  ModifiedPeptideReader(RecordReader* reader,
+                        const vector<const pb::Protein*>& proteins,
+                        VariableModTable* var_mod_table,
+                        const pb::Header::PeptidesHeader& header);
+  ~ModifiedPeptideReader();
+
+  // Same protocol as RecordReader: call Done() once before each Read().
+  bool Done();
+  void Read(pb::Peptide* peptide);
+
+  // Tells the reader that the caller discards the forms lighter than mass
+  // that it reads until the next call.
+  void SkipBelow(double mass) { skip_below_ = mass; }
+
+  // Continues with the peptides of another file once Done() has returned true.
+  void SetReader(RecordReader* reader);
+
+ protected:
+  void Emit(const vector<int>& counts);
+
+ private:
+  struct Pending {
+    pb::Peptide* peptide;
+    long long seq;  // generation order, breaks ties in mass
+  };
+  struct HeavierThan {
+    bool operator()(const Pending& x, const Pending& y) const {
+      if (x.peptide->mass() != y.peptide->mass())
+        return x.peptide->mass() > y.peptide->mass();
+      return x.seq > y.seq;
+    }
+  };
+
+  bool ReadUnmodified();
+
+  RecordReader* reader_;
+  double min_delta_;
+  double max_delta_;
+  double skip_below_;
+  bool counting_;  // Emit() only counts the forms
+  pb::Peptide unmodified_;
+  bool has_unmodified_;
+  vector<Pending> pending_;  // heap, lightest first
+  vector<pb::Peptide*> free_;
+  long long seq_;
+  int id_;
+};
+
+#endif // PEPTIDE_MODS_H
@@ -19,7 +19,7 @@
 #include "raw_proteins.pb.h"
 #include "peptides.pb.h"
 #include "mass_constants.h"
-#include "modifications.h"
+#include "peptide_mods.h"
 #include "util/FileUtils.h"
 #include "io/carp.h"
 
@@ -48,124 +48,84 @@ static string GetTempName(string tmpDir, int filenum) {
 #endif
 }
 
-class ModsOutputter {
- public:
-  unsigned long modpeptidecnt_;
-  ModsOutputter(string tmpDir,
-                const vector<const pb::Protein*>& proteins,
-		VariableModTable* var_mod_table,
-		HeadedRecordWriter* final_writer)
-    : proteins_(proteins),
-      mod_table_(var_mod_table),
-      max_counts_(*mod_table_->MaxCounts()),
-      counts_mapper_vec_(max_counts_.size(), 0),
-      final_writer_(final_writer),
-      count_(0) {
-    InitCountsMapper(tmpDir);
-  }
-
-  ~ModsOutputter() {
-    for (int i = 0; i < writers_.size(); ++i)
-      delete writers_[i];
-    Merge();
-  }
-
-  void Output(pb::Peptide* peptide) {
-    peptide_ = peptide;
-    const pb::Location& loc = peptide->first_location();
-    residues_ = proteins_[loc.protein_id()]->residues().data() + loc.pos();
-    vector<int> counts(max_counts_.size(), 0);
-    OutputNtermMods(0, counts);
-  }
-
- private:
-  string tmpDir_;
-  void OutputMods(int pos, vector<int>& counts);
-  void OutputNtermMods(int pos, vector<int>& counts);
-  void OutputCtermMods(int pos, vector<int>& counts);
-  void Merge();
-
-  void InitCountsMapper(string tmpDir) {
-    tmpDir_ = tmpDir;
-    
-    int prod = 1;
-    for (int i = 0; i < max_counts_.size(); ++i) {
-      counts_mapper_vec_[i] = prod;
-      if (max_counts_[i] == 0)
-        prod *= (max_counts_[i]+2);
-      else
-        prod *= (max_counts_[i]+1);
-    }
-
-    writers_.resize(prod);
-    if (prod > 100) {
-      carp(CARP_INFO, "Opening %d files for modifications.", prod);
-    }
-
-    for (int i = 0; i < prod; ++i) {
-      writers_[i] = new RecordWriter(GetTempName(tmpDir, i), FLAGS_buf_size << 10);
-      if (!writers_[i]->OK()) {
-        // delete temporary files
-        for (int j = 0; j < i; ++j)
-          unlink(GetTempName(tmpDir, j).c_str());
-        CHECK(writers_[i]->OK());
-      }
-    }
+ModsEnumerator::ModsEnumerator(const vector<const pb::Protein*>& proteins,
+                               VariableModTable* var_mod_table,
+                               int min_mods, int max_mods)
+  : proteins_(proteins),
+    mod_table_(var_mod_table),
+    max_counts_(*mod_table_->MaxCounts()),
+    min_mods_(min_mods),
+    max_mods_(max_mods),
+    peptide_(NULL),
+    residues_(NULL) {
+}
 
-    const vector<double>& deltas = *mod_table_->OriginalDeltas();
-    delta_by_file_.resize(prod);
-    for (int i = 0; i < prod; ++i) {
-      double total_delta = 0;
-      int x = i;
-      for (int j = max_counts_.size() - 1; j >= 0; --j) {
-        int digit = x / counts_mapper_vec_[j];
-        x %= counts_mapper_vec_[j];
-        total_delta += deltas[j] * digit;
-      }
-      delta_by_file_[i] = total_delta;
-    }
-  }
+void ModsEnumerator::Enumerate(pb::Peptide* peptide) {
+  peptide_ = peptide;
+  const pb::Location& loc = peptide->first_location();
+  residues_ = proteins_[loc.protein_id()]->residues().data() + loc.pos();
+  vector<int> counts(max_counts_.size(), 0);
+  OutputNtermMods(0, counts);
+}
 
-  int TotalMods(const vector<int>& counts) {
-    return accumulate(counts.begin(), counts.end(), 0);
-  }
+double ModsEnumerator::TotalDelta(const vector<int>& counts) const {
+  const vector<double>& deltas = *mod_table_->OriginalDeltas();
+  double total_delta = 0;
+  for (int j = counts.size() - 1; j >= 0; --j)
+    total_delta += deltas[j] * counts[j];
+  return total_delta;
+}
 
-  int DotProd(const vector<int>& counts) {
-    int dot = 0;
-    for (int i = 0; i < counts.size(); ++i)
-      dot += counts_mapper_vec_[i] * counts[i];
-    return dot;
+double ModsEnumerator::MinTotalDelta() const {
+  // Apply the most negative deltas first, as many times as they are allowed,
+  // until max_mods is reached. This ignores which residues the peptides have.
+  const vector<double>& deltas = *mod_table_->OriginalDeltas();
+  vector<pair<double, int> > negative;
+  for (int i = 0; i < deltas.size(); ++i)
+    if (deltas[i] < 0)
+      negative.push_back(make_pair(deltas[i], max_counts_[i]));
+  sort(negative.begin(), negative.end());
+  double total_delta = 0;
+  int mods_left = max_mods_;
+  for (int i = 0; i < negative.size() && mods_left > 0; ++i) {
+    int count = min(negative[i].second, mods_left);
+    total_delta += negative[i].first * count;
+    mods_left -= count;
   }
+  return total_delta;
+}
 
-  RecordWriter* Write(const vector<int>& counts) {
-    ++modpeptidecnt_;
-    int index = DotProd(counts);
-    double mass = peptide_->mass();
-    peptide_->set_mass(delta_by_file_[index] + mass);
-    if (!writers_[index]->Write(peptide_)) {
-      carp(CARP_FATAL, "I/O error writing modifications");
-    }
-    peptide_->set_mass(mass);
-    return writers_[index];
+double ModsEnumerator::MaxTotalDelta() const {
+  // As MinTotalDelta(), with the most positive deltas.
+  const vector<double>& deltas = *mod_table_->OriginalDeltas();
+  vector<pair<double, int> > positive;
+  for (int i = 0; i < deltas.size(); ++i)
+    if (deltas[i] > 0)
+      positive.push_back(make_pair(-deltas[i], max_counts_[i]));
+  sort(positive.begin(), positive.end());
+  double total_delta = 0;
+  int mods_left = max_mods_;
+  for (int i = 0; i < positive.size() && mods_left > 0; ++i) {
+    int count = min(positive[i].second, mods_left);
+    total_delta -= positive[i].first * count;
+    mods_left -= count;
   }
+  return total_delta;
+}
 
-  const vector<const pb::Protein*>& proteins_;
-  VariableModTable* mod_table_;
-  const vector<int>& max_counts_;
-  vector<int> counts_mapper_vec_;
-  vector<RecordWriter*> writers_;
-  vector<double> delta_by_file_;
-  HeadedRecordWriter* final_writer_;
-  int count_;
+int ModsEnumerator::TotalMods(const vector<int>& counts) const {
+  return accumulate(counts.begin(), counts.end(), 0);
+}
 
-  pb::Peptide* peptide_;
-  const char* residues_;
-};
+void ModsEnumerator::EmitIfEnoughMods(const vector<int>& counts) {
+  if (TotalMods(counts) >= min_mods_)
+    Emit(counts);
+}
 
 //terminal modifications count as a modification and hence 
 //it is taken into account the modification limit.
-void ModsOutputter::OutputMods(int pos, vector<int>& counts) {
-  if (TotalMods(counts) > FLAGS_max_mods) {
+void ModsEnumerator::OutputMods(int pos, vector<int>& counts) {
+  if (TotalMods(counts) > max_mods_) {
     return;
   }
   if (pos == peptide_->length()) {
@@ -197,8 +157,8 @@ void ModsOutputter::OutputMods(int pos, vector<int>& counts) {
   }
 }
 
-void ModsOutputter::OutputNtermMods(int pos, vector<int>& counts) {
-  if (TotalMods(counts) > FLAGS_max_mods) {
+void ModsEnumerator::OutputNtermMods(int pos, vector<int>& counts) {
+  if (TotalMods(counts) > max_mods_) {
     return;
   }
   bool any_term_modification = false;
@@ -262,15 +222,12 @@ void ModsOutputter::OutputNtermMods(int pos, vector<int>& counts) {
   }
 }
 
-void ModsOutputter::OutputCtermMods(int pos, vector<int>& counts) {
+void ModsEnumerator::OutputCtermMods(int pos, vector<int>& counts) {
   int total = TotalMods(counts);
-  if (total > FLAGS_max_mods) {
+  if (total > max_mods_) {
     return;
-  } else if (total == FLAGS_max_mods) {
-    if (total >= FLAGS_min_mods) {
-      peptide_->set_id(count_++);
-      Write(counts);
-    }
+  } else if (total == max_mods_) {
+    EmitIfEnoughMods(counts);
     return;
   }
 
@@ -282,12 +239,7 @@ void ModsOutputter::OutputCtermMods(int pos, vector<int>& counts) {
     if (max_counts_[poss_max_ct] == 0) {
       int delta_index = mod_table_->PossDeltIx(aa, i, CTPEP);
       peptide_->add_modifications(mod_table_->EncodeMod(pos, delta_index));
-
-      if (TotalMods(counts) >= FLAGS_min_mods) {
-        peptide_->set_id(count_++);
-        Write(counts);
-      }
-
+      EmitIfEnoughMods(counts);
       peptide_->mutable_modifications()->RemoveLast();
       any_term_modification = true;
     }
@@ -299,12 +251,7 @@ void ModsOutputter::OutputCtermMods(int pos, vector<int>& counts) {
     if (max_counts_[poss_max_ct] == 0) {
       int delta_index = mod_table_->PossDeltIx(aa, i, CTPEP);
       peptide_->add_modifications(mod_table_->EncodeMod(pos, delta_index));
-
-      if (TotalMods(counts) >= FLAGS_min_mods) {
-        peptide_->set_id(count_++);
-        Write(counts);
-      }
-
+      EmitIfEnoughMods(counts);
       peptide_->mutable_modifications()->RemoveLast();
       any_term_modification = true;
     }
@@ -319,12 +266,7 @@ void ModsOutputter::OutputCtermMods(int pos, vector<int>& counts) {
         ++counts[poss_max_ct];
         int delta_index = mod_table_->PossDeltIx(aa, i);
         peptide_->add_modifications(mod_table_->EncodeMod(pos, delta_index));
-
-        if (TotalMods(counts) >= FLAGS_min_mods) {
-          peptide_->set_id(count_++);
-          Write(counts);
-        }
-
+        EmitIfEnoughMods(counts);
         peptide_->mutable_modifications()->RemoveLast();
         --counts[poss_max_ct];
       }
@@ -339,12 +281,7 @@ void ModsOutputter::OutputCtermMods(int pos, vector<int>& counts) {
         ++counts[poss_max_ct];
         int delta_index = mod_table_->PossDeltIx(aa, i, CTPEP);
         peptide_->add_modifications(mod_table_->EncodeMod(pos, delta_index));
-
-        if (TotalMods(counts) >= FLAGS_min_mods) {
-          peptide_->set_id(count_++);
-          Write(counts);
-        }
-
+        EmitIfEnoughMods(counts);
         peptide_->mutable_modifications()->RemoveLast();
         --counts[poss_max_ct];
         any_term_modification = true;
@@ -358,24 +295,115 @@ void ModsOutputter::OutputCtermMods(int pos, vector<int>& counts) {
         ++counts[poss_max_ct];
         int delta_index = mod_table_->PossDeltIx(aa, i, CTPEP);
         peptide_->add_modifications(mod_table_->EncodeMod(pos, delta_index));
-
-        if (TotalMods(counts) >= FLAGS_min_mods) {
-          peptide_->set_id(count_++);
-          Write(counts);
-        }
-        
+        EmitIfEnoughMods(counts);
         peptide_->mutable_modifications()->RemoveLast();
         --counts[poss_max_ct];
         any_term_modification = true;
       }
     }
-    if (TotalMods(counts) >= FLAGS_min_mods) {
-      peptide_->set_id(count_++);
-      Write(counts);    
-    }
+    EmitIfEnoughMods(counts);
   }
 }
 
+class ModsOutputter : public ModsEnumerator {
+ public:
+  unsigned long modpeptidecnt_;
+  ModsOutputter(string tmpDir,
+                const vector<const pb::Protein*>& proteins,
+		VariableModTable* var_mod_table,
+		HeadedRecordWriter* final_writer)
+    : ModsEnumerator(proteins, var_mod_table, FLAGS_min_mods, FLAGS_max_mods),
+      counts_mapper_vec_(max_counts_.size(), 0),
+      final_writer_(final_writer),
+      count_(0) {
+    InitCountsMapper(tmpDir);
+  }
+
+  ~ModsOutputter() {
+    for (int i = 0; i < writers_.size(); ++i)
+      delete writers_[i];
+    Merge();
+  }
+
+  void Output(pb::Peptide* peptide) {
+    Enumerate(peptide);
+  }
+
+ protected:
+  void Emit(const vector<int>& counts) {
+    peptide_->set_id(count_++);
+    Write(counts);
+  }
+
+ private:
+  string tmpDir_;
+  void Merge();
+
+  void InitCountsMapper(string tmpDir) {
+    tmpDir_ = tmpDir;
+    
+    int prod = 1;
+    for (int i = 0; i < max_counts_.size(); ++i) {
+      counts_mapper_vec_[i] = prod;
+      if (max_counts_[i] == 0)
+        prod *= (max_counts_[i]+2);
+      else
+        prod *= (max_counts_[i]+1);
+    }
+
+    writers_.resize(prod);
+    if (prod > 100) {
+      carp(CARP_INFO, "Opening %d files for modifications.", prod);
+    }
+
+    for (int i = 0; i < prod; ++i) {
+      writers_[i] = new RecordWriter(GetTempName(tmpDir, i), FLAGS_buf_size << 10);
+      if (!writers_[i]->OK()) {
+        // delete temporary files
+        for (int j = 0; j < i; ++j)
+          unlink(GetTempName(tmpDir, j).c_str());
+        CHECK(writers_[i]->OK());
+      }
+    }
+
+    delta_by_file_.resize(prod);
+    vector<int> counts(max_counts_.size());
+    for (int i = 0; i < prod; ++i) {
+      int x = i;
+      for (int j = max_counts_.size() - 1; j >= 0; --j) {
+        counts[j] = x / counts_mapper_vec_[j];
+        x %= counts_mapper_vec_[j];
+      }
+      delta_by_file_[i] = TotalDelta(counts);
+    }
+  }
+
+  int DotProd(const vector<int>& counts) {
+    int dot = 0;
+    for (int i = 0; i < counts.size(); ++i)
+      dot += counts_mapper_vec_[i] * counts[i];
+    return dot;
+  }
+
+  RecordWriter* Write(const vector<int>& counts) {
+    ++modpeptidecnt_;
+    int index = DotProd(counts);
+    double mass = peptide_->mass();
+    peptide_->set_mass(delta_by_file_[index] + mass);
+    if (!writers_[index]->Write(peptide_)) {
+      carp(CARP_FATAL, "I/O error writing modifications");
+    }
+    peptide_->set_mass(mass);
+    return writers_[index];
+  }
+
+  vector<int> counts_mapper_vec_;
+  vector<RecordWriter*> writers_;
+  vector<double> delta_by_file_;
+  HeadedRecordWriter* final_writer_;
+  int count_;
+};
+
 class PepReader {
  public:
   PepReader(const string& filename)
@@ -496,3 +524,84 @@ void AddMods(HeadedRecordReader* reader, string out_file,
   }
   CHECK(reader->OK());
 }
+
+ModifiedPeptideReader::ModifiedPeptideReader(
+  RecordReader* reader,
+  const vector<const pb::Protein*>& proteins,
+  VariableModTable* var_mod_table,
+  const pb::Header::PeptidesHeader& header)
+  : ModsEnumerator(proteins, var_mod_table, header.min_mods(), header.max_mods()),
+    reader_(reader), skip_below_(0), counting_(false), has_unmodified_(false),
+    seq_(0), id_(0) {
+  // The margin keeps rounding in the sums of deltas from releasing a form
+  // before a lighter one has been generated, or from skipping one that is
+  // not lighter than skip_below_.
+  min_delta_ = min(0.0, MinTotalDelta()) - 1e-3;
+  max_delta_ = max(0.0, MaxTotalDelta()) + 1e-3;
+  has_unmodified_ = ReadUnmodified();
+}
+
+ModifiedPeptideReader::~ModifiedPeptideReader() {
+  for (int i = 0; i < pending_.size(); ++i)
+    delete pending_[i].peptide;
+  for (int i = 0; i < free_.size(); ++i)
+    delete free_[i];
+}
+
+bool ModifiedPeptideReader::ReadUnmodified() {
+  if (reader_->Done())
+    return false;
+  CHECK(reader_->Read(&unmodified_));
+  return true;
+}
+
+void ModifiedPeptideReader::SetReader(RecordReader* reader) {
+  assert(pending_.empty() && !has_unmodified_);
+  reader_ = reader;
+  has_unmodified_ = ReadUnmodified();
+}
+
+bool ModifiedPeptideReader::Done() {
+  // Every form still to be generated is at least as heavy as the next
+  // unmodified peptide plus min_delta_, so lighter pending forms can go.
+  // Skipped forms are all lighter than those read after them, so counting
+  // them in id_ gives the later forms their ids.
+  while (has_unmodified_ &&
+         (pending_.empty() ||
+          pending_.front().peptide->mass() > unmodified_.mass() + min_delta_)) {
+    counting_ = unmodified_.mass() + max_delta_ < skip_below_;
+    Enumerate(&unmodified_);
+    has_unmodified_ = ReadUnmodified();
+  }
+  counting_ = false;
+  return pending_.empty();
+}
+
+void ModifiedPeptideReader::Read(pb::Peptide* peptide) {
+  assert(!pending_.empty());
+  pop_heap(pending_.begin(), pending_.end(), HeavierThan());
+  pb::Peptide* next = pending_.back().peptide;
+  pending_.pop_back();
+  peptide->Swap(next);
+  peptide->set_id(id_++);
+  free_.push_back(next);
+}
+
+void ModifiedPeptideReader::Emit(const vector<int>& counts) {
+  if (counting_) {
+    ++id_;
+    return;
+  }
+  pb::Peptide* form;
+  if (free_.empty()) {
+    form = new pb::Peptide;
+  } else {
+    form = free_.back();
+    free_.pop_back();
+  }
+  form->CopyFrom(*peptide_);
+  form->set_mass(TotalDelta(counts) + peptide_->mass());
+  Pending pending = { form, seq_++ };
+  pending_.push_back(pending);
+  push_heap(pending_.begin(), pending_.end(), HeavierThan());
+}
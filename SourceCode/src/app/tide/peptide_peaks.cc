@@ -1,7 +1,11 @@
 // Benjamin Diament
 //
 // Add to the index of peptide records the pre-computed theoretical peaks.
-// We store the TheoreticalPeakSetDiff (q.v.) for each peptide. 
+// Originally we stored the TheoreticalPeakSetDiff (q.v.) for each peptide.
+// With store-peaks, tide-index now stores the TheoreticalPeakSetBYSparse
+// peaks that the search compiles each peptide's programs from, so that the
+// search does not have to recompute them; otherwise the records are copied
+// unchanged.
 //
 // Example command-line:
 // peptide_peaks --proteins=<raw_proteins.proto input file> \
@@ -18,6 +22,7 @@
 // case we could eliminate them.
 
 #include <stdio.h>
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -29,34 +34,33 @@
 using namespace std;
 
 #define CHECK(x) GOOGLE_CHECK(x)
-/*
-static void AddPeaksToPB(pb::Peptide* peptide, const TheoreticalPeakArr* peaks,
-			 int charge, bool neg) {
+
+// Stores the peaks in the order of their codes, so that the deltas are small
+// and non-negative, and CopyExceptions() can stop at the end of the cache.
+static void AddPeaksToPB(pb::Peptide* peptide, const TheoreticalPeakArr& peaks,
+                         int charge) {
+  vector<int> codes;
+  codes.reserve(peaks.size());
+  TheoreticalPeakArr::const_iterator i = peaks.begin();
+  for (; i != peaks.end(); ++i)
+    codes.push_back(i->Code());
+  sort(codes.begin(), codes.end());
   int last_code = 0;
-  TheoreticalPeakArr::const_iterator i = peaks->begin();
-  for (; i != peaks->end(); ++i) {
-    int delta = i->Code() - last_code;
-    last_code = i->Code();
-    if (neg) {
-      if (charge == 1) {
-        peptide->add_neg_peak1(delta);
-      } else {
-        peptide->add_neg_peak2(delta);
-      }
+  for (vector<int>::const_iterator j = codes.begin(); j != codes.end(); ++j) {
+    int delta = *j - last_code;
+    last_code = *j;
+    if (charge == 1) {
+      peptide->add_peak1(delta);
     } else {
-      if (charge == 1) {
-        peptide->add_peak1(delta);
-      } else {
-        peptide->add_peak2(delta);
-      }
+      peptide->add_peak2(delta);
     }
   }
 }
-*/
 
 void AddTheoreticalPeaks(const vector<const pb::Protein*>& proteins,
 			 const string& input_filename,
-			 const string& output_filename) {
+			 const string& output_filename,
+			 bool store_peaks) {
   pb::Header orig_header, new_header;
   HeadedRecordReader reader(input_filename, &orig_header);
   CHECK(orig_header.file_type() == pb::Header::PEPTIDES);
@@ -66,6 +70,10 @@ void AddTheoreticalPeaks(const vector<const pb::Protein*>& proteins,
   pb::Header_PeptidesHeader* subheader = new_header.mutable_peptides_header();
   subheader->CopyFrom(orig_header.peptides_header());
   subheader->set_has_peaks(true);
+  if (store_peaks) {
+    subheader->set_peaks_bin_width(MassConstants::bin_width_);
+    subheader->set_peaks_bin_offset(MassConstants::bin_offset_);
+  }
   pb::Header_Source* source = new_header.add_source();
   source->mutable_header()->CopyFrom(orig_header);
   source->set_filename(AbsPath(input_filename));
@@ -74,24 +82,20 @@ void AddTheoreticalPeaks(const vector<const pb::Protein*>& proteins,
   CHECK(writer.OK());
 
   pb::Peptide pb_peptide;
-//  const int workspace_size = 2000; // More than sufficient for theor. peaks.
-//  TheoreticalPeakSetDiff workspace(workspace_size);
+  const int workspace_size = 2000; // More than sufficient for theor. peaks.
+  ST_TheoreticalPeakSet workspace(workspace_size);
   while (!reader.Done()) {
     reader.Read(&pb_peptide);
-/*    Peptide peptide(pb_peptide, proteins);
-    workspace.Clear();
-    peptide.ComputeTheoreticalPeaks(&workspace);
-    TheoreticalPeakArr peaks_charge_1(2000);
-    TheoreticalPeakArr peaks_charge_2(2000);
-    TheoreticalPeakArr negs_charge_1(2000);
-    TheoreticalPeakArr negs_charge_2(2000);
-    workspace.GetPeaks(&peaks_charge_1, &negs_charge_1,
-		       &peaks_charge_2, &negs_charge_2, NULL);
-    AddPeaksToPB(&pb_peptide, &peaks_charge_1, 1, false);
-    AddPeaksToPB(&pb_peptide, &peaks_charge_2, 2, false);
-    AddPeaksToPB(&pb_peptide, &negs_charge_1, 1, true);
-    AddPeaksToPB(&pb_peptide, &negs_charge_2, 2, true);
-*/    CHECK(writer.Write(&pb_peptide));
+    if (store_peaks) {
+      // The same peaks the search compiles the peptide's programs from.
+      Peptide peptide(pb_peptide, proteins);
+      workspace.Clear();
+      peptide.ComputeTheoreticalPeaks(&workspace);
+      const TheoreticalPeakArr* peaks = workspace.GetPeaks();
+      AddPeaksToPB(&pb_peptide, peaks[0], 1);
+      AddPeaksToPB(&pb_peptide, peaks[1], 2);
+    }
+    CHECK(writer.Write(&pb_peptide));
   }
   CHECK(reader.OK());
 }
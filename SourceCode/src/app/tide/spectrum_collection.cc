@@ -9,6 +9,7 @@
 #include <functional>
 #include "spectrum.pb.h"
 #include "spectrum_collection.h"
+#include "indexed_spectra.h"
 #include "mass_constants.h"
 #include "records.h"
 #include "records_to_vector-inl.h"
@@ -18,7 +19,8 @@ using google::protobuf::uint64;
 
 #define CHECK(x) GOOGLE_CHECK((x))
 
-Spectrum::Spectrum(const pb::Spectrum& spec) {
+Spectrum::Spectrum(const pb::Spectrum& spec)
+  : source_(NULL), source_index_(0) {
   spectrum_number_ = spec.spectrum_number();
   precursor_m_z_ = spec.precursor_m_z();
   rtime_ = spec.rtime();
@@ -88,6 +90,46 @@ void Spectrum::FillPB(pb::Spectrum* spec) {
   }
 }
 
+void Spectrum::Decode(Spectrum* decoded, SpectrumBlockCache* cache) const {
+  CHECK(source_ != NULL);
+  decoded->spectrum_number_ = spectrum_number_;
+  decoded->rtime_ = rtime_;
+  decoded->precursor_m_z_ = precursor_m_z_;
+  decoded->charge_states_ = charge_states_;
+  decoded->source_ = NULL;
+  decoded->DecodePeaks(*source_, source_index_, cache);
+}
+
+int Spectrum::NumPeaks() const {
+  return source_ ? source_->Index().num_peaks(source_index_) : Size();
+}
+
+void Spectrum::DecodePeaks(const IndexedSpectra& source, int index,
+                           SpectrumBlockCache* cache) {
+  // Same values as the constructor from a pb::Spectrum.
+  const pb::SpectrumIndex& spectra = source.Index();
+  int size = spectra.num_peaks(index);
+  double m_z_denom = spectra.peak_m_z_denominator(index);
+  double intensity_denom = spectra.peak_intensity_denominator(index);
+  const google::protobuf::uint8* end;
+  const google::protobuf::uint8* peaks = source.Peaks(index, cache, &end);
+  google::protobuf::io::CodedInputStream input(peaks, end - peaks);
+  peak_m_z_.resize(size);
+  peak_intensity_.resize(size);
+  uint64 total = 0;
+  for (int i = 0; i < size; ++i) {
+    uint64 delta;
+    CHECK(input.ReadVarint64(&delta) && delta > 0);
+    total += delta; // deltas of m/z are stored
+    peak_m_z_[i] = total / m_z_denom;
+  }
+  for (int i = 0; i < size; ++i) {
+    uint64 intensity;
+    CHECK(input.ReadVarint64(&intensity));
+    peak_intensity_[i] = intensity / intensity_denom;
+  }
+}
+
 void Spectrum::SortIfNecessary() {
   if (adjacent_find(peak_m_z_.begin(), peak_m_z_.end(), greater<double>())
       == peak_m_z_.end())
@@ -159,14 +201,22 @@ void SpectrumCollection::ReadMS(istream& in, bool ms1) {
     spectra_.push_back(spectrum);
 }
 
+SpectrumCollection::~SpectrumCollection() {
+  for (int i = 0; i < spectra_.size(); ++i)
+    delete spectra_[i];
+  delete indexed_;
+}
+
 bool SpectrumCollection::ReadSpectrumRecords(const string& filename,
-					     pb::Header* header) {
+					     pb::Header* header, bool lazy) {
   pb::Header tmp_header;
   if (header == NULL)
     header = &tmp_header;
   HeadedRecordReader reader(filename, header);
   if (header->file_type() != pb::Header::SPECTRA)
     return false;
+  if (header->spectra_header().version() >= 2)
+    return ReadIndexedSpectra(filename, lazy);
   pb::Spectrum pb_spectrum;
   while (!reader.Done()) {
     reader.Read(&pb_spectrum);
@@ -181,6 +231,38 @@ bool SpectrumCollection::ReadSpectrumRecords(const string& filename,
   return true;
 }
 
+bool SpectrumCollection::ReadIndexedSpectra(const string& filename,
+                                            bool lazy) {
+  CHECK(indexed_ == NULL);
+  IndexedSpectra* indexed = new IndexedSpectra;
+  if (!indexed->Open(filename)) {
+    delete indexed;
+    return false;
+  }
+  const pb::SpectrumIndex& index = indexed->Index();
+  SpectrumBlockCache cache;
+  for (int i = 0; i < indexed->Size(); ++i) {
+    Spectrum* spectrum = new Spectrum(index.spectrum_number(i),
+                                      index.precursor_m_z(i));
+    spectrum->SetRTime(index.rtime(i));
+    int charge_start = indexed->ChargeStart(i);
+    for (int j = 0; j < index.num_charge_states(i); ++j)
+      spectrum->AddChargeState(index.charge_state(charge_start + j));
+    if (lazy) {
+      spectrum->source_ = indexed;
+      spectrum->source_index_ = i;
+    } else {
+      spectrum->DecodePeaks(*indexed, i, &cache);
+    }
+    spectra_.push_back(spectrum);
+  }
+  if (lazy)
+    indexed_ = indexed;
+  else
+    delete indexed;
+  return true;
+}
+
 void SpectrumCollection::MakeSpecCharges() {
   // Create one entry in the spec_charges_ array for each 
   // (spectrum, charge) pair.
@@ -203,6 +285,17 @@ double SpectrumCollection::FindHighestMZ() const {
   double highest = 0;
   vector<Spectrum*>::const_iterator i = spectra_.begin();
   for (; i != spectra_.end(); ++i) {
+    if ((*i)->Lazy()) {
+      // The index has the highest m/z of spectra whose peaks are not read.
+      const pb::SpectrumIndex& index = indexed_->Index();
+      int j = (*i)->source_index_;
+      CHECK(index.num_peaks(j) > 0) << "ERROR: spectrum "
+                                    << (*i)->SpectrumNumber()
+                                    << " has no peaks.\n";
+      if (index.max_m_z(j) > highest)
+        highest = index.max_m_z(j);
+      continue;
+    }
     CHECK((*i)->Size() > 0) << "ERROR: spectrum " << (*i)->SpectrumNumber()
 			    << " has no peaks.\n";
     double last_peak = (*i)->M_Z((*i)->Size() - 1);
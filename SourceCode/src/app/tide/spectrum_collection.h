@@ -7,6 +7,9 @@
 // The SpectrumCollection class represents all the spectra in the input.
 // Initialize with ReadMS2() or ReadSpectrumRecords(). ReadMS2() takes an MS2
 // format, ReadSpectrumRecords() takes a file of records of spectrum.proto.
+// For a version 2 file (see indexed_spectra.h), ReadSpectrumRecords() can
+// instead read only the index and leave each spectrum's peaks in the file
+// until Spectrum::Decode() is called.
 //
 // SpectrumCollection::Sort() creates one entry in the spec_charges_ array for
 // each (spectrum, charge) pair, e.g. for the case where a spectrum has
@@ -27,11 +30,15 @@
 
 using namespace std;
 
+class IndexedSpectra;
+struct SpectrumBlockCache;
+
 class Spectrum {
  public:
   // Manual instantiation and specification
   Spectrum(int spectrum_number, double precursor_m_z)
-    : spectrum_number_(spectrum_number), precursor_m_z_(precursor_m_z) {
+    : spectrum_number_(spectrum_number), precursor_m_z_(precursor_m_z),
+      source_(NULL), source_index_(0) {
   }
   void ReservePeaks(int num) {
     peak_m_z_.reserve(num);
@@ -63,7 +70,19 @@ class Spectrum {
   void SortIfNecessary();
   void InferChargeStatesIfNecessary();
 
+  // A lazily read spectrum has no peaks. Decode() makes decoded a copy of it
+  // with its peaks; cache holds the caller's last decompressed blocks.
+  // NumPeaks() is the number of peaks, whether or not they have been read.
+  bool Lazy() const { return source_ != NULL; }
+  void Decode(Spectrum* decoded, SpectrumBlockCache* cache) const;
+  int NumPeaks() const;
+
  private:
+  friend class SpectrumCollection;
+
+  void DecodePeaks(const IndexedSpectra& source, int index,
+                   SpectrumBlockCache* cache);
+
   int spectrum_number_;
   double rtime_;
   double precursor_m_z_;
@@ -71,17 +90,21 @@ class Spectrum {
 
   vector<double> peak_m_z_;
   vector<double> peak_intensity_;
+
+  const IndexedSpectra* source_;  // if lazy
+  int source_index_;
 };
 
 class SpectrumCollection {
  public:
-  ~SpectrumCollection() {
-    for (int i = 0; i < spectra_.size(); ++i)
-      delete spectra_[i];
-  }
+  SpectrumCollection() : indexed_(NULL) {}
+  ~SpectrumCollection();
 
   void ReadMS(istream& in, bool ms1);
-  bool ReadSpectrumRecords(const string& filename, pb::Header* header = NULL);
+  // With lazy, the spectra of a version 2 file are read without their peaks,
+  // and the file stays mapped for as long as the collection exists.
+  bool ReadSpectrumRecords(const string& filename, pb::Header* header = NULL,
+                           bool lazy = false);
   void Sort();
 
   template<typename BinaryPredicate>
@@ -97,11 +120,14 @@ class SpectrumCollection {
     int charge;
     Spectrum* spectrum;
     int spectrum_index;
+    int file_index;  // spectrum file, when several are searched together
 
     SpecCharge(double neutral_mass_param, int charge_param,
-               Spectrum* spectrum_param, int spectrum_index_param)
+               Spectrum* spectrum_param, int spectrum_index_param,
+               int file_index_param = 0)
     : neutral_mass(neutral_mass_param), charge(charge_param),
-      spectrum(spectrum_param), spectrum_index(spectrum_index_param) {
+      spectrum(spectrum_param), spectrum_index(spectrum_index_param),
+      file_index(file_index_param) {
     }
 
     bool operator<(const SpecCharge& other) const {
@@ -114,9 +140,11 @@ class SpectrumCollection {
 
  private:
   void MakeSpecCharges();
+  bool ReadIndexedSpectra(const string& filename, bool lazy);
 
   vector<Spectrum*> spectra_;
   vector<SpecCharge> spec_charges_;
+  IndexedSpectra* indexed_;  // source of lazily read spectra
 };
 
 #endif // SPECTRUM_COLLECTION_H
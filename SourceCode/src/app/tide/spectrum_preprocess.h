@@ -105,6 +105,7 @@
 #define SPECTRUM_PREPROCESS_H
 
 #include <iostream>
+#include <map>
 #include <vector>
 #include "theoretical_peak_pair.h"
 #include "max_mz.h"
@@ -114,12 +115,27 @@ using namespace std;
 
 class Spectrum;
 
+// Options of the preprocessing, resolved once by the caller rather than
+// looked up for every spectrum.
+struct PreprocessOptions {
+  PreprocessOptions()
+    : use_neutral_loss_peaks(false), use_flanking_peaks(false),
+      skip_preprocessing(false), remove_precursor_peak(false),
+      remove_precursor_tolerance(0) {
+  }
+
+  bool use_neutral_loss_peaks;
+  bool use_flanking_peaks;
+  bool skip_preprocessing;
+  bool remove_precursor_peak;
+  double remove_precursor_tolerance;
+};
+
 class ObservedPeakSet {
  public:
     
-  ObservedPeakSet(double bin_width = MassConstants::bin_width_, 
-     double bin_offset = MassConstants::bin_width_, 
-     bool NL = false, bool FP = false)
+  ObservedPeakSet(double bin_width, double bin_offset,
+                  const PreprocessOptions& options)
     : peaks_(new double[MaxBin::Global().BackgroundBinEnd()]),
     cache_(new int[MaxBin::Global().CacheBinEnd()*NUM_PEAK_TYPES]),
     bin(new int[MaxBin::Global().CacheBinEnd()]),
@@ -127,8 +143,11 @@ class ObservedPeakSet {
     
     bin_width_  = bin_width;
     bin_offset_ = bin_offset;
-    NL_ = NL; //NL means neutral loss
-    FP_ = FP; //FP means flanking peaks
+    NL_ = options.use_neutral_loss_peaks; //NL means neutral loss
+    FP_ = options.use_flanking_peaks; //FP means flanking peaks
+    skip_preprocessing_ = options.skip_preprocessing;
+    remove_precursor_ = options.remove_precursor_peak;
+    precursor_tolerance_ = options.remove_precursor_tolerance;
   }
 
   ~ObservedPeakSet() { delete[] peaks_; delete[] cache_; delete[] bin; delete[] ion; }
@@ -142,6 +161,9 @@ class ObservedPeakSet {
 #endif
   void PreprocessSpectrum(const Spectrum& spectrum, int charge);
   void PreprocessSpectrumHiXCorr(const Spectrum& spectrum, int charge);
+  // Fills the cache from bin and ion, as set by PreprocessSpectrumHiXCorr().
+  // The GPU search does this on the device instead.
+  void ComputeCacheHiXCorr();
   void CreateEvidenceVector(const Spectrum& spectrum, double binWidth,
     double binOffset, int charge, double pepMassMonoMean,
     int maxPrecurMass, int* evidenceInt);
@@ -185,6 +207,9 @@ class ObservedPeakSet {
 
   bool NL_;
   bool FP_;
+  bool skip_preprocessing_;
+  bool remove_precursor_;
+  double precursor_tolerance_;
   MaxBin max_mz_;
 
  private:
@@ -195,7 +220,6 @@ class ObservedPeakSet {
   }
   void MakeInteger();
   void ComputeCache();
-  void ComputeCacheHiXCorr();
   void SubtractBackgroundHiXCorr(map<int, double>* observed, int indexend);
 
   double* peaks_;
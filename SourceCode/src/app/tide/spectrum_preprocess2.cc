@@ -22,7 +22,6 @@
 #include "spectrum_preprocess.h"
 #include "mass_constants.h"
 #include "max_mz.h"
-#include "util/Params.h"
 
 using namespace std;
 
@@ -81,7 +80,7 @@ void ObservedPeakSet::PreprocessSpectrum(const Spectrum& spectrum,
 
   memset(peaks_, 0, sizeof(double) * MaxBin::Global().BackgroundBinEnd());
 
-  if (Params::GetBool("skip-preprocessing")) {
+  if (skip_preprocessing_) {
     for (int i = 0; i < spectrum.Size(); ++i) {
       double peak_location = spectrum.M_Z(i);
       if (peak_location >= experimental_mass_cut_off) {
@@ -94,8 +93,6 @@ void ObservedPeakSet::PreprocessSpectrum(const Spectrum& spectrum,
       }
     }
   } else {
-    bool remove_precursor = Params::GetBool("remove-precursor-peak");
-    double precursor_tolerance = Params::GetDouble("remove-precursor-tolerance");
 
     // Fill peaks
     int largest_mz = 0;
@@ -103,7 +100,7 @@ void ObservedPeakSet::PreprocessSpectrum(const Spectrum& spectrum,
     for (int i = 0; i < spectrum.Size(); ++i) {
       double peak_location = spectrum.M_Z(i);
       if (peak_location >= experimental_mass_cut_off ||
-          (remove_precursor && fabs(peak_location - precursor_mz) <= precursor_tolerance)) {
+          (remove_precursor_ && fabs(peak_location - precursor_mz) <= precursor_tolerance_)) {
         continue;
       }
 
@@ -221,8 +218,8 @@ void ObservedPeakSet::CreateEvidenceVector(
   const double H2OLossHeight = 10.0;
   const double FlankingHeight = BYHeight / 2;;
   // TODO end need to review
-  bool flanking_peak = Params::GetBool("use-flanking-peaks");
-  bool neutral_loss_peak = Params::GetBool("use-neutral-loss-peaks");
+  bool flanking_peak = FP_;
+  bool neutral_loss_peak = NL_;
 
   int ma;
   int pc;
@@ -595,7 +592,7 @@ void ObservedPeakSet::PreprocessSpectrumHiXCorr(const Spectrum& spectrum, int ch
 
   // memset(peaks_, 0, sizeof(double) * MaxBin::Global().BackgroundBinEnd());
   map<int, double> hPeaks_;
-  if (Params::GetBool("skip-preprocessing")) {
+  if (skip_preprocessing_) {
     for (int i = 0; i < spectrum.Size(); ++i) {
       double peak_location = spectrum.M_Z(i);
       if (peak_location >= experimental_mass_cut_off) {
@@ -608,8 +605,6 @@ void ObservedPeakSet::PreprocessSpectrumHiXCorr(const Spectrum& spectrum, int ch
       }
     }
   } else {
-    bool remove_precursor = Params::GetBool("remove-precursor-peak");
-    double precursor_tolerance = Params::GetDouble("remove-precursor-tolerance");
 
     // Fill peaks
     int largest_mz = 0;
@@ -618,7 +613,7 @@ void ObservedPeakSet::PreprocessSpectrumHiXCorr(const Spectrum& spectrum, int ch
     for (int i = 0; i < spectrum.Size(); ++i) {
       double peak_location = spectrum.M_Z(i);
       if (peak_location >= experimental_mass_cut_off ||
-          (remove_precursor && fabs(peak_location - precursor_mz) <= precursor_tolerance)) {
+          (remove_precursor_ && fabs(peak_location - precursor_mz) <= precursor_tolerance_)) {
         continue;
       }
 
@@ -503,6 +503,14 @@ class TheoreticalPeakSetBYSparse : public TheoreticalPeakSet {
   // Faster interface needing no copying at all.
   const TheoreticalPeakArr* GetPeaks() const { return peaks_; }
 
+  // Replaces the peaks with those stored in peptide by tide-index with
+  // store-peaks (see peptide_peaks.cc), up to the end of the cache.
+  void SetStoredPeaks(const pb::Peptide& peptide) {
+    Clear();
+    CopyExceptions(peptide.peak1(), &peaks_[0]);
+    CopyExceptions(peptide.peak2(), &peaks_[1]);
+  }
+
   void GetPeaks(TheoreticalPeakArr* peaks_charge_1,
     TheoreticalPeakArr* negs_charge_1,
     TheoreticalPeakArr* peaks_charge_2,
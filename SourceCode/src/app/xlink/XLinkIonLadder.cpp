@@ -0,0 +1,104 @@
+/**
+ * \file XLinkIonLadder.cpp
+ * \brief The b, y and a ion ladders of an XLinkablePeptide, stored as flat
+ * neutral mass arrays so that candidates can be scored without building
+ * IonSeries objects.
+ *****************************************************************************/
+
+#include "XLinkIonLadder.h"
+#include "XLinkIonSeriesCache.h"
+#include "model/Ion.h"
+#include "model/IonSeries.h"
+#include "model/Scorer.h"
+#include "util/mass.h"
+
+#include <stdlib.h>
+
+using namespace std;
+
+/**
+ * Predicts the singly charged XCorr ions of the peptide once and keeps
+ * their neutral masses.
+ */
+XLinkIonLadder::XLinkIonLadder(
+  XLinkablePeptide& xpep ///< the peptide
+  ) {
+
+  const char* seq = xpep.getSequence();
+  IonSeries* ion_series = new IonSeries(XLinkIonSeriesCache::getXCorrIonConstraint(1), 1);
+  ion_series->update(seq, xpep.getModifiedSequencePtr());
+  ion_series->predictIons();
+
+  length_ = strlen(seq);
+  int num_cleavages = max(length_ - 1, 0);
+  b_masses_.resize(num_cleavages);
+  y_masses_.resize(num_cleavages);
+
+  // XCorr ions are computed with monoisotopic hydrogen, see Ion::init
+  for (IonIterator ion_iter = ion_series->begin();
+    ion_iter != ion_series->end();
+    ++ion_iter) {
+    Ion* ion = *ion_iter;
+    int idx = ion->getCleavageIdx() - 1;
+    FLOAT_T mass = ion->getMassZ() - MASS_H_MONO;
+    switch (ion->getType()) {
+      case B_ION:
+        b_masses_[idx] = mass;
+        break;
+      case Y_ION:
+        y_masses_[idx] = mass;
+        break;
+      case A_ION:
+        a_masses_.resize(num_cleavages);
+        a_masses_[idx] = mass;
+        break;
+      default:
+        carp(CARP_FATAL, "only B, Y, A type ions for xcorr ladders");
+    }
+  }
+
+  IonSeries::freeIonSeries(ion_series);
+  free((char*)seq);
+}
+
+/**
+ * \returns the xcorr score of the ladder with ions of charge 1 to
+ * max_ion_charge, where the ions that contain link_pos are shifted by
+ * mod_mass.
+ */
+FLOAT_T XLinkIonLadder::scoreXCorr(
+  Scorer* scorer, ///< initialized xcorr scorer
+  int max_ion_charge, ///< the highest fragment charge
+  int link_pos, ///< sequence index of the link site
+  FLOAT_T mod_mass ///< mass added at the link site
+  ) const {
+
+  int num_cleavages = b_masses_.size();
+  if (num_cleavages == 0) {
+    return 0;
+  }
+  // b and a ions contain the link site after cleavage index link_pos, y
+  // ions from cleavage index length - link_pos
+  int forward_start = link_pos;
+  int reverse_start = length_ - link_pos - 1;
+
+  FLOAT_T sum = 0;
+  for (int charge = 1; charge <= max_ion_charge; charge++) {
+    sum += scorer->scoreXcorrLadder(&b_masses_[0], num_cleavages, B_ION,
+                                    charge, forward_start, mod_mass);
+    sum += scorer->scoreXcorrLadder(&y_masses_[0], num_cleavages, Y_ION,
+                                    charge, reverse_start, mod_mass);
+    if (!a_masses_.empty()) {
+      sum += scorer->scoreXcorrLadder(&a_masses_[0], num_cleavages, A_ION,
+                                      charge, forward_start, mod_mass);
+    }
+  }
+  return sum / 10000.0;
+}
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 2
+ * End:
+ */
@@ -0,0 +1,53 @@
+/**
+ * \file XLinkIonLadder.h
+ * \brief The b, y and a ion ladders of an XLinkablePeptide, stored as flat
+ * neutral mass arrays so that candidates can be scored without building
+ * IonSeries objects.
+ *****************************************************************************/
+
+#ifndef XLINKIONLADDER_H_
+#define XLINKIONLADDER_H_
+
+#include "model/objects.h"
+#include "XLinkablePeptide.h"
+
+#include <vector>
+
+class XLinkIonLadder {
+ protected:
+  int length_; ///< length of the peptide
+  std::vector<FLOAT_T> b_masses_; ///< b ion neutral masses by cleavage index - 1
+  std::vector<FLOAT_T> y_masses_; ///< y ion neutral masses by cleavage index - 1
+  std::vector<FLOAT_T> a_masses_; ///< a ion neutral masses, empty if not used
+
+ public:
+  /**
+   * Predicts the singly charged XCorr ions of the peptide once and keeps
+   * their neutral masses.
+   */
+  XLinkIonLadder(
+    XLinkablePeptide& xpep ///< the peptide
+  );
+
+  /**
+   * \returns the xcorr score of the ladder with ions of charge 1 to
+   * max_ion_charge, where the ions that contain link_pos are shifted by
+   * mod_mass.  The same as scoring XLinkablePeptide::predictIons with
+   * Scorer::scoreSpectrumVIonSeries.  The scorer must already be
+   * initialized for the spectrum.
+   */
+  FLOAT_T scoreXCorr(
+    Scorer* scorer, ///< initialized xcorr scorer
+    int max_ion_charge, ///< the highest fragment charge
+    int link_pos, ///< sequence index of the link site
+    FLOAT_T mod_mass ///< mass added at the link site
+  ) const;
+};
+
+#endif
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 2
+ * End:
+ */
@@ -7,6 +7,9 @@ vector<vector<IonSeries*> > XLinkIonSeriesCache::target_xlinkable_ion_series_;
 vector<vector<IonSeries*> > XLinkIonSeriesCache::decoy_xlinkable_ion_series_;
 vector<IonConstraint*> XLinkIonSeriesCache::xcorr_ion_constraint_;
 
+vector<XLinkIonLadder*> XLinkIonSeriesCache::target_xlinkable_ladders_;
+vector<XLinkIonLadder*> XLinkIonSeriesCache::decoy_xlinkable_ladders_;
+
 
 IonSeries* XLinkIonSeriesCache::getXLinkablePeptideIonSeries(
   XLinkablePeptide& xpep,
@@ -98,6 +101,26 @@ IonSeries* XLinkIonSeriesCache::getXLinkablePeptideIonSeries(
 
 }
 
+XLinkIonLadder* XLinkIonSeriesCache::getXLinkablePeptideLadder(
+  XLinkablePeptide& xpep
+  ) {
+
+  int xpep_idx = xpep.getIndex();
+  if (xpep_idx == -1) {
+    return NULL;
+  }
+
+  vector<XLinkIonLadder*>& ladders = xpep.isDecoy() ?
+    decoy_xlinkable_ladders_ : target_xlinkable_ladders_;
+  if (ladders.size() <= (size_t)xpep_idx) {
+    ladders.resize(xpep_idx + 1, NULL);
+  }
+  if (ladders[xpep_idx] == NULL) {
+    ladders[xpep_idx] = new XLinkIonLadder(xpep);
+  }
+  return ladders[xpep_idx];
+}
+
 IonConstraint* XLinkIonSeriesCache::getXCorrIonConstraint(
   int charge
   ) {
@@ -134,6 +157,15 @@ void XLinkIonSeriesCache::finalize() {
     }
   }
 
+  for (size_t xpep_idx = 0; xpep_idx < target_xlinkable_ladders_.size(); xpep_idx++) {
+    delete target_xlinkable_ladders_[xpep_idx];
+  }
+  target_xlinkable_ladders_.clear();
+  for (size_t xpep_idx = 0; xpep_idx < decoy_xlinkable_ladders_.size(); xpep_idx++) {
+    delete decoy_xlinkable_ladders_[xpep_idx];
+  }
+  decoy_xlinkable_ladders_.clear();
+
   for (size_t charge_idx=0;charge_idx < xcorr_ion_constraint_.size();charge_idx++) {
     IonConstraint::free(xcorr_ion_constraint_[charge_idx]);
   }
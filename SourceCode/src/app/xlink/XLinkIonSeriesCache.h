@@ -2,6 +2,7 @@
 #include "model/IonSeries.h"
 #include "XLinkablePeptide.h"
 #include "model/IonConstraint.h"
+#include "XLinkIonLadder.h"
 
 #include <vector>
 
@@ -15,6 +16,10 @@ class XLinkIonSeriesCache {
 
   static std::vector<IonConstraint*> xcorr_ion_constraint_;
 
+  //key is: xpep.getIndex()
+  static std::vector<XLinkIonLadder*> target_xlinkable_ladders_;
+  static std::vector<XLinkIonLadder*> decoy_xlinkable_ladders_;
+
  public:
 
   static IonSeries* getXLinkablePeptideIonSeries(
@@ -24,6 +29,14 @@ class XLinkIonSeriesCache {
 
   static IonConstraint* getXCorrIonConstraint(int charge);
 
+  /**
+   * \returns the cached mass ladder of the peptide, computing it the
+   * first time.  NULL if the peptide is unindexed.
+   */
+  static XLinkIonLadder* getXLinkablePeptideLadder(
+    XLinkablePeptide& xpep
+    );
+
   static void finalize();
 
 };
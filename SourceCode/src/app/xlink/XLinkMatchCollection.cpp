@@ -367,13 +367,14 @@ void XLinkMatchCollection::fitWeibull() {
   correlation_ = 0;
 
   FLOAT_T* xcorrs = extractScores(XCORR);
-// reverse sort the scores
-
-  std::sort(xcorrs, xcorrs + getMatchTotal(), greater<FLOAT_T>());
 
   double fraction_to_fit = Params::GetDouble("fraction-top-scores-to-fit");
   int num_tail_samples = (int)(getMatchTotal() * fraction_to_fit);
 
+  // only the tail that is fit needs to be in descending order
+  std::partial_sort(xcorrs, xcorrs + num_tail_samples,
+                    xcorrs + getMatchTotal(), greater<FLOAT_T>());
+
   fit_three_parameter_weibull(xcorrs,
             num_tail_samples,
             getMatchTotal(),
@@ -11,6 +11,8 @@
 #include "model/IonSeries.h"
 #include "util/Params.h"
 #include "XLinkPeptide.h"
+#include "XLinkIonLadder.h"
+#include "XLinkIonSeriesCache.h"
 #include "util/GlobalParams.h"
 
 
@@ -159,6 +161,20 @@ FLOAT_T XLinkScorer::scoreCandidate(
         
     xcorr = xcorr1+xcorr2;
     candidate->setScore(XCORR, xcorr);
+  } else if (candidate->getCandidateType() == XLINK_INTER_CANDIDATE ||
+             candidate->getCandidateType() == XLINK_INTRA_CANDIDATE ||
+             candidate->getCandidateType() == XLINK_INTER_INTRA_CANDIDATE) {
+    // the xcorr of the two ion series together is the sum of their xcorrs
+    XLinkPeptide* xpep = (XLinkPeptide*)candidate;
+    XLinkablePeptide& xpep1 = xpep->getXLinkablePeptide(0);
+    XLinkablePeptide& xpep2 = xpep->getXLinkablePeptide(1);
+    MASS_TYPE_T fragment_mass_type = GlobalParams::getFragmentMass();
+    FLOAT_T link_mass = XLinkPeptide::getLinkerMass();
+    FLOAT_T mod_mass1 = xpep1.getMass(fragment_mass_type) + link_mass;
+    FLOAT_T mod_mass2 = xpep2.getMass(fragment_mass_type) + link_mass;
+    xcorr = scoreXLinkablePeptide(xpep1, xpep->getLinkIdx(0), mod_mass2) +
+      scoreXLinkablePeptide(xpep2, xpep->getLinkIdx(1), mod_mass1);
+    candidate->setScore(XCORR, xcorr);
   } else {
     candidate->predictIons(ion_series_xcorr_, charge_);
     xcorr = scorer_xcorr_->scoreSpectrumVIonSeries(spectrum_, ion_series_xcorr_);
@@ -195,9 +211,18 @@ FLOAT_T XLinkScorer::scoreXLinkablePeptide(
   int link_idx,
   FLOAT_T mod_mass) {
 
-  xlpeptide.predictIons(ion_series_xcorr_, charge_, link_idx, mod_mass);
-  FLOAT_T xcorr = scorer_xcorr_->scoreSpectrumVIonSeries(spectrum_, ion_series_xcorr_);
-  return xcorr;
+  // score the peptide's cached mass ladder against the preprocessed
+  // spectrum, rather than predicting and scoring a shifted ion series
+  scorer_xcorr_->initializeXcorr(spectrum_, charge_);
+  int max_ion_charge = min(ion_constraint_xcorr_->getMaxCharge(), charge_);
+  int link_pos = xlpeptide.getLinkSite(link_idx);
+
+  XLinkIonLadder* ladder = XLinkIonSeriesCache::getXLinkablePeptideLadder(xlpeptide);
+  if (ladder != NULL) {
+    return ladder->scoreXCorr(scorer_xcorr_, max_ion_charge, link_pos, mod_mass);
+  }
+  XLinkIonLadder unindexed_ladder(xlpeptide);
+  return unindexed_ladder.scoreXCorr(scorer_xcorr_, max_ion_charge, link_pos, mod_mass);
 
 }
 
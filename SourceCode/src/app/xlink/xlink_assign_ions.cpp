@@ -258,6 +258,7 @@ vector<string> XLinkAssignIons::getOptions() const {
   string arr[] = {
     "verbosity",
     "spectrum-parser",
+    "scan-index-cache",
     "fragment-mass",
     "max-ion-charge",
     "mz-bin-width",
@@ -46,6 +46,7 @@
 #include "app/CascadeSearchApplication.h"
 #include "app/AssignConfidenceApplication.h"
 #include "app/SubtractIndexApplication.h"
+#include "app/TideBenchApplication.h"
 /**
  * The starting point for crux.  Prints a general usage statement when
  * given no arguments.  Runs one of the crux commands, including
@@ -93,6 +94,7 @@ int main(int argc, char** argv) {
     applications.add(new PrintVersion());
     applications.add(new PSMConvertApplication());
     applications.add(new SubtractIndexApplication());
+    applications.add(new TideBenchApplication());
     applications.add(new XLinkAssignIons());
     applications.add(new XLinkScoreSpectrum());
 
@@ -0,0 +1,645 @@
+/**
+ * \file BinaryMatchFile.cpp
+ * \brief Reader and writer for compact binary files of PSMs (matches).
+ */
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "BinaryMatchFile.h"
+#include "MatchCollectionParser.h"
+#include "carp.h"
+#include "model/MatchCollection.h"
+#include "model/PeptideSrc.h"
+#include "model/Protein.h"
+#include "util/FileUtils.h"
+#include "util/modifications.h"
+#include "util/Params.h"
+#include "util/StringUtils.h"
+
+using namespace std;
+using namespace Crux;
+
+const char BinaryMatchFile::MAGIC[8] = { 'C', 'R', 'U', 'X', 'P', 'S', 'M', 'B' };
+const unsigned int BinaryMatchFile::VERSION = 1;
+const char* BinaryMatchFile::EXTENSION = ".psm.bin";
+
+// rows buffered by the writer before a block is written
+static const unsigned int BLOCK_ROWS = 65536;
+
+bool BinaryMatchFile::isBinaryMatchFile(const string& file_path) {
+  return StringUtils::IEndsWith(file_path, EXTENSION);
+}
+
+int BinaryMatchFile::emptyInt() {
+  return numeric_limits<int>::min();
+}
+
+BinaryMatchFileWriter::BinaryMatchFileWriter(const string& file_path, bool overwrite)
+  : header_written_(false), block_rows_(0) {
+  if (FileUtils::Exists(file_path)) {
+    if (!overwrite) {
+      carp(CARP_FATAL,
+           "The file '%s' already exists and cannot be overwritten. "
+           "Use --overwrite T to replace or choose a different output file name",
+           file_path.c_str());
+    }
+    carp(CARP_WARNING, "The file '%s' already exists and will be overwritten.",
+         file_path.c_str());
+  }
+  file_ = new ofstream(file_path.c_str(), ios::out | ios::binary);
+  if (!file_->is_open()) {
+    carp(CARP_FATAL, "Error creating file '%s'.", file_path.c_str());
+  }
+  for (int i = 0; i < NUMBER_MATCH_COLUMNS; i++) {
+    column_idx_[i] = -1;
+  }
+  // string 0 is the empty string
+  getStringId("");
+}
+
+BinaryMatchFileWriter::~BinaryMatchFileWriter() {
+  close();
+}
+
+void BinaryMatchFileWriter::addColumn(
+  MATCH_COLUMNS_T col,
+  BinaryMatchFile::COLUMN_TYPE_T type
+) {
+  if (header_written_) {
+    carp(CARP_FATAL, "Cannot add column %s after rows have been written.",
+         get_column_header(col));
+  }
+  if (column_idx_[col] >= 0) {
+    return;
+  }
+  column_idx_[col] = columns_.size();
+  columns_.push_back(col);
+  types_.push_back(type);
+  int_row_.push_back(type == BinaryMatchFile::STRING_COLUMN ? 0 : BinaryMatchFile::emptyInt());
+  double_row_.push_back(numeric_limits<double>::quiet_NaN());
+  int_columns_.push_back(vector<int>());
+  double_columns_.push_back(vector<double>());
+}
+
+void BinaryMatchFileWriter::setInt(MATCH_COLUMNS_T col, int value) {
+  int idx = column_idx_[col];
+  if (idx < 0) {
+    return;
+  }
+  if (types_[idx] == BinaryMatchFile::DOUBLE_COLUMN) {
+    double_row_[idx] = value;
+  } else {
+    int_row_[idx] = value;
+  }
+}
+
+void BinaryMatchFileWriter::setDouble(MATCH_COLUMNS_T col, double value) {
+  int idx = column_idx_[col];
+  if (idx < 0) {
+    return;
+  }
+  if (types_[idx] == BinaryMatchFile::INT_COLUMN) {
+    int_row_[idx] = (int)value;
+  } else {
+    double_row_[idx] = value;
+  }
+}
+
+void BinaryMatchFileWriter::setString(MATCH_COLUMNS_T col, const string& value) {
+  int idx = column_idx_[col];
+  if (idx < 0) {
+    return;
+  }
+  if (types_[idx] != BinaryMatchFile::STRING_COLUMN) {
+    carp(CARP_FATAL, "Column %s does not hold strings.", get_column_header(col));
+  }
+  int_row_[idx] = getStringId(value);
+}
+
+/**
+ * Appends the current row to the column buffers and resets it.
+ */
+void BinaryMatchFileWriter::writeRow() {
+  if (!header_written_) {
+    writeHeader();
+  }
+  for (size_t i = 0; i < columns_.size(); i++) {
+    switch (types_[i]) {
+    case BinaryMatchFile::DOUBLE_COLUMN:
+      double_columns_[i].push_back(double_row_[i]);
+      double_row_[i] = numeric_limits<double>::quiet_NaN();
+      break;
+    case BinaryMatchFile::STRING_COLUMN:
+      int_columns_[i].push_back(int_row_[i]);
+      int_row_[i] = 0;
+      break;
+    default:
+      int_columns_[i].push_back(int_row_[i]);
+      int_row_[i] = BinaryMatchFile::emptyInt();
+      break;
+    }
+  }
+  if (++block_rows_ >= BLOCK_ROWS) {
+    writeBlock();
+  }
+}
+
+void BinaryMatchFileWriter::writeHeader() {
+  file_->write(BinaryMatchFile::MAGIC, sizeof(BinaryMatchFile::MAGIC));
+  unsigned int version = BinaryMatchFile::VERSION;
+  unsigned int num_columns = columns_.size();
+  file_->write((const char*)&version, sizeof(version));
+  file_->write((const char*)&num_columns, sizeof(num_columns));
+  for (size_t i = 0; i < columns_.size(); i++) {
+    string name = get_column_header(columns_[i]);
+    unsigned int length = name.length();
+    unsigned int type = types_[i];
+    file_->write((const char*)&length, sizeof(length));
+    file_->write(name.data(), length);
+    file_->write((const char*)&type, sizeof(type));
+  }
+  header_written_ = true;
+}
+
+void BinaryMatchFileWriter::writeBlock() {
+  if (block_rows_ == 0) {
+    return;
+  }
+  file_->write((const char*)&block_rows_, sizeof(block_rows_));
+  for (size_t i = 0; i < columns_.size(); i++) {
+    if (types_[i] == BinaryMatchFile::DOUBLE_COLUMN) {
+      file_->write((const char*)&double_columns_[i][0], block_rows_ * sizeof(double));
+      double_columns_[i].clear();
+    } else {
+      file_->write((const char*)&int_columns_[i][0], block_rows_ * sizeof(int));
+      int_columns_[i].clear();
+    }
+  }
+  block_rows_ = 0;
+}
+
+void BinaryMatchFileWriter::close() {
+  if (!file_) {
+    return;
+  }
+  if (!header_written_) {
+    writeHeader();
+  }
+  writeBlock();
+  unsigned int end = 0;
+  file_->write((const char*)&end, sizeof(end));
+
+  unsigned int num_strings = strings_.size();
+  file_->write((const char*)&num_strings, sizeof(num_strings));
+  for (vector<const string*>::const_iterator i = strings_.begin(); i != strings_.end(); ++i) {
+    unsigned int length = (*i)->length();
+    file_->write((const char*)&length, sizeof(length));
+    file_->write((*i)->data(), length);
+  }
+  file_->close();
+  delete file_;
+  file_ = NULL;
+}
+
+unsigned int BinaryMatchFileWriter::getStringId(const string& value) {
+  map<string, unsigned int>::iterator i = string_ids_.find(value);
+  if (i != string_ids_.end()) {
+    return i->second;
+  }
+  unsigned int id = strings_.size();
+  i = string_ids_.insert(make_pair(value, id)).first;
+  strings_.push_back(&i->first);
+  return id;
+}
+
+BinaryMatchFileReader::BinaryMatchFileReader(
+  const string& file_path,
+  Database* database,
+  Database* decoy_database
+) : PSMReader(file_path, database, decoy_database), num_rows_(0), row_(0) {
+  for (int i = 0; i < NUMBER_MATCH_COLUMNS; i++) {
+    column_idx_[i] = -1;
+  }
+}
+
+BinaryMatchFileReader::~BinaryMatchFileReader() {
+}
+
+MatchCollection* BinaryMatchFileReader::parse(
+  const string& file_path,
+  Database* database,
+  Database* decoy_database) {
+  return BinaryMatchFileReader(file_path, database, decoy_database).parse();
+}
+
+bool BinaryMatchFileReader::read() {
+  ifstream file(file_path_.c_str(), ios::in | ios::binary);
+  if (!file.is_open()) {
+    carp(CARP_ERROR, "Could not open %s", file_path_.c_str());
+    return false;
+  }
+  char magic[sizeof(BinaryMatchFile::MAGIC)];
+  unsigned int version, num_columns;
+  file.read(magic, sizeof(magic));
+  file.read((char*)&version, sizeof(version));
+  file.read((char*)&num_columns, sizeof(num_columns));
+  if (!file || memcmp(magic, BinaryMatchFile::MAGIC, sizeof(magic)) != 0) {
+    carp(CARP_ERROR, "%s is not a binary match file", file_path_.c_str());
+    return false;
+  } else if (version != BinaryMatchFile::VERSION) {
+    carp(CARP_ERROR, "%s has unsupported version %u", file_path_.c_str(), version);
+    return false;
+  }
+
+  for (unsigned int i = 0; i < num_columns; i++) {
+    unsigned int length, type;
+    file.read((char*)&length, sizeof(length));
+    string name(length, '\0');
+    file.read(&name[0], length);
+    file.read((char*)&type, sizeof(type));
+    int col = get_column_idx(name.c_str());
+    if (col >= 0 && col < NUMBER_MATCH_COLUMNS) {
+      column_idx_[col] = i;
+    } else {
+      carp(CARP_DEBUG, "Ignoring unknown column %s", name.c_str());
+    }
+    types_.push_back((BinaryMatchFile::COLUMN_TYPE_T)type);
+  }
+  int_columns_.resize(num_columns);
+  double_columns_.resize(num_columns);
+
+  unsigned int rows;
+  while (file.read((char*)&rows, sizeof(rows)) && rows > 0) {
+    for (unsigned int i = 0; i < num_columns; i++) {
+      if (types_[i] == BinaryMatchFile::DOUBLE_COLUMN) {
+        vector<double>& column = double_columns_[i];
+        column.resize(num_rows_ + rows);
+        file.read((char*)&column[num_rows_], rows * sizeof(double));
+      } else {
+        vector<int>& column = int_columns_[i];
+        column.resize(num_rows_ + rows);
+        file.read((char*)&column[num_rows_], rows * sizeof(int));
+      }
+    }
+    num_rows_ += rows;
+  }
+
+  unsigned int num_strings = 0;
+  file.read((char*)&num_strings, sizeof(num_strings));
+  strings_.resize(num_strings);
+  for (unsigned int i = 0; i < num_strings; i++) {
+    unsigned int length;
+    file.read((char*)&length, sizeof(length));
+    strings_[i].resize(length);
+    if (length > 0) {
+      file.read(&strings_[i][0], length);
+    }
+  }
+  if (!file) {
+    carp(CARP_ERROR, "%s is truncated", file_path_.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool BinaryMatchFileReader::empty(MATCH_COLUMNS_T col) const {
+  int idx = column_idx_[col];
+  if (idx == -1) {
+    return true;
+  }
+  switch (types_[idx]) {
+  case BinaryMatchFile::DOUBLE_COLUMN:
+    return isnan(double_columns_[idx][row_]);
+  case BinaryMatchFile::STRING_COLUMN:
+    return strings_[int_columns_[idx][row_]].empty();
+  default:
+    return int_columns_[idx][row_] == BinaryMatchFile::emptyInt();
+  }
+}
+
+int BinaryMatchFileReader::getInteger(MATCH_COLUMNS_T col) const {
+  int idx = column_idx_[col];
+  if (idx == -1) {
+    return -1;
+  }
+  switch (types_[idx]) {
+  case BinaryMatchFile::DOUBLE_COLUMN:
+    return (int)double_columns_[idx][row_];
+  case BinaryMatchFile::STRING_COLUMN:
+    return StringUtils::FromString<int>(getString(col));
+  default:
+    return int_columns_[idx][row_];
+  }
+}
+
+FLOAT_T BinaryMatchFileReader::getFloat(MATCH_COLUMNS_T col) const {
+  return (FLOAT_T)getDouble(col);
+}
+
+double BinaryMatchFileReader::getDouble(MATCH_COLUMNS_T col) const {
+  int idx = column_idx_[col];
+  if (idx == -1) {
+    return -1;
+  }
+  switch (types_[idx]) {
+  case BinaryMatchFile::DOUBLE_COLUMN:
+    return double_columns_[idx][row_];
+  case BinaryMatchFile::STRING_COLUMN:
+    return StringUtils::FromString<double>(getString(col));
+  default:
+    return int_columns_[idx][row_];
+  }
+}
+
+unsigned int BinaryMatchFileReader::getStringId(MATCH_COLUMNS_T col) const {
+  int idx = column_idx_[col];
+  if (idx == -1 || types_[idx] != BinaryMatchFile::STRING_COLUMN) {
+    return 0;
+  }
+  return int_columns_[idx][row_];
+}
+
+const string& BinaryMatchFileReader::getString(MATCH_COLUMNS_T col) const {
+  return strings_[getStringId(col)];
+}
+
+MatchCollection* BinaryMatchFileReader::parse() {
+  if (!read()) {
+    return NULL;
+  }
+  if (column_idx_[SEQUENCE_COL] == -1 || column_idx_[PROTEIN_ID_COL] == -1) {
+    carp(CARP_FATAL, "%s has no peptide sequence or protein id column",
+         file_path_.c_str());
+  }
+
+  MatchCollection* match_collection = new MatchCollection();
+  match_collection->preparePostProcess();
+  match_collection->setHasDistinctMatches(column_idx_[DISTINCT_MATCHES_SPECTRUM_COL] != -1);
+
+  // columns are typed for the whole file, so scored types are set once
+  match_collection->setScoredType(DELTA_CN, column_idx_[DELTA_CN_COL] != -1);
+  match_collection->setScoredType(DELTA_LCN, column_idx_[DELTA_LCN_COL] != -1);
+  match_collection->setScoredType(SP, column_idx_[SP_SCORE_COL] != -1);
+  match_collection->setScoredType(XCORR, column_idx_[XCORR_SCORE_COL] != -1);
+  match_collection->setScoredType(TIDE_SEARCH_EXACT_PVAL, column_idx_[EXACT_PVALUE_COL] != -1);
+  match_collection->setScoredType(TIDE_SEARCH_REFACTORED_XCORR, column_idx_[REFACTORED_SCORE_COL] != -1);
+  match_collection->setScoredType(EVALUE, column_idx_[EVALUE_COL] != -1);
+  match_collection->setScoredType(DECOY_XCORR_QVALUE, column_idx_[DECOY_XCORR_QVALUE_COL] != -1);
+  match_collection->setScoredType(LOGP_BONF_WEIBULL_XCORR, column_idx_[PVALUE_COL] != -1);
+  match_collection->setScoredType(PERCOLATOR_QVALUE, column_idx_[PERCOLATOR_QVALUE_COL] != -1);
+  match_collection->setScoredType(PERCOLATOR_SCORE, column_idx_[PERCOLATOR_SCORE_COL] != -1);
+  match_collection->setScoredType(LOGP_QVALUE_WEIBULL_XCORR, column_idx_[WEIBULL_QVALUE_COL] != -1);
+  match_collection->setScoredType(QRANKER_SCORE, column_idx_[QRANKER_SCORE_COL] != -1);
+  match_collection->setScoredType(QRANKER_QVALUE, column_idx_[QRANKER_QVALUE_COL] != -1);
+  match_collection->setScoredType(BARISTA_SCORE, column_idx_[BARISTA_SCORE_COL] != -1);
+  match_collection->setScoredType(BARISTA_QVALUE, column_idx_[BARISTA_QVALUE_COL] != -1);
+  match_collection->setScoredType(BY_IONS_MATCHED, column_idx_[BY_IONS_MATCHED_COL] != -1);
+  match_collection->setScoredType(BY_IONS_TOTAL, column_idx_[BY_IONS_TOTAL_COL] != -1);
+
+  for (row_ = 0; row_ < num_rows_; row_++) {
+    Match* match = parseMatch();
+    if (match == NULL) {
+      carp(CARP_ERROR, "Failed to parse binary PSM match");
+      delete match_collection;
+      return NULL;
+    }
+    SpectrumZState zState(getFloat(SPECTRUM_NEUTRAL_MASS_COL),
+                          getInteger(CHARGE_COL));
+    match->setZState(zState);
+    match_collection->addMatchToPostMatchCollection(match);
+  }
+  carp(CARP_DEBUG, "Read %d matches from %s", num_rows_, file_path_.c_str());
+  return match_collection;
+}
+
+/**
+ * \returns a match object for the current row
+ */
+Match* BinaryMatchFileReader::parseMatch() {
+  Spectrum* spectrum = new Spectrum(getInteger(SCAN_COL),
+                                    getInteger(SCAN_COL),
+                                    getFloat(SPECTRUM_PRECURSOR_MZ_COL),
+                                    vector<int>(1, getInteger(CHARGE_COL)),
+                                    getString(FILE_COL));
+  Peptide* peptide = parsePeptide();
+  if (peptide == NULL) {
+    delete spectrum;
+    return NULL;
+  }
+
+  Match* match = new Match(peptide, spectrum, spectrum->getZState(0), false);
+  match->setPostProcess(true);
+  match->setDatabaseIndexName(getString(INDEX_NAME_COL));
+  if (!empty(FILE_COL)) {
+    match->setFilePath(getString(FILE_COL));
+  }
+
+  if (empty(SP_SCORE_COL) || empty(SP_RANK_COL)) {
+    match->setScore(SP, NOT_SCORED);
+    match->setRank(SP, 0);
+  } else {
+    match->setScore(SP, getFloat(SP_SCORE_COL));
+    match->setRank(SP, getInteger(SP_RANK_COL));
+  }
+  match->setScore(XCORR, getFloat(XCORR_SCORE_COL));
+  match->setRank(XCORR, getInteger(XCORR_RANK_COL));
+  if (!empty(DELTA_CN_COL)) {
+    match->setScore(DELTA_CN, getFloat(DELTA_CN_COL));
+  }
+  if (!empty(DELTA_LCN_COL)) {
+    match->setScore(DELTA_LCN, getFloat(DELTA_LCN_COL));
+  }
+  if (!empty(EXACT_PVALUE_COL)) {
+    match->setScore(TIDE_SEARCH_EXACT_PVAL, getFloat(EXACT_PVALUE_COL));
+    match->setScore(TIDE_SEARCH_REFACTORED_XCORR, getFloat(REFACTORED_SCORE_COL));
+  }
+  if (!empty(DECOY_XCORR_QVALUE_COL)) {
+    match->setScore(DECOY_XCORR_QVALUE, getFloat(DECOY_XCORR_QVALUE_COL));
+  }
+  if (!empty(PVALUE_COL)) {
+    FLOAT_T pval = getFloat(PVALUE_COL);
+    match->setScore(LOGP_BONF_WEIBULL_XCORR,
+                    pval > 0 ? -log(pval) : numeric_limits<FLOAT_T>::infinity());
+  }
+  if (!empty(EVALUE_COL)) {
+    match->setScore(EVALUE, getFloat(EVALUE_COL));
+  }
+  if (!empty(PERCOLATOR_QVALUE_COL)) {
+    match->setScore(PERCOLATOR_QVALUE, getFloat(PERCOLATOR_QVALUE_COL));
+  }
+  if (!empty(PERCOLATOR_SCORE_COL)) {
+    match->setScore(PERCOLATOR_SCORE, getFloat(PERCOLATOR_SCORE_COL));
+    match->setRank(PERCOLATOR_SCORE, getInteger(PERCOLATOR_RANK_COL));
+  }
+  if (!empty(WEIBULL_QVALUE_COL)) {
+    match->setScore(LOGP_QVALUE_WEIBULL_XCORR, getFloat(WEIBULL_QVALUE_COL));
+  }
+  if (!empty(QRANKER_SCORE_COL)) {
+    match->setScore(QRANKER_SCORE, getFloat(QRANKER_SCORE_COL));
+    match->setScore(QRANKER_QVALUE, getFloat(QRANKER_QVALUE_COL));
+  }
+  if (!empty(BARISTA_SCORE_COL)) {
+    match->setScore(BARISTA_SCORE, getFloat(BARISTA_SCORE_COL));
+    match->setScore(BARISTA_QVALUE, getFloat(BARISTA_QVALUE_COL));
+  }
+  if (!empty(BY_IONS_MATCHED_COL)) {
+    match->setScore(BY_IONS_MATCHED, getInteger(BY_IONS_MATCHED_COL));
+  }
+  if (!empty(BY_IONS_TOTAL_COL)) {
+    match->setScore(BY_IONS_TOTAL, getInteger(BY_IONS_TOTAL_COL));
+  }
+
+  int experimentSize = 0;
+  if (!empty(DISTINCT_MATCHES_SPECTRUM_COL)) {
+    experimentSize = getInteger(DISTINCT_MATCHES_SPECTRUM_COL);
+  } else if (!empty(MATCHES_SPECTRUM_COL)) {
+    experimentSize = getInteger(MATCHES_SPECTRUM_COL);
+  }
+  match->setTargetExperimentSize(experimentSize);
+  if (experimentSize == 0) {
+    carp_once(CARP_WARNING, "num target matches=0, suppressing warning");
+    match->setLnExperimentSize(0);
+  } else {
+    match->setLnExperimentSize(log((FLOAT_T) experimentSize));
+  }
+
+  if (StringUtils::StartsWith(getString(PROTEIN_ID_COL), Params::GetString("decoy-prefix"))) {
+    match->setNullPeptide(true);
+  }
+  return match;
+}
+
+/**
+ * \returns a new peptide for the current row, with its protein sources.
+ * The sequence, modifications and sources are only parsed the first
+ * time a sequence is seen.
+ */
+Peptide* BinaryMatchFileReader::parsePeptide() {
+  pair<unsigned int, unsigned int> key(getStringId(SEQUENCE_COL),
+                                       getStringId(MODIFICATIONS_COL));
+  map<pair<unsigned int, unsigned int>, PeptideInfo>::iterator info = peptides_.find(key);
+  if (info == peptides_.end()) {
+    string seq = strings_[key.first];
+    if (seq.empty()) {
+      carp(CARP_FATAL, "No peptide sequence (%s).", seq.c_str());
+    }
+    // In cases where the sequence is in X.seq.X format, parse out the seq part
+    if (seq.length() > 4 && seq[1] == '.' && seq[seq.length() - 2] == '.') {
+      seq = seq.substr(2, seq.length() - 4);
+    }
+    Peptide peptide;
+    MODIFIED_AA_T* modified_seq;
+    peptide.setLength(convert_to_mod_aa_seq(seq.c_str(), &modified_seq));
+    peptide.setModifiedAASequence(modified_seq, false);
+    freeModSeq(modified_seq);
+
+    const string& modsString = strings_[key.second];
+    if (!modsString.empty()) {
+      vector<string> modStrings = StringUtils::Split(modsString, ',');
+      vector<Modification> mods;
+      for (vector<string>::const_iterator i = modStrings.begin(); i != modStrings.end(); i++) {
+        try {
+          Modification mod = Modification::Parse(StringUtils::Trim(*i), &peptide);
+          if (!mod.Static()) {
+            mods.push_back(mod);
+          }
+        } catch (runtime_error& e) {
+          carp(CARP_ERROR, "Error parsing modification string: %s", e.what());
+        }
+      }
+      peptide.setMods(mods);
+    }
+    info = peptides_.insert(make_pair(key, PeptideInfo())).first;
+    char* sequence = peptide.getSequence();
+    info->second.sequence = sequence;
+    free(sequence);
+    info->second.mods = peptide.getVarMods();
+  }
+
+  Peptide* peptide = new Peptide(info->second.sequence, info->second.mods);
+  const vector<SrcInfo>& srcs = getSrcs(info->second);
+  for (vector<SrcInfo>::const_iterator i = srcs.begin(); i != srcs.end(); ++i) {
+    PeptideSrc* src = new PeptideSrc();
+    if (i->start_idx_original >= 0) {
+      src->setStartIdxOriginal(i->start_idx_original);
+    }
+    src->setParentProtein(i->protein);
+    src->setDigest(i->digestion);
+    src->setStartIdx(i->start_idx);
+    peptide->addPeptideSrc(src);
+  }
+  return peptide;
+}
+
+/**
+ * \returns the protein sources for the current row, as
+ * PeptideSrc::parseTabDelimited would find them.
+ */
+const vector<BinaryMatchFileReader::SrcInfo>& BinaryMatchFileReader::getSrcs(
+  const PeptideInfo& info
+) {
+  SrcKey key(make_pair(getStringId(PROTEIN_ID_COL), getStringId(FLANKING_AA_COL)),
+             make_pair(getStringId(SEQUENCE_COL), getStringId(CLEAVAGE_TYPE_COL)));
+  map<SrcKey, vector<SrcInfo> >::iterator found = srcs_.find(key);
+  if (found != srcs_.end()) {
+    return found->second;
+  }
+  vector<SrcInfo>& srcs = srcs_[key];
+
+  vector<string> protein_ids = StringUtils::Split(strings_[key.first.first], ',');
+  vector<string> flanking_aas = StringUtils::Split(strings_[key.first.second], ',');
+  while (flanking_aas.size() < protein_ids.size()) {
+    flanking_aas.push_back("");
+  }
+  DIGEST_T digestion = string_to_digest_type(strings_[key.second.second]);
+
+  for (size_t idx = 0; idx < protein_ids.size(); idx++) {
+    string protein_id = protein_ids[idx];
+    const string& flanking_aa = flanking_aas[idx];
+    string prev_aa = "", next_aa = "";
+    if (flanking_aa.length() == 2) {
+      prev_aa = flanking_aa[0];
+      next_aa = flanking_aa[1];
+    }
+
+    SrcInfo src;
+    src.digestion = digestion;
+    src.start_idx_original = -1;
+    bool is_decoy;
+    size_t left_paren_index = protein_id.find('(');
+    if (left_paren_index == string::npos) {
+      src.protein = MatchCollectionParser::getProtein(
+        database_, decoy_database_, protein_id, is_decoy);
+      if (src.protein == NULL) {
+        carp(CARP_WARNING, "Can't find protein %s", protein_id.c_str());
+        continue;
+      }
+      src.start_idx = src.protein->findStart(info.sequence, prev_aa, next_aa);
+      if (src.start_idx == -1) {
+        carp(CARP_FATAL, "Can't find sequence %s in %s",
+             info.sequence.c_str(), protein_id.c_str());
+      }
+    } else {
+      string protein_id_string = protein_id.substr(0, left_paren_index);
+      string start_index_string = protein_id.substr(left_paren_index + 1,
+        protein_id.length() - left_paren_index - 2);
+      src.protein = MatchCollectionParser::getProtein(
+        database_, decoy_database_, protein_id_string, is_decoy);
+      if (src.protein->isPostProcess()) {
+        src.start_idx_original = StringUtils::FromString<int>(start_index_string);
+      }
+      src.start_idx = src.protein->findStart(info.sequence, prev_aa, next_aa);
+    }
+    srcs.push_back(src);
+  }
+  return srcs;
+}
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 2
+ * End:
+ */
@@ -0,0 +1,174 @@
+/**
+ * \file BinaryMatchFile.h
+ * \brief Reader and writer for compact binary files of PSMs (matches).
+ *
+ * A binary match file holds the same columns as a tab-delimited match
+ * file, stored column by column as typed values instead of text.
+ * Strings (peptide sequences, protein ids, ...) are stored once in a
+ * string table and referenced by index, so reading a file is mostly a
+ * matter of copying arrays.
+ *
+ * Layout, in native byte order:
+ *   "CRUXPSMB", uint32 version, uint32 number of columns
+ *   per column: uint32 name length, column name (as in MatchColumns),
+ *     uint32 column type
+ *   blocks of rows: uint32 number of rows (0 ends the blocks), then
+ *     for each column that many int32, double or uint32 string indices
+ *   string table: uint32 number of strings, then uint32 length and
+ *     bytes of each string; string 0 is always the empty string
+ */
+
+#ifndef BINARY_MATCH_FILE_H
+#define BINARY_MATCH_FILE_H
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "MatchColumns.h"
+#include "PSMReader.h"
+#include "model/Modification.h"
+#include "model/objects.h"
+
+class BinaryMatchFile {
+ public:
+  enum COLUMN_TYPE_T { INT_COLUMN, DOUBLE_COLUMN, STRING_COLUMN };
+
+  static const char MAGIC[8];
+  static const unsigned int VERSION;
+  static const char* EXTENSION; ///< ".psm.bin"
+
+  /**
+   * \returns true if the file name has the binary match file extension.
+   */
+  static bool isBinaryMatchFile(const std::string& file_path);
+
+  /**
+   * Value stored for an int cell that was not set.
+   */
+  static int emptyInt();
+};
+
+/**
+ * Writes a binary match file. Columns are added before the first row;
+ * each row is filled in with the set functions and then written with
+ * writeRow(). Rows are buffered and written in blocks.
+ */
+class BinaryMatchFileWriter {
+ public:
+  /**
+   * Creates the file, or dies if it exists and overwrite is false.
+   */
+  BinaryMatchFileWriter(const std::string& file_path, bool overwrite);
+  ~BinaryMatchFileWriter();
+
+  void addColumn(MATCH_COLUMNS_T col, BinaryMatchFile::COLUMN_TYPE_T type);
+  bool hasColumn(MATCH_COLUMNS_T col) const { return column_idx_[col] >= 0; }
+
+  void setInt(MATCH_COLUMNS_T col, int value);
+  void setDouble(MATCH_COLUMNS_T col, double value);
+  void setString(MATCH_COLUMNS_T col, const std::string& value);
+
+  void writeRow();
+
+  /**
+   * Writes any buffered rows and the string table, then closes the file.
+   */
+  void close();
+
+ protected:
+  void writeHeader();
+  void writeBlock();
+  unsigned int getStringId(const std::string& value);
+
+  std::ofstream* file_;
+  bool header_written_;
+  int column_idx_[NUMBER_MATCH_COLUMNS];
+  std::vector<MATCH_COLUMNS_T> columns_;
+  std::vector<BinaryMatchFile::COLUMN_TYPE_T> types_;
+  std::vector<int> int_row_; ///< current row, int and string columns
+  std::vector<double> double_row_; ///< current row, double columns
+  std::vector< std::vector<int> > int_columns_;
+  std::vector< std::vector<double> > double_columns_;
+  unsigned int block_rows_;
+  std::map<std::string, unsigned int> string_ids_;
+  std::vector<const std::string*> strings_;
+};
+
+/**
+ * Reads a binary match file into a MatchCollection. Peptides and protein
+ * sources are built once per distinct string and then copied.
+ */
+class BinaryMatchFileReader : public PSMReader {
+ public:
+  BinaryMatchFileReader(
+    const std::string& file_path,
+    Database* database,
+    Database* decoy_database = NULL
+  );
+  ~BinaryMatchFileReader();
+
+  MatchCollection* parse();
+
+  static MatchCollection* parse(
+    const std::string& file_path,
+    Database* database,
+    Database* decoy_database = NULL
+  );
+
+  /**
+   * Reads all columns and the string table into memory, for reading the
+   * rows one at a time with the same calls as a MatchFileReader.
+   * \returns false if the file is not a valid binary match file.
+   */
+  bool read();
+  bool hasNext() const { return row_ < num_rows_; }
+  void next() { row_++; }
+
+  bool empty(MATCH_COLUMNS_T col) const;
+  int getInteger(MATCH_COLUMNS_T col) const;
+  FLOAT_T getFloat(MATCH_COLUMNS_T col) const;
+  double getDouble(MATCH_COLUMNS_T col) const;
+  const std::string& getString(MATCH_COLUMNS_T col) const;
+
+ protected:
+  struct PeptideInfo {
+    std::string sequence;
+    std::vector<Crux::Modification> mods;
+  };
+  struct SrcInfo {
+    Crux::Protein* protein;
+    int start_idx;
+    int start_idx_original; ///< -1 if not set
+    DIGEST_T digestion;
+  };
+  typedef std::pair< std::pair<unsigned int, unsigned int>,
+                     std::pair<unsigned int, unsigned int> > SrcKey;
+
+  unsigned int getStringId(MATCH_COLUMNS_T col) const;
+
+  Crux::Match* parseMatch();
+  Crux::Peptide* parsePeptide();
+  const std::vector<SrcInfo>& getSrcs(const PeptideInfo& info);
+
+  int column_idx_[NUMBER_MATCH_COLUMNS];
+  std::vector<BinaryMatchFile::COLUMN_TYPE_T> types_;
+  std::vector< std::vector<int> > int_columns_;
+  std::vector< std::vector<double> > double_columns_;
+  std::vector<std::string> strings_;
+  size_t num_rows_;
+  size_t row_; ///< row being parsed
+
+  std::map<std::pair<unsigned int, unsigned int>, PeptideInfo> peptides_;
+  std::map<SrcKey, std::vector<SrcInfo> > srcs_;
+};
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 2
+ * End:
+ */
@@ -10,6 +10,19 @@
 #include "util/Params.h"
 #include "parameter.h"
 #include "model/Spectrum.h"
+#include "util/FileUtils.h"
+#include "util/StringUtils.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+using namespace std;
+
+/**
+ * Identifies and versions scan index cache files.
+ */
+static const char SCAN_INDEX_MAGIC[8] = { 'C', 'R', 'X', 'S', 'C', 'A', 'N', '1' };
 
 /**
  * Instantiates a new spectrum_collection object from a filename. 
@@ -17,10 +30,18 @@
  */
 MSToolkitSpectrumCollection::MSToolkitSpectrumCollection(
   const string& filename   ///< The spectrum collection filename.
-) : SpectrumCollection(filename) {
+) : SpectrumCollection(filename),
+    scan_index_built_(false), indexed_reader_(NULL) {
 
 }
 
+/**
+ * Closes the indexed reader, if any.
+ */
+MSToolkitSpectrumCollection::~MSToolkitSpectrumCollection() {
+  delete indexed_reader_;
+}
+
 /**
  * Parses all the spectra from file designated by the filename member
  * variable.
@@ -94,6 +115,19 @@ bool MSToolkitSpectrumCollection::getSpectrum(
   int first_scan,      ///< The first scan of the spectrum to retrieve -in
   Crux::Spectrum* spectrum   ///< Put the spectrum info here
   ) {
+  // Scan 0 is left to MSToolkit, for which it marks the end of the file.
+  if (first_scan > 0 && buildScanIndex()) {
+    vector< pair<int, long long> >::const_iterator entry = lower_bound(
+      scan_offsets_.begin(), scan_offsets_.end(), make_pair(first_scan, -1LL));
+    if (entry == scan_offsets_.end() || entry->first != first_scan) {
+      carp(CARP_ERROR, "Spectrum %d does not exist in file", first_scan);
+      return false;
+    }
+    if (readIndexedSpectrum(entry->second, spectrum)) {
+      return true;
+    }
+  }
+
   carp(CARP_DEBUG, "Using mstoolkit to parse spectrum");
   MSToolkit::MSReader* mst_reader = new MSToolkit::MSReader();
   MSToolkit::Spectrum* mst_spectrum = new MSToolkit::Spectrum();
@@ -122,6 +156,15 @@ bool MSToolkitSpectrumCollection::getSpectrum(
 Crux::Spectrum* MSToolkitSpectrumCollection::getSpectrum(
   int first_scan      ///< The first scan of the spectrum to retrieve -in
   ) {
+  if (buildScanIndex()) {
+    Crux::Spectrum* spectrum = new Crux::Spectrum();
+    if (!getSpectrum(first_scan, spectrum)) {
+      delete spectrum;
+      return NULL;
+    }
+    return spectrum;
+  }
+
   carp(CARP_DEBUG, "Using mstoolkit to parse spectrum");
   MSToolkit::MSReader* mst_reader = new MSToolkit::MSReader();
   MSToolkit::Spectrum* mst_spectrum = new MSToolkit::Spectrum();
@@ -142,6 +185,202 @@ Crux::Spectrum* MSToolkitSpectrumCollection::getSpectrum(
   return return_spec;
 }
 
+/**
+ * Fills scan_offsets_ if the file is a text MS2 file, reading the cache
+ * file beside it if scan-index-cache is set and the cache is current.
+ * \returns True if the file is indexed.
+ */
+bool MSToolkitSpectrumCollection::buildScanIndex() {
+  if (scan_index_built_) {
+    return indexed_reader_ != NULL;
+  }
+  scan_index_built_ = true;
+  if (!StringUtils::IEndsWith(filename_, ".ms2")) {
+    return false;
+  }
+
+  bool use_cache = Params::GetBool("scan-index-cache");
+  string cache_file = filename_ + ".scanidx";
+  if (!use_cache || !readScanIndexCache(cache_file)) {
+    carp(CARP_DEBUG, "Indexing scans in %s", filename_.c_str());
+    ifstream in(filename_.c_str(), ios::in | ios::binary);
+    if (!in.good()) {
+      return false;
+    }
+    scan_offsets_.clear();
+    long long offset = 0;
+    string line;
+    while (getline(in, line)) {
+      if (line.length() > 1 && line[0] == 'S' && (line[1] == '\t' || line[1] == ' ')) {
+        int scan;
+        istringstream fields(line.substr(1));
+        if (fields >> scan) {
+          scan_offsets_.push_back(make_pair(scan, offset));
+        }
+      }
+      offset += line.length() + 1;
+    }
+    // Keep the first spectrum for a repeated scan number, as a sequential
+    // search would find.
+    stable_sort(scan_offsets_.begin(), scan_offsets_.end());
+    vector< pair<int, long long> >::iterator out = scan_offsets_.begin();
+    for (vector< pair<int, long long> >::const_iterator i = scan_offsets_.begin();
+         i != scan_offsets_.end(); ++i) {
+      if (out == scan_offsets_.begin() || (out - 1)->first != i->first) {
+        *out++ = *i;
+      }
+    }
+    scan_offsets_.erase(out, scan_offsets_.end());
+    if (use_cache) {
+      writeScanIndexCache(cache_file);
+    }
+  }
+
+  indexed_reader_ = new ifstream(filename_.c_str(), ios::in | ios::binary);
+  if (!indexed_reader_->good()) {
+    delete indexed_reader_;
+    indexed_reader_ = NULL;
+    return false;
+  }
+  carp(CARP_DEBUG, "Indexed %d scans in %s",
+       (int)scan_offsets_.size(), filename_.c_str());
+  return true;
+}
+
+/**
+ * Reads scan_offsets_ from the cache file if it matches the size and
+ * modification time of the spectrum file.
+ */
+bool MSToolkitSpectrumCollection::readScanIndexCache(const string& cache_file) {
+  if (!FileUtils::Exists(cache_file)) {
+    return false;
+  }
+  ifstream in(cache_file.c_str(), ios::in | ios::binary);
+  char magic[sizeof(SCAN_INDEX_MAGIC)];
+  long long file_size, write_time, count;
+  in.read(magic, sizeof(magic));
+  in.read((char*)&file_size, sizeof(file_size));
+  in.read((char*)&write_time, sizeof(write_time));
+  in.read((char*)&count, sizeof(count));
+  if (!in.good() ||
+      !equal(magic, magic + sizeof(magic), SCAN_INDEX_MAGIC) ||
+      file_size != FileUtils::Size(filename_) ||
+      write_time != (long long)FileUtils::LastWriteTime(filename_) ||
+      count < 0) {
+    carp(CARP_DEBUG, "Ignoring out of date scan index %s", cache_file.c_str());
+    return false;
+  }
+  scan_offsets_.resize(count);
+  for (long long i = 0; i < count && in.good(); ++i) {
+    int scan;
+    long long offset;
+    in.read((char*)&scan, sizeof(scan));
+    in.read((char*)&offset, sizeof(offset));
+    scan_offsets_[i] = make_pair(scan, offset);
+  }
+  if (!in.good()) {
+    scan_offsets_.clear();
+    return false;
+  }
+  carp(CARP_DEBUG, "Read scan index %s", cache_file.c_str());
+  return true;
+}
+
+/**
+ * Writes scan_offsets_ to the cache file. Failure is not an error.
+ */
+void MSToolkitSpectrumCollection::writeScanIndexCache(const string& cache_file) {
+  ofstream out(cache_file.c_str(), ios::out | ios::binary | ios::trunc);
+  long long file_size = FileUtils::Size(filename_);
+  long long write_time = FileUtils::LastWriteTime(filename_);
+  long long count = scan_offsets_.size();
+  out.write(SCAN_INDEX_MAGIC, sizeof(SCAN_INDEX_MAGIC));
+  out.write((const char*)&file_size, sizeof(file_size));
+  out.write((const char*)&write_time, sizeof(write_time));
+  out.write((const char*)&count, sizeof(count));
+  for (vector< pair<int, long long> >::const_iterator i = scan_offsets_.begin();
+       i != scan_offsets_.end(); ++i) {
+    out.write((const char*)&i->first, sizeof(i->first));
+    out.write((const char*)&i->second, sizeof(i->second));
+  }
+  out.close();
+  if (!out.good()) {
+    carp(CARP_DEBUG, "Could not write scan index %s", cache_file.c_str());
+    FileUtils::Remove(cache_file);
+  }
+}
+
+/**
+ * Reads the spectrum whose S line is at the given offset into an MSToolkit
+ * spectrum, then converts it as parse() does.
+ * \returns True if the spectrum was parsed, false if it has to be read with
+ * MSToolkit instead: if it cannot be parsed here or has no Z lines.
+ */
+bool MSToolkitSpectrumCollection::readIndexedSpectrum(
+  long long offset,
+  Crux::Spectrum* spectrum
+) {
+  indexed_reader_->clear();
+  indexed_reader_->seekg(offset);
+  MSToolkit::Spectrum mst_spectrum;
+  string line;
+  bool have_s_line = false;
+  while (getline(*indexed_reader_, line)) {
+    if (!line.empty() && line[line.length() - 1] == '\r') {
+      line.erase(line.length() - 1);
+    }
+    if (line.empty()) {
+      continue;
+    }
+    switch (line[0]) {
+    case 'S': {
+      if (have_s_line) {
+        // start of the next spectrum
+        return mst_spectrum.sizeZ() > 0 &&
+          spectrum->parseMstoolkitSpectrum(&mst_spectrum, filename_.c_str());
+      }
+      istringstream fields(line.substr(1));
+      int first_scan, last_scan;
+      double precursor_mz;
+      if (!(fields >> first_scan >> last_scan >> precursor_mz)) {
+        return false;
+      }
+      mst_spectrum.setScanNumber(first_scan);
+      mst_spectrum.setScanNumber(last_scan, true);
+      mst_spectrum.setMZ(precursor_mz);
+      have_s_line = true;
+      break;
+    }
+    case 'Z': {
+      istringstream fields(line.substr(1));
+      int charge;
+      double mh;
+      if (fields >> charge >> mh) {
+        mst_spectrum.addZState(charge, mh);
+      }
+      break;
+    }
+    case 'H':
+    case 'I':
+    case 'D':
+      break;
+    default: {
+      const char* mz_start = line.c_str();
+      char* mz_end;
+      char* intensity_end;
+      double mz = strtod(mz_start, &mz_end);
+      float intensity = (float)strtod(mz_end, &intensity_end);
+      if (mz_end != mz_start && intensity_end != mz_end) {
+        mst_spectrum.add(mz, intensity);
+      }
+      break;
+    }
+    }
+  }
+  return have_s_line && mst_spectrum.sizeZ() > 0 &&
+    spectrum->parseMstoolkitSpectrum(&mst_spectrum, filename_.c_str());
+}
+
 /*
  * Local Variables:
  * mode: c
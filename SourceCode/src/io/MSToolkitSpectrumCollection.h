@@ -9,6 +9,10 @@
 
 #include "SpectrumCollection.h"
 
+#include <fstream>
+#include <utility>
+#include <vector>
+
 /**
  * \class SpectrumCollection
  * \brief An abstract class for accessing spectra from a file.
@@ -16,6 +20,43 @@
 class MSToolkitSpectrumCollection : public Crux::SpectrumCollection {
 
  protected:
+  /**
+   * Byte offset of the S line of each spectrum in a text MS2 file, sorted
+   * by first scan. Built on the first call to getSpectrum(), so that
+   * later calls seek straight to the spectrum instead of having MSToolkit
+   * read the file from the start.
+   */
+  std::vector< std::pair<int, long long> > scan_offsets_;
+  bool scan_index_built_;  ///< getSpectrum() has tried to build the index
+  std::ifstream* indexed_reader_;  ///< open while the index is in use
+
+  /**
+   * Fills scan_offsets_ if the file is a text MS2 file, reading the cache
+   * file beside it if scan-index-cache is set and the cache is current.
+   * \returns True if the file is indexed.
+   */
+  bool buildScanIndex();
+
+  /**
+   * Reads scan_offsets_ from the cache file if it matches the size and
+   * modification time of the spectrum file.
+   */
+  bool readScanIndexCache(const std::string& cache_file);
+
+  /**
+   * Writes scan_offsets_ to the cache file. Failure is not an error.
+   */
+  void writeScanIndexCache(const std::string& cache_file);
+
+  /**
+   * Reads the spectrum whose S line is at the given offset.
+   * \returns True if the spectrum was parsed, false if MSToolkit has to
+   * read it.
+   */
+  bool readIndexedSpectrum(
+    long long offset,
+    Crux::Spectrum* spectrum
+  );
 
  public:
   /**
@@ -25,6 +66,11 @@ class MSToolkitSpectrumCollection : public Crux::SpectrumCollection {
     const std::string& filename ///< The spectrum collection filename. -in
   );
 
+  /**
+   * Destructor closes the indexed reader, if any.
+   */
+  virtual ~MSToolkitSpectrumCollection();
+
   /**
    * Parses all the spectra from file designated by the filename member
    * variable.
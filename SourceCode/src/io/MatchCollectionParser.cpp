@@ -7,6 +7,7 @@
  */
 #include "parameter.h"
 #include "MatchCollectionParser.h"
+#include "BinaryMatchFile.h"
 #include "MatchFileReader.h"
 #include "PepXMLReader.h"
 #include "SQTReader.h"
@@ -193,6 +194,8 @@ MatchCollection* MatchCollectionParser::create(
     collection = SQTReader::parse(match_path, database_, decoy_database_);
   } else if (StringUtils::IEndsWith(match_path, ".mzid")) {
     collection = MzIdentMLReader::parse(match_path, database_, decoy_database_);
+  } else if (BinaryMatchFile::isBinaryMatchFile(match_path)) {
+    collection = BinaryMatchFileReader::parse(match_path, database_, decoy_database_);
   } else {
     collection = MatchFileReader::parse(match_path, database_, decoy_database_);
   }
@@ -141,7 +141,10 @@ static const char* match_column_strings[NUMBER_MATCH_COLUMNS] = {
   "xcorr 2",
   "protein id x",
   "index name",
-  "xlink type"
+  "xlink type",
+  "localization score",
+  "site probabilities",
+  "delta mass"
 };
 
 /**
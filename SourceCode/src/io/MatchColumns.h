@@ -111,6 +111,9 @@ enum MATCH_COLUMNS_T {
   PROTEIN_ID_X_COL,
   INDEX_NAME_COL,
   XLINK_TYPE_COL,
+  LOCALIZATION_SCORE_COL,
+  SITE_PROBABILITIES_COL,
+  DELTA_MASS_COL,
 
   NUMBER_MATCH_COLUMNS,
   INVALID_COL
@@ -76,6 +76,7 @@ void MatchFileWriter::setPrecision() {
     case PROTEIN_ID_COL:
     case FLANKING_AA_COL:
     case ORIGINAL_TARGET_SEQUENCE_COL:
+    case SITE_PROBABILITIES_COL:
     case PARSIMONY_RANK_COL:
     case RAW_SCORE_COL:  //Raw counts should be integral
       match_precision_[col_idx] = 0;
@@ -89,6 +90,7 @@ void MatchFileWriter::setPrecision() {
     case DM_COL:
     case ABS_DM_COL:
     case PEPTIDE_MASS_COL:
+    case DELTA_MASS_COL:
       match_precision_[col_idx] = Params::GetInt("mass-precision");
       match_fixed_float_[col_idx] = true;
       break;
@@ -129,6 +131,7 @@ void MatchFileWriter::setPrecision() {
     case SIDAK_ADJUSTED_COL:
     case QVALUE_MIXMAX_COL:
     case QVALUE_TDC_COL:
+    case LOCALIZATION_SCORE_COL:
 #ifdef NEW_COLUMNS
     case WEIBULL_PEPTIDE_QVALUE_COL:      // NEW
     case DECOY_XCORR_PEPTIDE_QVALUE_COL:  // NEW
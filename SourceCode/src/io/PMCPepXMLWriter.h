@@ -43,10 +43,9 @@ class PMCPepXMLWriter : public PepXMLWriter, public PSMWriter {
     ProteinMatchCollection* collection ///< collection to be written
   );
 
- protected:
-
   /**
-   * Writes the PSMs in a ProteinMatchCollection to the currently open file
+   * Writes the PSMs in a ProteinMatchCollection to the currently open file,
+   * without the header, so that matches can be written in several parts.
    */
   void writePSMs(
     ProteinMatchCollection* collection ///< collection to be written
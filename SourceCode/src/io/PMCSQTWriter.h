@@ -40,10 +40,9 @@ class PMCSQTWriter : public SQTWriter, public PSMWriter {
     int charge
   );
 
- protected:
-
   /**
-   * Writes the PSMs in a ProteinMatchCollection to the currently open file
+   * Writes the PSMs in a ProteinMatchCollection to the currently open file,
+   * without the header, so that matches can be written in several parts.
    */
   void writePSMs(
     ProteinMatchCollection* collection ///< collection to be written
@@ -133,6 +133,23 @@ void PinWriter::write(
 }
 
 void PinWriter::write(MatchCollection* collection, string database) {
+  int max_charge = 0;
+  for (MatchIterator i = MatchIterator(collection); i.hasNext();) {
+    max_charge = max(i.next()->getCharge(), max_charge);
+  }
+  enableFeatures(collection, max_charge);
+
+  vector<MatchCollection*> decoyvec;
+  int top_match = Params::GetInt("top-match");
+  printHeader();
+  write(collection, decoyvec, top_match); // TODO: When top match is greater than default (5) in a given PSM File?
+}
+
+/**
+ * Enables the features for the scores of the collection, and the charge
+ * features up to max_charge.
+ */
+void PinWriter::enableFeatures(MatchCollection* collection, int max_charge) {
   bool sp = collection->getScoredType(SP);
   bool xcorr = collection->getScoredType(XCORR);
   bool exact_p = collection->getScoredType(TIDE_SEARCH_REFACTORED_XCORR);
@@ -145,18 +162,9 @@ void PinWriter::write(MatchCollection* collection, string database) {
   setEnabledStatus("RefactoredXCorr", exact_p);
   setEnabledStatus("NegLog10PValue", exact_p);
 
-  int max_charge = 0;
-  for (MatchIterator i = MatchIterator(collection); i.hasNext();) {
-    max_charge = max(i.next()->getCharge(), max_charge);
-  }
   for (int i = 1; i <= max_charge; i++) {
     setEnabledStatus("Charge" + StringUtils::ToString(i), true);
   }
-
-  vector<MatchCollection*> decoyvec;
-  int top_match = Params::GetInt("top-match");
-  printHeader();
-  write(collection, decoyvec, top_match); // TODO: When top match is greater than default (5) in a given PSM File?
 }
 
 bool PinWriter::isInfinite(FLOAT_T x) {
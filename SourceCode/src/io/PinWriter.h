@@ -36,6 +36,10 @@ class PinWriter : public PSMWriter {
     std::string database
   );
 
+  void enableFeatures(
+    MatchCollection* collection,
+    int max_charge
+  );
   void printHeader();
 
   void closeFile();
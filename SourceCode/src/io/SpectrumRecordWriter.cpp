@@ -1,5 +1,13 @@
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <memory>
+#include <sstream>
+#include <boost/bind.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/thread.hpp>
+#include "app/tide/indexed_spectra.h"
 #include "app/tide/records.h"
 #include "app/tide/mass_constants.h"
 
@@ -8,6 +16,8 @@
 #include "SpectrumRecordWriter.h"
 #include "io/carp.h"
 #include "util/crux-utils.h"
+#include "util/Params.h"
+#include "util/StringUtils.h"
 
 // For printing uint64_t values
 #define __STDC_FORMAT_MACROS
@@ -17,14 +27,36 @@
 
 int SpectrumRecordWriter::scanCounter_ = 0;
 
+/**
+ * A piece of an MS2 file, starting at an S line or at the start of the
+ * file, and the records of its spectra in file order.
+ */
+struct SpectrumRecordWriter::Ms2Chunk {
+  const char* begin;
+  const char* end;
+  vector<int> scans;  ///< scan number of each spectrum
+  vector<vector<pb::Spectrum> > spectra;  ///< records of each spectrum
+  bool complete;  ///< false if parsing stopped at a spectrum that needs MSToolkit
+};
+
 /**
  * Converts a spectra file to spectrumrecords format for use with tide-search.
- * Spectra file is read by pwiz. Returns true on successful conversion.
+ * With spectrum-parser=mstoolkit, an MS2 file is parsed directly in parallel
+ * chunks; otherwise the spectra file is read by the configured parser.
+ * Returns true on successful conversion.
  */
 bool SpectrumRecordWriter::convert(
   const string& infile, ///< spectra file to convert
   string outfile  ///< spectrumrecords file to output
 ) {
+  if (Params::GetString("spectrum-parser") == "mstoolkit" &&
+      StringUtils::IEndsWith(infile, ".ms2")) {
+    if (convertMs2(infile, outfile)) {
+      return true;
+    }
+    carp(CARP_DEBUG, "Reading %s with MSToolkit", infile.c_str());
+  }
+
   auto_ptr<Crux::SpectrumCollection> spectra(SpectrumCollectionFactory::create(infile.c_str()));
 
   // Open infile
@@ -51,7 +83,7 @@ bool SpectrumRecordWriter::convert(
 
   header.mutable_spectra_header()->set_sorted(false);
 
-  HeadedRecordWriter writer(outfile, header);
+  SpectraWriter writer(outfile, header, Params::GetInt("spectrumrecords-version"));
   if (!writer.OK()) {
     return false;
   }
@@ -69,7 +101,7 @@ bool SpectrumRecordWriter::convert(
     }
   }
 
-  return true;
+  return writer.Close();
 }
 
 /**
@@ -93,20 +125,33 @@ vector<pb::Spectrum> SpectrumRecordWriter::getPbSpectra(
     scan_num = ++scanCounter_;
   }
 
-  const vector<SpectrumZState>& zStates = s->getZStates();
+  addPbSpectra(scan_num, s->getZStates(), s->getPeakMzs(),
+               s->getPeakIntensities(), &spectra);
+  return spectra;
+}
+
+/**
+ * Add a pb::Spectrum for each charge state of a spectrum with peaks
+ * sorted by m/z
+ */
+void SpectrumRecordWriter::addPbSpectra(
+  int scanNum,
+  const vector<SpectrumZState>& zStates,
+  const vector<FLOAT_T>& peakMzs,
+  const vector<FLOAT_T>& peakIntensities,
+  vector<pb::Spectrum>* spectra
+) {
   for (vector<SpectrumZState>::const_iterator i = zStates.begin(); i != zStates.end(); ++i) {
-    spectra.push_back(pb::Spectrum());
-    pb::Spectrum& newSpectrum = spectra.back();
-    newSpectrum.set_spectrum_number(scan_num);
+    spectra->push_back(pb::Spectrum());
+    pb::Spectrum& newSpectrum = spectra->back();
+    newSpectrum.set_spectrum_number(scanNum);
     newSpectrum.set_precursor_m_z(i->getMZ());
     newSpectrum.mutable_charge_state()->Add(i->getCharge());
-    addPeaks(&newSpectrum, s);
+    addPeaks(&newSpectrum, peakMzs, peakIntensities);
     if (newSpectrum.peak_m_z_size() == 0) {
-      spectra.pop_back();
+      spectra->pop_back();
     }
   }
-
-  return spectra;
 }
 
 /**
@@ -114,20 +159,21 @@ vector<pb::Spectrum> SpectrumRecordWriter::getPbSpectra(
  */
 void SpectrumRecordWriter::addPeaks(
   pb::Spectrum* spectrum,
-  const Crux::Spectrum* s
+  const vector<FLOAT_T>& peakMzs,
+  const vector<FLOAT_T>& peakIntensities
 ) {
   int mz_denom, intensity_denom;
-  getDenoms(s, &mz_denom, &intensity_denom);
+  getDenoms(peakMzs, peakIntensities, &mz_denom, &intensity_denom);
   spectrum->set_peak_m_z_denominator(mz_denom);
   spectrum->set_peak_intensity_denominator(intensity_denom);
   uint64_t last = 0;
   int last_index = -1;
   uint64_t intensity_sum = 0;
 
-  for (PeakIterator i = s->begin(); i != s->end(); ++i) {
-    FLOAT_T peakMz = (*i)->getLocation();
+  for (size_t i = 0; i < peakMzs.size(); ++i) {
+    FLOAT_T peakMz = peakMzs[i];
     uint64_t mz = peakMz * mz_denom + 0.5;
-    uint64_t intensity = (*i)->getIntensity() * intensity_denom + 0.5;
+    uint64_t intensity = peakIntensities[i] * intensity_denom + 0.5;
     if (mz < last) {
       // Unsorted peaks, this should never happen since peaks get sorted earlier
       carp(CARP_FATAL, "Peaks are not sorted");
@@ -148,7 +194,8 @@ void SpectrumRecordWriter::addPeaks(
  * See how much precision is given in the peak data
  */
 void SpectrumRecordWriter::getDenoms(
-  const Crux::Spectrum* s,  ///< spectra with peaks to check
+  const vector<FLOAT_T>& peakMzs,  ///< values to check
+  const vector<FLOAT_T>& peakIntensities,  ///< values to check
   int* mzDenom, ///< out parameter for m/z denom
   int* intensityDenom ///< out parameter for intensity denom
 ) {
@@ -161,15 +208,15 @@ void SpectrumRecordWriter::getDenoms(
     if (!mzDenomOk && !intensityDenomOk) {
       return;
     }
-    for (PeakIterator i = s->begin(); i != s->end(); ++i) {
+    for (size_t i = 0; i < peakMzs.size(); ++i) {
       if (mzDenomOk) {
-        double mzX = (*i)->getLocation() * precision;
+        double mzX = peakMzs[i] * precision;
         if (fabs(mzX - google::protobuf::uint64(mzX + 0.5)) >= 0.001) {
           mzDenomOk = false;
         }
       }
       if (intensityDenomOk) {
-        double intensityX = (*i)->getIntensity() * precision;
+        double intensityX = peakIntensities[i] * precision;
         if (fabs(intensityX - google::protobuf::uint64(intensityX + 0.5)) >= 0.001) {
           intensityDenomOk = false;
         }
@@ -187,6 +234,275 @@ void SpectrumRecordWriter::getDenoms(
   }
 }
 
+/**
+ * Converts a text MS2 file to spectrumrecords format without going through
+ * a spectrum collection, giving the records that reading it with MSToolkit
+ * would.
+ */
+bool SpectrumRecordWriter::convertMs2(
+  const string& infile, ///< MS2 file to convert
+  const string& outfile  ///< spectrumrecords file to output
+) {
+  boost::iostreams::mapped_file_source file;
+  try {
+    file.open(infile);
+  } catch (const std::exception& e) {
+    carp(CARP_DEBUG, "Could not map %s: %s", infile.c_str(), e.what());
+    return false;
+  }
+  if (!file.is_open() || file.size() == 0) {
+    return false;
+  }
+
+  string range_string = Params::GetString("scan-number");
+  int first_scan;
+  int last_scan;
+  if (!get_range_from_string(range_string, first_scan, last_scan)) {
+    carp(CARP_FATAL, "The scan number range '%s' is invalid. "
+         "Must be of the form <first>-<last>.", range_string.c_str());
+  }
+  bool ignore_no_charge = Params::GetBool("pm-ignore-no-charge");
+  int num_threads = Params::GetInt("num-threads");
+  if (num_threads < 1) {
+    num_threads = boost::thread::hardware_concurrency();
+  }
+  num_threads = max(num_threads, 1);
+
+  // Split the file at the first S line after every kChunkSize bytes
+  const size_t kChunkSize = 1 << 24;
+  const char* data = file.data();
+  const char* data_end = data + file.size();
+  vector<const char*> starts(1, data);
+  while (data_end - starts.back() > (ptrdiff_t)kChunkSize) {
+    const char* p = starts.back() + kChunkSize - 1;
+    const char* start = NULL;
+    while (start == NULL &&
+           (p = (const char*)memchr(p, '\n', data_end - p)) != NULL) {
+      if (++p < data_end && *p == 'S') {
+        start = p;
+      }
+    }
+    if (start == NULL) {
+      break;
+    }
+    starts.push_back(start);
+  }
+  starts.push_back(data_end);
+  size_t num_chunks = starts.size() - 1;
+
+  pb::Header header;
+  header.set_file_type(pb::Header::SPECTRA);
+  pb::Header_Source* source = header.add_source();
+  source->set_filename(infile);
+  size_t pos = infile.rfind('.');
+  source->set_filetype(infile.substr(pos + 1));
+  header.mutable_spectra_header()->set_sorted(false);
+
+  SpectraWriter writer(outfile, header, Params::GetInt("spectrumrecords-version"));
+  if (!writer.OK()) {
+    return false;
+  }
+
+  // Parse one chunk per thread at a time and write their records in order,
+  // so that only that much of the file is held as records
+  for (size_t first = 0; first < num_chunks; first += num_threads) {
+    size_t count = min((size_t)num_threads, num_chunks - first);
+    vector<Ms2Chunk> chunks(count);
+    boost::thread_group threads;
+    for (size_t i = 0; i < count; i++) {
+      chunks[i].begin = starts[first + i];
+      chunks[i].end = starts[first + i + 1];
+      if (i > 0) {
+        threads.create_thread(boost::bind(&SpectrumRecordWriter::parseMs2Chunk,
+                                          &chunks[i], ignore_no_charge));
+      }
+    }
+    parseMs2Chunk(&chunks[0], ignore_no_charge);
+    threads.join_all();
+
+    for (vector<Ms2Chunk>::const_iterator i = chunks.begin(); i != chunks.end(); ++i) {
+      for (size_t j = 0; j < i->scans.size(); j++) {
+        if (i->scans[j] < first_scan) {
+          continue;
+        } else if (i->scans[j] > last_scan) {
+          // MSToolkit stops reading here
+          return writer.Close();
+        }
+        for (vector<pb::Spectrum>::const_iterator k = i->spectra[j].begin();
+             k != i->spectra[j].end();
+             ++k) {
+          writer.Write(&*k);
+        }
+      }
+      if (!i->complete) {
+        return false;
+      }
+    }
+  }
+  return writer.Close();
+}
+
+/**
+ * Parses a number at p the way strtod does, returning the end of the
+ * number, or NULL if strtod has to be used instead. Numbers without an
+ * exponent and with at most 15 significant digits, which covers the peaks
+ * in MS2 files, are the quotient of two exactly representable doubles,
+ * which is correctly rounded, as strtod's result is.
+ */
+static const char* parseMs2Number(
+  const char* p,
+  const char* end,
+  double* value
+) {
+  static const double kPowersOf10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  while (p < end && (*p == ' ' || *p == '\t')) {
+    ++p;
+  }
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p++ == '-';
+  }
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int fraction_digits = 0;
+  bool any_digits = false;
+  bool point = false;
+  for (; p < end; ++p) {
+    if (*p >= '0' && *p <= '9') {
+      any_digits = true;
+      if (mantissa > 0 || *p != '0') {
+        ++digits;
+      }
+      mantissa = mantissa * 10 + (*p - '0');
+      if (point) {
+        ++fraction_digits;
+      }
+    } else if (*p == '.' && !point) {
+      point = true;
+    } else {
+      break;
+    }
+  }
+  if (!any_digits || digits > 15 || fraction_digits > 22 ||
+      (p < end && (*p == 'e' || *p == 'E' || *p == 'x' || *p == 'X'))) {
+    return NULL;
+  }
+  *value = (double)mantissa / kPowersOf10[fraction_digits];
+  if (negative) {
+    *value = -*value;
+  }
+  return p;
+}
+
+/**
+ * Parses the spectra of one piece of an MS2 file into records. Lines are
+ * read as MSToolkitSpectrumCollection::readIndexedSpectrum reads them.
+ */
+void SpectrumRecordWriter::parseMs2Chunk(
+  Ms2Chunk* chunk,
+  bool ignoreNoCharge ///< skip spectra without Z lines
+) {
+  chunk->complete = true;
+  bool have_s_line = false;
+  int scan = 0;
+  vector<SpectrumZState> zStates;
+  vector<pair<FLOAT_T, FLOAT_T> > peaks;
+  vector<FLOAT_T> peakMzs;
+  vector<FLOAT_T> peakIntensities;
+
+  const char* p = chunk->begin;
+  while (chunk->complete && (have_s_line || p < chunk->end)) {
+    const char* eol = p < chunk->end ?
+      (const char*)memchr(p, '\n', chunk->end - p) : NULL;
+    const char* line_end = eol ? eol : chunk->end;
+    if (line_end > p && line_end[-1] == '\r') {
+      --line_end;
+    }
+    bool next_spectrum = p >= chunk->end || (line_end > p && *p == 'S');
+    if (next_spectrum && have_s_line) {
+      // Records of the spectrum read so far
+      if (scan <= 0 || (zStates.empty() && !ignoreNoCharge)) {
+        chunk->complete = false;
+        break;
+      }
+      chunk->scans.push_back(scan);
+      chunk->spectra.push_back(vector<pb::Spectrum>());
+      sort(peaks.begin(), peaks.end());
+      peakMzs.clear();
+      peakIntensities.clear();
+      for (vector<pair<FLOAT_T, FLOAT_T> >::const_iterator i = peaks.begin();
+           i != peaks.end();
+           ++i) {
+        peakMzs.push_back(i->first);
+        peakIntensities.push_back(i->second);
+      }
+      if (!peakMzs.empty()) {
+        addPbSpectra(scan, zStates, peakMzs, peakIntensities, &chunk->spectra.back());
+      }
+      have_s_line = false;
+    }
+    if (p >= chunk->end) {
+      break;
+    }
+
+    if (line_end > p) {
+      switch (*p) {
+      case 'S': {
+        istringstream fields(string(p + 1, line_end));
+        int last_scan;
+        double precursor_mz;
+        if (!(fields >> scan >> last_scan >> precursor_mz)) {
+          chunk->complete = false;
+        }
+        zStates.clear();
+        peaks.clear();
+        have_s_line = true;
+        break;
+      }
+      case 'Z': {
+        istringstream fields(string(p + 1, line_end));
+        int charge;
+        double mh;
+        if (fields >> charge >> mh) {
+          zStates.push_back(SpectrumZState());
+          zStates.back().setSinglyChargedMass(mh, charge);
+        }
+        break;
+      }
+      case 'H':
+      case 'I':
+      case 'D':
+        break;
+      default: {
+        double mz;
+        double intensity;
+        const char* mz_end = parseMs2Number(p, line_end, &mz);
+        const char* intensity_end = mz_end ?
+          parseMs2Number(mz_end, line_end, &intensity) : NULL;
+        if (intensity_end != NULL) {
+          peaks.push_back(make_pair((FLOAT_T)mz, (FLOAT_T)(float)intensity));
+        } else {
+          string line(p, line_end);
+          const char* mz_start = line.c_str();
+          char* strtod_mz_end;
+          char* strtod_intensity_end;
+          mz = strtod(mz_start, &strtod_mz_end);
+          float strtod_intensity = (float)strtod(strtod_mz_end, &strtod_intensity_end);
+          if (strtod_mz_end != mz_start && strtod_intensity_end != strtod_mz_end) {
+            peaks.push_back(make_pair((FLOAT_T)mz, (FLOAT_T)strtod_intensity));
+          }
+        }
+        break;
+      }
+      }
+    }
+    p = eol ? eol + 1 : chunk->end;
+  }
+}
+
 /*
  * Local Variables:
  * mode: c
@@ -25,8 +25,32 @@ class SpectrumRecordWriter {
 
  protected:
 
+  struct Ms2Chunk;
+
   static int scanCounter_;
 
+  /**
+   * Converts a text MS2 file to spectrumrecords format without going through
+   * a spectrum collection, giving the records that reading it with MSToolkit
+   * would. The file is memory mapped and split at S lines, and the pieces are
+   * parsed in parallel. Returns false, possibly having written part of
+   * outfile, if the file cannot be mapped or has spectra that need
+   * MSToolkit: spectra without Z lines, whose charge MSToolkit guesses, and
+   * spectra numbered 0, at which MSToolkit stops reading.
+   */
+  static bool convertMs2(
+    const string& infile, ///< MS2 file to convert
+    const string& outfile  ///< spectrumrecords file to output
+  );
+
+  /**
+   * Parses the spectra of one piece of an MS2 file into records.
+   */
+  static void parseMs2Chunk(
+    Ms2Chunk* chunk,
+    bool ignoreNoCharge ///< skip spectra without Z lines
+  );
+
   /**
    * Return a pb::Spectrum from a Crux::Spectrum
    * Returns a default instance if there is a problem
@@ -35,19 +59,33 @@ class SpectrumRecordWriter {
     const Crux::Spectrum* s
   );
 
+  /**
+   * Add a pb::Spectrum for each charge state of a spectrum with peaks
+   * sorted by m/z
+   */
+  static void addPbSpectra(
+    int scanNum,
+    const vector<SpectrumZState>& zStates,
+    const vector<FLOAT_T>& peakMzs,
+    const vector<FLOAT_T>& peakIntensities,
+    vector<pb::Spectrum>* spectra
+  );
+
   /**
    * Add peaks to a pb::Spectrum
    */
   static void addPeaks(
     pb::Spectrum* spectrum,
-    const Crux::Spectrum* s
+    const vector<FLOAT_T>& peakMzs,
+    const vector<FLOAT_T>& peakIntensities
   );
 
   /**
    * See how much precision is given in the vals array.
    */
   static void getDenoms(
-    const Crux::Spectrum* s,  ///< values to check
+    const vector<FLOAT_T>& peakMzs,  ///< values to check
+    const vector<FLOAT_T>& peakIntensities,  ///< values to check
     int* mzDenom, ///< out parameter for m/z denom
     int* intensityDenom ///< out parameter for intensity denom
   );
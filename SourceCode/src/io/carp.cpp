@@ -5,12 +5,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <vector>
+#include <boost/thread.hpp>
 #include "carp.h"
 #include "util/crux-utils.h"
 #include "parameter.h"
 #include "util/Params.h"
 #include "util/utils.h"
 
+#ifdef _MSC_VER
+#include "util/WinCrux.h"
+#endif
+
 using namespace std;
 
 /**
@@ -19,6 +25,30 @@ using namespace std;
 static int G_verbosity; 
 static FILE* log_file = NULL;
 
+/**
+ * Messages are written under write_lock. While carp_begin_async is in
+ * effect, carp only appends messages to queued, under queue_lock, and the
+ * writer thread writes them. Whoever writes takes write_lock before
+ * queue_lock, so that messages come out in the order they were queued.
+ *
+ * The state is never destroyed, since a fatal carp exits while the writer
+ * thread may be waiting on it.
+ */
+struct CarpQueue {
+  boost::mutex write_lock;
+  boost::mutex queue_lock;
+  boost::condition_variable queue_ready;
+  vector<string> queued;
+  boost::thread* writer_thread;
+  bool stop_writer;
+  CarpQueue() : writer_thread(NULL), stop_writer(false) {}
+};
+
+static CarpQueue& carp_queue() {
+  static CarpQueue* queue = new CarpQueue();
+  return *queue;
+}
+
 unsigned int hash_size_ = 1000;
 
 void set_verbosity_level(int verbosity) {
@@ -59,11 +89,91 @@ void log_command_line(int argc, char *argv[]) {
   }
 }
 
-static void carp_print(const char *string) {
-  fprintf(stderr, "%s", string);
+/**
+ * Writes the queued messages, then message unless it is NULL. The caller
+ * holds write_lock.
+ */
+static void carp_write(const string* message) {
+  CarpQueue& q = carp_queue();
+  vector<string> messages;
+  {
+    boost::mutex::scoped_lock lock(q.queue_lock);
+    messages.swap(q.queued);
+  }
+  if (message != NULL) {
+    messages.push_back(*message);
+  }
+  for (vector<string>::const_iterator i = messages.begin(); i != messages.end(); ++i) {
+    fputs(i->c_str(), stderr);
+    if (log_file != NULL) {
+      fputs(i->c_str(), log_file);
+    }
+  }
+  fflush(stderr);
   if (log_file != NULL) {
-    fprintf(log_file, "%s", string);
+    fflush(log_file);
+  }
+}
+
+static void carp_writer() {
+  CarpQueue& q = carp_queue();
+  while (true) {
+    {
+      boost::mutex::scoped_lock lock(q.queue_lock);
+      while (q.queued.empty() && !q.stop_writer) {
+        q.queue_ready.wait(lock);
+      }
+      if (q.queued.empty()) {
+        return;
+      }
+    }
+    boost::mutex::scoped_lock lock(q.write_lock);
+    carp_write(NULL);
+  }
+}
+
+void carp_begin_async() {
+  CarpQueue& q = carp_queue();
+  boost::mutex::scoped_lock lock(q.queue_lock);
+  if (q.writer_thread == NULL) {
+    q.stop_writer = false;
+    q.writer_thread = new boost::thread(carp_writer);
+  }
+}
+
+void carp_end_async() {
+  CarpQueue& q = carp_queue();
+  boost::thread* thread;
+  {
+    boost::mutex::scoped_lock lock(q.queue_lock);
+    thread = q.writer_thread;
+    q.writer_thread = NULL;
+    q.stop_writer = true;
+    q.queue_ready.notify_one();
+  }
+  if (thread != NULL) {
+    thread->join();
+    delete thread;
+  }
+}
+
+static const char* carp_prefix(int verbosity) {
+  if (verbosity == CARP_WARNING) {
+    return "WARNING: ";
+  } else if (verbosity == CARP_ERROR) {
+    return "ERROR: ";
+  } else if (verbosity == CARP_FATAL) {
+    return "FATAL: ";
+  } else if (verbosity == CARP_INFO) {
+    return "INFO: ";
+  } else if (verbosity == CARP_DETAILED_INFO) {
+    return "DETAILED INFO: ";
+  } else if (verbosity == CARP_DEBUG) {
+    return "DEBUG: ";
+  } else if (verbosity == CARP_DETAILED_DEBUG) {
+    return "DETAILED DEBUG: ";
   }
+  return "UNKNOWN: ";
 }
 
 /**
@@ -81,36 +191,33 @@ void carp( int verbosity, const char* format, ...) {
   if (verbosity <= G_verbosity) {
     va_list  argp;
 
-    if (verbosity == CARP_WARNING) {
-      carp_print("WARNING: ");
-    } else if (verbosity == CARP_ERROR) {
-      carp_print("ERROR: ");
-    } else if (verbosity == CARP_FATAL) {
-      carp_print("FATAL: ");
-    } else if (verbosity == CARP_INFO) {
-      carp_print("INFO: ");
-    } else if (verbosity == CARP_DETAILED_INFO) {
-      carp_print("DETAILED INFO: ");
-    } else if (verbosity == CARP_DEBUG) {
-      carp_print("DEBUG: ");
-    } else if (verbosity == CARP_DETAILED_DEBUG) {
-      carp_print("DETAILED DEBUG: ");
-    } else {
-      carp_print("UNKNOWN: ");
+    // Format the message once, for both outputs. Some vsnprintf
+    // implementations return -1 rather than the length when it is truncated.
+    vector<char> buffer(256);
+    while (true) {
+      va_start(argp, format);
+      int length = vsnprintf(&buffer[0], buffer.size(), format, argp);
+      va_end(argp);
+      if (length >= 0 && (size_t)length < buffer.size()) {
+        break;
+      }
+      buffer.resize(length >= 0 ? length + 1 : buffer.size() * 2);
     }
+    string message = string(carp_prefix(verbosity)) + &buffer[0] + "\n";
 
-    va_start(argp, format);
-    vfprintf(stderr, format, argp);
-    va_end(argp);
-    if (log_file != NULL) { 
-      va_start(argp, format); //BF: added to fix segfault
-      vfprintf(log_file, format, argp);
-      va_end(argp);
+    CarpQueue& q = carp_queue();
+    bool queue = false;
+    if (verbosity != CARP_FATAL) {
+      boost::mutex::scoped_lock lock(q.queue_lock);
+      if (q.writer_thread != NULL) {
+        q.queued.push_back(message);
+        q.queue_ready.notify_one();
+        queue = true;
+      }
     }
-    carp_print("\n");
-    fflush(stderr);
-    if (log_file != NULL) {
-      fflush(log_file);
+    if (!queue) {
+      boost::mutex::scoped_lock lock(q.write_lock);
+      carp_write(&message);
     }
   } 
   if (verbosity == CARP_FATAL) {
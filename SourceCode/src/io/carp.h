@@ -128,6 +128,19 @@ void carp(
   std::string& msg
 );
 
+/**
+ * Queue carp messages from here on, to be written by a background thread,
+ * so that threads that carp do not wait for the output. Fatal messages are
+ * still written before carp returns, after the messages queued before them.
+ */
+void carp_begin_async();
+
+/**
+ * Write the queued carp messages and go back to writing each message as it
+ * is carped.
+ */
+void carp_end_async();
+
 /**
  * \def carp_once( verbosity, msg, ...)
  *
@@ -292,6 +292,10 @@ void Match::printOneMatchField(
                                        peptide_mass);
     }
     break;
+  case DELTA_MASS_COL:
+    output_file->setColumnCurrentRow((MATCH_COLUMNS_T)column_idx,
+                                     getNeutralMass() - getPeptide()->calcModifiedMass());
+    break;
   case DELTA_CN_COL:
     {
       FLOAT_T delta_cn = getScore(DELTA_CN);
@@ -559,6 +563,9 @@ void Match::printOneMatchField(
   case DNSAF_SCORE_COL:
   case EMPAI_SCORE_COL:
   case PARSIMONY_RANK_COL:
+    // values only for tide-search
+  case LOCALIZATION_SCORE_COL:
+  case SITE_PROBABILITIES_COL:
     return;
   case NUMBER_MATCH_COLUMNS:
   case INVALID_COL:
@@ -1358,43 +1358,17 @@ FLOAT_T* MatchCollection::extractScores(
 }
 
 /**
- * Given a hash table that maps from a score to its q-value, assign
- * q-values to all of the matches in a given collection.
+ * Assign q-values to all of the matches in a given collection, from an
+ * array in the same order as the matches (see extractScores()).
  */
 void MatchCollection::assignQValues(
-  const map<FLOAT_T, FLOAT_T>* score_to_qvalue_hash,
-  SCORER_TYPE_T score_type,
+  const FLOAT_T* qvalues,
   SCORER_TYPE_T derived_score_type
 ){
-
-  // Iterate over the matches filling in the q-values
-  MatchIterator* match_iterator = 
-    new MatchIterator(this, score_type, false);
-
-  while(match_iterator->hasNext()){
-    Match* match = match_iterator->next();
-    FLOAT_T score = match->getScore(score_type);
-
-    FLOAT_T qvalue;
-    // If the score is not a number, punt.
-    if ( isinf(score) || isnan(score) ) {
-      carp(CARP_DEBUG, "Found inf or nan score.");
-      qvalue = numeric_limits<double>::quiet_NaN();
-    } else {
-      // Retrieve the corresponding q-value.
-      map<FLOAT_T, FLOAT_T>::const_iterator map_position 
-	= score_to_qvalue_hash->find(score);
-      if (map_position == score_to_qvalue_hash->end()) {
-	carp(CARP_FATAL,
-	     "Cannot find q-value corresponding to score of %g.",
-	     score);
-      }
-      qvalue = map_position->second;
-    }
-    match->setScore(derived_score_type, qvalue);
+  for (size_t idx = 0; idx < match_.size(); ++idx) {
+    match_[idx]->setScore(derived_score_type, qvalues[idx]);
   }
   scored_type_[derived_score_type] = true;
-  delete match_iterator;
 }
 
 /*
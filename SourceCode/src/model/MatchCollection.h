@@ -362,12 +362,11 @@ class MatchCollection {
   );
 
   /**
-   * Given a hash table that maps from a score to its q-value, assign
-   * q-values to all of the matches in a given collection.
+   * Assign q-values to all of the matches in a given collection, from an
+   * array in the same order as the matches (see extractScores()).
    */
   void assignQValues(
-    const map<FLOAT_T, FLOAT_T>* score_to_qvalue_hash,
-    SCORER_TYPE_T score_type,
+    const FLOAT_T* qvalues,
     SCORER_TYPE_T derived_score_type
     );
 
@@ -84,20 +84,27 @@ private:
 };
 
 /**
- * Return a vector of allocated Peak pointers
+ * Iterates over the peaks of a Crux::Spectrum.  Dereferencing yields a
+ * Peak*, as when peaks were stored as a vector of pointers.
  */
-std::vector<Peak*> allocate_peak_vector(unsigned int num_peaks);
-
-/**
- * Free a Peak pointer array
- */
-void free_peak_vector(std::vector<Peak*> &peaks);
+class PeakIterator {
+public:
+    PeakIterator() : peak_(NULL) {}
+    explicit PeakIterator(Peak* peak) : peak_(peak) {}
+
+    Peak* operator*() const { return peak_; }
+    PeakIterator& operator++() { ++peak_; return *this; }
+    PeakIterator operator++(int) { PeakIterator old(*this); ++peak_; return old; }
+    PeakIterator& operator--() { --peak_; return *this; }
+    PeakIterator operator+(int n) const { return PeakIterator(peak_ + n); }
+    int operator-(const PeakIterator& other) const { return (int)(peak_ - other.peak_); }
+    bool operator==(const PeakIterator& other) const { return peak_ == other.peak_; }
+    bool operator!=(const PeakIterator& other) const { return peak_ != other.peak_; }
+    bool operator<(const PeakIterator& other) const { return peak_ < other.peak_; }
 
-/**
- * Sort peaks by their intensity or location
- * Use the lib function sort()
- */
-void sort_peaks(std::vector<Peak*> &peak_array, PEAK_SORT_TYPE_T sort_type);
+private:
+    Peak* peak_;
+};
 
 /*
  * Local Variables:
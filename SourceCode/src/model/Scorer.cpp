@@ -499,7 +499,6 @@ bool Scorer::createIntensityArraySp(
   int charge               ///< the peptide charge -in 
   )
 {
-  Peak * peak = NULL;
   FLOAT_T peak_location = 0;
   FLOAT_T max_intensity = 0;
   int mz = 0;
@@ -516,13 +515,13 @@ bool Scorer::createIntensityArraySp(
     return false;
   }
   
+  const vector<FLOAT_T>& peak_mzs = spectrum->getPeakMzs();
+  const vector<FLOAT_T>& peak_intensities = spectrum->getPeakIntensities();
+
   // while there are more peaks to iterate over..
-  for (PeakIterator peak_iterator = spectrum->begin();
-    peak_iterator != spectrum->end();
-    ++peak_iterator) {
+  for (size_t peak_idx = 0; peak_idx < peak_mzs.size(); ++peak_idx) {
 
-    peak = *peak_iterator;
-    peak_location = peak->getLocation();
+    peak_location = peak_mzs[peak_idx];
 
     // skip all peaks larger than experimental mass
     if(peak_location > experimental_mass_cut_off){
@@ -550,7 +549,7 @@ bool Scorer::createIntensityArraySp(
     }
 
     // get intensity
-    intensity = sqrt(peak->getIntensity());
+    intensity = sqrt(peak_intensities[peak_idx]);
     
     // set intensity in array with correct mz, only if max peak in the bin
     if(intensity_array_[mz] < intensity){
@@ -831,14 +830,13 @@ bool Scorer::createIntensityArrayObserved(
   // while there are more peaks to iterate over..
   // find the maximum peak m/z (location)
   double max_peak = 0.0;
+  const vector<FLOAT_T>& peak_mzs = spectrum->getPeakMzs();
+  const vector<FLOAT_T>& peak_intensities = spectrum->getPeakIntensities();
 
-  for (PeakIterator peak_iterator = spectrum->begin();
-    peak_iterator != spectrum->end();
-    ++peak_iterator) {
-    Peak* peak = *peak_iterator;
-    FLOAT_T peak_location = peak->getLocation();
+  for (size_t peak_idx = 0; peak_idx < peak_mzs.size(); ++peak_idx) {
+    FLOAT_T peak_location = peak_mzs[peak_idx];
     if (peak_location < experimental_mass_cut_off && peak_location > max_peak
-        && peak->getIntensity() > 0) {
+        && peak_intensities[peak_idx] > 0) {
       max_peak = peak_location;
     }
   }
@@ -848,11 +846,8 @@ bool Scorer::createIntensityArrayObserved(
 
   // while there are more peaks to iterate over..
   // bin peaks, adjust intensties, find max for each region
-  for (PeakIterator peak_iterator = spectrum->begin();
-       peak_iterator != spectrum->end();
-       ++peak_iterator) {
-    Peak* peak = *peak_iterator;
-    FLOAT_T peak_location = peak->getLocation();
+  for (size_t peak_idx = 0; peak_idx < peak_mzs.size(); ++peak_idx) {
+    FLOAT_T peak_location = peak_mzs[peak_idx];
 
     // skip all peaks larger than experimental mass
     // skip all peaks within precursor ion mz +/- 15
@@ -879,7 +874,7 @@ bool Scorer::createIntensityArrayObserved(
     // get intensity
     // sqrt the original intensity
     FLOAT_T intensity = (stop_after >= SQUARE_ROOT_STEP)
-      ? sqrt(peak->getIntensity()) : peak->getIntensity();
+      ? sqrt(peak_intensities[peak_idx]) : peak_intensities[peak_idx];
 
     // Record the max intensity in the full spectrum
     if (intensity > max_intensity_overall) {
@@ -1075,6 +1070,78 @@ bool Scorer::createIntensityArrayXcorr(
   return true;
 }
 
+/**
+ * Preprocesses the observed spectrum for XCORR scoring, if that has
+ * not already been done.
+ */
+void Scorer::initializeXcorr(
+  Spectrum* spectrum,    ///< the spectrum to score(observed) -in
+  int charge               ///< the peptide charge -in
+  )
+{
+  if(!initialized_){
+    if(!createIntensityArrayXcorr(spectrum, charge)){
+      carp(CARP_FATAL, "failed to produce XCORR");
+    }
+  }
+}
+
+/**
+ * Scores a ladder of ions given by their neutral masses directly
+ * against the observed array.  The same sums as scoreIntensityIonSeries,
+ * without creating Ion objects.
+ * \returns the weighted sum of matched intensities, not yet scaled.
+ */
+FLOAT_T Scorer::scoreXcorrLadder(
+  const FLOAT_T* masses, ///< neutral ion masses -in
+  int num_masses, ///< number of masses -in
+  ION_TYPE_T ion_type, ///< B_ION, Y_ION or A_ION -in
+  int charge, ///< the ion charge -in
+  int shift_start, ///< index of the first shifted mass -in
+  FLOAT_T shift ///< mass added to the shifted masses -in
+  )
+{
+  FLOAT_T bin_width = bin_width_;
+  FLOAT_T bin_offset = bin_offset_;
+  int max_bin = getMaxBin();
+  FLOAT_T B_Y_sum = 0.0;
+  FLOAT_T FLANK_sum = 0.0;
+  FLOAT_T LOSS_sum = 0.0;
+  FLOAT_T h2o_mz = MASS_H2O_MONO / charge;
+  FLOAT_T nh3_mz = MASS_NH3_MONO / charge;
+
+  for (int idx = 0; idx < num_masses; idx++) {
+    FLOAT_T mass = masses[idx];
+    if (idx >= shift_start) {
+      mass += shift;
+    }
+    FLOAT_T ion_mass_z = (mass + MASS_H_MONO * charge) / charge;
+    int intensity_array_idx = INTEGERIZE(ion_mass_z, bin_width, bin_offset);
+    // skip ions that are located beyond max mz limit
+    if (intensity_array_idx >= max_bin) {
+      continue;
+    }
+    if (ion_type == A_ION) {
+      LOSS_sum += observed_[intensity_array_idx];
+      continue;
+    }
+    B_Y_sum += observed_[intensity_array_idx];
+    if (use_flanks_) {
+      FLANK_sum += observed_[intensity_array_idx-1];
+      if ((intensity_array_idx + 1) < max_bin) {
+        FLANK_sum += observed_[intensity_array_idx+1];
+      }
+    }
+    // add neutral loss of water and NH3
+    if (ion_type == B_ION) {
+      LOSS_sum += observed_[INTEGERIZE(ion_mass_z - h2o_mz, bin_width, bin_offset)];
+    }
+    LOSS_sum += observed_[INTEGERIZE(ion_mass_z - nh3_mz, bin_width, bin_offset)];
+  }
+
+  return B_Y_sum * B_Y_HEIGHT + FLANK_sum * FLANK_HEIGHT + LOSS_sum * LOSS_HEIGHT;
+}
+
 /**
  * Uses an iterative cross correlation
  *
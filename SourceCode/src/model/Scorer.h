@@ -377,6 +377,32 @@ class Scorer {
     int charge               ///< the peptide charge -in 
     );
 
+  /**
+   * Preprocesses the observed spectrum for XCORR scoring, if that has
+   * not already been done.
+   */
+  void initializeXcorr(
+    Crux::Spectrum* spectrum,    ///< the spectrum to score(observed) -in
+    int charge               ///< the peptide charge -in
+    );
+
+  /**
+   * Scores a ladder of singly typed ions given by their neutral masses
+   * directly against the observed array, as scoreIntensityIonSeries does
+   * for an ion series.  The masses from shift_start on are shifted by
+   * shift.  The scorer must have been initialized for XCORR.
+   * \returns the weighted sum of matched intensities, not yet scaled
+   * by 1/10000.
+   */
+  FLOAT_T scoreXcorrLadder(
+    const FLOAT_T* masses, ///< neutral ion masses -in
+    int num_masses, ///< number of masses -in
+    ION_TYPE_T ion_type, ///< B_ION, Y_ION or A_ION -in
+    int charge, ///< the ion charge -in
+    int shift_start, ///< index of the first shifted mass -in
+    FLOAT_T shift ///< mass added to the shifted masses -in
+    );
+
   /**
    * Uses an iterative cross correlation
    *
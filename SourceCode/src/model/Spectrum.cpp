@@ -11,6 +11,7 @@
 #include <string.h>
 #include <assert.h>
 #include <ctype.h>
+#include <algorithm>
 #include "Spectrum.h"
 #include "util/utils.h"
 #include "util/mass.h"
@@ -44,11 +45,10 @@ Spectrum::Spectrum() :
    has_total_energy_(false),
    has_lowest_sp_(false),
    has_peaks_(false),
-   sorted_by_mz_(false),
+   sorted_by_mz_(true),
    sorted_by_intensity_(false),
-   has_mz_peak_array_(false)
+   has_peak_views_(false)
 {
-  mz_peak_array_ = NULL;
 }
 
 /**
@@ -72,11 +72,10 @@ Spectrum::Spectrum (
    has_lowest_sp_(false),
    filename_(filename),
    has_peaks_(false),
-   sorted_by_mz_(false),
+   sorted_by_mz_(true),
    sorted_by_intensity_(false),
-   has_mz_peak_array_(false)
- {
-  mz_peak_array_ = NULL;
+   has_peak_views_(false)
+{
 
   for (unsigned int idx=0;idx<possible_z.size();idx++) {
     SpectrumZState zstate;
@@ -90,11 +89,6 @@ Spectrum::Spectrum (
  */
 Spectrum::~Spectrum()
 {
-  free_peak_vector(peaks_);
-  
-  if(has_mz_peak_array_){
-    delete [] mz_peak_array_;
-  }
 }
 
 /**
@@ -102,7 +96,8 @@ Spectrum::~Spectrum()
  * in the spectrum
  */
 PeakIterator Spectrum::begin() const {
-  return peaks_.begin();
+  buildPeakViews();
+  return peak_views_.empty() ? PeakIterator() : PeakIterator(&peak_views_[0]);
 }
 
 /**
@@ -110,7 +105,7 @@ PeakIterator Spectrum::begin() const {
  * in the spectrum
  */
 PeakIterator Spectrum::end() const {
-  return peaks_.end();
+  return begin() + (int)peak_views_.size();
 }
 
 /**
@@ -156,11 +151,11 @@ void Spectrum::print(FILE* file) ///< output file to print at -out
   }
 
   // print peaks
-  for(int peak_idx = 0; peak_idx < (int)peaks_.size(); ++peak_idx){
+  for(int peak_idx = 0; peak_idx < (int)peak_mz_.size(); ++peak_idx){
     fprintf(file, "%.*f %.4f\n",
             mass_precision,
-            peaks_[peak_idx]->getLocation(),
-            peaks_[peak_idx]->getIntensity());
+            peak_mz_[peak_idx],
+            peak_intensity_[peak_idx]);
   }
 }
 
@@ -251,7 +246,7 @@ void Spectrum::printSqt(
 }
 
 /**
- * Copy constructor.  Deep copy--allocates new peaks for peak vector.
+ * Copy constructor.  Deep copy--copies the peak arrays.
  */
  Spectrum::Spectrum(
   const Spectrum& old_spectrum ///< the spectrum to take values from
@@ -260,6 +255,9 @@ void Spectrum::printSqt(
  last_scan_(old_spectrum.last_scan_),
  precursor_mz_(old_spectrum.precursor_mz_),
  zstates_(old_spectrum.zstates_),
+ peak_mz_(old_spectrum.peak_mz_),
+ peak_intensity_(old_spectrum.peak_intensity_),
+ peak_rank_(old_spectrum.peak_rank_),
  min_peak_mz_(old_spectrum.min_peak_mz_),
  max_peak_mz_(old_spectrum.max_peak_mz_),
  total_energy_(old_spectrum.total_energy_),
@@ -269,20 +267,8 @@ void Spectrum::printSqt(
  has_peaks_(old_spectrum.has_peaks_),
  sorted_by_mz_(old_spectrum.sorted_by_mz_),
  sorted_by_intensity_(old_spectrum.sorted_by_intensity_),
- has_mz_peak_array_(old_spectrum.has_mz_peak_array_)
+ has_peak_views_(false)
 {
-
-  // copy each peak
-  for(int peak_idx=0; peak_idx < (int)old_spectrum.peaks_.size(); ++peak_idx){
-    this->addPeak(old_spectrum.peaks_[peak_idx]->getIntensity(),
-                  old_spectrum.peaks_[peak_idx]->getLocation());
-  }
-
-  /*  Should we do this??
-  if( old_spectrum.mz_peak_array ){
-    populateMzPeakArray();
-  }
-  */
 }
 
 void Spectrum::copyFrom(Spectrum *src) {
@@ -299,19 +285,14 @@ void Spectrum::copyFrom(Spectrum *src) {
  has_peaks_ = src-> has_peaks_;
  sorted_by_mz_ = src->sorted_by_mz_;
  sorted_by_intensity_ = src->sorted_by_intensity_;
- has_mz_peak_array_ = src->has_mz_peak_array_;
  // copy each peak
- for(int peak_idx=0; peak_idx < (int)src->peaks_.size(); ++peak_idx){
-   this->addPeak(src->peaks_[peak_idx]->getIntensity(),
-                  src->peaks_[peak_idx]->getLocation());
-  }
-
-  /*  Should we do this??
-  if( old_spectrum.mz_peak_array ){
-    populateMzPeakArray();
+ for(int peak_idx=0; peak_idx < (int)src->peak_mz_.size(); ++peak_idx){
+   this->addPeak(src->peak_intensity_[peak_idx],
+                 src->peak_mz_[peak_idx]);
   }
-  */
-
+ if (!src->peak_rank_.empty() && src->peak_rank_.size() == peak_mz_.size()) {
+   peak_rank_ = src->peak_rank_;
+ }
 }
 
 /**
@@ -326,10 +307,9 @@ bool Spectrum::parseMstoolkitSpectrum
   // clear any existing values
   zstates_.clear();
 
-  free_peak_vector(peaks_);
+  clearPeaks();
   i_lines_v_.clear();
   d_lines_v_.clear();
-  if( mz_peak_array_ ){ delete [] mz_peak_array_; }
 
   MSToolkit::Spectrum* mst_real_spectrum = (MSToolkit::Spectrum*)mst_spectrum;
 
@@ -342,6 +322,8 @@ bool Spectrum::parseMstoolkitSpectrum
   filename_ = filename;
 
   //add all peaks.
+  peak_mz_.reserve(mst_real_spectrum->size());
+  peak_intensity_.reserve(mst_real_spectrum->size());
   for(int peak_idx = 0; peak_idx < (int)mst_real_spectrum->size(); peak_idx++){
     this->addPeak(mst_real_spectrum->at(peak_idx).intensity,
                    mst_real_spectrum->at(peak_idx).mz);
@@ -377,10 +359,9 @@ bool Spectrum::parsePwizSpecInfo(
   // clear any existing values
   zstates_.clear();
   ezstates_.clear();
-  free_peak_vector(peaks_);
+  clearPeaks();
   i_lines_v_.clear();
   d_lines_v_.clear();
-  if( mz_peak_array_ ){ free(mz_peak_array_); }
 
   // assign new values
   first_scan_ = firstScan;
@@ -390,6 +371,8 @@ bool Spectrum::parsePwizSpecInfo(
   int num_peaks = pwiz_spectrum->defaultArrayLength;
   vector<double>& mzs = pwiz_spectrum->getMZArray()->data;
   vector<double>& intensities = pwiz_spectrum->getIntensityArray()->data;
+  peak_mz_.reserve(num_peaks);
+  peak_intensity_.reserve(num_peaks);
   for(int peak_idx = 0; peak_idx < num_peaks; peak_idx++){
     addPeak(intensities[peak_idx], mzs[peak_idx]);
   }
@@ -504,25 +487,45 @@ void Spectrum::addPeak
   FLOAT_T location_mz ///< the location of peak to add -in
   )
 {
-  Peak *peak = new Peak(intensity, location_mz);
-  peaks_.push_back(peak);
+  if (!peak_mz_.empty()) {
+    sorted_by_mz_ = sorted_by_mz_ && location_mz >= peak_mz_.back();
+    sorted_by_intensity_ = sorted_by_intensity_ &&
+      intensity <= peak_intensity_.back();
+  }
+  peak_mz_.push_back(location_mz);
+  peak_intensity_.push_back(intensity);
+  if (!peak_rank_.empty()) {
+    peak_rank_.push_back(0);
+  }
+  invalidatePeakViews();
   updateFields(intensity, location_mz);
   has_peaks_ = true;
 }
 
+/**
+ * Removes all peaks.
+ */
+void Spectrum::clearPeaks() {
+  peak_mz_.clear();
+  peak_intensity_.clear();
+  peak_rank_.clear();
+  invalidatePeakViews();
+  sorted_by_mz_ = true;
+  sorted_by_intensity_ = false;
+}
+
 void Spectrum::truncatePeaks(int count) {
   if (count < 0) {
     count = 0;
   }
-  if (peaks_.size() <= count) {
+  if (peak_mz_.size() <= (size_t)count) {
     return;
   }
   min_peak_mz_ = count > 0 ? numeric_limits<FLOAT_T>::max() : 0;
   max_peak_mz_ = 0;
-  vector<Peak*>::const_iterator removePoint = peaks_.begin() + count;
-  for (vector<Peak*>::const_iterator i = peaks_.begin(); i != peaks_.end(); i++) {
-    if (i < removePoint) {
-      FLOAT_T mz = (*i)->getLocation();
+  for (int i = 0; i < (int)peak_mz_.size(); i++) {
+    if (i < count) {
+      FLOAT_T mz = peak_mz_[i];
       if (mz < min_peak_mz_) {
         min_peak_mz_ = mz;
       }
@@ -530,92 +533,181 @@ void Spectrum::truncatePeaks(int count) {
         max_peak_mz_ = mz;
       }
     } else {
-      total_energy_ -= (*i)->getIntensity();
-      delete *i;
+      total_energy_ -= peak_intensity_[i];
     }
   }
-  peaks_.resize(count);
+  peak_mz_.resize(count);
+  peak_intensity_.resize(count);
+  if (!peak_rank_.empty()) {
+    peak_rank_.resize(count);
+  }
+  invalidatePeakViews();
 }
 
 /**
- * Creates and fills mz_peak_array_, the array of pointers to peaks
- * in the Spectrum's vector of peaks.  Peaks in the array are
- * indexed by ???
+ * Reorders the peak arrays so that the peak at order[i] moves to i.
  */
-void Spectrum::populateMzPeakArray()
-{
-  if (has_mz_peak_array_ == true){
+void Spectrum::permutePeaks(const vector<int>& order) {
+  vector<FLOAT_T> values(order.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    values[i] = peak_mz_[order[i]];
+  }
+  peak_mz_.swap(values);
+  for (size_t i = 0; i < order.size(); i++) {
+    values[i] = peak_intensity_[order[i]];
+  }
+  peak_intensity_.swap(values);
+  if (!peak_rank_.empty()) {
+    for (size_t i = 0; i < order.size(); i++) {
+      values[i] = peak_rank_[order[i]];
+    }
+    peak_rank_.swap(values);
+  }
+  invalidatePeakViews();
+}
+
+/**
+ * Drops the peak objects and m/z order, after the peaks have changed.
+ */
+void Spectrum::invalidatePeakViews() {
+  if (has_peak_views_) {
+    peak_views_.clear();
+    has_peak_views_ = false;
+  }
+  mz_order_.clear();
+}
+
+/**
+ * Builds peak_views_ from the peak arrays, if needed.
+ */
+void Spectrum::buildPeakViews() const {
+  boost::mutex::scoped_lock lock(views_lock_);
+  if (has_peak_views_) {
     return;
   }
-  
-  int array_length = MZ_TO_PEAK_ARRAY_RESOLUTION * MAX_PEAK_MZ;
-  mz_peak_array_ = new Peak * [array_length];
-  for (int peak_idx = 0; peak_idx < array_length; peak_idx++){
-    mz_peak_array_[peak_idx] = NULL;
-  }
-  for(int peak_idx = 0; peak_idx < (int)peaks_.size(); peak_idx++){
-    Peak * peak = peaks_[peak_idx];
-    FLOAT_T peak_mz = peak->getLocation();
-    int mz_idx = (int) (peak_mz * MZ_TO_PEAK_ARRAY_RESOLUTION);
-    if (mz_peak_array_[mz_idx] != NULL){
-      carp(CARP_INFO, "Peak collision at mz %.3f = %i", peak_mz, mz_idx);
-      if (mz_peak_array_[mz_idx]->getIntensity() < peak->getIntensity()) {
-        mz_peak_array_[mz_idx] = peak;
+  peak_views_.clear();
+  peak_views_.reserve(peak_mz_.size());
+  for (size_t i = 0; i < peak_mz_.size(); i++) {
+    peak_views_.push_back(Peak(peak_intensity_[i], peak_mz_[i]));
+    if (!peak_rank_.empty()) {
+      peak_views_.back().setIntensityRank(peak_rank_[i]);
+    }
+  }
+  has_peak_views_ = true;
+}
+
+/**
+ * Orders peak indices by m/z, ties by index.
+ */
+class PeakMzLess {
+ public:
+  explicit PeakMzLess(const vector<FLOAT_T>& mz) : mz_(mz) {}
+  bool operator()(int x, int y) const {
+    return mz_[x] < mz_[y] || (mz_[x] == mz_[y] && x < y);
+  }
+ private:
+  const vector<FLOAT_T>& mz_;
+};
+
+/**
+ * Orders peak indices by decreasing intensity, ties by index.
+ */
+class PeakIntensityGreater {
+ public:
+  explicit PeakIntensityGreater(const vector<FLOAT_T>& intensity)
+    : intensity_(intensity) {}
+  bool operator()(int x, int y) const {
+    return intensity_[x] > intensity_[y] ||
+      (intensity_[x] == intensity_[y] && x < y);
+  }
+ private:
+  const vector<FLOAT_T>& intensity_;
+};
+
+/**
+ * \returns The index in mz_order_ (or in the peak arrays, if sorted
+ * by m/z) of the first peak with m/z >= 'mz'.
+ */
+int Spectrum::lowerBoundMz(FLOAT_T mz) const {
+  if (sorted_by_mz_) {
+    return lower_bound(peak_mz_.begin(), peak_mz_.end(), mz) - peak_mz_.begin();
+  }
+  {
+    boost::mutex::scoped_lock lock(views_lock_);
+    if (mz_order_.size() != peak_mz_.size()) {
+      mz_order_.resize(peak_mz_.size());
+      for (size_t i = 0; i < mz_order_.size(); i++) {
+        mz_order_[i] = i;
       }
+      sort(mz_order_.begin(), mz_order_.end(), PeakMzLess(peak_mz_));
+    }
+  }
+  int lo = 0;
+  int hi = mz_order_.size();
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (peak_mz_[mz_order_[mid]] < mz) {
+      lo = mid + 1;
     } else {
-      mz_peak_array_[mz_idx] = peak; 
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/**
+ * \returns The index of the peak closest to 'mz' and no more than
+ * 'max' away, or -1 if there is none.  Ties go to the lower m/z.
+ */
+int Spectrum::getNearestPeakIndex(
+  FLOAT_T mz, ///< the mz of the peak to find -in
+  FLOAT_T max ///< the maximum distance from mz -in
+  ) const
+{
+  int pos = lowerBoundMz(mz);
+  int nearest = -1;
+  FLOAT_T min_distance = max;
+  // the nearest peak is either the last one below mz or the first one
+  // at or above it
+  if (pos > 0) {
+    int idx = peakAtMzPosition(pos - 1);
+    FLOAT_T distance = mz - peak_mz_[idx];
+    if (distance <= min_distance) {
+      nearest = idx;
+      min_distance = distance;
+    }
+  }
+  if (pos < (int)peak_mz_.size()) {
+    int idx = peakAtMzPosition(pos);
+    FLOAT_T distance = peak_mz_[idx] - mz;
+    if (nearest < 0 ? distance <= min_distance : distance < min_distance) {
+      nearest = idx;
     }
   }
-  has_mz_peak_array_ = true;
+  return nearest;
 }
 
 /**
  * \returns The closest intensity within 'max' of 'mz' in 'spectrum'
  * NULL if no peak.
- * This should lazily create the data structures within the
- * spectrum object that it needs.
- * TODO: reimplement with faster peak lookup
  */
 Peak * Spectrum::getNearestPeak(
   FLOAT_T mz, ///< the mz of the peak around which to sum intensities -in
   FLOAT_T max ///< the maximum distance to get intensity -in
   )
 {
-  this->populateMzPeakArray(); // for rapid peak lookup by mz
-
-  FLOAT_T min_distance = BILLION;
-  int min_mz_idx = (int)((mz - max) * MZ_TO_PEAK_ARRAY_RESOLUTION + 0.5);
-  min_mz_idx = min_mz_idx < 0 ? 0 : min_mz_idx;
-  int max_mz_idx = (int)((mz + max) * MZ_TO_PEAK_ARRAY_RESOLUTION + 0.5);
-  int absolute_max_mz_idx = MAX_PEAK_MZ * MZ_TO_PEAK_ARRAY_RESOLUTION - 1;
-  max_mz_idx = max_mz_idx > absolute_max_mz_idx 
-    ? absolute_max_mz_idx : max_mz_idx;
-  Peak * peak = NULL;
-  Peak * nearest_peak = NULL;
-  int peak_idx;
-  for (peak_idx=min_mz_idx; peak_idx < max_mz_idx + 1; peak_idx++){
-    if ((peak = mz_peak_array_[peak_idx]) == NULL){
-      continue;
-    }
-    FLOAT_T peak_mz = peak->getLocation();
-    FLOAT_T distance = fabs(mz - peak_mz);
-    if (distance > max){
-      continue;
-    }
-    if (distance < min_distance){
-      nearest_peak = peak;
-      min_distance = distance;
-    }
+  int idx = getNearestPeakIndex(mz, max);
+  if (idx < 0) {
+    return NULL;
   }
-  return nearest_peak;
+  buildPeakViews();
+  return &peak_views_[idx];
 }
 
 /**
  * \returns The PEAK_T within 'max' of 'mz' in 'spectrum'
  * that is the maximum intensity.
  * NULL if no peak within 'max'
- * This should lazily create the data structures within the
- * spectrum object that it needs.
  */
 Peak* Spectrum::getMaxIntensityPeak(
   FLOAT_T mz, ///< the mz of the peak to find
@@ -623,22 +715,25 @@ Peak* Spectrum::getMaxIntensityPeak(
   ) {
 
   FLOAT_T max_intensity = -BILLION;
-  Peak* max_intensity_peak = NULL;
-
-  for (PeakIterator peak_iter = begin();
-    peak_iter != end();
-    ++peak_iter) {
-
-    Peak* peak = *peak_iter;
-    FLOAT_T peak_mz = peak->getLocation();
-    FLOAT_T distance = fabs(mz - peak_mz);
-    FLOAT_T intensity = peak->getIntensity();
-    if ((distance <= max) && (intensity > max_intensity)){
-      max_intensity_peak = peak;
-      max_intensity = intensity;
+  int max_intensity_idx = -1;
+
+  // only the peaks within [mz - max, mz + max] are visited
+  for (int pos = lowerBoundMz(mz - max); pos < (int)peak_mz_.size(); pos++) {
+    int idx = peakAtMzPosition(pos);
+    FLOAT_T distance = peak_mz_[idx] - mz;
+    if (distance > max) {
+      break;
+    }
+    if (fabs(distance) <= max && peak_intensity_[idx] > max_intensity) {
+      max_intensity_idx = idx;
+      max_intensity = peak_intensity_[idx];
     }
   }
-  return max_intensity_peak;
+  if (max_intensity_idx < 0) {
+    return NULL;
+  }
+  buildPeakViews();
+  return &peak_views_[max_intensity_idx];
 }
 
 /**
@@ -649,11 +744,11 @@ void Spectrum::updateFields(
   FLOAT_T location ///< the location of the peak that has been added -in
 ) {
   // is new peak the smallest peak
-  if(peaks_.size() == 1 || min_peak_mz_ > location){
+  if(peak_mz_.size() == 1 || min_peak_mz_ > location){
     min_peak_mz_ = location;
   }
   // is new peak the largest peak
-  if(peaks_.size() == 1 || max_peak_mz_ < location){
+  if(peak_mz_.size() == 1 || max_peak_mz_ < location){
     max_peak_mz_ = location;
   }
   // update total_energy
@@ -705,7 +800,7 @@ FLOAT_T Spectrum::getMaxPeakMz()
  */
 int Spectrum::getNumPeaks() const
 {
-  return (int)peaks_.size();
+  return (int)peak_mz_.size();
 }
 
 
@@ -840,9 +935,9 @@ FLOAT_T Spectrum::getMaxPeakIntensity()
 {
   FLOAT_T max_intensity = -1;
 
-  for(int peak_idx = 0; peak_idx < (int)peaks_.size(); ++peak_idx){
-    if (max_intensity <= peaks_[peak_idx]->getIntensity()) {
-      max_intensity = peaks_[peak_idx]->getIntensity();
+  for(int peak_idx = 0; peak_idx < (int)peak_intensity_.size(); ++peak_idx){
+    if (max_intensity <= peak_intensity_[peak_idx]) {
+      max_intensity = peak_intensity_[peak_idx];
     }
   }
   return max_intensity; 
@@ -853,11 +948,10 @@ FLOAT_T Spectrum::getMaxPeakIntensity()
  */
 void Spectrum::sumNormalize()
 {
-  for(int peak_idx = 0; peak_idx < (int)peaks_.size(); peak_idx++){
-    Peak * peak = peaks_[peak_idx];
-    FLOAT_T new_intensity = peak->getIntensity() / total_energy_;
-    peak->setIntensity(new_intensity);
+  for(int peak_idx = 0; peak_idx < (int)peak_intensity_.size(); peak_idx++){
+    peak_intensity_[peak_idx] /= total_energy_;
   }
+  invalidatePeakViews();
 }
 
 /**
@@ -869,7 +963,19 @@ void Spectrum::sortPeaks(PEAK_SORT_TYPE_T type)
       (type == _PEAK_INTENSITY && sorted_by_intensity_)) {
     return;
   }
-  sort_peaks(peaks_, type);
+  vector<int> order(peak_mz_.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  if (type == _PEAK_INTENSITY) {
+    sort(order.begin(), order.end(), PeakIntensityGreater(peak_intensity_));
+  } else if (type == _PEAK_LOCATION) {
+    sort(order.begin(), order.end(), PeakMzLess(peak_mz_));
+  } else {
+    carp(CARP_ERROR, "no matching peak sort type");
+    return;
+  }
+  permutePeaks(order);
   sorted_by_mz_ = (type == _PEAK_LOCATION);
   sorted_by_intensity_ = (type == _PEAK_INTENSITY);
 }
@@ -879,16 +985,16 @@ void Spectrum::sortPeaks(PEAK_SORT_TYPE_T type)
  */
 void Spectrum::rankPeaks()
 {
-  sort_peaks(peaks_, _PEAK_INTENSITY);
-  sorted_by_intensity_ = true;
-  sorted_by_mz_ = false;
-  int rank = (int)peaks_.size();
-  for(int peak_idx = 0; peak_idx < (int) peaks_.size(); peak_idx++){
-    Peak * peak = peaks_[peak_idx];
-    FLOAT_T new_rank = rank/(float)peaks_.size();
+  sortPeaks(_PEAK_INTENSITY);
+  int num_peaks = (int)peak_intensity_.size();
+  peak_rank_.resize(num_peaks);
+  int rank = num_peaks;
+  for(int peak_idx = 0; peak_idx < num_peaks; peak_idx++){
+    FLOAT_T new_rank = rank/(float)num_peaks;
     rank--;
-    peak->setIntensityRank(new_rank);
+    peak_rank_[peak_idx] = new_rank;
   }
+  invalidatePeakViews();
 
 }
 
@@ -908,7 +1014,7 @@ bool Spectrum::assignZState() {
   carp_once(CARP_WARNING, "Spectrum %i has no charge state. Calculating charge",
             first_scan_);
   
-  if (peaks_.empty()) {
+  if (peak_mz_.empty()) {
     carp(CARP_INFO, "Cannot determine charge state of spectrum %d with no peaks.",
          first_scan_);
     return false;
@@ -917,19 +1023,19 @@ bool Spectrum::assignZState() {
   // sum peaks below and above the precursor m/z window separately
   FLOAT_T left_sum = 0.00001;
   FLOAT_T right_sum = 0.00001;
-  for (vector<Peak*>::const_iterator i = peaks_.begin(); i != peaks_.end(); i++) {
-    FLOAT_T location = (*i)->getLocation();
+  for (size_t i = 0; i < peak_mz_.size(); i++) {
+    FLOAT_T location = peak_mz_[i];
     if (location < precursor_mz_ - 20) {
-      left_sum += (*i)->getIntensity();
+      left_sum += peak_intensity_[i];
     } else if (location > precursor_mz_ + 20) {
-      right_sum += (*i)->getIntensity();
+      right_sum += peak_intensity_[i];
     } // else, skip peaks around precursor
   }
 
   // What is the justification for this? Ask Mike MacCoss
   FLOAT_T FractionWindow = 0;
   FLOAT_T CorrectionFactor = 1;
-  FLOAT_T max_peak_mz = peaks_.back()->getLocation();
+  FLOAT_T max_peak_mz = peak_mz_.back();
   if ((precursor_mz_ * 2) >= max_peak_mz) {
     FractionWindow = (precursor_mz_ * 2) - max_peak_mz;
     CorrectionFactor = fabs((precursor_mz_ - FractionWindow)) / precursor_mz_;
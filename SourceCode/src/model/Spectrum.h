@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <vector>
 #include <string>
+#include <boost/thread/mutex.hpp>
 #include "util/utils.h"
 #include "model/objects.h"
 #include "Peak.h"
@@ -22,7 +23,8 @@
  * \class Spectrum 
  * \brief A mass spectrum
 
- * A mass spectrum consists mainly of a list of peak objects along with
+ * A mass spectrum consists mainly of a list of peaks, stored as parallel
+ * m/z and intensity arrays, along with
  * some identifying information. A single spectrum is generated from one 
  * or more "scans" of the mass spectrometer; each scan is identified by 
  * a unique increasing positive integer. The range of scans that
@@ -49,7 +51,9 @@ class Spectrum{
   FLOAT_T          precursor_mz_;  ///< The m/z of precursor (MS-MS spectra)
   std::vector<SpectrumZState> zstates_;
   std::vector<SpectrumZState> ezstates_;
-  std::vector<Peak*>  peaks_;         ///< The spectrum peaks
+  std::vector<FLOAT_T> peak_mz_;   ///< The m/z of each peak
+  std::vector<FLOAT_T> peak_intensity_; ///< The intensity of each peak
+  std::vector<FLOAT_T> peak_rank_; ///< Intensity ranks, empty until rankPeaks()
   FLOAT_T          min_peak_mz_;   ///< The minimum m/z of all peaks
   FLOAT_T          max_peak_mz_;   ///< The maximum m/z of all peaks
   double           total_energy_;  ///< The sum of intensities in all peaks
@@ -62,15 +66,25 @@ class Spectrum{
   bool             has_peaks_;  ///< Does the spectrum contain peak information
   bool             sorted_by_mz_; ///< Are the spectrum peaks sorted by m/z...
   bool             sorted_by_intensity_; ///< ... or by intensity?
-  bool             has_mz_peak_array_; ///< Is the mz_peak_array populated.
-  Peak         **mz_peak_array_;  ///< Allows rapid peak retrieval by mz.
-
-  // constants
   /**
-   * m/z resolution.  I.e., 5 == 0.2 m/z units
+   * Peak objects handed out by begin(), end(), getNearestPeak() and
+   * getMaxIntensityPeak(). Built on first use from the peak arrays and
+   * rebuilt after the peaks are added to, reordered or removed.
+   */
+  mutable std::vector<Peak> peak_views_;
+  mutable bool     has_peak_views_;
+  /**
+   * Peak indices in m/z order, used for lookups by m/z while the peaks
+   * are not sorted by m/z.  Built on first use.
+   */
+  mutable std::vector<int> mz_order_;
+  /**
+   * Guards building peak_views_ and mz_order_, which const methods do and
+   * several threads may do at once for a shared spectrum.
    */
-  static const int MZ_TO_PEAK_ARRAY_RESOLUTION = 5;
-  static const int MAX_PEAK_MZ = 5000; ///< Maximum possible m/z value.
+  mutable boost::mutex views_lock_;
+
+  // constants
   static const int MAX_CHARGE = 6;     ///< Maximum allowed charge.
   
   // private methods
@@ -82,6 +96,40 @@ class Spectrum{
      FLOAT_T location  ///< the location of the peak that has been added -in
      );
 
+  /**
+   * Removes all peaks.
+   */
+  void clearPeaks();
+
+  /**
+   * Reorders the peak arrays so that the peak at order[i] moves to i.
+   */
+  void permutePeaks(const std::vector<int>& order);
+
+  /**
+   * Drops the peak objects and m/z order, after the peaks have changed.
+   */
+  void invalidatePeakViews();
+
+  /**
+   * Builds peak_views_ from the peak arrays, if needed.
+   */
+  void buildPeakViews() const;
+
+  /**
+   * \returns The index in mz_order_ (or in the peak arrays, if sorted
+   * by m/z) of the first peak with m/z >= 'mz'.
+   */
+  int lowerBoundMz(FLOAT_T mz) const;
+
+  /**
+   * \returns The index in the peak arrays of the peak at position
+   * 'pos' in m/z order.
+   */
+  int peakAtMzPosition(int pos) const {
+    return sorted_by_mz_ ? pos : mz_order_[pos];
+  }
+
  public:
   /**
    * Default constructor.
@@ -100,7 +148,7 @@ class Spectrum{
      );
   
   /**
-   * Copy constructor.  Deep copy--allocates new peaks peak array. 
+   * Copy constructor.  Deep copy--copies the peak arrays. 
    */
   Spectrum(const Spectrum& old_spec);
 
@@ -114,7 +162,8 @@ class Spectrum{
 
   /**
    * \returns the peak iterator that signifies the start of the peaks 
-   * in the spectrum
+   * in the spectrum.  Peaks reached through the iterator are invalidated
+   * by any call that adds, reorders or removes peaks.
    */
   PeakIterator begin() const;
 
@@ -237,11 +286,30 @@ class Spectrum{
    */
   int getNumPeaks() const;
 
+  /**
+   * \returns The m/z of every peak, in the current peak order.
+   */
+  const std::vector<FLOAT_T>& getPeakMzs() const { return peak_mz_; }
+
+  /**
+   * \returns The intensity of every peak, parallel to getPeakMzs().
+   */
+  const std::vector<FLOAT_T>& getPeakIntensities() const {
+    return peak_intensity_;
+  }
+
+  /**
+   * \returns The index of the peak closest to 'mz' and no more than
+   * 'max' away, or -1 if there is none.  Ties go to the lower m/z.
+   */
+  int getNearestPeakIndex
+    (FLOAT_T mz, ///< the mz of the peak to find -in
+     FLOAT_T max ///< the maximum distance from mz -in
+     ) const;
+
   /**
    * \returns The closest PEAK_T within 'max' of 'mz' in 'spectrum'
    * NULL if no peak within 'max'
-   * This should lazily create the data structures within the
-   * spectrum object that it needs.
    */
   Peak * getNearestPeak
     (FLOAT_T mz, ///< the mz of the peak around which to sum intensities -in
@@ -252,8 +320,6 @@ class Spectrum{
    * \returns The PEAK_T within 'max' of 'mz' in 'spectrum'
    * that is the maximum intensity.
    * NULL if no peak within 'max'
-   * This should lazily create the data structures within the
-   * spectrum object that it needs.
    */
   Peak* getMaxIntensityPeak(
     FLOAT_T mz, ///< the mz of the peak to find
@@ -334,14 +400,10 @@ class Spectrum{
      FLOAT_T location_mz ///< the location of peak to add -in
      );
 
-  void truncatePeaks(int count);
-
   /**
-   * Creates and fills mz_peak_array_, the array of pointers to peaks
-   * in the Spectrum's vector of peaks.  Peaks in the array are
-   * indexed by ???
+   * Keeps only the first 'count' peaks in the current peak order.
    */
-  void populateMzPeakArray();
+  void truncatePeaks(int count);
 
   /**
    *if ms2 file dose not have any Z line then assignZState will create it  
@@ -84,3 +84,14 @@ void FileUtils::Copy(const std::string& orig, const std::string& dest) {
   }
 }
 
+long long FileUtils::Size(const string& path) {
+  return boost::filesystem::file_size(path);
+}
+
+void FileUtils::Resize(const string& path, long long size) {
+  boost::filesystem::resize_file(path, size);
+}
+
+time_t FileUtils::LastWriteTime(const string& path) {
+  return boost::filesystem::last_write_time(path);
+}
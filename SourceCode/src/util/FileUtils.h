@@ -1,6 +1,7 @@
 #ifndef FILEUTILS_H
 #define FILEUTILS_H
 
+#include <ctime>
 #include <fstream>
 #include <string>
 
@@ -19,6 +20,9 @@ class FileUtils {
   static std::string Stem(const std::string& path);
   static std::string Extension(const std::string& path);
   static void Copy(const std::string& orig, const std::string& dest);
+  static long long Size(const std::string& path);
+  static void Resize(const std::string& path, long long size);
+  static std::time_t LastWriteTime(const std::string& path);
  private:
   FileUtils();
   ~FileUtils();
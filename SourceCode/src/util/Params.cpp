@@ -258,8 +258,16 @@ Params::Params() : finalized_(false) {
     "http://proteowizard.sourceforge.net/formats.shtml\">here</a>. The alternative is "
     "<a href=\"../mstoolkit.html\">MSToolkit parser</a>. "
     "If the ProteoWizard parser fails to read your files properly, you may want to try the "
-    "MSToolkit parser instead.]]",
+    "MSToolkit parser instead.]] With mstoolkit, tide-search converts .ms2 files to "
+    "spectrumrecords with a faster, multithreaded reader; other formats, including "
+    "MGF, and all files read with pwiz are converted one spectrum at a time.",
     "Available for search-for-xlinks.", true);
+  InitBoolParam("scan-index-cache", false,
+    "When spectrum-parser = mstoolkit and spectra are read one scan at a time "
+    "from an MS2 file, save the index of scan positions in a .scanidx file "
+    "next to the MS2 file, and reuse it on later runs if the MS2 file has not "
+    "changed.",
+    "Available for spectral-counts and xlink-assign-ions.", true);
   InitBoolParam("use-z-line", true,
     "Specify whether, when parsing an MS2 spectrum file, Crux obtains the "
     "precursor mass information from the \"S\" line or the \"Z\" line. ",
@@ -298,6 +306,12 @@ Params::Params() : finalized_(false) {
   InitBoolParam("pin-output", false,
     "Output a Percolator input (PIN) file to the output directory.",
     "Available for tide-search.", true);
+  InitBoolParam("binary-output", false,
+    "Output the PSMs in a compact binary file (.psm.bin) that assign-confidence, "
+    "make-pin, psm-convert and the other commands that read tab-delimited PSMs "
+    "load much faster. If txt-output is disabled as well, the binary file "
+    "replaces the tab-delimited file.",
+    "Available for tide-search.", true);
   InitBoolParam("pout-output", false,
     "Output a Percolator [[html:<a href=\""
     "https://github.com/percolator/percolator/blob/master/src/xml/percolator_out.xsd\">]]"
@@ -327,6 +341,21 @@ Params::Params() : finalized_(false) {
     "cannot be overridden. Note that the Sp computation requires re-processing each "
     "observed spectrum, so turning on this switch involves significant computational overhead.",
     "Available for tide-search.", true);
+  InitBoolParam("cpu-scoring", false,
+    "Score the candidate peptides on the CPU instead of on the GPU, with a "
+    "dot-product program compiled for each candidate as in the original "
+    "tide-search. The programs use AVX2 or AVX-512 gather instructions when the "
+    "CPU supports them.",
+    "Available for tide-search, except with exact-p-value.", true);
+  InitBoolParam("localize-mods", false,
+    "Score the alternative placements of the variable modifications of the top target "
+    "and top decoy match of each spectrum-charge on the other residues that can carry "
+    "them, and report a localization score and site probabilities. The localization "
+    "score is the XCorr of the reported placement minus that of the best other "
+    "placement. Site probabilities give, for each residue that can carry a "
+    "modification, the probability that it does, from the XCorr of the placements. "
+    "Terminal modifications are not moved.",
+    "Available for tide-search, except with exact-p-value or peptide-centric-search.", true);
   InitBoolParam("compute-p-values", false, 
     "Estimate the parameters of the score distribution for each spectrum by fitting to a "
     "Weibull distribution, and compute a p-value for each xlink product. This option is "
@@ -345,13 +374,14 @@ Params::Params() : finalized_(false) {
     "formula for computing the discretized m/z value is floor((x/mz-bin-width) + 1.0 - mz-bin-offset), where x is the observed m/z "
     "value. For low resolution ion trap ms/ms data 1.0005079 and for high resolution ms/ms "
     "0.02 is recommended.",
-    "Available for tide-search and xlink-assign-ions.", true);
+    "Available for tide-search, tide-index with fragment-index or store-peaks and "
+    "xlink-assign-ions.", true);
   InitDoubleParam("mz-bin-offset", 0.40, 0.0, 1.0,
     "In the discretization of the m/z axes of the observed and theoretical spectra, this "
     "parameter specifies the location of the left edge of the first bin, relative to "
     "mass = 0 (i.e., mz-bin-offset = 0.xx means the left edge of the first bin will be "
     "located at +0.xx Da).",
-    "Available for tide-search.", true);
+    "Available for tide-search and tide-index with fragment-index or store-peaks.", true);
   InitStringParam("auto-mz-bin-width", "false", "false|warn|fail",
     "Automatically estimate optimal value for the mz-bin-width parameter "
     "from the spectra themselves. false=no estimation, warn=try to estimate "
@@ -438,6 +468,12 @@ Params::Params() : finalized_(false) {
     "The maximum number of modifications that can be applied to a single " 
     "peptide.",
     "Available for tide-index.", true);
+  InitBoolParam("lazy-mods", false,
+    "Store only unmodified peptides in the index, together with the variable "
+    "modifications, and generate the modified forms of each peptide during the "
+    "search, as it enters the precursor window. The index then stays the size of "
+    "the unmodified database however many modifications are allowed.",
+    "Available for tide-index.", true);
   InitIntParam("max-aas-modified", MAX_PEPTIDE_LENGTH, 0, MAX_PEPTIDE_LENGTH,
     "The maximum number of modified amino acids that can appear in one "
     "peptide.  Each aa can be modified multiple times.",
@@ -494,6 +530,62 @@ Params::Params() : finalized_(false) {
     "Show search progress by printing every n spectra searched. Set to 0 to show no "
     "search progress.",
     "Available for tide-search", true);
+  InitIntParam("checkpoint-interval", 0, 0, BILLION,
+    "Save the search progress to tide-search.checkpoint.txt in the output directory "
+    "every n seconds. If the search is interrupted, running it again with the same "
+    "parameters and input files skips the spectra that were already searched and "
+    "appends to the existing tab-delimited output. Only searches that write "
+    "tab-delimited, spectrum-centric results can be checkpointed. Set to 0 to "
+    "disable checkpoints.",
+    "Available for tide-search", true);
+  InitIntParam("index-shards", 1, 1, 1000,
+    "Split the peptides of the index into this many shards, each holding a range "
+    "of consecutive peptide masses. tide-search searches the shards one after "
+    "another, or one per process with index-shard, and merges the results.",
+    "Available for tide-index", true);
+  InitIntParam("index-shard", -1, -1, 999,
+    "Search only this shard (numbered from 0) of an index that was built with "
+    "index-shards, and write its partial results to tide-search.shard-<n>.txt in "
+    "the output directory. Once every shard has been searched, run tide-search "
+    "again with merge-shards to write the final results. Set to -1 to search all "
+    "shards.",
+    "Available for tide-search", true);
+  InitBoolParam("merge-shards", false,
+    "Merge the partial results written by index-shard searches in the output "
+    "directory into the final tab-delimited results, instead of searching.",
+    "Available for tide-search", true);
+  InitBoolParam("fragment-index", false,
+    "Also build an inverted index from the m/z bins of the singly charged b and y "
+    "ions of the peptides to the peptides, using mz-bin-width and mz-bin-offset, for "
+    "searches with fragment-candidates.",
+    "Available for tide-index", true);
+  InitBoolParam("store-peaks", false,
+    "Store the binned theoretical b and y ion peaks of each peptide in the index, "
+    "using mz-bin-width and mz-bin-offset, so that tide-search reads them instead of "
+    "computing them for every candidate. Makes the index larger. The stored peaks are "
+    "only used by searches with cpu-scoring and the same mz-bin-width and "
+    "mz-bin-offset, and cannot be stored with lazy-mods.",
+    "Available for tide-index", true);
+  InitIntParam("fragment-candidates", 0, 0, BILLION,
+    "Rank the candidate peptides of each spectrum by the number of their b and y ions "
+    "that match one of the fragment-peaks most intense peaks of the spectrum, using "
+    "the fragment ion index of the index, and score only this many of the best ranked "
+    "candidates with XCorr. Intended for open modification searches, whose wide "
+    "precursor windows admit many candidates. The difference between the spectrum "
+    "neutral mass and the peptide mass is reported in a delta mass column. Set to 0 "
+    "to score all candidates.",
+    "Available for tide-search with an index built with fragment-index, except with "
+    "exact-p-value or peptide-centric-search.", true);
+  InitIntParam("fragment-peaks", 50, 1, BILLION,
+    "Number of most intense peaks of each spectrum used to rank candidates with "
+    "fragment-candidates.",
+    "Available for tide-search", true);
+  InitIntParam("bench-proteins", 2000, 1, BILLION,
+    "Number of random proteins to generate for the benchmark proteome.",
+    "Available for tide-bench", true);
+  InitIntParam("bench-spectra", 5000, 1, BILLION,
+    "Number of synthetic spectra to generate and search.",
+    "Available for tide-bench", true);
   // Sp scoring params
   InitDoubleParam("max-mz", 4000, 0, BILLION, 
     "Used in scoring sp.",
@@ -759,6 +851,14 @@ Params::Params() : finalized_(false) {
     "the current working directory, not the Crux output directory (as specified by "
     "--output-dir). This option is not valid if multiple input spectrum files are given.",
     "Available for tide-search", true);
+  InitIntParam("spectrumrecords-version", 1, 1, 2,
+    "Format of the binarized spectra written by tide-search. Version 1 stores each "
+    "spectrum as a record. Version 2 stores the peaks in compressed blocks, in order "
+    "of precursor mass, with an index of the spectra at the end of the file, so that "
+    "tide-search keeps the peaks of each spectrum in the file until it searches the "
+    "spectrum. Both versions can be read by this tide-search, but older versions of "
+    "Crux read a version 2 file as one without spectra.",
+    "Available for tide-search", true);
   InitBoolParam("exact-p-value", false,
     "Enable the calculation of exact p-values for the XCorr score[[html: as described in "
     "<a href=\"http://www.ncbi.nlm.nih.gov/pubmed/24895379\">this article</a>]]. Calculation "
@@ -843,7 +943,8 @@ Params::Params() : finalized_(false) {
                   "Available for tide-search", true);
   InitIntParam("num-threads", 0, 0, 64,
                "0=poll CPU to set num threads; else specify num threads directly.",
-               "Available for tide-search tab-delimited files only.", true);
+               "Available for tide-search tab-delimited files only, for "
+               "spectral-counts with measure=SIN, and for sort-by-column.", true);
   /*
    * Comet parameters
    */
@@ -1660,6 +1761,11 @@ Params::Params() : finalized_(false) {
   InitBoolParam("ascending", true,
     "Sort in ascending (T) or descending (F) order.",
     "Available for sort-by-column", true);
+  InitIntParam("sort-memory", 1024, 16, 1048576,
+    "Amount of memory in megabytes to use for rows being sorted. Files larger "
+    "than this are sorted in pieces that are written to temporary files in the "
+    "current directory and then merged.",
+    "Available for sort-by-column", true);
   InitArgParam("tsv file",
     "A tab-delimited file, with column headers in the first row. Use \"-\" to read from "
     "standard input.");
@@ -1824,6 +1930,7 @@ void Params::Categorize() {
   items.insert("cterm-protein-mods-spec");
   items.insert("min-mods");
   items.insert("max-mods");
+  items.insert("lazy-mods");
   items.insert("mod");
   for (char c = 'A'; c <= 'Z'; c++) {
     items.insert(string(1, c));
@@ -1856,6 +1963,10 @@ void Params::Categorize() {
   items.insert("peptide-centric-search");
   items.insert("exact-p-value");
   items.insert("compute-sp");
+  items.insert("cpu-scoring");
+  items.insert("localize-mods");
+  items.insert("fragment-candidates");
+  items.insert("fragment-peaks");
   items.insert("spectrum-min-mz");
   items.insert("spectrum-max-mz");
   items.insert("min-peaks");
@@ -1929,6 +2040,11 @@ void Params::Categorize() {
   items.insert("num_threads");
   AddCategory("CPU threads", items);
 
+  items.clear();
+  items.insert("bench-proteins");
+  items.insert("bench-spectra");
+  AddCategory("Benchmark", items);
+
   items.clear();
   items.insert("peptide_mass_tolerance");
   items.insert("auto_peptide_mass_tolerance");
@@ -2055,12 +2171,20 @@ void Params::Categorize() {
   items.clear();
   items.insert("spectrum-format");
   items.insert("spectrum-parser");
+  items.insert("scan-index-cache");
   items.insert("list-of-files");
   items.insert("print-search-progress");
+  items.insert("checkpoint-interval");
+  items.insert("index-shards");
+  items.insert("fragment-index");
+  items.insert("store-peaks");
+  items.insert("index-shard");
+  items.insert("merge-shards");
   items.insert("use-z-line");
   items.insert("top-match");
   items.insert("concat");
   items.insert("store-spectra");
+  items.insert("spectrumrecords-version");
   items.insert("store-index");
   items.insert("xlink-print-db");
   items.insert("fileroot");
@@ -2073,6 +2197,7 @@ void Params::Categorize() {
   items.insert("pepxml-output");
   items.insert("mzid-output");
   items.insert("pin-output");
+  items.insert("binary-output");
   items.insert("pout-output");
   items.insert("output_sqtfile");
   items.insert("output_txtfile");
@@ -2095,6 +2220,7 @@ void Params::Categorize() {
   items.insert("header");
   items.insert("column-type");
   items.insert("ascending");
+  items.insert("sort-memory");
   items.insert("delimiter");
   items.insert("file-column");
   AddCategory("Input and output", items);
@@ -24,6 +24,7 @@
 #define mkdir(a, b) _mkdir(a)
 #define mkstemp _mktemp_s
 #define snprintf _snprintf
+#define vsnprintf _vsnprintf
 
 #undef NO_ERROR
 // Turn off Microsoft min and max macros
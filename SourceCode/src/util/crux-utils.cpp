@@ -1245,10 +1245,133 @@ void shuffle_floats(FLOAT_T* array, int size) {
   }
 }
 
+/**
+ * The terms of the rank regression of a Weibull tail that do not depend
+ * on the shift.  The Y values depend only on the rank of each score, so
+ * they and their running mean and sum of squared deviations are computed
+ * once per fit, and each proposed shift only has to take the logs of the
+ * shifted scores.
+ */
+struct WeibullTail {
+  const FLOAT_T* data; ///< the tail scores in descending order
+  int fit_data_points; ///< the number of scores in the tail
+  vector<double> Y;    ///< ln(-ln(1 - F)) of each rank
+  vector<double> mean_Y; ///< mean_Y[n] is the mean of the first n Y values
+  vector<double> m2_Y;   ///< m2_Y[n] is their sum of squared deviations
+};
+
+/**
+ * Computes the shift independent terms of the tail.
+ */
+static void init_weibull_tail(
+  const FLOAT_T* data, ///< the data to be fit. should be in descending order -in
+  int fit_data_points, ///< the number of data points to fit -in
+  int total_data_points, ///< the total number of data points -in
+  WeibullTail* tail ///< the tail to fill -out
+) {
+  tail->data = data;
+  tail->fit_data_points = max(fit_data_points, 0);
+  tail->Y.resize(tail->fit_data_points);
+  tail->mean_Y.assign(tail->fit_data_points + 1, 0.0);
+  tail->m2_Y.assign(tail->fit_data_points + 1, 0.0);
+  for (int idx = 0; idx < tail->fit_data_points; idx++) {
+    int reverse_idx = total_data_points - idx;
+    double F_T_idx = (reverse_idx - 0.3) / (total_data_points + 0.4);
+    double Y = log( -log(1.0 - F_T_idx) );
+    tail->Y[idx] = Y;
+    // Welford's update
+    double delta = Y - tail->mean_Y[idx];
+    tail->mean_Y[idx + 1] = tail->mean_Y[idx] + delta / (idx + 1);
+    tail->m2_Y[idx + 1] = tail->m2_Y[idx] + delta * (Y - tail->mean_Y[idx + 1]);
+  }
+}
+
+/**
+ * Fits a two-parameter Weibull distribution to the tail shifted by
+ * shift, in a single pass with Welford's updates of the means and of the
+ * sums of squared deviations and of products of deviations, which do not
+ * lose precision the way sums of squares do when the logs of the scores
+ * are close together.  Scores that are not positive after the shift end
+ * the tail.  If there are too few data points, sets correlation to 0
+ * (minimum value).
+ */
+static void fit_weibull_tail(
+  const WeibullTail& tail, ///< the tail to fit -in
+  FLOAT_T shift, ///< the amount by which to shift our data -in
+  FLOAT_T* eta,      ///< the eta parameter of the Weibull dist -out
+  FLOAT_T* beta,      ///< the beta parameter of the Weibull dist -out
+  FLOAT_T* correlation ///< the correlation -out
+) {
+  double mean_X = 0.0;
+  double m2_X = 0.0;  // sum of squared deviations of X
+  double c_XY = 0.0;  // sum of products of deviations of X and Y
+  int N = 0;
+  for (; N < tail.fit_data_points; N++) {
+    double score = tail.data[N] + shift; // move right by shift
+    if (score <= 0.0) {
+      carp(CARP_DEBUG, "Reached negative score at idx %i", N);
+      break;
+    }
+    double X = log(score);
+    double delta = X - mean_X;
+    mean_X += delta / (N + 1);
+    m2_X += delta * (X - mean_X);
+    c_XY += delta * (tail.Y[N] - tail.mean_Y[N + 1]);
+  }
+  double mean_Y = tail.mean_Y[N];
+
+  double b_num   = c_XY;
+  double b_denom = m2_X;
+  double c_denom = sqrt(b_denom * tail.m2_Y[N]);
+  if (N < 2 || !(c_denom > 0.0)) {
+    carp(CARP_DETAILED_DEBUG, "Zero denominator in correlation calculation!");
+    *correlation = 0.0; // min value
+    *eta = 0;
+    *beta = 0;
+    return;
+  }
+  double b_hat = b_num / b_denom;
+  double a_hat = mean_Y - b_hat * mean_X;
+  *beta = b_hat;
+  *eta  = exp( - a_hat / b_hat );
+  *correlation = b_num / c_denom;
+
+  carp(CARP_DETAILED_DEBUG, "shift=%.6f", shift);
+  carp(CARP_DETAILED_DEBUG, "eta=%.6f", *eta);
+  carp(CARP_DETAILED_DEBUG, "beta=%.6f", *beta);
+  carp(CARP_DETAILED_DEBUG, "correlation=%.6f", *correlation);
+}
+
+/**
+ * \returns the correlation of the fit at shift, or 0 if the fit is not
+ * a valid Weibull distribution.  According to the definition of the
+ * weibull distribution, https://en.wikipedia.org/wiki/Weibull_distribution
+ * the eta and beta parameters both have to be >0.  SJM 2016_03_03
+ */
+static FLOAT_T weibull_shift_correlation(
+  const WeibullTail& tail, ///< the tail to fit -in
+  FLOAT_T shift, ///< the shift to try -in
+  FLOAT_T* eta,      ///< the eta parameter of the Weibull dist -out
+  FLOAT_T* beta      ///< the beta parameter of the Weibull dist -out
+) {
+  FLOAT_T correlation;
+  fit_weibull_tail(tail, shift, eta, beta, &correlation);
+  if (*beta > 0 && *eta > 0 && correlation == correlation) {
+    return correlation;
+  }
+  return 0.0;
+}
+
+static const int MAX_WEIBULL_SHIFT_SCAN = 16;
+
 /**
  * Fits a three-parameter Weibull distribution to the input data. 
  * Implementation of Weibull distribution parameter estimation from 
  * http:// www.chinarel.com/onlincebook/LifeDataWeb/rank_regression_on_y.htm
+ *
+ * The shift is searched in (min_shift, max_shift]: a coarse scan of at
+ * most MAX_WEIBULL_SHIFT_SCAN shifts finds the best region, which is
+ * then narrowed to within step by golden-section search.
  * \returns eta, beta, c (which in this case is the amount the data should
  * be shifted by) and the best correlation coefficient
  */
@@ -1266,7 +1389,10 @@ void fit_three_parameter_weibull(
   FLOAT_T* correlation   ///< the best correlation -out
 ) {
   FLOAT_T correlation_tolerance = 0.1;
-  
+
+  WeibullTail tail;
+  init_weibull_tail(data, fit_data_points, total_data_points, &tail);
+
   FLOAT_T best_eta = 0.0;
   FLOAT_T best_beta = 0.0;
   FLOAT_T best_shift = 0.0;
@@ -1275,25 +1401,64 @@ void fit_three_parameter_weibull(
   FLOAT_T cur_eta = 0.0;
   FLOAT_T cur_beta = 0.0;
   FLOAT_T cur_correlation = 0.0;
-  FLOAT_T cur_shift = 0.0;
-
-  for (cur_shift = max_shift; cur_shift > min_shift ; cur_shift -= step) {
-
-    fit_two_parameter_weibull(data, fit_data_points, total_data_points, 
-                              cur_shift, &cur_eta, &cur_beta, &cur_correlation);
-    //According to the definition of the weibull distribution,
-    //https://en.wikipedia.org/wiki/Weibull_distribution
-    //the eta and beta parameters both have to be >0.
-    //Put in a check here so that any fit needs to satisfy these constraints
-    //In order to be considered.
-    //SJM 2016_03_03
-    if (cur_beta > 0 && cur_eta > 0 && cur_correlation > best_correlation){
-      best_eta = cur_eta;
-      best_beta = cur_beta;
-      best_shift = cur_shift;
-      best_correlation = cur_correlation;
-    } else if (cur_correlation < best_correlation - correlation_tolerance) {
-      break;
+
+  FLOAT_T range = max_shift - min_shift;
+  if (step > 0 && range > 0) {
+    // coarse scan down from max_shift, as the grid search did
+    FLOAT_T scan_step = max(step, range / MAX_WEIBULL_SHIFT_SCAN);
+    for (FLOAT_T cur_shift = max_shift; cur_shift > min_shift; cur_shift -= scan_step) {
+      cur_correlation = weibull_shift_correlation(tail, cur_shift, &cur_eta, &cur_beta);
+      if (cur_correlation > best_correlation) {
+        best_eta = cur_eta;
+        best_beta = cur_beta;
+        best_shift = cur_shift;
+        best_correlation = cur_correlation;
+      } else if (cur_correlation < best_correlation - correlation_tolerance) {
+        break;
+      }
+    }
+
+    // golden-section search around the best scanned shift
+    if (scan_step > step && best_correlation > 0) {
+      const FLOAT_T inv_phi = 0.6180339887498949;
+      FLOAT_T lo = max(best_shift - scan_step, min_shift);
+      FLOAT_T hi = min(best_shift + scan_step, max_shift);
+      FLOAT_T x1 = hi - inv_phi * (hi - lo);
+      FLOAT_T x2 = lo + inv_phi * (hi - lo);
+      FLOAT_T eta1, beta1, eta2, beta2;
+      FLOAT_T f1 = weibull_shift_correlation(tail, x1, &eta1, &beta1);
+      FLOAT_T f2 = weibull_shift_correlation(tail, x2, &eta2, &beta2);
+      while (hi - lo > step) {
+        if (f1 >= f2) {
+          hi = x2;
+          x2 = x1;
+          f2 = f1;
+          eta2 = eta1;
+          beta2 = beta1;
+          x1 = hi - inv_phi * (hi - lo);
+          f1 = weibull_shift_correlation(tail, x1, &eta1, &beta1);
+        } else {
+          lo = x1;
+          x1 = x2;
+          f1 = f2;
+          eta1 = eta2;
+          beta1 = beta2;
+          x2 = lo + inv_phi * (hi - lo);
+          f2 = weibull_shift_correlation(tail, x2, &eta2, &beta2);
+        }
+      }
+      if (f1 > best_correlation && x1 > min_shift) {
+        best_eta = eta1;
+        best_beta = beta1;
+        best_shift = x1;
+        best_correlation = f1;
+      }
+      if (f2 > best_correlation && x2 > min_shift) {
+        best_eta = eta2;
+        best_beta = beta2;
+        best_shift = x2;
+        best_correlation = f2;
+      }
     }
   }
 
@@ -1329,85 +1494,9 @@ void fit_two_parameter_weibull(
     FLOAT_T* beta,      ///< the beta parameter of the Weibull dist -out
     FLOAT_T* correlation ///< the best correlation -out
 ) {
-  FLOAT_T* X = (FLOAT_T*)mymalloc(sizeof(FLOAT_T) * fit_data_points); //hold data here
-
-  // transform data into an array of values for fitting
-  // shift (including only non-neg data values) and take log
-  int idx;
-  for (idx = 0; idx < fit_data_points; idx++) {
-    FLOAT_T score = data[idx] + shift; // move right by shift
-    if (score <= 0.0) {
-      carp(CARP_DEBUG, "Reached negative score at idx %i", idx);
-      fit_data_points = idx;
-      break;
-    } 
-    X[idx] = log(score);
-    // carp(CARP_DEBUG, "X[%i]=%.6f=ln(%.6f)", idx, X[idx], score);
-  }
-
-  FLOAT_T* Y   = (FLOAT_T*)mymalloc(sizeof(FLOAT_T) * fit_data_points);
-  for (idx = 0; idx < fit_data_points; idx++) {
-    int reverse_idx = total_data_points - idx;
-    FLOAT_T F_T_idx = (reverse_idx - 0.3) / (total_data_points + 0.4);
-    Y[idx] = log( -log(1.0 - F_T_idx) );
-    //carp(CARP_DEBUG, "Y[%i]=%.6f", idx, Y[idx]);
-  }
-
-  int N = fit_data_points; // rename for formula's sake
-  FLOAT_T sum_Y  = 0.0;
-  FLOAT_T sum_X  = 0.0;
-  FLOAT_T sum_XY = 0.0;
-  FLOAT_T sum_XX = 0.0;
-  for (idx = 0; idx < fit_data_points; idx++) {
-    sum_Y  += Y[idx];
-    sum_X  += X[idx];
-    sum_XX += X[idx] * X[idx];
-    sum_XY += X[idx] * Y[idx];
-  }
-  carp(CARP_DETAILED_DEBUG, "sum_X=%.6f", sum_X);
-  carp(CARP_DETAILED_DEBUG, "sum_Y=%.6f", sum_Y);
-  carp(CARP_DETAILED_DEBUG, "sum_XX=%.6f", sum_XX);
-  carp(CARP_DETAILED_DEBUG, "sum_XY=%.6f", sum_XY);
-
-  FLOAT_T b_num    = sum_XY - (sum_X * sum_Y / N);
-  carp(CARP_DETAILED_DEBUG, "b_num=%.6f", b_num);
-  FLOAT_T b_denom  = sum_XX - sum_X * sum_X / N;
-  carp(CARP_DETAILED_DEBUG, "b_denom=%.6f", b_denom);
-  FLOAT_T b_hat    = b_num / b_denom;
-
-  FLOAT_T a_hat    = (sum_Y - b_hat * sum_X) / N;
-  *beta = b_hat;
-  *eta  = exp( - a_hat / *beta );
-
-  FLOAT_T c_num   = 0.0;
-  FLOAT_T c_denom_X = 0.0;
-  FLOAT_T c_denom_Y = 0.0;
-  FLOAT_T mean_X = sum_X / N;
-  FLOAT_T mean_Y = sum_Y / N;
-  for (idx = 0; idx < N; idx++) {
-    FLOAT_T X_delta = X[idx] - mean_X; 
-    FLOAT_T Y_delta = Y[idx] - mean_Y;
-    c_num += X_delta * Y_delta;
-    c_denom_X += X_delta * X_delta;
-    c_denom_Y += Y_delta * Y_delta;
-  }
-  FLOAT_T c_denom = sqrt(c_denom_X * c_denom_Y);
-  if (c_denom == 0.0) {
-    //carp(CARP_FATAL, "Zero denominator in correlation calculation!");
-    carp(CARP_DETAILED_DEBUG, "Zero denominator in correlation calculation!");
-    *correlation = 0.0; // min value
-    *eta = 0;
-    *beta = 0;
-  } else {
-    *correlation = c_num / c_denom;
-  }
-  carp(CARP_DETAILED_DEBUG, "shift=%.6f", shift);
-  carp(CARP_DETAILED_DEBUG, "eta=%.6f", *eta);
-  carp(CARP_DETAILED_DEBUG, "beta=%.6f", *beta);
-  carp(CARP_DETAILED_DEBUG, "correlation=%.6f", *correlation);
-
-  free(Y);
-  free(X);
+  WeibullTail tail;
+  init_weibull_tail(data, fit_data_points, total_data_points, &tail);
+  fit_weibull_tail(tail, shift, eta, beta, correlation);
 }
 
 